@@ -17,11 +17,12 @@
 #   $(PYTHON_EXTRA_LDFLAGS) for embedding Python in your code.
 #
 #   You can search for some particular version of Python by passing a
-#   parameter to this macro, for example ">= '2.3.1'", or "== '2.4'". Please
-#   note that you *have* to pass also an operator along with the version to
-#   match, and pay special attention to the single quotes surrounding the
-#   version number. Don't use "PYTHON_VERSION" for this: that environment
-#   variable is declared as precious and thus reserved for the end-user.
+#   parameter to this macro, for example ">= (2, 3, 1)", or "== (2, 4)".
+#   Please note that you *have* to pass also an operator along with the
+#   version to match, given as a tuple of integers so that it compares
+#   numerically (3.10 is later than 3.8). Don't use "PYTHON_VERSION" for
+#   this: that environment variable is declared as precious and thus reserved
+#   for the end-user.
 #
 #   This macro should work for all versions of Python >= 2.1.0. As an end
 #   user, you can disable the check for the python version by setting the
@@ -117,7 +118,7 @@ to something else than an empty string.
 	if test -n "$1"; then
 		AC_MSG_CHECKING([for a version of Python $1])
 		ac_supports_python_ver=`$PYTHON -c "import sys; \
-			ver = sys.version.split ()[[0]]; \
+			ver = tuple (sys.version_info[[:3]]); \
 			print (ver $1)"`
 		if test "$ac_supports_python_ver" = "True"; then
 		   AC_MSG_RESULT([yes])
@@ -190,7 +191,7 @@ EOD`
 				ac_python_version=$PYTHON_VERSION
 			else
 				ac_python_version=`$PYTHON -c "import sys; \
-					print (sys.version[[:3]])"`
+					print ('%d.%d' % sys.version_info[[:2]])"`
 			fi
 		fi
 
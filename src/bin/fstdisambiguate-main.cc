@@ -28,6 +28,7 @@ DECLARE_double(delta);
 DECLARE_int64(nstate);
 DECLARE_string(weight);
 DECLARE_int64(subsequential_label);
+DECLARE_uint64(threads);
 
 int fstdisambiguate_main(int argc, char **argv) {
   namespace s = fst::script;
@@ -63,7 +64,7 @@ int fstdisambiguate_main(int argc, char **argv) {
 
   const s::DisambiguateOptions opts(
       FST_FLAGS_delta, weight_threshold, FST_FLAGS_nstate,
-      FST_FLAGS_subsequential_label);
+      FST_FLAGS_subsequential_label, FST_FLAGS_threads);
 
   s::Disambiguate(*ifst, &ofst, opts);
 
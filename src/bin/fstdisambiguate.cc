@@ -25,6 +25,7 @@ DEFINE_string(weight, "", "Weight threshold");
 DEFINE_int64(subsequential_label, 0,
              "Input label of arc corresponding to residual final output when"
              " producing a subsequential transducer");
+DEFINE_uint64(threads, 1, "Number of threads (0 = one per hardware thread)");
 
 int fstdisambiguate_main(int argc, char **argv);
 
@@ -30,6 +30,7 @@ DECLARE_bool(decode);
 DECLARE_bool(encode_labels);
 DECLARE_bool(encode_weights);
 DECLARE_bool(encode_reuse);
+DECLARE_uint64(threads);
 
 int fstencode_main(int argc, char **argv) {
   namespace s = fst::script;
@@ -64,12 +65,12 @@ int fstencode_main(int argc, char **argv) {
     std::unique_ptr<EncodeMapperClass> mapper(
         EncodeMapperClass::Read(mapper_name));
     if (!mapper) return 1;
-    s::Encode(fst.get(), mapper.get());
+    s::Encode(fst.get(), mapper.get(), FST_FLAGS_threads);
   } else {
     const auto flags = s::GetEncodeFlags(FST_FLAGS_encode_labels,
                                          FST_FLAGS_encode_weights);
     EncodeMapperClass mapper(fst->ArcType(), flags);
-    s::Encode(fst.get(), &mapper);
+    s::Encode(fst.get(), &mapper, FST_FLAGS_threads);
     if (!mapper.Write(mapper_name)) return 1;
   }
 
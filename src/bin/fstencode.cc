@@ -21,6 +21,8 @@ DEFINE_bool(decode, false, "Decode labels and/or weights");
 DEFINE_bool(encode_labels, false, "Encode output labels");
 DEFINE_bool(encode_weights, false, "Encode weights");
 DEFINE_bool(encode_reuse, false, "Re-use existing mapper");
+DEFINE_uint64(threads, 1,
+              "Number of threads to encode with (0 = one per hardware thread)");
 
 int fstencode_main(int argc, char **argv);
 
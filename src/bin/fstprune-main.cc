@@ -26,6 +26,7 @@
 
 DECLARE_double(delta);
 DECLARE_int64(nstate);
+DECLARE_uint64(threads);
 DECLARE_string(weight);
 
 int fstprune_main(int argc, char **argv) {
@@ -57,8 +58,8 @@ int fstprune_main(int argc, char **argv) {
           ? WeightClass::Zero(fst->WeightType())
           : WeightClass(fst->WeightType(), FST_FLAGS_weight);
 
-  s::Prune(fst.get(), weight_threshold, FST_FLAGS_nstate,
-           FST_FLAGS_delta);
+  s::Prune(fst.get(), weight_threshold, FST_FLAGS_nstate, FST_FLAGS_delta,
+           FST_FLAGS_threads);
 
   return !fst->Write(out_name);
 }
@@ -21,6 +21,9 @@
 
 DEFINE_double(delta, fst::kDelta, "Comparison/quantization delta");
 DEFINE_int64(nstate, fst::kNoStateId, "State number threshold");
+DEFINE_uint64(threads, 1,
+              "Number of threads, if there is no state number threshold "
+              "(0 = one per hardware thread)");
 DEFINE_string(weight, "", "Weight threshold");
 
 int fstprune_main(int argc, char **argv);
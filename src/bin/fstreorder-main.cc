@@ -0,0 +1,88 @@
+// Copyright 2005-2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Renumbers the states of an FST to improve its memory locality.
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+
+#include <fst/flags.h>
+#include <fst/log.h>
+#include <fst/script/getters.h>
+#include <fst/script/reorder.h>
+
+DECLARE_string(reorder_type);
+DECLARE_int32(max_length);
+DECLARE_int32(npath);
+DECLARE_uint64(seed);
+DECLARE_string(select);
+
+int fstreorder_main(int argc, char **argv) {
+  namespace s = fst::script;
+  using fst::StateReorderOptions;
+  using fst::StateReorderType;
+  using fst::script::FstClass;
+
+  std::string usage =
+      "Renumbers the states of an FST to improve its memory locality.\n\n"
+      "  Usage: ";
+  usage += argv[0];
+  usage += " [in.fst [out.fst]]\n";
+
+  std::set_new_handler(FailedNewHandler);
+  SET_FLAGS(usage.c_str(), &argc, &argv, true);
+  if (argc > 3) {
+    ShowUsage();
+    return 1;
+  }
+
+  const std::string in_name =
+      (argc > 1 && strcmp(argv[1], "-") != 0) ? argv[1] : "";
+  const std::string out_name =
+      (argc > 2 && strcmp(argv[2], "-") != 0) ? argv[2] : "";
+
+  StateReorderType reorder_type;
+  if (!s::GetStateReorderType(FST_FLAGS_reorder_type, &reorder_type)) {
+    LOG(ERROR) << argv[0] << ": Unknown or unsupported reorder type: "
+               << FST_FLAGS_reorder_type;
+    return 1;
+  }
+
+  s::RandArcSelection ras;
+  if (!s::GetRandArcSelection(FST_FLAGS_select, &ras)) {
+    LOG(ERROR) << argv[0] << ": Unknown or unsupported select type "
+               << FST_FLAGS_select;
+    return 1;
+  }
+
+  std::unique_ptr<FstClass> ifst(FstClass::Read(in_name));
+  if (!ifst) return 1;
+
+  // Writes the result with the input FST type, so that a ConstFst or
+  // CompactFst keeps its type with its states in the new order.
+  std::unique_ptr<FstClass> ofst(s::StateReorder(
+      *ifst,
+      StateReorderOptions<s::RandArcSelection>(reorder_type, ras,
+                                               FST_FLAGS_npath,
+                                               FST_FLAGS_max_length),
+      FST_FLAGS_seed));
+  if (!ofst) return 1;
+  return !ofst->Write(out_name);
+}
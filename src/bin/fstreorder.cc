@@ -0,0 +1,38 @@
+// Copyright 2005-2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+
+#include <cstdint>
+#include <limits>
+#include <random>
+
+#include <fst/flags.h>
+
+DEFINE_string(reorder_type, "bfs",
+              "Reorder type: one of \"bfs\", \"dfs\", \"rcm\" "
+              "(reverse Cuthill-McKee), \"frequency\" (of sampled paths)");
+DEFINE_int32(max_length, std::numeric_limits<int32_t>::max(),
+             "Maximum length of sampled paths");
+DEFINE_int32(npath, 1000, "Number of paths to sample");
+DEFINE_uint64(seed, std::random_device()(), "Random seed");
+DEFINE_string(select, "uniform",
+              "Selection type for sampled paths: one of "
+              " \"uniform\", \"log_prob\" (when appropriate),"
+              " \"fast_log_prob\" (when appropriate)");
+
+int fstreorder_main(int argc, char **argv);
+
+int main(int argc, char **argv) { return fstreorder_main(argc, argv); }
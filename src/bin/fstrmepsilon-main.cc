@@ -30,6 +30,7 @@ DECLARE_bool(connect);
 DECLARE_double(delta);
 DECLARE_int64(nstate);
 DECLARE_string(queue_type);
+DECLARE_uint64(threads);
 DECLARE_string(weight);
 
 int fstrmepsilon_main(int argc, char **argv) {
@@ -71,7 +72,7 @@ int fstrmepsilon_main(int argc, char **argv) {
 
   const s::RmEpsilonOptions opts(queue_type, FST_FLAGS_connect,
                                  weight_threshold, FST_FLAGS_nstate,
-                                 FST_FLAGS_delta);
+                                 FST_FLAGS_delta, FST_FLAGS_threads);
 
   s::RmEpsilon(fst.get(), opts);
 
@@ -26,6 +26,9 @@ DEFINE_int64(nstate, fst::kNoStateId, "State number threshold");
 DEFINE_string(queue_type, "auto",
               "Queue type: one of \"auto\", "
               "\"fifo\", \"lifo\", \"shortest\", \"state\", \"top\"");
+DEFINE_uint64(threads, 1,
+              "Number of threads computing epsilon-closures (0 = one per "
+              "hardware thread)");
 DEFINE_string(weight, "", "Weight threshold");
 
 int fstrmepsilon_main(int argc, char **argv);
@@ -64,8 +64,9 @@ REGISTER_FST_OPERATION(OpenFarReaderClass, ErrorArc, OpenFarReaderClassArgs);
 // FarWriterClass.
 
 std::unique_ptr<FarWriterClass> FarWriterClass::Create(
-    const std::string &source, const std::string &arc_type, FarType type) {
-  CreateFarWriterClassInnerArgs iargs(source, type);
+    const std::string &source, const std::string &arc_type, FarType type,
+    bool append) {
+  CreateFarWriterClassInnerArgs iargs(source, type, append);
   CreateFarWriterClassArgs args(iargs);
   args.retval = nullptr;
   Apply<Operation<CreateFarWriterClassArgs>>("CreateFarWriterClass", arc_type,
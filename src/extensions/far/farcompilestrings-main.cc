@@ -31,6 +31,7 @@ DECLARE_string(key_prefix);
 DECLARE_string(key_suffix);
 DECLARE_int32(generate_keys);
 DECLARE_string(far_type);
+DECLARE_bool(far_append);
 DECLARE_bool(allow_negative_labels);
 DECLARE_string(arc_type);
 DECLARE_string(entry_type);
@@ -107,7 +108,8 @@ int farcompilestrings_main(int argc, char **argv) {
   if (arc_type.empty()) return 1;
 
   std::unique_ptr<FarWriterClass> writer(
-      FarWriterClass::Create(out_far, arc_type, far_type));
+      FarWriterClass::Create(out_far, arc_type, far_type,
+                             FST_FLAGS_far_append));
   if (!writer) return 1;
 
   s::CompileStrings(
@@ -20,7 +20,9 @@ DEFINE_int32(generate_keys, 0,
              "Generate N digit numeric keys (def: use file basenames)");
 DEFINE_string(far_type, "default",
               "FAR file format type: one of: \"default\", \"fst\", "
-              "\"stlist\", \"sttable\"");
+              "\"stlist\", \"ststream\", \"sttable\"");
+DEFINE_bool(far_append, false,
+            "Append to the output FAR; only supported for the ststream type");
 DEFINE_bool(allow_negative_labels, false,
             "Allow negative labels (not recommended; may cause conflicts)");
 DEFINE_string(arc_type, "standard", "Output arc type");
@@ -27,6 +27,7 @@
 #include <fst/extensions/far/getters.h>
 
 DECLARE_string(far_type);
+DECLARE_bool(far_append);
 DECLARE_string(fst_type);
 
 int farconvert_main(int argc, char **argv) {
@@ -72,7 +73,8 @@ int farconvert_main(int argc, char **argv) {
   if (arc_type.empty()) return 1;
 
   std::unique_ptr<FarWriterClass> writer(
-      FarWriterClass::Create(out_name, arc_type, far_type));
+      FarWriterClass::Create(out_name, arc_type, far_type,
+                             FST_FLAGS_far_append));
   if (!writer) return 1;
 
   // An unspecified fst_type entails that the input FST types are preserved.
@@ -22,8 +22,10 @@ DEFINE_string(fst_type, "",
               "If empty, each FST's type is unchanged");
 DEFINE_string(far_type, "default",
               "FAR file format type: one of: \"default\", \"fst\", "
-              "\"stlist\", \"sttable\"; "
+              "\"stlist\", \"ststream\", \"sttable\"; "
               "\"default\" means use type of input FAR");
+DEFINE_bool(far_append, false,
+            "Append to the output FAR; only supported for the ststream type");
 
 int farconvert_main(int argc, char **argv);
 
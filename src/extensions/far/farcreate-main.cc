@@ -30,6 +30,7 @@ DECLARE_string(key_prefix);
 DECLARE_string(key_suffix);
 DECLARE_int32(generate_keys);
 DECLARE_string(far_type);
+DECLARE_bool(far_append);
 DECLARE_bool(file_list_input);
 
 int farcreate_main(int argc, char **argv) {
@@ -80,7 +81,8 @@ int farcreate_main(int argc, char **argv) {
   }
 
   std::unique_ptr<FarWriterClass> writer(
-      FarWriterClass::Create(out_far, arc_type, far_type));
+      FarWriterClass::Create(out_far, arc_type, far_type,
+                             FST_FLAGS_far_append));
   if (!writer) return 1;
 
   s::Create(sources, *writer, FST_FLAGS_generate_keys,
@@ -31,6 +31,7 @@ DECLARE_bool(encode_labels);
 DECLARE_bool(encode_weights);
 DECLARE_bool(encode_reuse);
 DECLARE_string(far_type);
+DECLARE_bool(far_append);
 
 int farencode_main(int argc, char **argv) {
   namespace s = fst::script;
@@ -71,7 +72,8 @@ int farencode_main(int argc, char **argv) {
   if (arc_type.empty()) return 1;
 
   std::unique_ptr<FarWriterClass> writer(
-      FarWriterClass::Create(out_name, arc_type, far_type));
+      FarWriterClass::Create(out_name, arc_type, far_type,
+                             FST_FLAGS_far_append));
   if (!writer) return 1;
 
   if (FST_FLAGS_decode) {
@@ -23,8 +23,10 @@ DEFINE_bool(encode_weights, false, "Encode weights");
 DEFINE_bool(encode_reuse, false, "Re-use existing mapper");
 DEFINE_string(far_type, "default",
               "FAR file format type: one of: \"default\", \"fst\", "
-              "\"stlist\", \"sttable\"; "
+              "\"stlist\", \"ststream\", \"sttable\"; "
               "\"default\" means use type of input FAR");
+DEFINE_bool(far_append, false,
+            "Append to the output FAR; only supported for the ststream type");
 
 int farencode_main(int argc, char **argv);
 
@@ -173,5 +173,27 @@ void PrintStrings(FarReaderClass &reader, const FarEntryType entry_type,
 
 REGISTER_FST_OPERATION_4ARCS(PrintStrings, FarPrintStringsArgs);
 
+bool ShortestPath(FarReaderClass &reader, FarWriterClass &writer,
+                  int32_t nshortest, bool unique,
+                  const std::string &weight_threshold, int64_t state_threshold,
+                  float delta, size_t num_threads, size_t batch_size) {
+  if (!internal::ArcTypesMatch(reader, writer, "ShortestPath")) return false;
+  FarShortestPathInnerArgs iargs{reader,
+                                 writer,
+                                 nshortest,
+                                 unique,
+                                 weight_threshold,
+                                 state_threshold,
+                                 delta,
+                                 num_threads,
+                                 batch_size};
+  FarShortestPathArgs args(iargs);
+  Apply<Operation<FarShortestPathArgs>>("ShortestPath", reader.ArcType(),
+                                        &args);
+  return args.retval;
+}
+
+REGISTER_FST_OPERATION_3ARCS(ShortestPath, FarShortestPathArgs);
+
 }  // namespace script
 }  // namespace fst
@@ -38,6 +38,8 @@ bool GetFarType(std::string_view str, FarType *far_type) {
     *far_type = FarType::STLIST;
   } else if (str == "sttable") {
     *far_type = FarType::STTABLE;
+  } else if (str == "ststream") {
+    *far_type = FarType::STSTREAM;
   } else if (str == "default") {
     *far_type = FarType::DEFAULT;
   } else {
@@ -70,6 +72,8 @@ std::string GetFarTypeString(FarType far_type) {
       return "stlist";
     case FarType::STTABLE:
       return "sttable";
+    case FarType::STSTREAM:
+      return "ststream";
     case FarType::DEFAULT:
       return "default";
     default:
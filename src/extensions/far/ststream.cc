@@ -0,0 +1,80 @@
+// Copyright 2005-2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+
+#include <fst/extensions/far/ststream.h>
+
+#include <array>
+#include <cstdint>
+#include <ios>
+#include <string>
+
+#include <fstream>
+#include <string_view>
+
+namespace fst {
+namespace internal {
+namespace {
+
+// Lookup tables for slice-by-8 CRC-32 computation.
+using Crc32Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+Crc32Tables MakeCrc32Tables() {
+  static constexpr uint32_t kPolynomial = 0xEDB88320;
+  Crc32Tables tables;
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int j = 0; j < 8; ++j) crc = (crc >> 1) ^ ((crc & 1) * kPolynomial);
+    tables[0][i] = crc;
+  }
+  for (uint32_t i = 0; i < 256; ++i) {
+    for (int k = 1; k < 8; ++k) {
+      tables[k][i] =
+          (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+    }
+  }
+  return tables;
+}
+
+}  // namespace
+
+uint32_t Crc32(std::string_view data, uint32_t crc) {
+  static const auto *const tables = new Crc32Tables(MakeCrc32Tables());
+  const auto &t = *tables;
+  const auto *p = reinterpret_cast<const unsigned char *>(data.data());
+  size_t size = data.size();
+  crc = ~crc;
+  for (; size >= 8; p += 8, size -= 8) {
+    const uint32_t lo = crc ^ (p[0] | p[1] << 8 | p[2] << 16 |
+                               static_cast<uint32_t>(p[3]) << 24);
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^
+          t[4][lo >> 24] ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+  }
+  for (; size > 0; ++p, --size) crc = t[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+}  // namespace internal
+
+bool IsSTStream(const std::string &source) {
+  std::ifstream strm(source, std::ios_base::in | std::ios_base::binary);
+  if (!strm) return false;
+  int32_t magic_number = 0;
+  ReadType(strm, &magic_number);
+  return magic_number == kSTStreamMagicNumber;
+}
+
+}  // namespace fst
@@ -39,6 +39,12 @@ cdef extern from "<fst/util.h>" nogil:
   bool FST_FLAGS_fst_error_fatal
 
 
+cdef extern from "<fst/parallel.h>" namespace "fst" nogil:
+
+  void ParallelFor(size_t, size_t, void (*)(size_t, void *) noexcept nogil,
+                   void *)
+
+
 cdef extern from "<fst/fstlib.h>" namespace "fst" nogil:
 
   # FST properties.
@@ -345,6 +351,8 @@ cdef extern from "<fst/script/fstscript.h>" namespace "fst::script" nogil:
 
     FstClass(const FstClass &)
 
+    FstClass(const FstClass &, bool)
+
     @staticmethod
     unique_ptr[FstClass] Read(const string &)
 
@@ -535,6 +543,33 @@ cdef extern from "<fst/script/fstscript.h>" namespace "fst::script" nogil:
 
   cdef void ArcSort(MutableFstClass *, ArcSortType)
 
+  cdef cppclass ArcArrays:
+
+    int64_t *states
+    int64_t *ilabels
+    int64_t *olabels
+    double *weights
+    int64_t *nextstates
+
+  cdef cppclass ConstArcArrays:
+
+    const int64_t *states
+    const int64_t *ilabels
+    const int64_t *olabels
+    const double *weights
+    const int64_t *nextstates
+
+  cdef int64_t CountArcs(const FstClass &, int64_t)
+
+  cdef int64_t CountStates(const FstClass &)
+
+  cdef void GetArcArrays(const FstClass &, int64_t, const ArcArrays &)
+
+  cdef void GetFinalWeights(const FstClass &, double *)
+
+  cdef bool SetArcArrays(MutableFstClass *, int64_t, int64_t, const double *,
+                         int64_t, const ConstArcArrays &)
+
   cdef bool GetClosureType(const string &, ClosureType *)
 
   cdef void Closure(MutableFstClass *, ClosureType)
@@ -800,6 +835,7 @@ cdef extern from "<fst/extensions/far/far.h>" namespace "fst" nogil:
     FAR_STTABLE "fst::FarType::STTABLE"
     FAR_STLIST "fst::FarType::STLIST"
     FAR_FST "fst::FarType::FST"
+    FAR_STSTREAM "fst::FarType::STSTREAM"
     FAR_SSTABLE "fst::FarType::SSTABLE"
 
 cdef extern from "<fst/extensions/far/getters.h>" \
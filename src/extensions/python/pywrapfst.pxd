@@ -324,7 +324,7 @@ cdef class MutableFst(Fst):
 
   cdef void _arcsort(self, sort_type=?) except *
 
-  cdef void _closure(self, closure_type=?)
+  cdef void _closure(self, closure_type=?) except *
 
   cdef void _concat(self, Fst fst2) except *
 
@@ -353,7 +353,7 @@ cdef class MutableFst(Fst):
   cdef void _push(self,
                   float delta=?,
                   bool remove_total_weight=?,
-                  reweight_type=?)
+                  reweight_type=?) except *
 
   cdef void _relabel_pairs(self, ipairs=?, opairs=?) except *
 
@@ -56,6 +56,7 @@ normal `k` prefix.
 # * _ArcIterator and _MutableArcIterator
 # * _StateIterator
 # * FST operations
+# * Batch operations
 # * Compiler
 # * FarReader and FarWriter
 # * Cleanup operations for module entrance and exit.
@@ -72,6 +73,10 @@ normal `k` prefix.
 # Cython's type annotations (e.g., `string`) are used when the variables will
 # be sent as arguments to C++ functions, but are not used for variables used
 # within the module.
+#
+# The GIL is released while the underlying C++ operations run, so Python threads
+# can run them concurrently. As in C++, an FST may be read by several threads
+# at once but must not be mutated while other threads are using it.
 
 
 ## Imports.
@@ -81,6 +86,9 @@ from cython.operator cimport address as addr       # &foo
 from cython.operator cimport dereference as deref  # *foo
 from cython.operator cimport preincrement as inc   # ++foo
 
+# Cython array type, used for buffers returned to Python.
+from cython.view cimport array as cvarray
+
 # C imports.
 from libc.time cimport time
 
@@ -234,12 +242,31 @@ cdef string path_tostring(data) except *:
   return tostring(os.fspath(data))
 
 
+cdef cvarray _new_array(Py_ssize_t size, str format):
+  """Allocates a one-dimensional array of 64-bit items.
+
+  The array supports the buffer protocol, so it can be wrapped without copying
+  by, e.g., `numpy.asarray`. Since Cython arrays cannot be empty, one extra item
+  is allocated; callers return a slice of the first `size` items.
+
+  Args:
+    size: The number of items.
+    format: A struct-style format string, either "q" (int64) or "d" (float64).
+
+  Returns:
+    A Cython array.
+
+  This function is not visible to Python users.
+  """
+  return cvarray(shape=(size + 1,), itemsize=8, format=format)
+
+
 cdef fst.FarType _get_far_type(const string &far_type) except *:
   """Matches string with the appropriate FarType enum value.
 
   Args:
     far_type: A string indicating the FAR type; one of: "fst", "stlist",
-              "sttable", "sstable", "default".
+              "ststream", "sttable", "sstable", "default".
 
   Returns:
     A FarType enum value.
@@ -1693,6 +1720,53 @@ cdef class Fst:
   def __str__(self):
     return self.print()
 
+  def arc_arrays(self, state=None):
+    """
+    arc_arrays(self, state=None)
+
+    Returns the arcs leaving a state, or all arcs, as parallel arrays.
+
+    This is much faster than iterating over the arcs when many arcs are needed
+    since no Python object is created per arc, and the GIL is released while the
+    arrays are filled. The arrays support the buffer protocol, so they can be
+    wrapped without copying by, e.g., `numpy.asarray`.
+
+    Args:
+      state: The integer index of a state, or None for all states, in which
+          case the arcs are given in state order.
+
+    Returns:
+      A tuple (states, ilabels, olabels, weights, nextstates) of equal-length
+      one-dimensional arrays giving the source state, the labels, the weight (as
+      a float64) and the destination state of each arc; all but the weights are
+      int64.
+
+    Raises:
+      FstIndexError: State index out of range.
+    """
+    cdef int64_t _state = fst.kNoStateId
+    cdef int64_t _narcs
+    if state is None:
+      _narcs = fst.CountArcs(deref(self._fst), _state)
+    else:
+      _state = state
+      _narcs = self.num_arcs(_state)
+    cdef cvarray _states = _new_array(_narcs, "q")
+    cdef cvarray _ilabels = _new_array(_narcs, "q")
+    cdef cvarray _olabels = _new_array(_narcs, "q")
+    cdef cvarray _weights = _new_array(_narcs, "d")
+    cdef cvarray _nextstates = _new_array(_narcs, "q")
+    cdef fst.ArcArrays _arrays
+    _arrays.states = <int64_t *> _states.data
+    _arrays.ilabels = <int64_t *> _ilabels.data
+    _arrays.olabels = <int64_t *> _olabels.data
+    _arrays.weights = <double *> _weights.data
+    _arrays.nextstates = <int64_t *> _nextstates.data
+    with nogil:
+      fst.GetArcArrays(deref(self._fst), _state, _arrays)
+    return (_states[:_narcs], _ilabels[:_narcs], _olabels[:_narcs],
+            _weights[:_narcs], _nextstates[:_narcs])
+
   cpdef string arc_type(self):
     """
     arc_type(self)
@@ -1720,8 +1794,10 @@ cdef class Fst:
     copy(self)
 
     Makes a copy of the FST.
+
+    The copy may safely be used in a different thread than the original.
     """
-    return _init_XFst(new fst.FstClass(deref(self._fst)))
+    return _init_XFst(new fst.FstClass(deref(self._fst), True))
 
   cpdef void draw(self,
                   source,
@@ -1823,6 +1899,25 @@ cdef class Fst:
       raise FstIndexError("State index out of range")
     return _weight
 
+  def final_weights(self):
+    """
+    final_weights(self)
+
+    Returns the final weights of all states as an array.
+
+    The GIL is released while the array is filled. The array supports the buffer
+    protocol, so it can be wrapped without copying by, e.g., `numpy.asarray`.
+
+    Returns:
+      A one-dimensional float64 array indexed by state ID; non-final states have
+      the value of the semiring zero (e.g., infinity for the tropical semiring).
+    """
+    cdef int64_t _nstates = fst.CountStates(deref(self._fst))
+    cdef cvarray _finals = _new_array(_nstates, "d")
+    with nogil:
+      fst.GetFinalWeights(deref(self._fst), <double *> _finals.data)
+    return _finals[:_nstates]
+
   cpdef string fst_type(self):
     """
     fst_type(self)
@@ -2159,7 +2254,8 @@ cdef class MutableFst(Fst):
     cdef fst.ArcSortType _sort_type
     if not fst.GetArcSortType(tostring(sort_type), addr(_sort_type)):
       raise FstArgError(f"Unknown sort type: {sort_type!r}")
-    fst.ArcSort(self._mfst.get(), _sort_type)
+    with nogil:
+      fst.ArcSort(self._mfst.get(), _sort_type)
 
   def arcsort(self, sort_type="ilabel"):
     """
@@ -2183,8 +2279,11 @@ cdef class MutableFst(Fst):
     self._arcsort(sort_type)
     return self
 
-  cdef void _closure(self, closure_type="star"):
-    fst.Closure(self._mfst.get(), _get_closure_type(tostring(closure_type)))
+  cdef void _closure(self, closure_type="star") except *:
+    cdef fst.ClosureType _closure_type = _get_closure_type(
+        tostring(closure_type))
+    with nogil:
+      fst.Closure(self._mfst.get(), _closure_type)
 
   def closure(self, closure_type="star"):
     """
@@ -2208,7 +2307,8 @@ cdef class MutableFst(Fst):
     return self
 
   cdef void _concat(self, Fst fst2) except *:
-    fst.Concat(self._mfst.get(), deref(fst2._fst))
+    with nogil:
+      fst.Concat(self._mfst.get(), deref(fst2._fst))
     self._check_mutating_imethod()
 
   def concat(self, Fst fst2):
@@ -2232,7 +2332,8 @@ cdef class MutableFst(Fst):
     return self
 
   cdef void _connect(self):
-    fst.Connect(self._mfst.get())
+    with nogil:
+      fst.Connect(self._mfst.get())
 
   def connect(self):
     """
@@ -2250,7 +2351,8 @@ cdef class MutableFst(Fst):
     return self
 
   cdef void _decode(self, EncodeMapper mapper) except *:
-    fst.Decode(self._mfst.get(), deref(mapper._mapper))
+    with nogil:
+      fst.Decode(self._mfst.get(), deref(mapper._mapper))
     self._check_mutating_imethod()
 
   def decode(self, EncodeMapper mapper):
@@ -2326,7 +2428,8 @@ cdef class MutableFst(Fst):
     return self
 
   cdef void _encode(self, EncodeMapper mapper) except *:
-    fst.Encode(self._mfst.get(), mapper._mapper.get())
+    with nogil:
+      fst.Encode(self._mfst.get(), mapper._mapper.get())
     self._check_mutating_imethod()
 
   def encode(self, EncodeMapper mapper):
@@ -2352,7 +2455,8 @@ cdef class MutableFst(Fst):
     return self
 
   cdef void _invert(self):
-    fst.Invert(self._mfst.get())
+    with nogil:
+      fst.Invert(self._mfst.get())
 
   def invert(self):
     """
@@ -2373,7 +2477,8 @@ cdef class MutableFst(Fst):
                       float delta=fst.kShortestDelta,
                       bool allow_nondet=False) except *:
     # This runs in-place when the second argument is null.
-    fst.Minimize(self._mfst.get(), NULL, delta, allow_nondet)
+    with nogil:
+      fst.Minimize(self._mfst.get(), NULL, delta, allow_nondet)
     self._check_mutating_imethod()
 
   def minimize(self, float delta=fst.kShortestDelta, bool allow_nondet=False):
@@ -2448,7 +2553,10 @@ cdef class MutableFst(Fst):
     return self._mfst.get().NumStates()
 
   cdef void _project(self, project_type) except *:
-    fst.Project(self._mfst.get(), _get_project_type(tostring(project_type)))
+    cdef fst.ProjectType _project_type = _get_project_type(
+        tostring(project_type))
+    with nogil:
+      fst.Project(self._mfst.get(), _project_type)
 
   def project(self, project_type):
     """
@@ -2477,7 +2585,8 @@ cdef class MutableFst(Fst):
     # Threshold is set to semiring Zero (no pruning) if no weight is specified.
     cdef fst.WeightClass _weight = _get_WeightClass_or_zero(self.weight_type(),
                                                             weight)
-    fst.Prune(self._mfst.get(), _weight, nstate, delta)
+    with nogil:
+      fst.Prune(self._mfst.get(), _weight, nstate, delta)
     self._check_mutating_imethod()
 
   def prune(self,
@@ -2509,11 +2618,11 @@ cdef class MutableFst(Fst):
   cdef void _push(self,
                   float delta=fst.kShortestDelta,
                   bool remove_total_weight=False,
-                  reweight_type="to_initial"):
-    fst.Push(self._mfst.get(),
-             _get_reweight_type(tostring(reweight_type)),
-             delta,
-             remove_total_weight)
+                  reweight_type="to_initial") except *:
+    cdef fst.ReweightType _reweight_type = _get_reweight_type(
+        tostring(reweight_type))
+    with nogil:
+      fst.Push(self._mfst.get(), _reweight_type, delta, remove_total_weight)
 
   def push(self,
            float delta=fst.kShortestDelta,
@@ -2557,7 +2666,8 @@ cdef class MutableFst(Fst):
         _opairs.push_back(fst.LabelPair(before, after))
     if _ipairs.empty() and _opairs.empty():
       raise FstArgError("No relabeling pairs specified")
-    fst.Relabel(self._mfst.get(), _ipairs, _opairs)
+    with nogil:
+      fst.Relabel(self._mfst.get(), _ipairs, _opairs)
     self._check_mutating_imethod()
 
   def relabel_pairs(self, ipairs=None, opairs=None):
@@ -2606,15 +2716,18 @@ cdef class MutableFst(Fst):
     cdef const fst.SymbolTable *_new_osymbols = NULL
     if new_osymbols is not None:
       _new_osymbols = new_osymbols._raw_ptr_or_raise()
-    fst.Relabel(self._mfst.get(),
-        _old_isymbols,
-        _new_isymbols,
-        tostring(unknown_isymbol),
-        attach_new_isymbols,
-        _old_osymbols,
-        _new_osymbols,
-        tostring(unknown_osymbol),
-        attach_new_osymbols)
+    cdef string _unknown_isymbol = tostring(unknown_isymbol)
+    cdef string _unknown_osymbol = tostring(unknown_osymbol)
+    with nogil:
+      fst.Relabel(self._mfst.get(),
+          _old_isymbols,
+          _new_isymbols,
+          _unknown_isymbol,
+          attach_new_isymbols,
+          _old_osymbols,
+          _new_osymbols,
+          _unknown_osymbol,
+          attach_new_osymbols)
     self._check_mutating_imethod()
 
   def relabel_tables(self,
@@ -2716,8 +2829,10 @@ cdef class MutableFst(Fst):
     cdef vector[fst.WeightClass] _potentials
     for weight in potentials:
       _potentials.push_back(_get_WeightClass_or_one(_weight_type, weight))
-    fst.Reweight(self._mfst.get(), _potentials,
-                 _get_reweight_type(tostring(reweight_type)))
+    cdef fst.ReweightType _reweight_type = _get_reweight_type(
+        tostring(reweight_type))
+    with nogil:
+      fst.Reweight(self._mfst.get(), _potentials, _reweight_type)
     self._check_mutating_imethod()
 
   def reweight(self, potentials, reweight_type="to_initial"):
@@ -2761,7 +2876,8 @@ cdef class MutableFst(Fst):
                                  _weight,
                                  nstate,
                                  delta))
-    fst.RmEpsilon(self._mfst.get(), deref(_opts))
+    with nogil:
+      fst.RmEpsilon(self._mfst.get(), deref(_opts))
     self._check_mutating_imethod()
 
   def rmepsilon(self,
@@ -2910,8 +3026,11 @@ cdef class MutableFst(Fst):
     return self
 
   cdef void _topsort(self):
+    cdef bool _acyclic
+    with nogil:
+      _acyclic = fst.TopSort(self._mfst.get())
     # TopSort returns False if the FST is cyclic, and thus can't be TopSorted.
-    if not fst.TopSort(self._mfst.get()):
+    if not _acyclic:
       logging.warning("Cannot topsort cyclic FST")
 
   def topsort(self):
@@ -2950,7 +3069,8 @@ cdef class MutableFst(Fst):
     cdef vector[const_FstClass_ptr] _fsts2
     for _fst2 in fsts2:
       _fsts2.push_back(_fst2._fst.get())
-    fst.Union(self._mfst.get(), _fsts2)
+    with nogil:
+      fst.Union(self._mfst.get(), _fsts2)
     self._check_mutating_imethod()
     return self
 
@@ -3601,8 +3721,10 @@ cdef Fst _map(Fst ifst,
       _weight = _get_WeightClass_or_one(ifst.weight_type(), weight)
   else:
       _weight = _get_WeightClass_or_zero(ifst.weight_type(), weight)
-  return _init_XFst(
-    fst.Map(deref(ifst._fst), _map_type, delta, power, _weight).release())
+  cdef unique_ptr[fst.FstClass] _tfst
+  with nogil:
+    _tfst = fst.Map(deref(ifst._fst), _map_type, delta, power, _weight)
+  return _init_XFst(_tfst.release())
 
 
 cpdef Fst arcmap(Fst ifst,
@@ -3684,7 +3806,9 @@ cpdef MutableFst compose(Fst ifst1,
   _opts.reset(
       new fst.ComposeOptions(connect,
                              _get_compose_filter(tostring(compose_filter))))
-  fst.Compose(deref(ifst1._fst), deref(ifst2._fst), _tfst.get(), deref(_opts))
+  with nogil:
+    fst.Compose(deref(ifst1._fst), deref(ifst2._fst), _tfst.get(),
+                deref(_opts))
   return _init_MutableFst(_tfst.release())
 
 
@@ -3707,7 +3831,8 @@ cpdef Fst convert(Fst ifst, fst_type=""):
   """
   cdef string _fst_type = tostring(fst_type)
   cdef unique_ptr[fst.FstClass] _tfst
-  _tfst = fst.Convert(deref(ifst._fst), _fst_type)
+  with nogil:
+    _tfst = fst.Convert(deref(ifst._fst), _fst_type)
   # Script-land Convert returns a null pointer to signal failure.
   if _tfst.get() == NULL:
     raise FstOpError(f"Conversion to {fst_type!r} failed")
@@ -3769,7 +3894,8 @@ cpdef MutableFst determinize(Fst ifst,
                                  subsequential_label,
                                  _det_type,
                                  increment_subsequential_label))
-  fst.Determinize(deref(ifst._fst), _tfst.get(), deref(_opts))
+  with nogil:
+    fst.Determinize(deref(ifst._fst), _tfst.get(), deref(_opts))
   return _init_MutableFst(_tfst.release())
 
 
@@ -3806,10 +3932,11 @@ cpdef MutableFst difference(Fst ifst1,
   _opts.reset(
       new fst.ComposeOptions(connect,
                             _get_compose_filter(tostring(compose_filter))))
-  fst.Difference(deref(ifst1._fst),
-                 deref(ifst2._fst),
-                 _tfst.get(),
-                 deref(_opts))
+  with nogil:
+    fst.Difference(deref(ifst1._fst),
+                   deref(ifst2._fst),
+                   _tfst.get(),
+                   deref(_opts))
   return _init_MutableFst(_tfst.release())
 
 
@@ -3852,7 +3979,8 @@ cpdef MutableFst disambiguate(Fst ifst,
                                   _weight,
                                   nstate,
                                   subsequential_label))
-  fst.Disambiguate(deref(ifst._fst), _tfst.get(), deref(_opts))
+  with nogil:
+    fst.Disambiguate(deref(ifst._fst), _tfst.get(), deref(_opts))
   return _init_MutableFst(_tfst.release())
 
 
@@ -3879,10 +4007,10 @@ cpdef MutableFst epsnormalize(Fst ifst, eps_norm_type="input"):
   """
   cdef unique_ptr[fst.VectorFstClass] _tfst
   _tfst.reset(new fst.VectorFstClass(ifst.arc_type()))
-  fst.EpsNormalize(
-      deref(ifst._fst),
-      _tfst.get(),
-    _get_eps_norm_type(tostring(eps_norm_type)))
+  cdef fst.EpsNormalizeType _eps_norm_type = _get_eps_norm_type(
+      tostring(eps_norm_type))
+  with nogil:
+    fst.EpsNormalize(deref(ifst._fst), _tfst.get(), _eps_norm_type)
   return _init_MutableFst(_tfst.release())
 
 
@@ -3904,7 +4032,10 @@ cpdef bool equal(Fst ifst1, Fst ifst2, float delta=fst.kDelta):
   Returns:
     True if the FSTs satisfy the above condition, else False.
   """
-  return fst.Equal(deref(ifst1._fst), deref(ifst2._fst), delta)
+  cdef bool _result
+  with nogil:
+    _result = fst.Equal(deref(ifst1._fst), deref(ifst2._fst), delta)
+  return _result
 
 
 cpdef bool equivalent(Fst ifst1, Fst ifst2, float delta=fst.kDelta):
@@ -3925,7 +4056,92 @@ cpdef bool equivalent(Fst ifst1, Fst ifst2, float delta=fst.kDelta):
   Returns:
     True if the FSTs satisfy the above condition, else False.
   """
-  return fst.Equivalent(deref(ifst1._fst), deref(ifst2._fst), delta)
+  cdef bool _result
+  with nogil:
+    _result = fst.Equivalent(deref(ifst1._fst), deref(ifst2._fst), delta)
+  return _result
+
+
+def from_arc_arrays(const int64_t[::1] states,
+                    const int64_t[::1] ilabels,
+                    const int64_t[::1] olabels,
+                    const double[::1] weights,
+                    const int64_t[::1] nextstates,
+                    const double[::1] final_weights=None,
+                    int64_t start=0,
+                    arc_type="standard",
+                    fst_type="vector"):
+  """
+  from_arc_arrays(states, ilabels, olabels, weights, nextstates,
+                  final_weights=None, start=0, arc_type="standard",
+                  fst_type="vector")
+
+  Constructs an FST from parallel arrays of arc attributes.
+
+  This is the inverse of `Fst.arc_arrays` and `Fst.final_weights`, and is much
+  faster than adding arcs one at a time. The arrays may be any contiguous
+  objects supporting the buffer protocol (e.g., NumPy arrays), and are read
+  without copying; the GIL is released during construction.
+
+  Args:
+    states: An int64 array of the source state of each arc.
+    ilabels: An int64 array of the input label of each arc.
+    olabels: An int64 array of the output label of each arc.
+    weights: A float64 array of the weight of each arc.
+    nextstates: An int64 array of the destination state of each arc.
+    final_weights: An optional float64 array of final weights indexed by state
+        ID, which also gives the number of states; if omitted, there are no
+        final states and the number of states is one more than the largest
+        state ID in the arcs.
+    start: The start state ID; with no states, the default of zero gives the
+        empty FST.
+    arc_type: A string indicating the arc type.
+    fst_type: A string indicating the FST type to convert to (e.g., "const").
+
+  Returns:
+    An FST.
+
+  Raises:
+    FstArgError: Array lengths differ.
+    FstOpError: Construction failed.
+  """
+  cdef Py_ssize_t _narcs = states.shape[0]
+  if (ilabels.shape[0] != _narcs or olabels.shape[0] != _narcs or
+      weights.shape[0] != _narcs or nextstates.shape[0] != _narcs):
+    raise FstArgError("Arc arrays must all have the same length")
+  cdef fst.ConstArcArrays _arrays
+  if _narcs:
+    _arrays.states = &states[0]
+    _arrays.ilabels = &ilabels[0]
+    _arrays.olabels = &olabels[0]
+    _arrays.weights = &weights[0]
+    _arrays.nextstates = &nextstates[0]
+  cdef int64_t _nstates = 0
+  cdef Py_ssize_t _i
+  cdef const double *_finals = NULL
+  if final_weights is not None:
+    _nstates = final_weights.shape[0]
+    if _nstates:
+      _finals = &final_weights[0]
+  else:
+    with nogil:
+      for _i in range(_narcs):
+        _nstates = max(_nstates, _arrays.states[_i] + 1,
+                       _arrays.nextstates[_i] + 1)
+  cdef unique_ptr[fst.VectorFstClass] _tfst
+  _tfst.reset(new fst.VectorFstClass(tostring(arc_type)))
+  if _tfst.get().Properties(fst.kError, True) == fst.kError:
+    raise FstOpError(f"Unknown arc type: {arc_type!r}")
+  cdef bool _success
+  with nogil:
+    _success = fst.SetArcArrays(_tfst.get(), _nstates, start, _finals, _narcs,
+                                _arrays)
+  if not _success:
+    raise FstOpError("Construction failed")
+  cdef MutableFst _ofst = _init_MutableFst(_tfst.release())
+  if fst_type == "vector":
+    return _ofst
+  return convert(_ofst, fst_type)
 
 
 cpdef MutableFst intersect(Fst ifst1,
@@ -3959,7 +4175,9 @@ cpdef MutableFst intersect(Fst ifst1,
   _opts.reset(
       new fst.ComposeOptions(connect,
                             _get_compose_filter(tostring(compose_filter))))
-  fst.Intersect(deref(ifst1._fst), deref(ifst2._fst), _tfst.get(), deref(_opts))
+  with nogil:
+    fst.Intersect(deref(ifst1._fst), deref(ifst2._fst), _tfst.get(),
+                  deref(_opts))
   return _init_MutableFst(_tfst.release())
 
 
@@ -3984,7 +4202,10 @@ cpdef bool isomorphic(Fst ifst1, Fst ifst2, float delta=fst.kDelta):
   Returns:
     True if the two transducers satisfy the above condition, else False.
   """
-  return fst.Isomorphic(deref(ifst1._fst), deref(ifst2._fst), delta)
+  cdef bool _result
+  with nogil:
+    _result = fst.Isomorphic(deref(ifst1._fst), deref(ifst2._fst), delta)
+  return _result
 
 
 cpdef MutableFst prune(Fst ifst,
@@ -4015,7 +4236,8 @@ cpdef MutableFst prune(Fst ifst,
   _tfst.reset(new fst.VectorFstClass(ifst.arc_type()))
   cdef fst.WeightClass _weight = _get_WeightClass_or_zero(ifst.weight_type(),
                                                           weight)
-  fst.Prune(deref(ifst._fst), _tfst.get(), _weight, nstate, delta)
+  with nogil:
+    fst.Prune(deref(ifst._fst), _tfst.get(), _weight, nstate, delta)
   return _init_MutableFst(_tfst.release())
 
 
@@ -4068,11 +4290,10 @@ cpdef MutableFst push(Fst ifst,
                                       push_labels,
                                       remove_common_affix,
                                       remove_total_weight)
-  fst.Push(deref(ifst._fst),
-           _tfst.get(),
-           flags,
-           _get_reweight_type(tostring(reweight_type)),
-           delta)
+  cdef fst.ReweightType _reweight_type = _get_reweight_type(
+      tostring(reweight_type))
+  with nogil:
+    fst.Push(deref(ifst._fst), _tfst.get(), flags, _reweight_type, delta)
   return _init_MutableFst(_tfst.release())
 
 
@@ -4120,12 +4341,15 @@ cpdef bool randequivalent(Fst ifst1,
                                                     False))
   if seed == 0:
     seed = time(NULL)
-  return fst.RandEquivalent(deref(ifst1._fst),
-                            deref(ifst2._fst),
-                            npath,
-                            deref(_opts),
-                            delta,
-                            seed)
+  cdef bool _result
+  with nogil:
+    _result = fst.RandEquivalent(deref(ifst1._fst),
+                                 deref(ifst2._fst),
+                                 npath,
+                                 deref(_opts),
+                                 delta,
+                                 seed)
+  return _result
 
 
 cpdef MutableFst randgen(Fst ifst,
@@ -4176,7 +4400,8 @@ cpdef MutableFst randgen(Fst ifst,
   _tfst.reset(new fst.VectorFstClass(ifst.arc_type()))
   if seed == 0:
     seed = time(NULL)
-  fst.RandGen(deref(ifst._fst), _tfst.get(), deref(_opts), seed)
+  with nogil:
+    fst.RandGen(deref(ifst._fst), _tfst.get(), deref(_opts), seed)
   return _init_MutableFst(_tfst.release())
 
 
@@ -4236,7 +4461,8 @@ cpdef MutableFst replace(pairs,
       epsilon_on_replace)
   cdef unique_ptr[fst.ReplaceOptions] _opts
   _opts.reset(new fst.ReplaceOptions(_pairs[0].first, _cal, _ral, return_label))
-  fst.Replace(_pairs, _tfst.get(), deref(_opts))
+  with nogil:
+    fst.Replace(_pairs, _tfst.get(), deref(_opts))
   return _init_MutableFst(_tfst.release())
 
 
@@ -4261,7 +4487,8 @@ cpdef MutableFst reverse(Fst ifst, bool require_superinitial=True):
   """
   cdef unique_ptr[fst.VectorFstClass] _tfst
   _tfst.reset(new fst.VectorFstClass(ifst.arc_type()))
-  fst.Reverse(deref(ifst._fst), _tfst.get(), require_superinitial)
+  with nogil:
+    fst.Reverse(deref(ifst._fst), _tfst.get(), require_superinitial)
   return _init_MutableFst(_tfst.release())
 
 
@@ -4278,14 +4505,16 @@ cdef void _shortestdistance(Fst ifst,
   if reverse:
     # Only the simpler signature supports shortest distance to final states;
     # `nstate` and `queue_type` arguments are ignored.
-    fst.ShortestDistance(deref(ifst._fst), distance, True, delta)
+    with nogil:
+      fst.ShortestDistance(deref(ifst._fst), distance, True, delta)
   else:
     _opts.reset(
         new fst.ShortestDistanceOptions(_get_queue_type(tostring(queue_type)),
                                         fst.ArcFilterType.ANY_ARC_FILTER,
                                         nstate,
                                         delta))
-    fst.ShortestDistance(deref(ifst._fst), distance, deref(_opts))
+    with nogil:
+      fst.ShortestDistance(deref(ifst._fst), distance, deref(_opts))
 
 
 def shortestdistance(Fst ifst,
@@ -4375,7 +4604,8 @@ cpdef MutableFst shortestpath(Fst ifst,
                                   delta,
                                   _weight,
                                   nstate))
-  fst.ShortestPath(deref(ifst._fst), _tfst.get(), deref(_opts))
+  with nogil:
+    fst.ShortestPath(deref(ifst._fst), _tfst.get(), deref(_opts))
   return _init_MutableFst(_tfst.release())
 
 
@@ -4426,10 +4656,81 @@ cpdef MutableFst synchronize(Fst ifst):
   """
   cdef unique_ptr[fst.VectorFstClass] _tfst
   _tfst.reset(new fst.VectorFstClass(ifst.arc_type()))
-  fst.Synchronize(deref(ifst._fst), _tfst.get())
+  with nogil:
+    fst.Synchronize(deref(ifst._fst), _tfst.get())
   return _init_MutableFst(_tfst.release())
 
 
+## Batch operations.
+
+
+cdef class _BatchApply:
+
+  """
+  (No constructor.)
+
+  State shared by the threads of a call to `batch_apply`.
+
+  This class is not visible to Python users.
+  """
+
+  cdef object _func
+  cdef list _inputs
+  cdef list _outputs
+  cdef object _error
+
+  cdef void _apply(self, size_t i):
+    try:
+      self._outputs[i] = self._func(self._inputs[i])
+    except BaseException as e:
+      # Only the first error is kept and later re-raised.
+      if self._error is None:
+        self._error = e
+
+
+cdef void _batch_apply_callback(size_t i, void *data) noexcept nogil:
+  # Holds the GIL only while calling into Python; the wrapped operations release
+  # it again while they run, so the threads work concurrently.
+  with gil:
+    (<_BatchApply> data)._apply(i)
+
+
+def batch_apply(func, fsts, size_t threads=0):
+  """
+  batch_apply(func, fsts, threads=0)
+
+  Applies a function to each of a sequence of FSTs on a pool of threads.
+
+  The FST operations in this module release the GIL while they run, so this
+  runs independent operations (e.g., `lambda f: shortestpath(f, nshortest=5)`)
+  concurrently. Each call is passed a copy of its FST which may safely be used
+  in a thread, so in-place operations (e.g., `lambda f: f.minimize()`) do not
+  modify the inputs. Other arguments (e.g., elements of sequences which are not
+  FSTs) are passed as is.
+
+  Args:
+    func: A function taking one argument.
+    fsts: An iterable of FSTs (or other arguments to `func`).
+    threads: The number of threads to use; if zero, one per hardware thread.
+
+  Returns:
+    A list of the results of `func`, in the order of the inputs.
+
+  Raises:
+    Any exception raised by `func`; if several calls fail, the first to do so.
+  """
+  cdef _BatchApply _batch = _BatchApply.__new__(_BatchApply)
+  _batch._func = func
+  _batch._inputs = [arg.copy() if isinstance(arg, Fst) else arg for arg in fsts]
+  _batch._outputs = [None] * len(_batch._inputs)
+  cdef size_t _size = len(_batch._inputs)
+  with nogil:
+    fst.ParallelFor(_size, threads, _batch_apply_callback, <void *> _batch)
+  if _batch._error is not None:
+    raise _batch._error
+  return _batch._outputs
+
+
 ## Compiler.
 
 
@@ -4765,7 +5066,7 @@ cdef class FarWriter:
       source: The string location for the output FAR files.
       arc_type: A string indicating the arc type.
       far_type: A string indicating the FAR type; one of: "fst", "stlist",
-          "sttable", "sstable", "default".
+          "ststream", "sttable", "sstable", "default".
 
     Returns:
       A new FarWriter instance.
@@ -0,0 +1,213 @@
+# Copyright 2005-2020 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the 'License');
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an 'AS IS' BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# See www.openfst.org for extensive documentation on this weighted
+# finite-state transducer library.
+"""Tests for the Python extension."""
+
+import array
+import concurrent.futures
+import math
+
+from absl.testing import absltest
+
+import pywrapfst as fst
+
+
+def _make_fst():
+  """Returns a small acyclic transducer with several final states."""
+  compiler = fst.Compiler()
+  print("0 1 1 2 0.5", file=compiler)
+  print("0 2 3 4 1.5", file=compiler)
+  print("1 2 5 6 0.25", file=compiler)
+  print("1 3 7 8 2", file=compiler)
+  print("2 3 9 10 0.75", file=compiler)
+  print("2 1.25", file=compiler)
+  print("3", file=compiler)
+  return compiler.compile()
+
+
+def _make_fsts(n):
+  """Returns n small cyclic transducers with different weights."""
+  fsts = []
+  for i in range(n):
+    compiler = fst.Compiler()
+    print(f"0 1 1 1 {i % 3}", file=compiler)
+    print(f"0 2 2 3 {i % 5}", file=compiler)
+    print("1 1 3 2 1", file=compiler)
+    print(f"1 3 4 4 {i % 2}", file=compiler)
+    print("2 3 4 5 0.5", file=compiler)
+    print("2 0 5 1 2", file=compiler)
+    print(f"3 {i % 4}", file=compiler)
+    fsts.append(compiler.compile())
+  return fsts
+
+
+def _arc_list(f, state):
+  return [(arc.ilabel, arc.olabel, float(arc.weight), arc.nextstate)
+          for arc in f.arcs(state)]
+
+
+class ArcArraysTest(absltest.TestCase):
+
+  def testArcArraysMatchArcs(self):
+    f = _make_fst()
+    states, ilabels, olabels, weights, nextstates = f.arc_arrays()
+    self.assertLen(states, f.num_arcs(0) + f.num_arcs(1) + f.num_arcs(2))
+    expected = []
+    for state in f.states():
+      expected.extend((state,) + arc for arc in _arc_list(f, state))
+    self.assertEqual(
+        list(zip(states, ilabels, olabels, weights, nextstates)), expected)
+
+  def testArcArraysOfState(self):
+    f = _make_fst()
+    states, ilabels, olabels, weights, nextstates = f.arc_arrays(1)
+    self.assertEqual(list(states), [1, 1])
+    self.assertEqual(list(zip(ilabels, olabels, weights, nextstates)),
+                     _arc_list(f, 1))
+    self.assertEmpty(f.arc_arrays(3)[0])
+    with self.assertRaises(fst.FstIndexError):
+      f.arc_arrays(4)
+
+  def testFinalWeights(self):
+    f = _make_fst()
+    finals = f.final_weights()
+    self.assertLen(finals, f.num_states())
+    for state in f.states():
+      self.assertEqual(finals[state], float(f.final(state)))
+    self.assertEqual(finals[0], math.inf)
+
+  def testEmptyFst(self):
+    f = fst.VectorFst()
+    for values in f.arc_arrays():
+      self.assertEmpty(values)
+    self.assertEmpty(f.final_weights())
+    arrays = [array.array(code) for code in "qqqdq"]
+    g = fst.from_arc_arrays(*arrays)
+    self.assertEqual(g.num_states(), 0)
+    self.assertEqual(g.start(), fst.NO_STATE_ID)
+    g = fst.from_arc_arrays(*arrays, final_weights=array.array("d"))
+    self.assertEqual(g.num_states(), 0)
+    self.assertTrue(fst.equal(f, g))
+
+  def testRoundTrip(self):
+    f = _make_fst()
+    g = fst.from_arc_arrays(*f.arc_arrays(), final_weights=f.final_weights(),
+                            start=f.start())
+    self.assertTrue(fst.equal(f, g))
+    self.assertEqual(g.fst_type(), "vector")
+    h = fst.from_arc_arrays(*f.arc_arrays(), final_weights=f.final_weights(),
+                            start=f.start(), fst_type="const")
+    self.assertEqual(h.fst_type(), "const")
+    self.assertTrue(fst.equal(f, h))
+    log = fst.arcmap(f, map_type="to_log")
+    g = fst.from_arc_arrays(*log.arc_arrays(),
+                            final_weights=log.final_weights(),
+                            start=log.start(), arc_type="log")
+    self.assertEqual(g.arc_type(), "log")
+    self.assertTrue(fst.equal(log, g))
+
+  def testFromArcArraysWithoutFinalWeights(self):
+    f = _make_fst()
+    g = fst.from_arc_arrays(*f.arc_arrays())
+    self.assertEqual(g.num_states(), f.num_states())
+    self.assertEqual(g.start(), 0)
+    self.assertTrue(all(w == math.inf for w in g.final_weights()))
+
+  def testFromArcArraysErrors(self):
+    states, ilabels, olabels, weights, nextstates = _make_fst().arc_arrays()
+    with self.assertRaises(fst.FstArgError):
+      fst.from_arc_arrays(states[:-1], ilabels, olabels, weights, nextstates)
+    with self.assertRaises(fst.FstOpError):
+      fst.from_arc_arrays(states, ilabels, olabels, weights, nextstates,
+                          final_weights=array.array("d", [0, 0]))
+    with self.assertRaises(fst.FstOpError):
+      fst.from_arc_arrays(states, ilabels, olabels, weights, nextstates,
+                          start=4)
+    with self.assertRaises(fst.FstOpError):
+      fst.from_arc_arrays(states, ilabels, olabels, weights, nextstates,
+                          arc_type="nonexistent")
+
+
+class BatchApplyTest(absltest.TestCase):
+
+  def testMatchesSequential(self):
+    fsts = _make_fsts(10)
+    func = lambda f: fst.shortestpath(f, nshortest=3)
+    expected = [func(f) for f in fsts]
+    for threads in (1, 2, 0):
+      results = fst.batch_apply(func, fsts, threads=threads)
+      self.assertLen(results, len(fsts))
+      for result, e in zip(results, expected):
+        self.assertTrue(fst.equal(result, e))
+
+  def testInPlaceOperationsDoNotModifyInputs(self):
+    fsts = _make_fsts(5)
+    originals = [f.copy() for f in fsts]
+    results = fst.batch_apply(lambda f: f.project("input").rmepsilon(), fsts,
+                              threads=2)
+    for f, original, result in zip(fsts, originals, results):
+      self.assertTrue(fst.equal(f, original))
+      self.assertTrue(
+          fst.equal(result, original.copy().project("input").rmepsilon()))
+
+  def testOtherArguments(self):
+    self.assertEqual(fst.batch_apply(lambda x: 2 * x, [1, 2, 3], threads=2),
+                     [2, 4, 6])
+    self.assertEqual(fst.batch_apply(len, iter(["a", "bc"])), [1, 2])
+    self.assertEqual(fst.batch_apply(lambda f: f, []), [])
+
+  def testExceptionsPropagate(self):
+
+    def func(f):
+      if f.num_states() == 0:
+        raise ValueError("empty")
+      return f.num_states()
+
+    fsts = _make_fsts(3) + [fst.VectorFst()]
+    with self.assertRaisesRegex(ValueError, "empty"):
+      fst.batch_apply(func, fsts, threads=2)
+    with self.assertRaises(fst.FstArgError):
+      fst.batch_apply(lambda f: fst.determinize(f, det_type="nonexistent"),
+                      fsts[:1])
+
+
+class NoGilTest(absltest.TestCase):
+
+  def testConcurrentOperations(self):
+    fsts = _make_fsts(8)
+    operations = [
+        lambda f: fst.determinize(f.copy().project("input").rmepsilon()),
+        lambda f: fst.compose(f, fst.arcmap(f, map_type="invert").arcsort()),
+        lambda f: fst.shortestpath(f, nshortest=2),
+        lambda f: fst.prune(f, weight=1),
+        fst.reverse,
+    ]
+    with concurrent.futures.ThreadPoolExecutor(max_workers=4) as executor:
+      for operation in operations:
+        expected = [operation(f) for f in fsts]
+        for result, e in zip(executor.map(operation, fsts), expected):
+          self.assertTrue(fst.equal(result, e))
+      distances = list(executor.map(fst.shortestdistance, fsts))
+      determinized = [operations[0](f) for f in fsts]
+      self.assertTrue(all(executor.map(fst.equivalent, determinized,
+                                       [d.copy() for d in determinized])))
+    for f, distance in zip(fsts, distances):
+      self.assertEqual([float(w) for w in distance],
+                       [float(w) for w in fst.shortestdistance(f)])
+
+
+if __name__ == "__main__":
+  absltest.main()
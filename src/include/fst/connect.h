@@ -265,6 +265,26 @@ inline void SccVisitor<Arc>::FinishState(StateId s, StateId p, const Arc *) {
   }
 }
 
+// Scratch space for Connect. Passing the same workspace to repeated calls
+// (e.g., when trimming many small FSTs) lets them reuse the visitation buffers
+// rather than allocating them anew each time. A workspace may only be used by
+// one call at a time.
+template <class Arc>
+struct ConnectWorkspace {
+  using StateId = typename Arc::StateId;
+
+  ConnectWorkspace() = default;
+  ConnectWorkspace(const ConnectWorkspace &) = delete;
+  ConnectWorkspace &operator=(const ConnectWorkspace &) = delete;
+
+  std::vector<bool> access;
+  std::vector<bool> coaccess;
+  uint64_t props = 0;
+  SccVisitor<Arc> scc_visitor{nullptr, &access, &coaccess, &props};
+  DfsVisitWorkspace<Fst<Arc>> dfs_workspace;
+  std::vector<StateId> dstates;
+};
+
 // Trims an FST, removing states and arcs that are not on successful paths.
 // This version modifies its input.
 //
@@ -275,14 +295,15 @@ inline void SccVisitor<Arc>::FinishState(StateId s, StateId p, const Arc *) {
 //
 // where V = # of states and E = # of arcs.
 template <class Arc>
-void Connect(MutableFst<Arc> *fst) {
+void Connect(MutableFst<Arc> *fst, ConnectWorkspace<Arc> *workspace) {
   using StateId = typename Arc::StateId;
-  std::vector<bool> access;
-  std::vector<bool> coaccess;
-  uint64_t props = 0;
-  SccVisitor<Arc> scc_visitor(nullptr, &access, &coaccess, &props);
-  DfsVisit(*fst, &scc_visitor);
-  std::vector<StateId> dstates;
+  const auto &access = workspace->access;
+  const auto &coaccess = workspace->coaccess;
+  workspace->props = 0;
+  DfsVisit<Fst<Arc>>(*fst, &workspace->scc_visitor, AnyArcFilter<Arc>(),
+                     /*access_only=*/false, &workspace->dfs_workspace);
+  auto &dstates = workspace->dstates;
+  dstates.clear();
   dstates.reserve(access.size());
   for (StateId s = 0; s < access.size(); ++s) {
     if (!access[s] || !coaccess[s]) dstates.push_back(s);
@@ -291,6 +312,13 @@ void Connect(MutableFst<Arc> *fst) {
   fst->SetProperties(kAccessible | kCoAccessible, kAccessible | kCoAccessible);
 }
 
+// As above, with its own scratch space.
+template <class Arc>
+void Connect(MutableFst<Arc> *fst) {
+  ConnectWorkspace<Arc> workspace;
+  Connect(fst, &workspace);
+}
+
 // Returns an acyclic FST where each SCC in the input FST has been condensed to
 // a single state with transitions between SCCs retained and within SCCs
 // dropped. Also populates 'scc' with a mapping from input to output states.
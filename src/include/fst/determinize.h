@@ -22,6 +22,7 @@
 
 #include <algorithm>
 #include <climits>
+#include <cstddef>
 #include <cstdint>
 #include <forward_list>
 #include <map>
@@ -207,7 +208,8 @@ struct DeterminizeArc {
 // on the source tuple, transition, and destination element or on similar
 // super-final transition information. The filter operates on a map between a
 // label and the corresponding destination state tuples. It must define the map
-// type LabelMap. The default filter is used for weighted determinization.
+// type LabelMap, which is cleared and reused across states. The default filter
+// is used for weighted determinization.
 // A determinize filter for implementing weighted determinization.
 template <class Arc>
 class DefaultDeterminizeFilter {
@@ -267,6 +269,156 @@ class DefaultDeterminizeFilter {
   std::unique_ptr<Fst<Arc>> fst_;
 };
 
+namespace internal {
+
+// Label map for FlatDeterminizeFilter. Rather than keeping a tree of
+// destination subsets keyed by label, it collects the destination elements of
+// a state in a flat buffer and groups them by label once all arcs have been
+// seen, on first iteration. Grouping is a counting sort when the labels span a
+// range not much larger than the number of elements and a comparison sort
+// otherwise; both are stable, so the subsets and arcs are built in the same
+// order as with the std::map of DefaultDeterminizeFilter. The buffers are kept
+// across clear() calls for reuse at the next state.
+template <class Arc>
+class FlatDeterminizeLabelMap {
+ public:
+  using Label = typename Arc::Label;
+
+  using StateTuple = DeterminizeStateTuple<Arc, CharFilterState>;
+  using Element = typename StateTuple::Element;
+  using DetArc = DeterminizeArc<StateTuple>;
+  using value_type = std::pair<Label, DetArc>;
+  using iterator = typename std::vector<value_type>::iterator;
+
+  // Adds the destination element of an arc with the given label.
+  void Add(Label label, Element &&element) {
+    labels_.push_back(label);
+    elements_.push_back(std::move(element));
+    grouped_ = false;
+  }
+
+  bool empty() const { return labels_.empty() && arcs_.empty(); }
+
+  iterator begin() {
+    if (!grouped_) Group();
+    return arcs_.begin();
+  }
+
+  iterator end() {
+    if (!grouped_) Group();
+    return arcs_.end();
+  }
+
+  void clear() {
+    labels_.clear();
+    elements_.clear();
+    arcs_.clear();
+    grouped_ = true;
+  }
+
+ private:
+  // Label ranges up to this size plus the number of elements are sorted by
+  // counting.
+  static constexpr int64_t kMaxDenseRange = 1024;
+
+  // Moves the buffered elements into one destination subset per label.
+  void Group() {
+    grouped_ = true;
+    const auto n = labels_.size();
+    if (n == 0) return;
+    const auto [min_label, max_label] =
+        std::minmax_element(labels_.begin(), labels_.end());
+    const int64_t base = *min_label;
+    const int64_t range = static_cast<int64_t>(*max_label) - base + 1;
+    order_.resize(n);
+    if (range <= static_cast<int64_t>(n) + kMaxDenseRange) {
+      counts_.assign(range + 1, 0);
+      for (const auto label : labels_) ++counts_[label - base + 1];
+      for (int64_t i = 1; i <= range; ++i) counts_[i] += counts_[i - 1];
+      for (size_t i = 0; i < n; ++i) order_[counts_[labels_[i] - base]++] = i;
+    } else {
+      for (size_t i = 0; i < n; ++i) order_[i] = i;
+      std::sort(order_.begin(), order_.end(), [this](size_t i, size_t j) {
+        return labels_[i] < labels_[j] || (labels_[i] == labels_[j] && i < j);
+      });
+    }
+    for (const auto i : order_) {
+      const auto label = labels_[i];
+      if (arcs_.empty() || arcs_.back().first != label) {
+        auto &det_arc = arcs_.emplace_back(label, DetArc()).second;
+        det_arc.label = label;
+        det_arc.dest_tuple = fst::make_unique_for_overwrite<StateTuple>();
+        det_arc.dest_tuple->filter_state = CharFilterState(0);
+      }
+      arcs_.back().second.dest_tuple->subset.push_front(
+          std::move(elements_[i]));
+    }
+    labels_.clear();
+    elements_.clear();
+  }
+
+  std::vector<Label> labels_;
+  std::vector<Element> elements_;
+  std::vector<size_t> order_;
+  std::vector<size_t> counts_;
+  std::vector<value_type> arcs_;
+  bool grouped_ = true;
+};
+
+}  // namespace internal
+
+// A determinize filter implementing weighted determinization like
+// DefaultDeterminizeFilter, with the same result, but grouping the
+// destination elements of each state by label in flat, reused buffers rather
+// than a map, which is faster for states with many distinct labels (e.g., in
+// lexicon transducers).
+template <class Arc>
+class FlatDeterminizeFilter {
+ public:
+  using Label = typename Arc::Label;
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  using FilterState = CharFilterState;
+  using Element = internal::DeterminizeElement<Arc>;
+  using StateTuple = internal::DeterminizeStateTuple<Arc, FilterState>;
+  using LabelMap = internal::FlatDeterminizeLabelMap<Arc>;
+
+  // This is needed e.g. to go into the gallic domain for transducers.
+  template <class A>
+  struct rebind {
+    using Other = FlatDeterminizeFilter<A>;
+  };
+
+  explicit FlatDeterminizeFilter(const Fst<Arc> &fst) {}
+
+  // This is needed (e.g.) to go into the gallic domain for transducers.
+  template <class Filter>
+  FlatDeterminizeFilter(const Fst<Arc> &fst, std::unique_ptr<Filter> filter) {}
+
+  // Copy constructor; the FST can be passed if it has been deep-copied.
+  FlatDeterminizeFilter(const FlatDeterminizeFilter<Arc> &filter,
+                        const Fst<Arc> *fst = nullptr) {}
+
+  FilterState Start() const { return FilterState(0); }
+
+  // Does no work.
+  void SetState(StateId s, const StateTuple &tuple) {}
+
+  // Filters transition, adding the destination element to the label map.
+  // Returns true.
+  bool FilterArc(const Arc &arc, const Element &src_element,
+                 Element &&dest_element, LabelMap *label_map) const {
+    label_map->Add(arc.ilabel, std::move(dest_element));
+    return true;
+  }
+
+  // Filters super-final transition, returning new final weight.
+  Weight FilterFinal(Weight weight, const Element &element) { return weight; }
+
+  static uint64_t Properties(uint64_t props) { return props; }
+};
+
 // Determinization state table interface:
 //
 // template <class Arc, class FilterState>
@@ -373,6 +525,172 @@ class DefaultDeterminizeStateTable {
       const DefaultDeterminizeStateTable &) = delete;
 };
 
+// A determinization state table storing the subsets compactly: the input
+// state IDs of all subsets are delta-encoded as varints in one byte array and
+// their weights are kept in one weight array, rather than as separately
+// allocated element lists. Each subset has a 64-bit fingerprint, computed
+// with its weights quantized by hash_delta, which is used to hash it into an
+// open-addressed table and to rule out most unequal subsets before comparing
+// them exactly. Tuple() decodes the subset into a tuple owned by the table,
+// which remains valid until the next call to Tuple().
+template <class Arc, class FilterState>
+class CompactDeterminizeStateTable {
+ public:
+  using Label = typename Arc::Label;
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  using StateTuple = internal::DeterminizeStateTuple<Arc, FilterState>;
+  using Element = typename StateTuple::Element;
+  using Subset = typename StateTuple::Subset;
+
+  template <class B, class G>
+  struct rebind {
+    using Other = CompactDeterminizeStateTable<B, G>;
+  };
+
+  explicit CompactDeterminizeStateTable(float hash_delta = kDelta)
+      : hash_delta_(hash_delta) {}
+
+  CompactDeterminizeStateTable(
+      const CompactDeterminizeStateTable<Arc, FilterState> &table)
+      : hash_delta_(table.hash_delta_) {}
+
+  // Finds the state corresponding to a state tuple. Only creates a new state if
+  // the tuple is not found.
+  StateId FindState(std::unique_ptr<StateTuple> tuple) {
+    const StateId ns = filter_states_.size();
+    if (2 * (static_cast<size_t>(ns) + 1) > table_.size()) Rehash();
+    // Appends the tuple as a candidate state, removed again if found.
+    Append(*tuple);
+    const auto fingerprint = fingerprints_.back();
+    const auto mask = table_.size() - 1;
+    for (auto i = fingerprint & mask;; i = (i + 1) & mask) {
+      const auto s = table_[i];
+      if (s == kNoStateId) {
+        table_[i] = ns;
+        return ns;
+      }
+      if (fingerprints_[s] == fingerprint && Equal(s, ns)) {
+        RemoveLast();
+        return s;
+      }
+    }
+  }
+
+  const StateTuple *Tuple(StateId s) {
+    elements_.clear();
+    const auto *data = state_ids_.data() + state_offsets_[s];
+    StateId state_id = 0;
+    for (auto i = weight_offsets_[s]; i < weight_offsets_[s + 1]; ++i) {
+      uint64_t delta = 0;
+      for (int shift = 0;; shift += 7) {
+        const auto byte = *data++;
+        delta |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+      }
+      // Zigzag decoding.
+      state_id += static_cast<StateId>((delta >> 1) ^ (~(delta & 1) + 1));
+      elements_.emplace_back(state_id, weights_[i]);
+    }
+    tuple_.subset.assign(elements_.begin(), elements_.end());
+    tuple_.filter_state = filter_states_[s];
+    return &tuple_;
+  }
+
+ private:
+  // Encodes the subset as the last state.
+  void Append(const StateTuple &tuple) {
+    uint64_t fingerprint = Mix(tuple.filter_state.Hash());
+    StateId prev = 0;
+    for (const auto &element : tuple.subset) {
+      // Zigzag encoding, so that unsorted subsets are also supported.
+      const int64_t diff = static_cast<int64_t>(element.state_id) - prev;
+      auto delta = (static_cast<uint64_t>(diff) << 1) ^
+                   static_cast<uint64_t>(diff >> 63);
+      for (; delta >= 0x80; delta >>= 7) {
+        state_ids_.push_back(static_cast<uint8_t>(delta | 0x80));
+      }
+      state_ids_.push_back(static_cast<uint8_t>(delta));
+      prev = element.state_id;
+      weights_.push_back(element.weight);
+      const auto weight_hash = hash_delta_ > 0
+                                   ? element.weight.Quantize(hash_delta_).Hash()
+                                   : element.weight.Hash();
+      fingerprint = Mix(fingerprint ^ element.state_id);
+      fingerprint = Mix(fingerprint ^ weight_hash);
+    }
+    state_offsets_.push_back(state_ids_.size());
+    weight_offsets_.push_back(weights_.size());
+    filter_states_.push_back(tuple.filter_state);
+    fingerprints_.push_back(fingerprint);
+  }
+
+  void RemoveLast() {
+    state_offsets_.pop_back();
+    weight_offsets_.pop_back();
+    state_ids_.resize(state_offsets_.back());
+    weights_.resize(weight_offsets_.back());
+    filter_states_.pop_back();
+    fingerprints_.pop_back();
+  }
+
+  bool Equal(StateId s1, StateId s2) const {
+    if (filter_states_[s1] != filter_states_[s2]) return false;
+    const auto begin1 = state_offsets_[s1];
+    const auto begin2 = state_offsets_[s2];
+    const auto size = state_offsets_[s1 + 1] - begin1;
+    if (state_offsets_[s2 + 1] - begin2 != size ||
+        !std::equal(state_ids_.begin() + begin1,
+                    state_ids_.begin() + begin1 + size,
+                    state_ids_.begin() + begin2)) {
+      return false;
+    }
+    const auto wbegin1 = weight_offsets_[s1];
+    const auto wbegin2 = weight_offsets_[s2];
+    const auto wsize = weight_offsets_[s1 + 1] - wbegin1;
+    return weight_offsets_[s2 + 1] - wbegin2 == wsize &&
+           std::equal(weights_.begin() + wbegin1,
+                      weights_.begin() + wbegin1 + wsize,
+                      weights_.begin() + wbegin2);
+  }
+
+  // Doubles the size of the hash table and reinserts all states.
+  void Rehash() {
+    table_.assign(std::max<size_t>(2 * table_.size(), 16), kNoStateId);
+    const auto mask = table_.size() - 1;
+    for (StateId s = 0; s < filter_states_.size(); ++s) {
+      auto i = fingerprints_[s] & mask;
+      while (table_[i] != kNoStateId) i = (i + 1) & mask;
+      table_[i] = s;
+    }
+  }
+
+  // Finalizer of the 64-bit MurmurHash3.
+  static uint64_t Mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  float hash_delta_;
+  std::vector<uint8_t> state_ids_;  // Encoded input state IDs of all subsets.
+  std::vector<Weight> weights_;     // Weights of all subsets.
+  std::vector<size_t> state_offsets_ = {0};   // Subset start in state_ids_.
+  std::vector<size_t> weight_offsets_ = {0};  // Subset start in weights_.
+  std::vector<FilterState> filter_states_;
+  std::vector<uint64_t> fingerprints_;
+  std::vector<StateId> table_;  // Open-addressed hash table of states.
+  std::vector<Element> elements_;
+  StateTuple tuple_;  // Last decoded tuple.
+
+  CompactDeterminizeStateTable &operator=(
+      const CompactDeterminizeStateTable &) = delete;
+};
+
 // Determinization type.
 enum DeterminizeType {
   // Input transducer is known to be functional (or error).
@@ -626,10 +944,11 @@ class DeterminizeFsaImpl : public DeterminizeFstImplBase<Arc> {
   }
 
   StateId FindState(std::unique_ptr<StateTuple> tuple) {
-    const auto &subset = tuple->subset;
     const auto s = state_table_->FindState(std::move(tuple));
+    // The state table need not keep the tuple it was given, so the distance of
+    // a new state is computed from the tuple the table stores.
     if (in_dist_ && out_dist_->size() <= s) {
-      out_dist_->push_back(ComputeDistance(subset));
+      out_dist_->push_back(ComputeDistance(state_table_->Tuple(s)->subset));
     }
     return s;
   }
@@ -650,11 +969,11 @@ class DeterminizeFsaImpl : public DeterminizeFstImplBase<Arc> {
   // Computes the outgoing transitions from a state, creating new destination
   // states as needed.
   void Expand(StateId s) override {
-    LabelMap label_map;
-    GetLabelMap(s, &label_map);
-    for (auto &[unused_label, arc] : label_map) {
+    GetLabelMap(s, &label_map_);
+    for (auto &[unused_label, arc] : label_map_) {
       AddArc(s, std::move(arc));
     }
+    label_map_.clear();
     SetArcs(s);
   }
 
@@ -728,6 +1047,7 @@ class DeterminizeFsaImpl : public DeterminizeFstImplBase<Arc> {
   static const CommonDivisor common_divisor_;
   std::unique_ptr<Filter> filter_;
   std::unique_ptr<StateTable> state_table_;
+  LabelMap label_map_;  // Scratch space for Expand.
 };
 
 template <class Arc, class CommonDivisor, class Filter, class StateTable>
@@ -1080,7 +1400,11 @@ void Determinize(
     const Fst<Arc> &ifst, MutableFst<Arc> *ofst,
     const DeterminizeOptions<Arc> &opts = DeterminizeOptions<Arc>()) {
   using Weight = typename Arc::Weight;
-  DeterminizeFstOptions<Arc> nopts;
+  using Filter = FlatDeterminizeFilter<Arc>;
+  using StateTable =
+      CompactDeterminizeStateTable<Arc, typename Filter::FilterState>;
+  DeterminizeFstOptions<Arc, DefaultCommonDivisor<Weight>, Filter, StateTable>
+      nopts;
   nopts.delta = opts.delta;
   nopts.subsequential_label = opts.subsequential_label;
   nopts.type = opts.type;
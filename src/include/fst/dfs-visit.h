@@ -22,11 +22,11 @@
 #define FST_DFS_VISIT_H_
 
 #include <cstdint>
-#include <stack>
 #include <vector>
 
 #include <fst/arcfilter.h>
 #include <fst/fst.h>
+#include <fst/memory.h>
 
 
 namespace fst {
@@ -96,33 +96,48 @@ struct DfsState {
   ArcIterator<FST> arc_iter;  // The corresponding arcs.
 };
 
+// An FST state's DFS status.
+enum class DfsStateColor : uint8_t {
+  kWhite = 0,  // Undiscovered.
+  kGrey = 1,   // Discovered but unfinished.
+  kBlack = 2,  // Finished.
+};
+
 }  // namespace internal
 
+// Scratch space for DfsVisit. Passing the same workspace to repeated visits
+// (e.g., of many small FSTs) lets them reuse the state colors, the DFS stack
+// and its state pool rather than allocating them anew each time. A workspace
+// may only be used by one visit at a time.
+template <class FST>
+struct DfsVisitWorkspace {
+  std::vector<internal::DfsStateColor> state_color;
+  std::vector<internal::DfsState<FST> *> state_stack;  // DFS execution stack.
+  MemoryPool<internal::DfsState<FST>> state_pool;      // Pool for DfsStates.
+};
+
 // Performs depth-first visitation. Visitor class argument determines actions
 // and contains any return data. ArcFilter determines arcs that are considered.
 // If 'access_only' is true, performs visitation only to states accessible from
 // the initial state.
 //
 // Note this is similar to Visit() in visit.h called with a LIFO queue, except
-// this version has a Visitor class specialized and augmented for a DFS.
+// this version has a Visitor class specialized and augmented for a DFS. This
+// version uses the scratch space in the workspace argument.
 template <class FST, class Visitor, class ArcFilter>
 void DfsVisit(const FST &fst, Visitor *visitor, ArcFilter filter,
-              bool access_only = false) {
+              bool access_only, DfsVisitWorkspace<FST> *workspace) {
+  using StateColor = internal::DfsStateColor;
   visitor->InitVisit(fst);
   const auto start = fst.Start();
   if (start == kNoStateId) {
     visitor->FinishVisit();
     return;
   }
-  // An FST state's DFS status
-  enum class StateColor : uint8_t {
-    kWhite = 0,  // Undiscovered.
-    kGrey = 1,   // Discovered but unfinished.
-    kBlack = 2,  // Finished.
-  };
-  std::vector<StateColor> state_color;
-  std::stack<internal::DfsState<FST> *> state_stack;  // DFS execution stack.
-  MemoryPool<internal::DfsState<FST>> state_pool;     // Pool for DFSStates.
+  auto &state_color = workspace->state_color;
+  auto &state_stack = workspace->state_stack;
+  auto &state_pool = workspace->state_pool;
+  state_color.clear();
   auto nstates = start + 1;  // Number of known states in general case.
   bool expanded = false;
   if (fst.Properties(kExpanded, false)) {  // Tests if expanded case, then
@@ -136,10 +151,10 @@ void DfsVisit(const FST &fst, Visitor *visitor, ArcFilter filter,
   // Iterate over trees in DFS forest.
   for (auto root = start; dfs && root < nstates;) {
     state_color[root] = StateColor::kGrey;
-    state_stack.push(new (&state_pool) internal::DfsState<FST>(fst, root));
+    state_stack.push_back(new (&state_pool) internal::DfsState<FST>(fst, root));
     dfs = visitor->InitState(root, root);
     while (!state_stack.empty()) {
-      auto *dfs_state = state_stack.top();
+      auto *dfs_state = state_stack.back();
       const auto s = dfs_state->state_id;
       if (s >= static_cast<decltype(s)>(state_color.size())) {
         nstates = s + 1;
@@ -149,9 +164,9 @@ void DfsVisit(const FST &fst, Visitor *visitor, ArcFilter filter,
       if (!dfs || aiter.Done()) {
         state_color[s] = StateColor::kBlack;
         internal::DfsState<FST>::Destroy(dfs_state, &state_pool);
-        state_stack.pop();
+        state_stack.pop_back();
         if (!state_stack.empty()) {
-          auto *parent_state = state_stack.top();
+          auto *parent_state = state_stack.back();
           auto &piter = parent_state->arc_iter;
           visitor->FinishState(s, parent_state->state_id, &piter.Value());
           piter.Next();
@@ -176,8 +191,8 @@ void DfsVisit(const FST &fst, Visitor *visitor, ArcFilter filter,
           dfs = visitor->TreeArc(s, arc);
           if (!dfs) break;
           state_color[arc.nextstate] = StateColor::kGrey;
-          state_stack.push(new (&state_pool)
-                               internal::DfsState<FST>(fst, arc.nextstate));
+          state_stack.push_back(
+              new (&state_pool) internal::DfsState<FST>(fst, arc.nextstate));
           dfs = visitor->InitState(arc.nextstate, root);
           break;
         case StateColor::kGrey:
@@ -209,6 +224,14 @@ void DfsVisit(const FST &fst, Visitor *visitor, ArcFilter filter,
   visitor->FinishVisit();
 }
 
+// Performs depth-first visitation, as above, with its own scratch space.
+template <class FST, class Visitor, class ArcFilter>
+void DfsVisit(const FST &fst, Visitor *visitor, ArcFilter filter,
+              bool access_only = false) {
+  DfsVisitWorkspace<FST> workspace;
+  DfsVisit(fst, visitor, filter, access_only, &workspace);
+}
+
 template <class Arc, class Visitor>
 void DfsVisit(const Fst<Arc> &fst, Visitor *visitor) {
   DfsVisit(fst, visitor, AnyArcFilter<Arc>());
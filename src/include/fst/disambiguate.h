@@ -20,11 +20,11 @@
 #ifndef FST_DISAMBIGUATE_H_
 #define FST_DISAMBIGUATE_H_
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
-#include <list>
 #include <map>
 #include <memory>
-#include <set>
 #include <utility>
 #include <vector>
 
@@ -34,6 +34,8 @@
 #include <fst/connect.h>
 #include <fst/determinize.h>
 #include <fst/dfs-visit.h>
+#include <fst/matcher.h>
+#include <fst/parallel.h>
 #include <fst/project.h>
 #include <fst/prune.h>
 #include <fst/state-map.h>
@@ -49,11 +51,17 @@ struct DisambiguateOptions : public DeterminizeOptions<Arc> {
   using StateId = typename Arc::StateId;
   using Weight = typename Arc::Weight;
 
+  // Number of threads used to search for ambiguities (0 = one per hardware
+  // thread); the output FST must then support concurrent reads.
+  size_t num_threads;
+
   explicit DisambiguateOptions(float delta = kDelta,
                                Weight weight = Weight::Zero(),
-                               StateId n = kNoStateId, Label label = 0)
+                               StateId n = kNoStateId, Label label = 0,
+                               size_t num_threads = 1)
       : DeterminizeOptions<Arc>(delta, std::move(weight), n, label,
-                                DETERMINIZE_FUNCTIONAL) {}
+                                DETERMINIZE_FUNCTIONAL),
+        num_threads(num_threads) {}
 };
 
 namespace internal {
@@ -203,11 +211,14 @@ class Disambiguator {
   // (super-final transition).
   using ArcId = std::pair<StateId, ssize_t>;
 
-  Disambiguator() : error_(false) {}
+  using StatePair = std::pair<StateId, StateId>;
+
+  Disambiguator() : num_threads_(1), error_(false) {}
 
   void Disambiguate(
       const Fst<Arc> &ifst, MutableFst<Arc> *ofst,
       const DisambiguateOptions<Arc> &opts = DisambiguateOptions<Arc>()) {
+    num_threads_ = opts.num_threads;
     VectorFst<Arc> sfst(ifst);
     Connect(&sfst);
     ArcSort(&sfst, ArcCompare());
@@ -287,30 +298,94 @@ class Disambiguator {
       DfsVisit(cfst, &scc_visitor);
       for (StateId s = 0; s < coaccess.size(); ++s) {
         if (coaccess[s]) {
-          related_.insert(opts.state_table->Tuple(s).StatePair());
+          related_.push_back(opts.state_table->Tuple(s).StatePair());
         }
       }
+      std::sort(related_.begin(), related_.end());
       if (trans) delete fsa;
     }
 
     bool operator()(const StateId s1, StateId s2) const {
-      return related_.count(std::make_pair(s1, s2)) > 0;
+      return std::binary_search(related_.begin(), related_.end(),
+                                std::make_pair(s1, s2));
     }
 
    private:
     // States s1 and s2 resp. are in this relation iff they there is a
     // path from s1 to a final state that has the same label as some
-    // path from s2 to a final state.
-    std::set<std::pair<StateId, StateId>> related_;
+    // path from s2 to a final state; sorted.
+    std::vector<StatePair> related_;
   };
 
-  using ArcIdMap = std::multimap<ArcId, ArcId, ArcIdCompare>;
+  // Open-addressed hash set of state pairs.
+  class StatePairSet {
+   public:
+    // Inserts the pair, returning false if it was already in the set.
+    bool Insert(const StatePair &pr) {
+      if (2 * (size_ + 1) > slots_.size()) Rehash();
+      const auto mask = slots_.size() - 1;
+      for (auto i = Hash(pr) & mask;; i = (i + 1) & mask) {
+        auto &slot = slots_[i];
+        if (slot.first == kNoStateId) {
+          slot = pr;
+          ++size_;
+          return true;
+        }
+        if (slot == pr) return false;
+      }
+    }
+
+    // Empties the set, releasing its memory.
+    void Clear() {
+      std::vector<StatePair>().swap(slots_);
+      size_ = 0;
+    }
+
+   private:
+    static size_t Hash(const StatePair &pr) {
+      auto h = static_cast<uint64_t>(pr.first) * 0x9e3779b97f4a7c15ULL ^
+               static_cast<uint64_t>(pr.second);
+      h ^= h >> 32;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 29;
+      return h;
+    }
+
+    void Rehash() {
+      std::vector<StatePair> slots(std::max<size_t>(2 * slots_.size(), 16),
+                                   StatePair(kNoStateId, kNoStateId));
+      const auto mask = slots.size() - 1;
+      for (const auto &pr : slots_) {
+        if (pr.first == kNoStateId) continue;
+        auto i = Hash(pr) & mask;
+        while (slots[i].first != kNoStateId) i = (i + 1) & mask;
+        slots[i] = pr;
+      }
+      slots_.swap(slots);
+    }
 
-  // Inserts candidate into the arc ID map.
-  inline void InsertCandidate(StateId s1, StateId s2, const ArcId &a1,
-                              const ArcId &a2) {
-    candidates_->insert(head_[s1] > head_[s2] ? std::make_pair(a1, a2)
-                                              : std::make_pair(a2, a1));
+    std::vector<StatePair> slots_;
+    size_t size_ = 0;
+  };
+
+  // Candidate ambiguous transitions and coreachable state pairs found from a
+  // range of state pairs, in the order found.
+  struct PairSearchResult {
+    std::vector<std::pair<ArcId, ArcId>> candidates;
+    std::vector<StatePair> pairs;
+
+    void Clear() {
+      candidates.clear();
+      pairs.clear();
+    }
+  };
+
+  // Orders candidate pairs so that the one with the larger head comes first.
+  std::pair<ArcId, ArcId> MakeCandidate(StateId s1, StateId s2,
+                                        const ArcId &a1,
+                                        const ArcId &a2) const {
+    return head_[s1] > head_[s2] ? std::make_pair(a1, a2)
+                                 : std::make_pair(a2, a1);
   }
 
   // Returns the arc corresponding to ArcId a.
@@ -333,9 +408,11 @@ class Disambiguator {
   // PreDisambiguate.
   void FindAmbiguities(const ExpandedFst<Arc> &fst);
 
-  // Finds transition pairs that are ambiguous candidates from two specified
-  // source states.
-  void FindAmbiguousPairs(const ExpandedFst<Arc> &fst, StateId s1, StateId s2);
+  // Finds transition pairs that are ambiguous candidates and the coreachable
+  // state pairs that follow from two specified source states.
+  void FindAmbiguousPairs(const ExpandedFst<Arc> &fst,
+                          SortedMatcher<Fst<Arc>> *matcher, StateId s1,
+                          StateId s2, PairSearchResult *result) const;
 
   // Marks ambiguous transitions to be removed.
   void MarkAmbiguities();
@@ -346,25 +423,24 @@ class Disambiguator {
   // Deletes actual ambiguous transitions.
   void RemoveAmbiguities(MutableFst<Arc> *ofst);
 
+  // Number of threads used by FindAmbiguities.
+  size_t num_threads_;
+
   // States s1 and s2 are in this relation iff there is a path from the initial
   // state to s1 that has the same label as some path from the initial state to
   // s2. We store only state pairs s1, s2 such that s1 <= s2.
-  std::set<std::pair<StateId, StateId>> coreachable_;
-
-  // Queue of disambiguation-related states to be processed. We store only
-  // state pairs s1, s2 such that s1 <= s2.
-  std::list<std::pair<StateId, StateId>> queue_;
+  StatePairSet coreachable_;
 
   // Head state in the pre-disambiguation for a given state.
   std::vector<StateId> head_;
 
-  // Maps from a candidate ambiguous arc A to each ambiguous candidate arc B
+  // Pairs a candidate ambiguous arc A with each ambiguous candidate arc B
   // with the same label and destination state as A, whose source state s' is
   // coreachable with the source state s of A, and for which head(s') < head(s).
-  std::unique_ptr<ArcIdMap> candidates_;
+  std::vector<std::pair<ArcId, ArcId>> candidates_;
 
-  // Set of ambiguous transitions to be removed.
-  std::set<ArcId> ambiguous_;
+  // Ambiguous transitions to be removed, sorted by ArcIdCompare.
+  std::vector<ArcId> ambiguous_;
 
   // States to merge due to quantization issues.
   std::unique_ptr<UnionFind<StateId>> merge_;
@@ -420,46 +496,52 @@ void Disambiguator<Arc>::PreDisambiguate(const ExpandedFst<Arc> &ifst,
   head_.resize(ofst->NumStates(), kNoStateId);
 }
 
+// Coreachable state pairs are searched breadth-first. The pairs of each level
+// are expanded by up to num_threads_ threads, in windows of chunks of
+// kDisambiguateChunkSize pairs, and the results are merged in order, so that
+// the pairs are visited, and split states are merged, in the same order
+// whatever the number of threads.
+inline constexpr size_t kDisambiguateChunkSize = 256;
+
 template <class Arc>
 void Disambiguator<Arc>::FindAmbiguities(const ExpandedFst<Arc> &fst) {
   if (fst.Start() == kNoStateId) return;
-  candidates_ = std::make_unique<ArcIdMap>(ArcIdCompare(head_));
-  const auto start_pr = std::make_pair(fst.Start(), fst.Start());
-  coreachable_.insert(start_pr);
-  queue_.push_back(start_pr);
-  while (!queue_.empty()) {
-    const auto &pr = queue_.front();
-    const auto s1 = pr.first;
-    const auto s2 = pr.second;
-    queue_.pop_front();
-    FindAmbiguousPairs(fst, s1, s2);
+  const auto num_threads = NumWorkerThreads(num_threads_);
+  std::vector<std::unique_ptr<SortedMatcher<Fst<Arc>>>> matchers(num_threads);
+  for (auto &matcher : matchers) {
+    matcher = std::make_unique<SortedMatcher<Fst<Arc>>>(&fst, MATCH_INPUT);
   }
-}
-
-template <class Arc>
-void Disambiguator<Arc>::FindAmbiguousPairs(const ExpandedFst<Arc> &fst,
-                                            StateId s1, StateId s2) {
-  if (fst.NumArcs(s2) > fst.NumArcs(s1)) FindAmbiguousPairs(fst, s2, s1);
-  SortedMatcher<Fst<Arc>> matcher(fst, MATCH_INPUT);
-  matcher.SetState(s2);
-  for (ArcIterator<Fst<Arc>> aiter(fst, s1); !aiter.Done(); aiter.Next()) {
-    const auto &arc1 = aiter.Value();
-    const ArcId a1(s1, aiter.Position());
-    if (matcher.Find(arc1.ilabel)) {
-      for (; !matcher.Done(); matcher.Next()) {
-        const auto &arc2 = matcher.Value();
-        // Continues on implicit epsilon match.
-        if (arc2.ilabel == kNoLabel) continue;
-        const ArcId a2(s2, matcher.Position());
-        // Actual transition is ambiguous.
-        if (s1 != s2 && arc1.nextstate == arc2.nextstate) {
-          InsertCandidate(s1, s2, a1, a2);
+  const size_t window_size = 4 * num_threads * kDisambiguateChunkSize;
+  std::vector<PairSearchResult> results(4 * num_threads);
+  candidates_.clear();
+  const auto start_pr = std::make_pair(fst.Start(), fst.Start());
+  coreachable_.Insert(start_pr);
+  std::vector<StatePair> queue = {start_pr};
+  std::vector<StatePair> next_queue;
+  while (!queue.empty()) {
+    for (size_t begin = 0; begin < queue.size(); begin += window_size) {
+      const auto end = std::min(queue.size(), begin + window_size);
+      const auto num_chunks =
+          (end - begin + kDisambiguateChunkSize - 1) / kDisambiguateChunkSize;
+      ParallelForWithThreadIndex(num_chunks, num_threads, [&](size_t c,
+                                                              size_t t) {
+        auto &result = results[c];
+        result.Clear();
+        const auto chunk_begin = begin + c * kDisambiguateChunkSize;
+        const auto chunk_end =
+            std::min(end, chunk_begin + kDisambiguateChunkSize);
+        for (auto i = chunk_begin; i < chunk_end; ++i) {
+          FindAmbiguousPairs(fst, matchers[t].get(), queue[i].first,
+                             queue[i].second, &result);
         }
-        const auto spr = arc1.nextstate <= arc2.nextstate
-                             ? std::make_pair(arc1.nextstate, arc2.nextstate)
-                             : std::make_pair(arc2.nextstate, arc1.nextstate);
-        // Not already marked as coreachable?
-        if (coreachable_.insert(spr).second) {
+      });
+      for (size_t c = 0; c < num_chunks; ++c) {
+        const auto &result = results[c];
+        candidates_.insert(candidates_.end(), result.candidates.begin(),
+                           result.candidates.end());
+        for (const auto &spr : result.pairs) {
+          // Not already marked as coreachable?
+          if (!coreachable_.Insert(spr)) continue;
           // Only possible if state split by quantization issues.
           if (spr.first != spr.second &&
               head_[spr.first] == head_[spr.second]) {
@@ -470,32 +552,73 @@ void Disambiguator<Arc>::FindAmbiguousPairs(const ExpandedFst<Arc> &fst,
             }
             merge_->Union(spr.first, spr.second);
           } else {
-            queue_.push_back(spr);
+            next_queue.push_back(spr);
           }
         }
       }
     }
+    queue.swap(next_queue);
+    next_queue.clear();
+  }
+  std::stable_sort(candidates_.begin(), candidates_.end(),
+                   [compare = ArcIdCompare(head_)](const auto &c1,
+                                                   const auto &c2) {
+                     return compare(c1.first, c2.first);
+                   });
+}
+
+template <class Arc>
+void Disambiguator<Arc>::FindAmbiguousPairs(const ExpandedFst<Arc> &fst,
+                                            SortedMatcher<Fst<Arc>> *matcher,
+                                            StateId s1, StateId s2,
+                                            PairSearchResult *result) const {
+  if (fst.NumArcs(s2) > fst.NumArcs(s1)) {
+    FindAmbiguousPairs(fst, matcher, s2, s1, result);
+  }
+  matcher->SetState(s2);
+  for (ArcIterator<Fst<Arc>> aiter(fst, s1); !aiter.Done(); aiter.Next()) {
+    const auto &arc1 = aiter.Value();
+    const ArcId a1(s1, aiter.Position());
+    if (matcher->Find(arc1.ilabel)) {
+      for (; !matcher->Done(); matcher->Next()) {
+        const auto &arc2 = matcher->Value();
+        // Continues on implicit epsilon match.
+        if (arc2.ilabel == kNoLabel) continue;
+        const ArcId a2(s2, matcher->Position());
+        // Actual transition is ambiguous.
+        if (s1 != s2 && arc1.nextstate == arc2.nextstate) {
+          result->candidates.push_back(MakeCandidate(s1, s2, a1, a2));
+        }
+        result->pairs.push_back(
+            arc1.nextstate <= arc2.nextstate
+                ? std::make_pair(arc1.nextstate, arc2.nextstate)
+                : std::make_pair(arc2.nextstate, arc1.nextstate));
+      }
+    }
   }
   // Super-final transition is ambiguous.
   if (s1 != s2 && fst.Final(s1) != Weight::Zero() &&
       fst.Final(s2) != Weight::Zero()) {
     const ArcId a1(s1, -1);
     const ArcId a2(s2, -1);
-    InsertCandidate(s1, s2, a1, a2);
+    result->candidates.push_back(MakeCandidate(s1, s2, a1, a2));
   }
 }
 
 template <class Arc>
 void Disambiguator<Arc>::MarkAmbiguities() {
-  if (!candidates_) return;
-  for (auto it = candidates_->begin(); it != candidates_->end(); ++it) {
-    const auto a = it->first;
-    const auto b = it->second;
+  // Candidates are sorted by their first arc, so ambiguous_ stays sorted.
+  const ArcIdCompare compare(head_);
+  for (const auto &[a, b] : candidates_) {
     // If b is not to be removed, then a is.
-    if (ambiguous_.count(b) == 0) ambiguous_.insert(a);
+    if (!std::binary_search(ambiguous_.begin(), ambiguous_.end(), b,
+                            compare) &&
+        (ambiguous_.empty() || ambiguous_.back() != a)) {
+      ambiguous_.push_back(a);
+    }
   }
-  coreachable_.clear();
-  candidates_.reset();
+  coreachable_.Clear();
+  std::vector<std::pair<ArcId, ArcId>>().swap(candidates_);
 }
 
 template <class Arc>
@@ -515,9 +638,9 @@ void Disambiguator<Arc>::RemoveSplits(MutableFst<Arc> *ofst) {
     }
   }
   // Repeats search for actual ambiguities on modified FST.
-  coreachable_.clear();
+  coreachable_.Clear();
   merge_.reset();
-  candidates_.reset();
+  candidates_.clear();
   FindAmbiguities(*ofst);
   if (merge_) {  // Shouldn't get here; sanity test.
     FSTERROR() << "Disambiguate: Unable to remove spurious ambiguities";
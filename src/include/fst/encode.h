@@ -25,16 +25,18 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include <fst/log.h>
 #include <fst/arc-map.h>
 #include <fstream>
+#include <fst/mapped-file.h>
+#include <fst/parallel.h>
 #include <fst/properties.h>
 #include <fst/rmfinalepsilon.h>
 #include <fst/util.h>
-#include <unordered_map>
 
 namespace fst {
 
@@ -51,6 +53,10 @@ namespace internal {
 inline constexpr uint8_t kEncodeHasISymbols = 0x04;
 inline constexpr uint8_t kEncodeHasOSymbols = 0x08;
 
+// Bit storing whether the triples of an encode table are written as one
+// aligned array rather than one by one, for internal use only.
+inline constexpr uint8_t kEncodeFlatTriples = 0x10;
+
 // Identifies stream data as an encode table (and its endianity).
 inline constexpr int32_t kEncodeMagicNumber = 2128178506;
 
@@ -95,6 +101,13 @@ namespace internal {
 // decoding of label/weight triples used for encoding and decoding of FSTs. The
 // EncodeTable is bidirectional, i.e, it stores both the Triple of encode labels
 // and weights to a unique label, and the reverse.
+//
+// The triples are stored contiguously, indexed by label - 1, and looked up
+// through an open-addressing hash table of labels. A table written with
+// FstWriteOptions::align stores the triples as one aligned array (when the
+// weight type is trivially copyable), which is memory-mapped when read in
+// FstReadOptions::MAP mode; it is only copied to memory, and its hash table
+// only built, if more triples are encoded.
 template <class Arc>
 class EncodeTable {
  public:
@@ -114,11 +127,11 @@ class EncodeTable {
           olabel(flags & kEncodeLabels ? arc.olabel : 0),
           weight(flags & kEncodeWeights ? arc.weight : Weight::One()) {}
 
-    static std::unique_ptr<Triple> Read(std::istream &strm) {
-      auto triple = std::make_unique<Triple>();
-      ReadType(strm, &triple->ilabel);
-      ReadType(strm, &triple->olabel);
-      ReadType(strm, &triple->weight);
+    static Triple Read(std::istream &strm) {
+      Triple triple;
+      ReadType(strm, &triple.ilabel);
+      ReadType(strm, &triple.olabel);
+      ReadType(strm, &triple.weight);
       return triple;
     }
 
@@ -128,7 +141,6 @@ class EncodeTable {
       WriteType(strm, weight);
     }
 
-    // Exploited below for TripleEqual functor.
     bool operator==(const Triple &other) const {
       return (ilabel == other.ilabel && olabel == other.olabel &&
               weight == other.weight);
@@ -139,25 +151,20 @@ class EncodeTable {
     Weight weight;
   };
 
-  // Equality functor for two Triple pointers.
-  struct TripleEqual {
-    bool operator()(const Triple *x, const Triple *y) const { return *x == *y; }
-  };
-
-  // Hash functor for one Triple pointer.
+  // Hash functor for one Triple.
   class TripleHash {
    public:
     explicit TripleHash(uint8_t flags) : flags_(flags) {}
 
-    size_t operator()(const Triple *triple) const {
-      size_t hash = triple->ilabel;
+    size_t operator()(const Triple &triple) const {
+      size_t hash = triple.ilabel;
       static constexpr int lshift = 5;
       static constexpr int rshift = CHAR_BIT * sizeof(size_t) - 5;
       if (flags_ & kEncodeLabels) {
-        hash = hash << lshift ^ hash >> rshift ^ triple->olabel;
+        hash = hash << lshift ^ hash >> rshift ^ triple.olabel;
       }
       if (flags_ & kEncodeWeights) {
-        hash = hash << lshift ^ hash >> rshift ^ triple->weight.Hash();
+        hash = hash << lshift ^ hash >> rshift ^ triple.weight.Hash();
       }
       return hash;
     }
@@ -166,35 +173,52 @@ class EncodeTable {
     uint8_t flags_;
   };
 
-  explicit EncodeTable(uint8_t flags)
-      : flags_(flags), triple2label_(1024, TripleHash(flags)) {}
+  explicit EncodeTable(uint8_t flags) : flags_(flags), hash_(flags) {}
 
   // Given an arc, encodes either input/output labels or input/costs or both.
-  Label Encode(const Arc &arc) {
-    // Encoding weights of a weighted superfinal transition could result in
-    // a clash with a true epsilon arc; to avoid this we hallucinate kNoLabel
-    // labels instead.
-    if (arc.nextstate == kNoStateId && (flags_ & kEncodeWeights)) {
-      return Encode(std::make_unique<Triple>(kNoLabel, kNoLabel, arc.weight));
-    } else {
-      return Encode(std::make_unique<Triple>(arc, flags_));
-    }
+  Label Encode(const Arc &arc) { return Encode(MakeTriple(arc)); }
+
+  // Returns the label of an arc encoded before, or kNoLabel if there is none.
+  // Unlike Encode(), this can be called from several threads at once, as long
+  // as the table is not modified meanwhile and Reserve() was called since the
+  // last modification.
+  Label Find(const Arc &arc) const {
+    DCHECK(!buckets_.empty());
+    const auto label = buckets_[FindBucket(MakeTriple(arc))];
+    return label == 0 ? kNoLabel : label;
   }
 
   // Given an encoded arc label, decodes back to input/output labels and costs.
+  // The triple returned is valid until the next call to Encode().
   const Triple *Decode(Label label) const {
-    if (label < 1 || label > triples_.size()) {
+    if (label < 1 || label > Size()) {
       LOG(ERROR) << "EncodeTable::Decode: Unknown decode label: " << label;
       return nullptr;
     }
-    return triples_[label - 1].get();
+    return Triples() + (label - 1);
   }
 
-  size_t Size() const { return triples_.size(); }
+  size_t Size() const { return region_ ? mapped_size_ : triples_.size(); }
 
-  static EncodeTable *Read(std::istream &strm, const std::string &source);
+  // Prepares the table to hold up to size triples without rehashing.
+  void Reserve(size_t size) {
+    if (region_) {
+      triples_.assign(Triples(), Triples() + mapped_size_);
+      region_.reset();
+    }
+    if (!buckets_.empty() && 2 * size <= buckets_.size()) return;
+    int bits = kMinBucketBits;
+    while ((size_t{1} << bits) < 2 * size) ++bits;
+    buckets_.assign(size_t{1} << bits, 0);
+    bucket_shift_ = 64 - bits;
+    for (Label label = 1; label <= triples_.size(); ++label) {
+      buckets_[FindBucket(triples_[label - 1])] = label;
+    }
+  }
 
-  bool Write(std::ostream &strm, const std::string &source) const;
+  static EncodeTable *Read(std::istream &strm, const FstReadOptions &opts);
+
+  bool Write(std::ostream &strm, const FstWriteOptions &opts) const;
 
   // This is masked to hide internal-only isymbol and osymbol bits.
 
@@ -225,17 +249,58 @@ class EncodeTable {
   }
 
  private:
-  Label Encode(std::unique_ptr<Triple> triple) {
-    auto insert_result =
-        triple2label_.emplace(triple.get(), triples_.size() + 1);
-    if (insert_result.second) triples_.push_back(std::move(triple));
-    return insert_result.first->second;
+  static constexpr int kMinBucketBits = 10;
+
+  // Encoding weights of a weighted superfinal transition could result in
+  // a clash with a true epsilon arc; to avoid this we hallucinate kNoLabel
+  // labels instead.
+  Triple MakeTriple(const Arc &arc) const {
+    if (arc.nextstate == kNoStateId && (flags_ & kEncodeWeights)) {
+      return Triple(kNoLabel, kNoLabel, arc.weight);
+    } else {
+      return Triple(arc, flags_);
+    }
+  }
+
+  Label Encode(Triple triple) {
+    Reserve(Size() + 1);
+    const auto bucket = FindBucket(triple);
+    if (buckets_[bucket] == 0) {
+      triples_.push_back(std::move(triple));
+      buckets_[bucket] = triples_.size();
+    }
+    return buckets_[bucket];
+  }
+
+  // Returns the bucket holding the label of the triple, or else the empty
+  // bucket where it goes; buckets are probed linearly from the (multiplicative)
+  // hash of the triple.
+  size_t FindBucket(const Triple &triple) const {
+    static constexpr uint64_t kMultiplier = 0x9e3779b97f4a7c15ULL;
+    const auto *triples = Triples();
+    const size_t mask = buckets_.size() - 1;
+    for (size_t bucket = (hash_(triple) * kMultiplier) >> bucket_shift_;;
+         bucket = (bucket + 1) & mask) {
+      const auto label = buckets_[bucket];
+      if (label == 0 || triples[label - 1] == triple) return bucket;
+    }
+  }
+
+  const Triple *Triples() const {
+    return region_ ? static_cast<const Triple *>(region_->data())
+                   : triples_.data();
   }
 
   uint8_t flags_;
-  std::vector<std::unique_ptr<Triple>> triples_;
-  std::unordered_map<const Triple *, Label, TripleHash, TripleEqual>
-      triple2label_;
+  TripleHash hash_;
+  std::vector<Triple> triples_;
+  // Triples memory-mapped (or read in bulk) from an aligned table.
+  std::unique_ptr<MappedFile> region_;
+  size_t mapped_size_ = 0;
+  // Labels of the triples (0 for an empty bucket), with a load factor of at
+  // most 1/2.
+  std::vector<Label> buckets_;
+  int bucket_shift_ = 64;
   std::unique_ptr<SymbolTable> isymbols_;
   std::unique_ptr<SymbolTable> osymbols_;
 
@@ -245,24 +310,44 @@ class EncodeTable {
 
 template <class Arc>
 EncodeTable<Arc> *EncodeTable<Arc>::Read(std::istream &strm,
-                                         const std::string &source) {
+                                         const FstReadOptions &opts) {
   EncodeTableHeader hdr;
-  if (!hdr.Read(strm, source)) return nullptr;
+  if (!hdr.Read(strm, opts.source)) return nullptr;
   const auto flags = hdr.Flags();
   const auto size = hdr.Size();
-  auto table = std::make_unique<EncodeTable>(flags);
-  for (int64_t i = 0; i < size; ++i) {
-    table->triples_.emplace_back(std::move(Triple::Read(strm)));
-    table->triple2label_[table->triples_.back().get()] = table->triples_.size();
+  auto table = std::make_unique<EncodeTable>(flags & ~kEncodeFlatTriples);
+  if (flags & kEncodeFlatTriples) {
+    if (!std::is_trivially_copyable_v<Triple>) {
+      LOG(ERROR) << "EncodeTable::Read: Aligned triples not supported for "
+                 << "weight type " << Weight::Type() << ": " << opts.source;
+      return nullptr;
+    }
+    if (!AlignInput(strm)) {
+      LOG(ERROR) << "EncodeTable::Read: Alignment failed: " << opts.source;
+      return nullptr;
+    }
+    table->region_.reset(MappedFile::Map(strm,
+                                         opts.mode == FstReadOptions::MAP,
+                                         opts.source, size * sizeof(Triple)));
+    if (!strm || !table->region_) {
+      LOG(ERROR) << "EncodeTable::Read: Read failed: " << opts.source;
+      return nullptr;
+    }
+    table->mapped_size_ = size;
+  } else {
+    table->triples_.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+      table->triples_.push_back(Triple::Read(strm));
+    }
   }
   if (flags & kEncodeHasISymbols) {
-    table->isymbols_.reset(SymbolTable::Read(strm, source));
+    table->isymbols_.reset(SymbolTable::Read(strm, opts.source));
   }
   if (flags & kEncodeHasOSymbols) {
-    table->osymbols_.reset(SymbolTable::Read(strm, source));
+    table->osymbols_.reset(SymbolTable::Read(strm, opts.source));
   }
   if (!strm) {
-    LOG(ERROR) << "EncodeTable::Read: Read failed: " << source;
+    LOG(ERROR) << "EncodeTable::Read: Read failed: " << opts.source;
     return nullptr;
   }
   return table.release();
@@ -270,18 +355,29 @@ EncodeTable<Arc> *EncodeTable<Arc>::Read(std::istream &strm,
 
 template <class Arc>
 bool EncodeTable<Arc>::Write(std::ostream &strm,
-                             const std::string &source) const {
+                             const FstWriteOptions &opts) const {
+  const bool flat = opts.align && std::is_trivially_copyable_v<Triple>;
   EncodeTableHeader hdr;
   hdr.SetArcType(Arc::Type());
-  hdr.SetFlags(flags_);  // Real flags, not masked ones.
+  // Real flags, not masked ones.
+  hdr.SetFlags(flat ? flags_ | kEncodeFlatTriples : flags_);
   hdr.SetSize(Size());
-  if (!hdr.Write(strm, source)) return false;
-  for (const auto &triple : triples_) triple->Write(strm);
+  if (!hdr.Write(strm, opts.source)) return false;
+  if (flat) {
+    if (!AlignOutput(strm)) {
+      LOG(ERROR) << "EncodeTable::Write: Alignment failed: " << opts.source;
+      return false;
+    }
+    strm.write(reinterpret_cast<const char *>(Triples()),
+               Size() * sizeof(Triple));
+  } else {
+    for (size_t i = 0; i < Size(); ++i) Triples()[i].Write(strm);
+  }
   if (flags_ & kEncodeHasISymbols) isymbols_->Write(strm);
   if (flags_ & kEncodeHasOSymbols) osymbols_->Write(strm);
   strm.flush();
   if (!strm) {
-    LOG(ERROR) << "EncodeTable::Write: Write failed: " << source;
+    LOG(ERROR) << "EncodeTable::Write: Write failed: " << opts.source;
     return false;
   }
   return true;
@@ -289,6 +385,17 @@ bool EncodeTable<Arc>::Write(std::ostream &strm,
 
 }  // namespace internal
 
+template <class Arc>
+class EncodeMapper;
+
+namespace internal {
+
+template <class Arc>
+void ParallelEncode(MutableFst<Arc> *fst, EncodeMapper<Arc> *mapper,
+                    size_t num_threads);
+
+}  // namespace internal
+
 // A mapper to encode/decode weighted transducers. Encoding of an FST is used
 // for performing classical determinization or minimization on a weighted
 // transducer viewing it as an unweighted acceptor over encoded labels.
@@ -366,12 +473,17 @@ class EncodeMapper {
 
   EncodeType Type() const { return type_; }
 
-  static EncodeMapper *Read(std::istream &strm, const std::string &source,
+  static EncodeMapper *Read(std::istream &strm, const FstReadOptions &opts,
                             EncodeType type = ENCODE) {
-    auto *table = internal::EncodeTable<Arc>::Read(strm, source);
+    auto *table = internal::EncodeTable<Arc>::Read(strm, opts);
     return table ? new EncodeMapper(table->Flags(), type, table) : nullptr;
   }
 
+  static EncodeMapper *Read(std::istream &strm, const std::string &source,
+                            EncodeType type = ENCODE) {
+    return Read(strm, FstReadOptions(source), type);
+  }
+
   static EncodeMapper *Read(const std::string &source,
                             EncodeType type = ENCODE) {
     std::ifstream strm(source, std::ios_base::in | std::ios_base::binary);
@@ -382,8 +494,12 @@ class EncodeMapper {
     return Read(strm, source, type);
   }
 
+  bool Write(std::ostream &strm, const FstWriteOptions &opts) const {
+    return table_->Write(strm, opts);
+  }
+
   bool Write(std::ostream &strm, const std::string &source) const {
-    return table_->Write(strm, source);
+    return Write(strm, FstWriteOptions(source));
   }
 
   bool Write(const std::string &source) const {
@@ -418,6 +534,17 @@ class EncodeMapper {
                         internal::EncodeTable<Arc> *table)
       : flags_(flags), type_(type), table_(table), error_(false) {}
 
+  // Returns the arc encoded with the given label.
+  Arc EncodeArc(const Arc &arc, Label label) const {
+    return Arc(label, flags_ & kEncodeLabels ? label : arc.olabel,
+               flags_ & kEncodeWeights ? Weight::One() : arc.weight,
+               arc.nextstate);
+  }
+
+  friend void internal::ParallelEncode<Arc>(MutableFst<Arc> *fst,
+                                            EncodeMapper<Arc> *mapper,
+                                            size_t num_threads);
+
   EncodeMapper &operator=(const EncodeMapper &) = delete;
 };
 
@@ -432,10 +559,7 @@ Arc EncodeMapper<Arc>::operator()(const Arc &arc) {
           ((flags_ & kEncodeWeights) && arc.weight == Weight::Zero())))) {
       return arc;
     } else {
-      const auto label = table_->Encode(arc);
-      return Arc(label, flags_ & kEncodeLabels ? label : arc.olabel,
-                 flags_ & kEncodeWeights ? Weight::One() : arc.weight,
-                 arc.nextstate);
+      return EncodeArc(arc, table_->Encode(arc));
     }
   } else {  // type_ == DECODE
     if (arc.nextstate == kNoStateId) {
@@ -469,12 +593,96 @@ Arc EncodeMapper<Arc>::operator()(const Arc &arc) {
   }
 }
 
-// Complexity: O(E + V).
+namespace internal {
+
+// Encodes the FST in place as ArcMap(fst, mapper) does, with num_threads > 1
+// threads. The states are processed in windows: the arcs of a window are
+// looked up in the encode table in parallel, then rewritten in state order,
+// encoding those not found, so that the labels are the same as with ArcMap.
+template <class Arc>
+void ParallelEncode(MutableFst<Arc> *fst, EncodeMapper<Arc> *mapper,
+                    size_t num_threads) {
+  using Label = typename Arc::Label;
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+  static constexpr StateId kStatesPerTask = 1024;
+  fst->SetInputSymbols(nullptr);
+  fst->SetOutputSymbols(nullptr);
+  if (fst->Start() == kNoStateId) return;
+  const auto props = fst->Properties(kFstProperties, false);
+  const bool encode_weights = mapper->Flags() & kEncodeWeights;
+  auto &table = *mapper->table_;
+  const StateId ns = fst->NumStates();
+  auto superfinal = kNoStateId;
+  if (encode_weights) {
+    superfinal = fst->AddState();
+    fst->SetFinal(superfinal);
+  }
+  const StateId window_size = 4 * num_threads * kStatesPerTask;
+  // For each state in the window, the labels found for its arcs followed, if
+  // weights are encoded, by the one found for its final weight.
+  std::vector<std::vector<Label>> labels(std::min(window_size, ns));
+  const Fst<Arc> &ifst = *fst;
+  for (StateId begin = 0; begin < ns; begin += window_size) {
+    const auto end = std::min(begin + window_size, ns);
+    table.Reserve(table.Size());
+    ParallelFor(
+        (end - begin + kStatesPerTask - 1) / kStatesPerTask, num_threads,
+        [&](size_t i) {
+          const auto task_end =
+              std::min<StateId>(begin + (i + 1) * kStatesPerTask, end);
+          for (StateId s = begin + i * kStatesPerTask; s < task_end; ++s) {
+            auto &state_labels = labels[s - begin];
+            state_labels.clear();
+            for (ArcIterator<Fst<Arc>> aiter(ifst, s); !aiter.Done();
+                 aiter.Next()) {
+              state_labels.push_back(table.Find(aiter.Value()));
+            }
+            if (encode_weights) {
+              const auto weight = ifst.Final(s);
+              state_labels.push_back(
+                  weight == Weight::Zero()
+                      ? kNoLabel
+                      : table.Find(Arc(0, 0, weight, kNoStateId)));
+            }
+          }
+        });
+    for (auto s = begin; s < end; ++s) {
+      auto label = labels[s - begin].cbegin();
+      for (MutableArcIterator<MutableFst<Arc>> aiter(fst, s); !aiter.Done();
+           aiter.Next(), ++label) {
+        const auto &arc = aiter.Value();
+        aiter.SetValue(mapper->EncodeArc(
+            arc, *label != kNoLabel ? *label : table.Encode(arc)));
+      }
+      if (!encode_weights) continue;
+      const auto weight = fst->Final(s);
+      if (weight == Weight::Zero()) continue;
+      const Arc arc(0, 0, weight, kNoStateId);
+      fst->AddArc(s, mapper->EncodeArc(
+                         Arc(0, 0, weight, superfinal),
+                         *label != kNoLabel ? *label : table.Encode(arc)));
+      fst->SetFinal(s, Weight::Zero());
+    }
+  }
+  fst->SetProperties(mapper->Properties(props), kFstProperties);
+}
+
+}  // namespace internal
+
+// Complexity: O(E + V). The arcs are looked up in the encode table with up
+// to num_threads threads (zero for one per hardware thread).
 template <class Arc>
-inline void Encode(MutableFst<Arc> *fst, EncodeMapper<Arc> *mapper) {
+inline void Encode(MutableFst<Arc> *fst, EncodeMapper<Arc> *mapper,
+                   size_t num_threads = 1) {
   mapper->SetInputSymbols(fst->InputSymbols());
   mapper->SetOutputSymbols(fst->OutputSymbols());
-  ArcMap(fst, mapper);
+  num_threads = NumWorkerThreads(num_threads);
+  if (num_threads > 1 && mapper->Type() == ENCODE) {
+    internal::ParallelEncode(fst, mapper, num_threads);
+  } else {
+    ArcMap(fst, mapper);
+  }
 }
 
 template <class Arc>
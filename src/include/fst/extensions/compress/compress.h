@@ -22,15 +22,18 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <cstddef>
 #include <cstdio>
+#include <functional>
 #include <ios>
 #include <iostream>
 #include <istream>
-#include <map>
 #include <memory>
 #include <ostream>
 #include <queue>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <fst/compat.h>
@@ -78,14 +81,13 @@ bool ExpandLZCode(const std::vector<std::pair<Var, Edge>> &code,
 
 }  // namespace internal
 
-// Lempel Ziv on data structure Edge, with a less-than operator EdgeLessThan and
-// an equals operator EdgeEquals.
-template <class Var, class Edge, class EdgeLessThan, class EdgeEquals>
+// Lempel Ziv on data structure Edge, with an equals operator EdgeEquals and a
+// hash function EdgeHash consistent with EdgeEquals.
+template <class Var, class Edge, class EdgeEquals,
+          class EdgeHash = std::hash<Edge>>
 class LempelZiv {
  public:
-  LempelZiv() : dict_number_(0), default_edge_() {
-    root_.current_number = dict_number_++;
-    root_.current_edge = default_edge_;
+  LempelZiv() : dict_number_(1), default_edge_() {
     decode_vector_.emplace_back(0, default_edge_);
   }
 
@@ -112,51 +114,62 @@ class LempelZiv {
   }
 
  private:
-  struct Node {
-    Var current_number;
-    Edge current_edge;
-    std::map<Edge, std::unique_ptr<Node>, EdgeLessThan> next_number;
+  // A dictionary key: the codeword of a prefix and the edge extending it.
+  using Key = std::pair<Var, Edge>;
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      return static_cast<size_t>(key.first) +
+             edge_hash(key.second) * size_t{7853};
+    }
+
+    EdgeHash edge_hash;
+  };
+
+  struct KeyEquals {
+    bool operator()(const Key &key1, const Key &key2) const {
+      return key1.first == key2.first && edge_equals(key1.second, key2.second);
+    }
+
+    EdgeEquals edge_equals;
   };
 
-  Node root_;
+  // Maps (prefix codeword, edge) pairs to codewords; the empty prefix is
+  // codeword 0.
+  std::unordered_map<Key, Var, KeyHash, KeyEquals> dict_;
   Var dict_number_;
   std::vector<std::pair<Var, Edge>> decode_vector_;
   Edge default_edge_;
 };
 
-template <class Var, class Edge, class EdgeLessThan, class EdgeEquals>
-void LempelZiv<Var, Edge, EdgeLessThan, EdgeEquals>::BatchEncode(
+template <class Var, class Edge, class EdgeEquals, class EdgeHash>
+void LempelZiv<Var, Edge, EdgeEquals, EdgeHash>::BatchEncode(
     const std::vector<Edge> &input, std::vector<std::pair<Var, Edge>> *output) {
   for (auto it = input.cbegin(); it != input.cend(); ++it) {
-    auto *temp_node = &root_;
+    Var current_number = 0;
     while (it != input.cend()) {
-      auto next = temp_node->next_number.find(*it);
-      if (next != temp_node->next_number.cend()) {
-        temp_node = next->second.get();
-        ++it;
-      } else {
-        break;
-      }
+      const auto next = dict_.find(Key(current_number, *it));
+      if (next == dict_.cend()) break;
+      current_number = next->second;
+      ++it;
     }
-    if (it == input.cend() && temp_node->current_number != 0) {
-      output->emplace_back(temp_node->current_number, default_edge_);
+    if (it == input.cend() && current_number != 0) {
+      output->emplace_back(current_number, default_edge_);
     } else if (it != input.cend()) {
-      output->emplace_back(temp_node->current_number, *it);
-      auto new_node = std::make_unique<Node>();
-      new_node->current_number = dict_number_++;
-      new_node->current_edge = *it;
-      temp_node->next_number[*it] = std::move(new_node);
+      output->emplace_back(current_number, *it);
+      dict_.emplace(Key(current_number, *it), dict_number_++);
     }
     if (it == input.cend()) break;
   }
 }
 
-template <class Var, class Edge, class EdgeLessThan, class EdgeEquals>
-bool LempelZiv<Var, Edge, EdgeLessThan, EdgeEquals>::BatchDecode(
+template <class Var, class Edge, class EdgeEquals, class EdgeHash>
+bool LempelZiv<Var, Edge, EdgeEquals, EdgeHash>::BatchDecode(
     const std::vector<std::pair<Var, Edge>> &input, std::vector<Edge> *output) {
+  std::vector<Edge> temp_output;
+  EdgeEquals InstEdgeEquals;
   for (const auto &[var, edge] : input) {
-    std::vector<Edge> temp_output;
-    EdgeEquals InstEdgeEquals;
+    temp_output.clear();
     if (InstEdgeEquals(edge, default_edge_) != 1) {
       decode_vector_.emplace_back(var, edge);
       temp_output.push_back(edge);
@@ -221,10 +234,7 @@ class Compressor {
   // Updates buffer_code_.
   template <class CVar>
   void WriteToBuffer(CVar input) {
-    std::vector<bool> current_code;
-    Elias<CVar>::DeltaEncode(input, &current_code);
-    buffer_code_.insert(buffer_code_.cend(), current_code.begin(),
-                        current_code.end());
+    Elias<CVar>::DeltaEncode(input, &buffer_code_);
   }
 
  private:
@@ -233,18 +243,16 @@ class Compressor {
     Label label;
   };
 
-  struct LabelLessThan {
-    bool operator()(const LZLabel &labelone, const LZLabel &labeltwo) const {
-      return labelone.label < labeltwo.label;
-    }
-  };
-
   struct LabelEquals {
     bool operator()(const LZLabel &labelone, const LZLabel &labeltwo) const {
       return labelone.label == labeltwo.label;
     }
   };
 
+  struct LabelHash {
+    size_t operator()(const LZLabel &label) const { return label.label; }
+  };
+
   struct Transition {
     Transition() : nextstate(0), label(0), weight(Weight::Zero()) {}
 
@@ -272,6 +280,14 @@ class Compressor {
     }
   };
 
+  // Ignores the weight, consistent with TransitionEquals.
+  struct TransitionHash {
+    size_t operator()(const Transition &transition) const {
+      return static_cast<size_t>(transition.nextstate) +
+             static_cast<size_t>(transition.label) * size_t{7853};
+    }
+  };
+
   struct OldDictCompare {
     bool operator()(const std::pair<StateId, Transition> &pair_one,
                     const std::pair<StateId, Transition> &pair_two) const {
@@ -283,7 +299,7 @@ class Compressor {
     }
   };
 
-  std::vector<bool> buffer_code_;
+  EliasBitWriter buffer_code_;
   std::vector<Weight> arc_weight_;
   std::vector<Weight> final_weight_;
 };
@@ -347,12 +363,14 @@ template <class Arc>
 void Compressor<Arc>::EncodeProcessedFst(const ExpandedFst<Arc> &fst,
                                          std::ostream &strm) {
   std::vector<StateId> output;
-  LempelZiv<StateId, LZLabel, LabelLessThan, LabelEquals> dict_new;
-  LempelZiv<StateId, Transition, TransitionLessThan, TransitionEquals> dict_old;
+  LempelZiv<StateId, LZLabel, LabelEquals, LabelHash> dict_new;
+  LempelZiv<StateId, Transition, TransitionEquals, TransitionHash> dict_old;
   std::vector<LZLabel> current_new_input;
   std::vector<Transition> current_old_input;
   std::vector<std::pair<StateId, LZLabel>> current_new_output;
   std::vector<std::pair<StateId, Transition>> current_old_output;
+  std::vector<StateId> dict_old_temp;
+  std::vector<Transition> transition_old_temp;
   std::vector<StateId> final_states;
   const auto number_of_states = fst.NumStates();
   StateId seen_states = 0;
@@ -365,9 +383,10 @@ void Compressor<Arc>::EncodeProcessedFst(const ExpandedFst<Arc> &fst,
     current_old_output.clear();
     if (state > seen_states) ++seen_states;
     // Collects the final states.
-    if (fst.Final(state) != Weight::Zero()) {
+    const auto final_weight = fst.Final(state);
+    if (final_weight != Weight::Zero()) {
       final_states.push_back(state);
-      final_weight_.push_back(fst.Final(state));
+      final_weight_.push_back(final_weight);
     }
     // Reads the states.
     for (ArcIterator<Fst<Arc>> aiter(fst, state); !aiter.Done(); aiter.Next()) {
@@ -403,8 +422,8 @@ void Compressor<Arc>::EncodeProcessedFst(const ExpandedFst<Arc> &fst,
       arc_weight_.push_back(it->weight);
     }
     dict_old.BatchEncode(current_old_input, &current_old_output);
-    std::vector<StateId> dict_old_temp;
-    std::vector<Transition> transition_old_temp;
+    dict_old_temp.clear();
+    transition_old_temp.clear();
     for (auto it = current_old_output.begin(); it != current_old_output.end();
          ++it) {
       dict_old_temp.push_back(it->first);
@@ -471,8 +490,8 @@ template <class Arc>
 void Compressor<Arc>::DecodeProcessedFst(const std::vector<StateId> &input,
                                          MutableFst<Arc> *fst,
                                          bool unweighted) {
-  LempelZiv<StateId, LZLabel, LabelLessThan, LabelEquals> dict_new;
-  LempelZiv<StateId, Transition, TransitionLessThan, TransitionEquals> dict_old;
+  LempelZiv<StateId, LZLabel, LabelEquals, LabelHash> dict_new;
+  LempelZiv<StateId, Transition, TransitionEquals, TransitionHash> dict_old;
   std::vector<std::pair<StateId, LZLabel>> current_new_input;
   std::vector<std::pair<StateId, Transition>> current_old_input;
   std::vector<LZLabel> current_new_output;
@@ -649,6 +668,8 @@ void Compressor<Arc>::ReadWeight(std::istream &strm,
   int64_t size;
   Weight weight;
   ReadType(strm, &size);
+  if (!strm || size < 0) return;
+  output->reserve(output->size() + size);
   for (int64_t i = 0; i < size; ++i) {
     weight.Read(strm);
     output->push_back(weight);
@@ -667,22 +688,21 @@ bool Compressor<Arc>::Decompress(std::istream &strm, const std::string &source,
   }
   std::unique_ptr<EncodeMapper<Arc>> encoder(
       EncodeMapper<Arc>::Read(strm, "Decoding", DECODE));
-  std::vector<bool> bool_code;
-  uint8_t block;
-  uint8_t msb = 128;
-  int64_t data_size;
+  int64_t data_size = -1;
   ReadType(strm, &data_size);
-  for (int64_t i = 0; i < data_size; ++i) {
-    ReadType(strm, &block);
-    for (int j = 0; j < 8; ++j) {
-      uint8_t temp = msb & block;
-      bool_code.push_back(temp == 128);
-      block = block << 1;
-    }
+  if (!strm || data_size <= 0) {
+    LOG(ERROR) << "Decompress: Bad compressed Fst: " << source;
+    return false;
   }
+  std::vector<uint8_t> byte_code(data_size);
+  strm.read(reinterpret_cast<char *>(byte_code.data()), data_size);
   std::vector<StateId> int_code;
-  Elias<StateId>::BatchDecode(bool_code, &int_code);
-  bool_code.clear();
+  if (!strm || !Elias<StateId>::BatchDecode(byte_code, &int_code)) {
+    LOG(ERROR) << "Decompress: Bad compressed Fst: " << source;
+    return false;
+  }
+  byte_code.clear();
+  byte_code.shrink_to_fit();
   uint8_t unweighted;
   ReadType(strm, &unweighted);
   if (unweighted == 0) {
@@ -706,22 +726,11 @@ void Compressor<Arc>::WriteWeight(const std::vector<Weight> &input,
 
 template <class Arc>
 void Compressor<Arc>::WriteToStream(std::ostream &strm) {
-  while (buffer_code_.size() % 8 != 0) buffer_code_.push_back(true);
-  int64_t data_size = buffer_code_.size() / 8;
+  buffer_code_.Finish();
+  const auto &bytes = buffer_code_.Bytes();
+  const int64_t data_size = bytes.size();
   WriteType(strm, data_size);
-  int64_t i = 0;
-  uint8_t block;
-  for (auto it = buffer_code_.begin(); it != buffer_code_.end(); ++it) {
-    if (i % 8 == 0) {
-      if (i > 0) WriteType(strm, block);
-      block = 0;
-    } else {
-      block = block << 1;
-    }
-    block |= *it;
-    ++i;
-  }
-  WriteType(strm, block);
+  strm.write(reinterpret_cast<const char *>(bytes.data()), data_size);
 }
 
 template <class Arc>
@@ -20,11 +20,152 @@
 #ifndef FST_EXTENSIONS_COMPRESS_ELIAS_H_
 #define FST_EXTENSIONS_COMPRESS_ELIAS_H_
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <stack>
 #include <vector>
 
 #include <fst/compat.h>
 namespace fst {
+namespace internal {
+
+// Number of significant bits in a nonzero value.
+inline int BitLength(uint64_t value) { return 64 - __builtin_clzll(value); }
+
+}  // namespace internal
+
+// Packs bits MSB-first into bytes, buffering a machine word at a time. This
+// produces the same byte sequence as packing a std::vector<bool> eight bits at
+// a time.
+class EliasBitWriter {
+ public:
+  EliasBitWriter() = default;
+
+  // Appends the low nbits of value, most significant bit first.
+  void Write(uint64_t value, int nbits) {
+    while (nbits > 0) {
+      const int take = std::min(nbits, 64 - nbuffered_);
+      const uint64_t bits = (value >> (nbits - take)) & Mask(take);
+      buffer_ = take == 64 ? bits : (buffer_ << take) | bits;
+      nbuffered_ += take;
+      nbits -= take;
+      if (nbuffered_ == 64) Flush();
+    }
+  }
+
+  // Pads the code with one bits to a byte boundary and flushes the buffer.
+  void Finish() {
+    const int padding = (8 - nbuffered_ % 8) % 8;
+    Write(Mask(padding), padding);
+    Flush();
+  }
+
+  // Number of bits written so far.
+  size_t NumBits() const { return bytes_.size() * 8 + nbuffered_; }
+
+  // Packed bytes; only complete after Finish().
+  const std::vector<uint8_t> &Bytes() const { return bytes_; }
+
+  void Clear() {
+    bytes_.clear();
+    buffer_ = 0;
+    nbuffered_ = 0;
+  }
+
+ private:
+  static uint64_t Mask(int nbits) {
+    return nbits == 64 ? ~uint64_t{0} : (uint64_t{1} << nbits) - 1;
+  }
+
+  // Moves whole buffered bytes to the output.
+  void Flush() {
+    while (nbuffered_ >= 8) {
+      nbuffered_ -= 8;
+      bytes_.push_back(static_cast<uint8_t>(buffer_ >> nbuffered_));
+    }
+  }
+
+  std::vector<uint8_t> bytes_;
+  uint64_t buffer_ = 0;
+  int nbuffered_ = 0;
+};
+
+// Reads bits MSB-first from a byte buffer, refilling a machine word at a time.
+class EliasBitReader {
+ public:
+  EliasBitReader(const uint8_t *data, size_t size)
+      : data_(data), size_(size) {}
+
+  // Returns true if no bits remain.
+  bool Done() {
+    Refill();
+    return nwindow_ == 0;
+  }
+
+  // True if a read ran past the end of the buffer.
+  bool Error() const { return error_; }
+
+  // Reads nbits (at most 64), most significant bit first.
+  uint64_t Read(int nbits) {
+    uint64_t value = 0;
+    while (nbits > 0) {
+      Refill();
+      if (nwindow_ == 0) {
+        error_ = true;
+        return value;
+      }
+      const int take = std::min(nbits, nwindow_);
+      value = take == 64 ? window_ : (value << take) | (window_ >> (64 - take));
+      Consume(take);
+      nbits -= take;
+    }
+    return value;
+  }
+
+  // Counts and consumes a run of zero bits together with the terminating one
+  // bit.
+  int ReadUnary() {
+    int zeros = 0;
+    while (true) {
+      Refill();
+      if (nwindow_ == 0) {
+        error_ = true;
+        return zeros;
+      }
+      if (window_ == 0) {
+        zeros += nwindow_;
+        Consume(nwindow_);
+      } else {
+        const int run = __builtin_clzll(window_);
+        zeros += run;
+        Consume(run + 1);
+        return zeros;
+      }
+    }
+  }
+
+ private:
+  // Tops up the window so that it holds at least 57 bits, if available.
+  void Refill() {
+    while (nwindow_ <= 56 && pos_ < size_) {
+      window_ |= static_cast<uint64_t>(data_[pos_++]) << (56 - nwindow_);
+      nwindow_ += 8;
+    }
+  }
+
+  void Consume(int nbits) {
+    window_ = nbits == 64 ? 0 : window_ << nbits;
+    nwindow_ -= nbits;
+  }
+
+  const uint8_t *data_;
+  size_t size_;
+  size_t pos_ = 0;
+  uint64_t window_ = 0;  // Unread bits, left-aligned.
+  int nwindow_ = 0;
+  bool error_ = false;
+};
 
 template <class Var>
 class Elias {
@@ -35,9 +176,17 @@ class Elias {
   // Elias Delta encoding for a single integer.
   static void DeltaEncode(const Var &input, std::vector<bool> *code);
 
+  // Elias Delta encoding for a single integer, appended to a packed buffer.
+  static void DeltaEncode(const Var &input, EliasBitWriter *writer);
+
   // Batch decoding of a set of integers.
   static void BatchDecode(const std::vector<bool> &input,
                           std::vector<Var> *output);
+
+  // Batch decoding of a set of integers from a packed buffer, as produced by
+  // EliasBitWriter. Returns false if the last code is truncated.
+  static bool BatchDecode(const std::vector<uint8_t> &input,
+                          std::vector<Var> *output);
 };
 
 template <class Var>
@@ -73,6 +222,17 @@ void Elias<Var>::DeltaEncode(const Var &input, std::vector<bool> *code) {
   }
 }
 
+template <class Var>
+void Elias<Var>::DeltaEncode(const Var &input, EliasBitWriter *writer) {
+  const uint64_t value = static_cast<uint64_t>(input) + 1;
+  const int nbits = internal::BitLength(value);
+  const int nbits_length = internal::BitLength(nbits);
+  // Gamma code of the length, followed by the value without its leading one.
+  writer->Write(0, nbits_length - 1);
+  writer->Write(nbits, nbits_length);
+  writer->Write(value, nbits - 1);
+}
+
 template <class Var>
 void Elias<Var>::BatchDecode(const std::vector<bool> &input,
                              std::vector<Var> *output) {
@@ -105,6 +265,23 @@ void Elias<Var>::BatchDecode(const std::vector<bool> &input,
   }
 }
 
+template <class Var>
+bool Elias<Var>::BatchDecode(const std::vector<uint8_t> &input,
+                             std::vector<Var> *output) {
+  EliasBitReader reader(input.data(), input.size());
+  while (!reader.Done()) {
+    const int lead_zeros = reader.ReadUnary();
+    if (lead_zeros > 6) return false;
+    const int nbits = (1 << lead_zeros) | reader.Read(lead_zeros);
+    if (nbits > 64) return false;
+    const uint64_t value =
+        nbits == 1 ? 1 : (uint64_t{1} << (nbits - 1)) | reader.Read(nbits - 1);
+    if (reader.Error()) return false;
+    output->push_back(static_cast<Var>(value - 1));
+  }
+  return true;
+}
+
 }  // namespace fst
 
 #endif  // FST_EXTENSIONS_COMPRESS_ELIAS_H_
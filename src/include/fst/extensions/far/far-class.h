@@ -22,6 +22,7 @@
 
 #include <memory>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include <fst/extensions/far/far.h>
@@ -185,8 +186,9 @@ template <class Arc>
 class FarWriterClassImpl : public FarWriterImplBase {
  public:
   explicit FarWriterClassImpl(const std::string &source,
-                              FarType type = FarType::DEFAULT)
-      : writer_(FarWriter<Arc>::Create(source, type)) {}
+                              FarType type = FarType::DEFAULT,
+                              bool append = false)
+      : writer_(FarWriter<Arc>::Create(source, type, append)) {}
 
   bool Add(const std::string &key, const FstClass &fst) final {
     if (ArcType() != fst.ArcType()) {
@@ -214,7 +216,8 @@ class FarWriterClassImpl : public FarWriterImplBase {
 
 class FarWriterClass;
 
-using CreateFarWriterClassInnerArgs = std::pair<const std::string &, FarType>;
+using CreateFarWriterClassInnerArgs =
+    std::tuple<const std::string &, FarType, bool>;
 
 using CreateFarWriterClassArgs =
     WithReturnValue<std::unique_ptr<FarWriterClass>,
@@ -225,7 +228,7 @@ class FarWriterClass {
  public:
   static std::unique_ptr<FarWriterClass> Create(
       const std::string &source, const std::string &arc_type,
-      FarType type = FarType::DEFAULT);
+      FarType type = FarType::DEFAULT, bool append = false);
 
   bool Add(const std::string &key, const FstClass &fst) {
     return impl_->Add(key, fst);
@@ -272,7 +275,8 @@ template <class Arc>
 void CreateFarWriterClass(CreateFarWriterClassArgs *args) {
   args->retval = fst::WrapUnique(
       new FarWriterClass(std::make_unique<FarWriterClassImpl<Arc>>(
-          std::get<0>(args->args), std::get<1>(args->args))));
+          std::get<0>(args->args), std::get<1>(args->args),
+          std::get<2>(args->args))));
 }
 
 }  // namespace script
@@ -21,14 +21,22 @@
 #define FST_EXTENSIONS_FAR_FAR_H_
 
 #include <algorithm>
+#include <condition_variable>
 #include <cstdint>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
 
+#include <fst/flags.h>
 #include <fst/log.h>
 #include <fst/extensions/far/stlist.h>
+#include <fst/extensions/far/ststream.h>
 #include <fst/extensions/far/sttable.h>
 #include <fst/arc.h>
 #include <fstream>
@@ -36,6 +44,8 @@
 #include <fst/vector-fst.h>
 #include <string_view>
 
+DECLARE_int32(far_prefetch);
+
 namespace fst {
 
 enum class FarEntryType { LINE, FILE };
@@ -45,6 +55,7 @@ enum class FarType {
   STTABLE = 1,
   STLIST = 2,
   FST = 3,
+  STSTREAM = 4,
 };
 
 // Checks for FST magic number in an input stream (to be opened given the source
@@ -59,6 +70,49 @@ inline bool IsFst(const std::string &source) {
   return match;
 }
 
+namespace internal {
+
+// Determines the FAR type from the magic number at the current position of an
+// open stream, leaving the position unchanged so that the stream can be handed
+// to the reader. A seekable stream is read and repositioned; otherwise only one
+// byte is peeked, which tells all the formats apart except STTable from STList,
+// and STTable cannot be read without seeking anyway. Returns false if the type
+// is not recognized.
+inline bool PeekFarType(std::istream &strm, FarType *type) {
+  static constexpr std::pair<int32_t, FarType> kMagicNumbers[] = {
+      {kSTListMagicNumber, FarType::STLIST},
+      {kSTTableMagicNumber, FarType::STTABLE},
+      {kSTStreamMagicNumber, FarType::STSTREAM},
+      {kFstMagicNumber, FarType::FST}};
+  const auto pos = strm.tellg();
+  if (pos != std::streampos(-1)) {
+    int32_t magic_number = 0;
+    ReadType(strm, &magic_number);
+    const bool read = !strm.fail();
+    strm.clear();
+    strm.seekg(pos);
+    if (!read) return false;
+    for (const auto &[magic, magic_type] : kMagicNumbers) {
+      if (magic_number != magic) continue;
+      *type = magic_type;
+      return true;
+    }
+    return false;
+  }
+  const auto c = strm.peek();
+  if (c == std::istream::traits_type::eof()) return false;
+  for (const auto &[magic, magic_type] : kMagicNumbers) {
+    char first;
+    std::memcpy(&first, &magic, 1);
+    if (std::istream::traits_type::to_char_type(c) != first) continue;
+    *type = magic_type;
+    return true;
+  }
+  return false;
+}
+
+}  // namespace internal
+
 // FST archive header class
 class FarHeader {
  public:
@@ -70,11 +124,25 @@ class FarHeader {
     FstHeader fsthdr;
     arctype_ = "unknown";
     if (source.empty()) {
-      // Header reading unsupported on stdin. Assumes STList and StdArc.
-      fartype_ = FarType::STLIST;
+      // Header reading unsupported on stdin, as the reader must see the whole
+      // input. Peeks at the FAR type and assumes StdArc.
+      if (!internal::PeekFarType(std::cin, &fartype_)) {
+        fartype_ = FarType::STLIST;
+      }
       arctype_ = "standard";
       return true;
-    } else if (IsSTTable(source)) {  // Checks if STTable.
+    }
+    {
+      // Likewise for pipes, which are not seekable; only the reader may read
+      // from them, so the FAR type is unknown.
+      std::ifstream strm(source, std::ios_base::in | std::ios_base::binary);
+      if (strm && strm.tellg() == std::streampos(-1)) {
+        fartype_ = FarType::DEFAULT;
+        arctype_ = "standard";
+        return true;
+      }
+    }
+    if (IsSTTable(source)) {  // Checks if STTable.
       fartype_ = FarType::STTABLE;
       if (!ReadSTTableHeader(source, &fsthdr)) return false;
       arctype_ = fsthdr.ArcType().empty() ? ErrorArc::Type() : fsthdr.ArcType();
@@ -84,6 +152,11 @@ class FarHeader {
       if (!ReadSTListHeader(source, &fsthdr)) return false;
       arctype_ = fsthdr.ArcType().empty() ? ErrorArc::Type() : fsthdr.ArcType();
       return true;
+    } else if (IsSTStream(source)) {  // Checks if STStream.
+      fartype_ = FarType::STSTREAM;
+      if (!ReadSTStreamHeader(source, &fsthdr)) return false;
+      arctype_ = fsthdr.ArcType().empty() ? ErrorArc::Type() : fsthdr.ArcType();
+      return true;
     } else if (IsFst(source)) {  // Checks if FST.
       fartype_ = FarType::FST;
       std::ifstream istrm(source,
@@ -107,8 +180,11 @@ class FarWriter {
   using Arc = A;
 
   // Creates a new (empty) FST archive; returns null on error.
+  // If append is true, FSTs are added after those already in the archive;
+  // this is only supported by the STStream type.
   static FarWriter *Create(const std::string &source,
-                           FarType type = FarType::DEFAULT);
+                           FarType type = FarType::DEFAULT,
+                           bool append = false);
 
   // Adds an FST to the end of an archive. Keys must be non-empty and
   // in lexicographic order. FSTs must have a suitable write method.
@@ -226,6 +302,34 @@ class STListFarWriter : public FarWriter<A> {
   std::unique_ptr<STListWriter<Fst<Arc>, FstWriter<Arc>>> writer_;
 };
 
+template <class A>
+class STStreamFarWriter : public FarWriter<A> {
+ public:
+  using Arc = A;
+
+  // If append is true, entries are added to an existing STStream archive.
+  static STStreamFarWriter *Create(const std::string &source,
+                                   bool append = false) {
+    auto *writer =
+        STStreamWriter<Fst<Arc>, FstWriter<Arc>>::Create(source, append);
+    return new STStreamFarWriter(writer);
+  }
+
+  void Add(std::string_view key, const Fst<Arc> &fst) final {
+    writer_->Add(key, fst);
+  }
+
+  FarType Type() const final { return FarType::STSTREAM; }
+
+  bool Error() const final { return writer_->Error(); }
+
+ private:
+  explicit STStreamFarWriter(STStreamWriter<Fst<Arc>, FstWriter<Arc>> *writer)
+      : writer_(writer) {}
+
+  std::unique_ptr<STStreamWriter<Fst<Arc>, FstWriter<Arc>>> writer_;
+};
+
 template <class A>
 class FstFarWriter final : public FarWriter<A> {
  public:
@@ -262,7 +366,12 @@ class FstFarWriter final : public FarWriter<A> {
 
 template <class Arc>
 FarWriter<Arc> *FarWriter<Arc>::Create(const std::string &source,
-                                       FarType type) {
+                                       FarType type, bool append) {
+  if (append && type != FarType::STSTREAM) {
+    LOG(ERROR) << "FarWriter::Create: Appending is only supported for "
+               << "STStream FARs";
+    return nullptr;
+  }
   switch (type) {
     case FarType::DEFAULT:
       if (source.empty()) return STListFarWriter<Arc>::Create(source);
@@ -272,6 +381,8 @@ FarWriter<Arc> *FarWriter<Arc>::Create(const std::string &source,
       return STListFarWriter<Arc>::Create(source);
     case FarType::FST:
       return FstFarWriter<Arc>::Create(source);
+    case FarType::STSTREAM:
+      return STStreamFarWriter<Arc>::Create(source, append);
     default:
       LOG(ERROR) << "FarWriter::Create: Unknown FAR type";
       return nullptr;
@@ -342,9 +453,12 @@ class STListFarReader : public FarReader<A> {
     return new STListFarReader(std::move(reader));
   }
 
-  static STListFarReader *Open(const std::vector<std::string> &sources) {
+  // If non-null, strm is a stream already opened on sources[0].
+  static STListFarReader *Open(const std::vector<std::string> &sources,
+                             std::unique_ptr<std::istream> strm = nullptr) {
     auto reader =
-        fst::WrapUnique(STListReader<Fst<Arc>, FstReader<Arc>>::Open(sources));
+        fst::WrapUnique(STListReader<Fst<Arc>, FstReader<Arc>>::Open(
+            sources, std::move(strm)));
     if (!reader || reader->Error()) return nullptr;
     return new STListFarReader(std::move(reader));
   }
@@ -373,6 +487,54 @@ class STListFarReader : public FarReader<A> {
   std::unique_ptr<STListReader<Fst<Arc>, FstReader<Arc>>> reader_;
 };
 
+template <class A>
+class STStreamFarReader final : public FarReader<A> {
+ public:
+  using Arc = A;
+
+  // Damaged data skipped while reading the first entry does not fail opening;
+  // it is reported by Error().
+  static STStreamFarReader *Open(const std::string &source) {
+    auto reader = fst::WrapUnique(
+        STStreamReader<Fst<Arc>, FstReader<Arc>>::Open(source));
+    if (!reader || (reader->Error() && !reader->NumSkipped())) return nullptr;
+    return new STStreamFarReader(std::move(reader));
+  }
+
+  // If non-null, strm is a stream already opened on sources[0].
+  static STStreamFarReader *Open(const std::vector<std::string> &sources,
+                                 std::unique_ptr<std::istream> strm = nullptr) {
+    auto reader =
+        fst::WrapUnique(STStreamReader<Fst<Arc>, FstReader<Arc>>::Open(
+            sources, std::move(strm)));
+    if (!reader || (reader->Error() && !reader->NumSkipped())) return nullptr;
+    return new STStreamFarReader(std::move(reader));
+  }
+
+  void Reset() final { reader_->Reset(); }
+
+  bool Find(std::string_view key) final { return reader_->Find(key); }
+
+  bool Done() const final { return reader_->Done(); }
+
+  void Next() final { return reader_->Next(); }
+
+  const std::string &GetKey() const final { return reader_->GetKey(); }
+
+  const Fst<Arc> *GetFst() const final { return reader_->GetEntry(); }
+
+  FarType Type() const final { return FarType::STSTREAM; }
+
+  bool Error() const final { return reader_->Error(); }
+
+ private:
+  explicit STStreamFarReader(
+      std::unique_ptr<STStreamReader<Fst<Arc>, FstReader<Arc>>> reader)
+      : reader_(std::move(reader)) {}
+
+  std::unique_ptr<STStreamReader<Fst<Arc>, FstReader<Arc>>> reader_;
+};
+
 template <class A>
 class FstFarReader final : public FarReader<A> {
  public:
@@ -384,16 +546,21 @@ class FstFarReader final : public FarReader<A> {
     return new FstFarReader<Arc>(sources);
   }
 
-  static FstFarReader *Open(const std::vector<std::string> &sources) {
-    return new FstFarReader<Arc>(sources);
+  // If non-null, strm is a stream already opened on sources[0].
+  static FstFarReader *Open(const std::vector<std::string> &sources,
+                            std::unique_ptr<std::istream> strm = nullptr) {
+    return new FstFarReader<Arc>(sources, std::move(strm));
   }
 
-  explicit FstFarReader(const std::vector<std::string> &sources)
+  explicit FstFarReader(const std::vector<std::string> &sources,
+                        std::unique_ptr<std::istream> strm = nullptr)
       : keys_(sources), has_stdin_(false), pos_(0), error_(false) {
     std::sort(keys_.begin(), keys_.end());
     streams_.resize(keys_.size(), nullptr);
     for (size_t i = 0; i < keys_.size(); ++i) {
-      if (keys_[i].empty()) {
+      if (strm && keys_[i] == sources[0]) {
+        streams_[i] = strm.release();
+      } else if (keys_[i].empty()) {
         if (!has_stdin_) {
           streams_[i] = &std::cin;
           has_stdin_ = true;
@@ -468,7 +635,8 @@ class FstFarReader final : public FarReader<A> {
   void ReadFst() {
     fst_.reset();
     if (pos_ >= keys_.size()) return;
-    streams_[pos_]->seekg(0);
+    // Rewinds if the FST was read before; pipes are only read once.
+    if (streams_[pos_]->tellg() > 0) streams_[pos_]->seekg(0);
     fst_.reset(Fst<Arc>::Read(*streams_[pos_], FstReadOptions()));
     if (!fst_) {
       FSTERROR() << "FstFarReader: Error reading Fst from: " << keys_[pos_];
@@ -484,30 +652,206 @@ class FstFarReader final : public FarReader<A> {
   mutable bool error_;
 };
 
+// Decorates another FarReader, deserializing up to a fixed number of entries
+// ahead of the current position on a background thread so that reading
+// overlaps with whatever the caller does with each FST. Entries are delivered
+// in the order of the underlying reader. All methods must be called from a
+// single thread, as with any other FarReader.
+template <class A>
+class PrefetchFarReader final : public FarReader<A> {
+ public:
+  using Arc = A;
+
+  // Takes ownership of the reader, which must not be used directly anymore.
+  // Returns null if the reader is null.
+  static PrefetchFarReader *Open(FarReader<Arc> *reader, size_t prefetch) {
+    if (!reader) return nullptr;
+    return new PrefetchFarReader(fst::WrapUnique(reader), prefetch);
+  }
+
+  void Reset() final {
+    Stop();
+    reader_->Reset();
+    Start();
+  }
+
+  bool Find(std::string_view key) final {
+    Stop();
+    const bool found = reader_->Find(key);
+    Start();
+    return found;
+  }
+
+  bool Done() const final { return !fst_; }
+
+  void Next() final { Fetch(); }
+
+  const std::string &GetKey() const final { return key_; }
+
+  const Fst<Arc> *GetFst() const final { return fst_.get(); }
+
+  FarType Type() const final { return reader_->Type(); }
+
+  bool Error() const final {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return error_;
+  }
+
+  ~PrefetchFarReader() final { Stop(); }
+
+ private:
+  struct Entry {
+    std::string key;
+    std::unique_ptr<const Fst<Arc>> fst;
+  };
+
+  PrefetchFarReader(std::unique_ptr<FarReader<Arc>> reader, size_t prefetch)
+      : reader_(std::move(reader)), prefetch_(std::max<size_t>(prefetch, 1)) {
+    Start();
+  }
+
+  // Starts reading ahead from the current position of the underlying reader
+  // and waits for the first entry.
+  void Start() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.clear();
+      stop_ = false;
+      finished_ = false;
+      error_ = reader_->Error();
+    }
+    thread_ = std::thread(&PrefetchFarReader::ReadAhead, this);
+    Fetch();
+  }
+
+  // Stops the background thread, discarding prefetched entries. Afterwards the
+  // underlying reader may be used directly.
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    not_full_.notify_all();
+    if (thread_.joinable()) thread_.join();
+    queue_.clear();
+    key_.clear();
+    fst_.reset();
+  }
+
+  // Moves the next prefetched entry to the current position, waiting for it if
+  // necessary.
+  void Fetch() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return !queue_.empty() || finished_; });
+    if (queue_.empty()) {
+      key_.clear();
+      fst_.reset();
+      return;
+    }
+    key_ = std::move(queue_.front().key);
+    fst_ = std::move(queue_.front().fst);
+    queue_.pop_front();
+    lock.unlock();
+    not_full_.notify_one();
+  }
+
+  // Background thread body; this is the only code touching the underlying
+  // reader while the thread is running.
+  void ReadAhead() {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock,
+                       [this] { return queue_.size() < prefetch_ || stop_; });
+        if (stop_) break;
+      }
+      if (reader_->Done()) break;
+      Entry entry;
+      entry.key = reader_->GetKey();
+      if (const auto *fst = reader_->GetFst()) entry.fst.reset(fst->Copy());
+      if (!entry.fst) {
+        FSTERROR() << "PrefetchFarReader: Error reading FST: " << entry.key;
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = true;
+        break;
+      }
+      reader_->Next();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(entry));
+      }
+      not_empty_.notify_one();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      error_ = error_ || reader_->Error();
+      finished_ = true;
+    }
+    not_empty_.notify_all();
+  }
+
+  std::unique_ptr<FarReader<Arc>> reader_;
+  const size_t prefetch_;
+  // Current entry, owned by the calling thread.
+  std::string key_;
+  std::unique_ptr<const Fst<Arc>> fst_;
+  // State shared with the background thread, guarded by mutex_.
+  mutable std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::deque<Entry> queue_;
+  bool stop_ = false;
+  bool finished_ = false;
+  bool error_ = false;
+  std::thread thread_;
+};
+
+namespace internal {
+
+// Wraps the reader in a PrefetchFarReader if requested by --far_prefetch.
+template <class Arc>
+FarReader<Arc> *MaybePrefetchFarReader(FarReader<Arc> *reader) {
+  if (FST_FLAGS_far_prefetch <= 0) return reader;
+  return PrefetchFarReader<Arc>::Open(reader, FST_FLAGS_far_prefetch);
+}
+
+}  // namespace internal
+
 template <class Arc>
 FarReader<Arc> *FarReader<Arc>::Open(const std::string &source) {
-  if (source.empty())
-    return STListFarReader<Arc>::Open(source);
-  else if (IsSTTable(source))
-    return STTableFarReader<Arc>::Open(source);
-  else if (IsSTList(source))
-    return STListFarReader<Arc>::Open(source);
-  else if (IsFst(source))
-    return FstFarReader<Arc>::Open(source);
-  return nullptr;
+  const std::vector<std::string> sources{source};
+  return FarReader<Arc>::Open(sources);
 }
 
 template <class Arc>
 FarReader<Arc> *FarReader<Arc>::Open(const std::vector<std::string> &sources) {
-  if (!sources.empty() && sources[0].empty())
-    return STListFarReader<Arc>::Open(sources);
-  else if (!sources.empty() && IsSTTable(sources[0]))
-    return STTableFarReader<Arc>::Open(sources);
-  else if (!sources.empty() && IsSTList(sources[0]))
-    return STListFarReader<Arc>::Open(sources);
-  else if (!sources.empty() && IsFst(sources[0]))
-    return FstFarReader<Arc>::Open(sources);
-  return nullptr;
+  if (sources.empty()) return nullptr;
+  // Opens the first source only once, so that pipes are read in full by the
+  // reader; the type is found from the magic number without consuming input.
+  std::unique_ptr<std::istream> strm;
+  if (!sources[0].empty()) {
+    strm = std::make_unique<std::ifstream>(
+        sources[0], std::ios_base::in | std::ios_base::binary);
+    if (strm->fail()) return nullptr;
+  }
+  FarType type;
+  if (!internal::PeekFarType(strm ? *strm : std::cin, &type)) return nullptr;
+  switch (type) {
+    case FarType::STTABLE:
+      return internal::MaybePrefetchFarReader<Arc>(
+          STTableFarReader<Arc>::Open(sources));
+    case FarType::STLIST:
+      return internal::MaybePrefetchFarReader<Arc>(
+          STListFarReader<Arc>::Open(sources, std::move(strm)));
+    case FarType::STSTREAM:
+      return internal::MaybePrefetchFarReader<Arc>(
+          STStreamFarReader<Arc>::Open(sources, std::move(strm)));
+    case FarType::FST:
+      return internal::MaybePrefetchFarReader<Arc>(
+          FstFarReader<Arc>::Open(sources, std::move(strm)));
+    default:
+      return nullptr;
+  }
 }
 
 }  // namespace fst
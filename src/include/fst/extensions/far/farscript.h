@@ -37,6 +37,7 @@
 #include <fst/extensions/far/isomorphic.h>
 #include <fst/extensions/far/print-strings.h>
 #include <fst/extensions/far/script-impl.h>
+#include <fst/extensions/far/shortest-path.h>
 #include <fst/script/arg-packs.h>
 #include <string_view>
 
@@ -262,6 +263,45 @@ void PrintStrings(FarReaderClass &reader, const FarEntryType entry_type,
                   const std::string &source_prefix,
                   const std::string &source_suffix);
 
+// The weight threshold is given as a string since its type depends on the arc
+// type of the reader; the empty string means no threshold.
+using FarShortestPathInnerArgs =
+    std::tuple<FarReaderClass &, FarWriterClass &, int32_t, bool,
+               const std::string &, int64_t, float, size_t, size_t>;
+
+using FarShortestPathArgs = WithReturnValue<bool, FarShortestPathInnerArgs>;
+
+template <class Arc>
+void ShortestPath(FarShortestPathArgs *args) {
+  using Weight = typename Arc::Weight;
+  if constexpr (IsPath<Weight>::value) {
+    FarReader<Arc> &reader = *std::get<0>(args->args).GetFarReader<Arc>();
+    FarWriter<Arc> &writer = *std::get<1>(args->args).GetFarWriter<Arc>();
+    const std::string &weight_str = std::get<4>(args->args);
+    const auto weight_threshold =
+        weight_str.empty() ? Weight::Zero() : StrToWeight<Weight>(weight_str);
+    if (!weight_threshold.Member()) {
+      args->retval = false;
+      return;
+    }
+    args->retval = ::fst::ShortestPath<Arc>(
+        reader, writer, std::get<2>(args->args), std::get<3>(args->args),
+        weight_threshold, std::get<5>(args->args), std::get<6>(args->args),
+        std::get<7>(args->args), std::get<8>(args->args));
+  } else {
+    FSTERROR() << "ShortestPath: Weight needs to have the path property: "
+               << Weight::Type();
+    args->retval = false;
+  }
+}
+
+bool ShortestPath(FarReaderClass &reader, FarWriterClass &writer,
+                  int32_t nshortest = 1, bool unique = false,
+                  const std::string &weight_threshold = "",
+                  int64_t state_threshold = kNoStateId,
+                  float delta = kShortestDelta, size_t num_threads = 0,
+                  size_t batch_size = kFarShortestPathBatchSize);
+
 }  // namespace script
 }  // namespace fst
 
@@ -0,0 +1,119 @@
+// Copyright 2005-2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Finds the shortest path(s) in each FST in a FAR, in parallel.
+
+#ifndef FST_EXTENSIONS_FAR_SHORTEST_PATH_H_
+#define FST_EXTENSIONS_FAR_SHORTEST_PATH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fst/log.h>
+#include <fst/extensions/far/far.h>
+#include <fst/arcfilter.h>
+#include <fst/parallel.h>
+#include <fst/queue.h>
+#include <fst/shortest-path.h>
+#include <fst/vector-fst.h>
+
+namespace fst {
+
+inline constexpr size_t kFarShortestPathBatchSize = 1024;
+
+namespace internal {
+
+// Per-thread scratch space for the shortest-path computation, reused across
+// the FSTs that a thread processes.
+template <class Arc>
+struct FarShortestPathWorkspace {
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  std::vector<Weight> distance;
+  NaturalShortestFirstQueue<StateId, Weight> queue{distance};
+};
+
+}  // namespace internal
+
+// Computes the n-shortest paths (see ShortestPath) of each FST in the reader,
+// writing them to the writer under the same key and in the same order as the
+// input. FSTs are read in batches of batch_size and the FSTs of each batch are
+// searched by up to num_threads threads (zero requests one per hardware
+// thread); each thread reuses its distance vector and shortest-first queue
+// across FSTs, and the output buffers are reused across batches. Returns false
+// if reading or searching any FST fails, in which case no further FSTs are
+// written.
+//
+// The caller is responsible for rewinding the reader afterwards, if desired,
+// and for checking the error bits of the reader and writer.
+template <class Arc>
+bool ShortestPath(FarReader<Arc> &reader, FarWriter<Arc> &writer,
+                  int32_t nshortest = 1, bool unique = false,
+                  typename Arc::Weight weight_threshold = Arc::Weight::Zero(),
+                  typename Arc::StateId state_threshold = kNoStateId,
+                  float delta = kShortestDelta, size_t num_threads = 0,
+                  size_t batch_size = kFarShortestPathBatchSize) {
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+  using Queue = NaturalShortestFirstQueue<StateId, Weight>;
+  using ArcFilter = AnyArcFilter<Arc>;
+  if (batch_size == 0) batch_size = 1;
+  std::vector<internal::FarShortestPathWorkspace<Arc>> workspaces(
+      NumWorkerThreads(num_threads));
+  std::vector<std::string> keys(batch_size);
+  std::vector<std::unique_ptr<const Fst<Arc>>> ifsts(batch_size);
+  std::vector<VectorFst<Arc>> ofsts(batch_size);
+  while (!reader.Done()) {
+    size_t size = 0;
+    for (; size < batch_size && !reader.Done(); ++size, reader.Next()) {
+      keys[size] = reader.GetKey();
+      const auto *fst = reader.GetFst();
+      if (!fst) {
+        LOG(ERROR) << "ShortestPath: Error reading FST with key: "
+                   << keys[size];
+        return false;
+      }
+      ifsts[size].reset(fst->Copy());
+    }
+    ParallelForWithThreadIndex(size, num_threads, [&](size_t i, size_t t) {
+      auto &workspace = workspaces[t];
+      const ShortestPathOptions<Arc, Queue, ArcFilter> opts(
+          &workspace.queue, ArcFilter(), nshortest, unique,
+          /*has_distance=*/false, delta, /*first_path=*/false,
+          weight_threshold, state_threshold);
+      ShortestPath(*ifsts[i], &ofsts[i], &workspace.distance, opts);
+      ifsts[i].reset();
+    });
+    for (size_t i = 0; i < size; ++i) {
+      if (ofsts[i].Properties(kError, false)) {
+        FSTERROR() << "ShortestPath: Failed on FST with key: " << keys[i];
+        return false;
+      }
+      writer.Add(keys[i], ofsts[i]);
+      ofsts[i].DeleteStates();
+    }
+  }
+  return true;
+}
+
+}  // namespace fst
+
+#endif  // FST_EXTENSIONS_FAR_SHORTEST_PATH_H_
@@ -111,12 +111,17 @@ class STListWriter {
 template <class T, class Reader>
 class STListReader {
  public:
-  explicit STListReader(const std::vector<std::string> &sources)
+  // If non-null, strm is a stream already opened on sources[0], which is read
+  // instead of opening the source again.
+  explicit STListReader(const std::vector<std::string> &sources,
+                        std::unique_ptr<std::istream> strm = nullptr)
       : sources_(sources), error_(false) {
     streams_.resize(sources.size(), nullptr);
     bool has_stdin = false;
     for (size_t i = 0; i < sources.size(); ++i) {
-      if (sources[i].empty()) {
+      if (i == 0 && strm) {
+        streams_[i] = strm.release();
+      } else if (sources[i].empty()) {
         if (!has_stdin) {
           streams_[i] = &std::cin;
           sources_[i] = "stdin";
@@ -185,8 +190,9 @@ class STListReader {
   }
 
   static STListReader<T, Reader> *Open(
-      const std::vector<std::string> &sources) {
-    return new STListReader<T, Reader>(sources);
+      const std::vector<std::string> &sources,
+      std::unique_ptr<std::istream> strm = nullptr) {
+    return new STListReader<T, Reader>(sources, std::move(strm));
   }
 
   void Reset() {
@@ -0,0 +1,528 @@
+// Copyright 2005-2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// A generic (string,type) stream file format.
+//
+// Like STList, this supports reading/writing from standard in/out but not the
+// Find() operation. Each entry is stored in a self-delimiting frame whose
+// header and payload carry CRC-32 checksums, so that:
+//
+// * each entry is emitted with a single write, which allows several processes
+//   to append to the same file;
+// * an archive cut short by an interrupted writer can be read up to the last
+//   complete entry, and appended to afterwards;
+// * damaged frames are skipped by scanning for the next frame marker.
+//
+// Skipped data, damaged or truncated, is reported by Error() once reached.
+//
+// Keys need not be sorted. Reading multiple sources yields the entries of each
+// source in turn.
+
+#ifndef FST_EXTENSIONS_FAR_STSTREAM_H_
+#define FST_EXTENSIONS_FAR_STSTREAM_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fst/log.h>
+#include <fstream>
+#include <fst/util.h>
+#include <string_view>
+
+namespace fst {
+
+inline constexpr int32_t kSTStreamMagicNumber = 1437395315;
+inline constexpr int32_t kSTStreamFileVersion = 1;
+
+// Marks the beginning of each frame.
+inline constexpr uint32_t kSTStreamFrameMarker = 0x53545346;
+
+namespace internal {
+
+// Computes the CRC-32 (as used by zlib) of data, continuing from crc.
+uint32_t Crc32(std::string_view data, uint32_t crc = 0);
+
+// A frame consists of a fixed-size header followed by the key and the
+// serialized entry. The header holds, in native byte order:
+//
+//   uint32_t marker;       // kSTStreamFrameMarker.
+//   uint32_t flags;        // Reserved, must be zero.
+//   uint32_t key_size;
+//   uint64_t entry_size;
+//   uint32_t payload_crc;  // CRC-32 of the key and entry.
+//   uint32_t header_crc;   // CRC-32 of the preceding header fields.
+inline constexpr size_t kSTStreamFrameHeaderSize = 28;
+inline constexpr size_t kSTStreamHeaderCrcOffset = 24;
+
+template <class T>
+T LoadFrameField(const char *data, size_t offset) {
+  T value;
+  std::memcpy(&value, data + offset, sizeof(value));
+  return value;
+}
+
+template <class T>
+void StoreFrameField(char *data, size_t offset, T value) {
+  std::memcpy(data + offset, &value, sizeof(value));
+}
+
+// Seekable, read-only stream buffer over memory owned by the caller.
+class MemoryStreamBuf : public std::streambuf {
+ public:
+  MemoryStreamBuf(const char *data, size_t size) {
+    auto *begin = const_cast<char *>(data);
+    setg(begin, begin, begin + size);
+  }
+
+ protected:
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override {
+    if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+    off_type base = 0;
+    if (dir == std::ios_base::cur) {
+      base = gptr() - eback();
+    } else if (dir == std::ios_base::end) {
+      base = egptr() - eback();
+    }
+    const off_type pos = base + off;
+    if (pos < 0 || pos > egptr() - eback()) return pos_type(off_type(-1));
+    setg(eback(), eback() + pos, egptr());
+    return pos_type(pos);
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+};
+
+}  // namespace internal
+
+bool IsSTStream(const std::string &source);
+
+// String-type stream writing class for object of type T using a functor
+// Writer. The Writer functor must provide at least the following interface:
+//
+//   struct Writer {
+//     void operator()(std::ostream &, const T &) const;
+//   };
+template <class T, class Writer>
+class STStreamWriter {
+ public:
+  // If append is true and the source is an existing STStream file, entries are
+  // added after its current contents.
+  explicit STStreamWriter(const std::string &source, bool append = false)
+      : stream_(&std::cout), error_(false) {
+    bool write_header = true;
+    if (!source.empty()) {
+      if (append) {
+        std::ifstream istrm(source, std::ios_base::in | std::ios_base::binary);
+        if (istrm && istrm.peek() != std::ifstream::traits_type::eof()) {
+          int32_t magic_number = 0;
+          ReadType(istrm, &magic_number);
+          if (magic_number != kSTStreamMagicNumber) {
+            FSTERROR() << "STStreamWriter::STStreamWriter: Cannot append to "
+                       << "file of a different type: " << source;
+            error_ = true;
+            return;
+          }
+          write_header = false;
+        }
+      }
+      auto *fstrm = new std::ofstream();
+      // Unbuffered, so that each frame is handed to the OS in a single write.
+      fstrm->rdbuf()->pubsetbuf(nullptr, 0);
+      fstrm->open(source, std::ios_base::out | std::ios_base::binary |
+                              (append ? std::ios_base::app
+                                      : std::ios_base::trunc));
+      stream_ = fstrm;
+    }
+    if (write_header) {
+      WriteType(*stream_, kSTStreamMagicNumber);
+      WriteType(*stream_, kSTStreamFileVersion);
+      stream_->flush();
+    }
+    if (!*stream_) {
+      FSTERROR() << "STStreamWriter::STStreamWriter: Error writing to file: "
+                 << source;
+      error_ = true;
+    }
+  }
+
+  static STStreamWriter<T, Writer> *Create(const std::string &source,
+                                           bool append = false) {
+    return new STStreamWriter<T, Writer>(source, append);
+  }
+
+  void Add(std::string_view key, const T &t) {
+    if (key.empty()) {
+      FSTERROR() << "STStreamWriter::Add: Key empty: " << key;
+      error_ = true;
+    }
+    if (error_) return;
+    entry_stream_.str(std::string());
+    entry_writer_(entry_stream_, t);
+    const std::string entry = entry_stream_.str();
+    frame_.resize(internal::kSTStreamFrameHeaderSize);
+    frame_.append(key.data(), key.size());
+    frame_.append(entry);
+    auto *data = frame_.data();
+    internal::StoreFrameField<uint32_t>(data, 0, kSTStreamFrameMarker);
+    internal::StoreFrameField<uint32_t>(data, 4, 0);
+    internal::StoreFrameField<uint32_t>(data, 8, key.size());
+    internal::StoreFrameField<uint64_t>(data, 12, entry.size());
+    internal::StoreFrameField<uint32_t>(
+        data, 20,
+        internal::Crc32(std::string_view(frame_).substr(
+            internal::kSTStreamFrameHeaderSize)));
+    internal::StoreFrameField<uint32_t>(
+        data, internal::kSTStreamHeaderCrcOffset,
+        internal::Crc32(std::string_view(
+            data, internal::kSTStreamHeaderCrcOffset)));
+    stream_->write(frame_.data(), frame_.size());
+    stream_->flush();
+    if (!*stream_) {
+      FSTERROR() << "STStreamWriter::Add: Error writing entry for key: "
+                 << key;
+      error_ = true;
+    }
+  }
+
+  bool Error() const { return error_; }
+
+  ~STStreamWriter() {
+    if (stream_ != &std::cout) delete stream_;
+  }
+
+ private:
+  Writer entry_writer_;
+  std::ostream *stream_;             // Output stream.
+  std::ostringstream entry_stream_;  // Serializes entries.
+  std::string frame_;                // Frame under construction.
+  bool error_;
+
+  STStreamWriter(const STStreamWriter &) = delete;
+  STStreamWriter &operator=(const STStreamWriter &) = delete;
+};
+
+// String-type stream reading class for object of type T using a functor
+// Reader. Reader must provide at least the following interface:
+//
+//   struct Reader {
+//     T *operator()(std::istream &) const;
+//   };
+template <class T, class Reader>
+class STStreamReader {
+ public:
+  // If non-null, strm is a stream already opened on sources[0], which is read
+  // first instead of opening the source again.
+  explicit STStreamReader(const std::vector<std::string> &sources,
+                          std::unique_ptr<std::istream> strm = nullptr)
+      : sources_(sources),
+        first_stream_(std::move(strm)),
+        has_stdin_(false),
+        error_(false) {
+    for (size_t i = 0; i < sources_.size(); ++i) {
+      if (!sources_[i].empty()) continue;
+      if (has_stdin_) {
+        FSTERROR() << "STStreamReader::STStreamReader: Cannot read multiple "
+                   << "inputs from standard input";
+        error_ = true;
+        return;
+      }
+      has_stdin_ = true;
+    }
+    Rewind();
+  }
+
+  ~STStreamReader() { CloseSource(); }
+
+  static STStreamReader<T, Reader> *Open(const std::string &source) {
+    std::vector<std::string> sources;
+    sources.push_back(source);
+    return new STStreamReader<T, Reader>(sources);
+  }
+
+  static STStreamReader<T, Reader> *Open(
+      const std::vector<std::string> &sources,
+      std::unique_ptr<std::istream> strm = nullptr) {
+    return new STStreamReader<T, Reader>(sources, std::move(strm));
+  }
+
+  void Reset() {
+    if (has_stdin_) {
+      FSTERROR() << "STStreamReader::Reset: Operation not supported on "
+                 << "standard input";
+      error_ = true;
+      return;
+    }
+    Rewind();
+  }
+
+  bool Find(std::string_view key) {
+    FSTERROR() << "STStreamReader::Find: Operation not supported";
+    error_ = true;
+    return false;
+  }
+
+  bool Done() const { return error_ || !entry_; }
+
+  void Next() {
+    if (Done()) return;
+    ReadFrame();
+  }
+
+  const std::string &GetKey() const { return key_; }
+
+  const T *GetEntry() const { return entry_.get(); }
+
+  // Also true once damaged or truncated data has been skipped; reading then
+  // goes on with the next intact entry.
+  bool Error() const { return error_ || num_skipped_ > 0; }
+
+  // Number of damaged or truncated regions skipped so far.
+  size_t NumSkipped() const { return num_skipped_; }
+
+ private:
+  static constexpr size_t kReadSize = 1 << 20;
+
+  // Positions the reader at the first entry of the first source.
+  void Rewind() {
+    CloseSource();
+    current_ = 0;
+    num_skipped_ = 0;
+    if (!error_ && !sources_.empty() && OpenSource()) ReadFrame();
+  }
+
+  void CloseSource() {
+    if (stream_ != &std::cin) delete stream_;
+    stream_ = nullptr;
+    begin_ = end_ = 0;
+    damaged_ = false;
+    key_.clear();
+    entry_.reset();
+  }
+
+  // Opens sources_[current_] and checks its file header.
+  bool OpenSource() {
+    const auto &source = sources_[current_];
+    if (first_stream_) {
+      stream_ = first_stream_.release();
+    } else if (source.empty()) {
+      stream_ = &std::cin;
+    } else {
+      stream_ =
+          new std::ifstream(source, std::ios_base::in | std::ios_base::binary);
+      if (stream_->fail()) {
+        FSTERROR() << "STStreamReader: Error reading file: " << source;
+        error_ = true;
+        return false;
+      }
+    }
+    if (!Fill(2 * sizeof(int32_t)) || !IsFileHeader()) {
+      FSTERROR() << "STStreamReader: Wrong file type or version: "
+                 << SourceName();
+      error_ = true;
+      return false;
+    }
+    begin_ += 2 * sizeof(int32_t);
+    return true;
+  }
+
+  const std::string &SourceName() const {
+    static const std::string *const kStdin = new std::string("stdin");
+    return sources_[current_].empty() ? *kStdin : sources_[current_];
+  }
+
+  bool IsFileHeader() const {
+    const auto *data = buffer_.data() + begin_;
+    return internal::LoadFrameField<int32_t>(data, 0) ==
+               kSTStreamMagicNumber &&
+           internal::LoadFrameField<int32_t>(data, sizeof(int32_t)) ==
+               kSTStreamFileVersion;
+  }
+
+  // Ensures at least size unread bytes are buffered, unless the source ends
+  // first; returns true on success.
+  bool Fill(size_t size) {
+    if (end_ - begin_ >= size) return true;
+    if (begin_ > 0) {
+      std::copy(buffer_.begin() + begin_, buffer_.begin() + end_,
+                buffer_.begin());
+      end_ -= begin_;
+      begin_ = 0;
+    }
+    if (buffer_.size() < std::max(size, kReadSize)) {
+      buffer_.resize(std::max(size, kReadSize));
+    }
+    while (end_ < size && *stream_) {
+      stream_->read(buffer_.data() + end_, buffer_.size() - end_);
+      end_ += stream_->gcount();
+    }
+    if (stream_->bad()) {
+      FSTERROR() << "STStreamReader: Error reading file: " << SourceName();
+      error_ = true;
+    }
+    return end_ >= size;
+  }
+
+  // Skips one byte of damaged data, warning once per damaged region.
+  void SkipDamaged() {
+    if (!damaged_) {
+      LOG(WARNING) << "STStreamReader: Skipping damaged or truncated data in "
+                   << SourceName();
+      ++num_skipped_;
+      damaged_ = true;
+    }
+    ++begin_;
+  }
+
+  // Reads the next intact frame, moving on to later sources as needed.
+  void ReadFrame() {
+    using internal::kSTStreamFrameHeaderSize;
+    using internal::LoadFrameField;
+    entry_.reset();
+    while (!error_) {
+      if (!Fill(kSTStreamFrameHeaderSize)) {
+        if (error_) return;
+        if (begin_ < end_) {
+          SkipDamaged();
+          begin_ = end_;
+        }
+        if (++current_ >= sources_.size()) return;
+        CloseSource();
+        if (!OpenSource()) return;
+        continue;
+      }
+      const auto *data = buffer_.data() + begin_;
+      if (LoadFrameField<uint32_t>(data, 0) != kSTStreamFrameMarker) {
+        // Concatenated streams contain file headers between frames.
+        if (!damaged_ && IsFileHeader()) {
+          begin_ += 2 * sizeof(int32_t);
+          continue;
+        }
+        // Moves to the next possible frame marker.
+        SkipDamaged();
+        const char *marker = reinterpret_cast<const char *>(
+            &kSTStreamFrameMarker);
+        const auto it = std::search(buffer_.begin() + begin_,
+                                    buffer_.begin() + end_, marker,
+                                    marker + sizeof(kSTStreamFrameMarker));
+        begin_ = std::max<size_t>(
+            begin_, std::min<size_t>(it - buffer_.begin(),
+                                     end_ - sizeof(kSTStreamFrameMarker) + 1));
+        continue;
+      }
+      const auto header_crc = internal::Crc32(
+          std::string_view(data, internal::kSTStreamHeaderCrcOffset));
+      if (header_crc != LoadFrameField<uint32_t>(
+                            data, internal::kSTStreamHeaderCrcOffset) ||
+          LoadFrameField<uint32_t>(data, 4) != 0) {
+        SkipDamaged();
+        continue;
+      }
+      const size_t key_size = LoadFrameField<uint32_t>(data, 8);
+      const size_t entry_size = LoadFrameField<uint64_t>(data, 12);
+      const uint32_t payload_crc = LoadFrameField<uint32_t>(data, 20);
+      const size_t frame_size =
+          kSTStreamFrameHeaderSize + key_size + entry_size;
+      if (!Fill(frame_size)) {
+        if (error_) return;
+        SkipDamaged();
+        continue;
+      }
+      data = buffer_.data() + begin_ + kSTStreamFrameHeaderSize;
+      if (internal::Crc32(std::string_view(data, key_size + entry_size)) !=
+          payload_crc) {
+        SkipDamaged();
+        continue;
+      }
+      damaged_ = false;
+      key_.assign(data, key_size);
+      internal::MemoryStreamBuf buf(data + key_size, entry_size);
+      std::istream strm(&buf);
+      entry_.reset(entry_reader_(strm));
+      begin_ += frame_size;
+      if (!entry_) {
+        FSTERROR() << "STStreamReader: Error reading entry for key: " << key_
+                   << ", file: " << SourceName();
+        error_ = true;
+      }
+      return;
+    }
+  }
+
+  Reader entry_reader_;               // Read functor.
+  std::vector<std::string> sources_;  // Input sources, read in turn.
+  std::unique_ptr<std::istream> first_stream_;  // Opened on sources_[0].
+  size_t current_ = 0;                // Index of the current source.
+  std::istream *stream_ = nullptr;    // Current input stream.
+  std::vector<char> buffer_;          // Read buffer.
+  size_t begin_ = 0;                  // Unread data is buffer_[begin_, end_).
+  size_t end_ = 0;
+  std::string key_;                   // The current key.
+  std::unique_ptr<T> entry_;          // The currently read entry.
+  bool has_stdin_;
+  bool damaged_ = false;              // Inside a damaged region?
+  size_t num_skipped_ = 0;
+  bool error_;
+
+  STStreamReader(const STStreamReader &) = delete;
+  STStreamReader &operator=(const STStreamReader &) = delete;
+};
+
+// String-type stream header reading function, templated on the entry header
+// type. The Header type must provide at least the following interface:
+//
+//  struct Header {
+//    bool Read(std::istream &strm, const string &source);
+//  };
+template <class Header>
+bool ReadSTStreamHeader(const std::string &source, Header *header) {
+  if (source.empty()) {
+    LOG(ERROR) << "ReadSTStreamHeader: Can't read header from standard input";
+    return false;
+  }
+  struct HeaderReader {
+    Header *operator()(std::istream &strm) const {
+      auto header = std::make_unique<Header>();
+      if (!header->Read(strm, "STStream entry")) return nullptr;
+      return header.release();
+    }
+  };
+  const std::vector<std::string> sources{source};
+  STStreamReader<Header, HeaderReader> reader(sources);
+  if (reader.Error() && !reader.NumSkipped()) {
+    LOG(ERROR) << "ReadSTStreamHeader: Error reading file: " << source;
+    return false;
+  }
+  // An empty STStream.
+  if (reader.Done()) return true;
+  *header = *reader.GetEntry();
+  return true;
+}
+
+}  // namespace fst
+
+#endif  // FST_EXTENSIONS_FAR_STSTREAM_H_
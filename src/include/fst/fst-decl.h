@@ -167,7 +167,7 @@ class UnionFst;
 
 // Heap.
 
-template <class T, class Compare>
+template <class T, class Compare, int Arity = 2>
 class Heap;
 
 // ArcCompactors.
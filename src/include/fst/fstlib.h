@@ -70,11 +70,13 @@
 #include <fst/minimize.h>
 #include <fst/project.h>
 #include <fst/prune.h>
+#include <fst/pruned-compose.h>
 #include <fst/push.h>
 #include <fst/randequivalent.h>
 #include <fst/randgen.h>
 #include <fst/rational.h>
 #include <fst/relabel.h>
+#include <fst/reorder.h>
 #include <fst/replace-util.h>
 #include <fst/replace.h>
 #include <fst/reverse.h>
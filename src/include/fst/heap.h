@@ -22,11 +22,13 @@
 #ifndef FST_HEAP_H_
 #define FST_HEAP_H_
 
+#include <algorithm>
 #include <utility>
 #include <vector>
 
 #include <fst/compat.h>
 #include <fst/log.h>
+#include <fst/fst-decl.h>
 
 namespace fst {
 
@@ -42,13 +44,18 @@ namespace fst {
 //
 // T: the element type of the hash. It can be POD, Data or a pointer to Data.
 // Compare: comparison functor for determining min-heapness.
-template <class T, class Compare>
+// Arity: number of children of each node. A larger arity gives a shallower
+// heap, making inserts and updates cheaper and each pop compare more (but
+// adjacent) children; a 4-ary heap is often faster when comparisons are cheap.
+template <class T, class Compare, int Arity /* = 2 */>
 class Heap {
  public:
   using Value = T;
 
   static constexpr int kNoKey = -1;
 
+  static_assert(Arity >= 2, "Heap arity must be at least 2");
+
   // Initializes with a specific comparator.
   explicit Heap(Compare comp = Compare()) : comp_(comp), size_(0) {}
 
@@ -123,19 +130,19 @@ class Heap {
   // The following private routines are used in a supportive role
   // for managing the heap and keeping the heap properties.
 
-  // Computes left child of parent.
+  // Computes first (leftmost) child of parent.
   static int Left(int i) {
-    return 2 * (i + 1) - 1;  // 0 -> 1, 1 -> 3
+    return Arity * i + 1;  // Binary: 0 -> 1, 1 -> 3
   }
 
-  // Computes right child of parent.
+  // Computes last (rightmost) child of parent.
   static int Right(int i) {
-    return 2 * (i + 1);  // 0 -> 2, 1 -> 4
+    return Arity * (i + 1);  // Binary: 0 -> 2, 1 -> 4
   }
 
   // Given a child computes parent.
   static int Parent(int i) {
-    return (i - 1) / 2;  // 0 -> 0, 1 -> 0, 2 -> 0,  3 -> 1,  4 -> 1, ...
+    return (i - 1) / Arity;  // Binary: 0 -> 0, 1 -> 0, 2 -> 0,  3 -> 1, ...
   }
 
   // Swaps a child and parent. Use to move element up/down tree. Note the use of
@@ -155,9 +162,11 @@ class Heap {
   // Heapifies the subtree rooted at index i.
   void Heapify(int i) {
     const auto l = Left(i);
-    const auto r = Right(i);
-    auto largest = (l < size_ && comp_(values_[l], values_[i])) ? l : i;
-    if (r < size_ && comp_(values_[r], values_[largest])) largest = r;
+    const auto r = std::min(Right(i), size_ - 1);
+    auto largest = i;
+    for (auto c = l; c <= r; ++c) {
+      if (comp_(values_[c], values_[largest])) largest = c;
+    }
     if (largest != i) {
       Swap(i, largest);
       Heapify(largest);
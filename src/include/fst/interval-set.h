@@ -21,11 +21,17 @@
 #define FST_INTERVAL_SET_H_
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <initializer_list>
 #include <iostream>
+#include <memory>
+#include <string>
 #include <vector>
 
 
+#include <fst/mapped-file.h>
 #include <fst/util.h>
 
 
@@ -413,6 +419,204 @@ std::ostream &operator<<(std::ostream &strm, const IntervalSet<T, Store> &s) {
   return strm;
 }
 
+// Read-only copy of a vector of normalized interval sets, laid out for fast
+// membership and intersection queries. The intervals of all the sets are
+// stored in two flat arrays, one of begins and one of ends. Small sets are
+// searched with a branch-free linear scan, which compilers vectorize, and
+// larger ones with a binary search over the begins only. Sets with many
+// intervals over a short range are also stored as bitsets.
+//
+// The arrays are written as is, optionally aligned, so that they can be
+// memory-mapped when read back.
+template <class T>
+class CompactIntervalSets {
+ public:
+  // Sets with at most this many intervals are searched linearly.
+  static constexpr size_t kLinearSearchSize = 16;
+
+  // Sets with more than kLinearSearchSize intervals are also stored as bitsets
+  // if their range is at most this many times their number of intervals, so
+  // that the bitset is no larger than the intervals.
+  static constexpr size_t kBitsPerInterval = 8 * 2 * sizeof(T);
+
+  CompactIntervalSets() { offsets_.Assign(std::vector<int64_t>(1, 0)); }
+
+  template <class ISet>
+  explicit CompactIntervalSets(const std::vector<ISet> &isets) {
+    std::vector<T> begins;
+    std::vector<T> ends;
+    std::vector<int64_t> offsets(1, 0);
+    offsets.reserve(isets.size() + 1);
+    for (const auto &iset : isets) {
+      for (const auto &interval : iset) {
+        begins.push_back(interval.begin);
+        ends.push_back(interval.end);
+      }
+      offsets.push_back(begins.size());
+    }
+    std::vector<int32_t> bitset_ids;
+    std::vector<Bitset> bitsets;
+    std::vector<uint64_t> words;
+    for (size_t i = 0; i < isets.size(); ++i) {
+      const size_t size = offsets[i + 1] - offsets[i];
+      if (size <= kLinearSearchSize) continue;
+      const auto *set_begins = begins.data() + offsets[i];
+      const auto *set_ends = ends.data() + offsets[i];
+      const int64_t first = set_begins[0];
+      const int64_t range = set_ends[size - 1] - first;
+      if (static_cast<size_t>(range) > kBitsPerInterval * size) continue;
+      if (bitset_ids.empty()) bitset_ids.resize(isets.size(), -1);
+      bitset_ids[i] = bitsets.size();
+      bitsets.push_back({first, range, static_cast<int64_t>(words.size())});
+      words.resize(words.size() + (range + 63) / 64, 0);
+      auto *set_words = words.data() + bitsets.back().offset;
+      for (size_t j = 0; j < size; ++j) {
+        for (int64_t v = set_begins[j] - first; v < set_ends[j] - first; ++v) {
+          set_words[v / 64] |= uint64_t{1} << (v % 64);
+        }
+      }
+    }
+    begins_.Assign(begins);
+    ends_.Assign(ends);
+    offsets_.Assign(offsets);
+    bitset_ids_.Assign(bitset_ids);
+    bitsets_.Assign(bitsets);
+    words_.Assign(words);
+  }
+
+  size_t NumSets() const { return offsets_.Size() - 1; }
+
+  // Number of intervals in set i.
+  size_t Size(size_t i) const { return offsets_[i + 1] - offsets_[i]; }
+
+  // Arrays of Size(i) interval begins and ends of set i.
+  const T *Begins(size_t i) const { return begins_.Data() + offsets_[i]; }
+
+  const T *Ends(size_t i) const { return ends_.Data() + offsets_[i]; }
+
+  // Returns the position in set i of the interval that may contain value: the
+  // number of intervals that begin at or before it, minus one (possibly -1).
+  ssize_t Find(size_t i, T value) const {
+    const auto *begins = Begins(i);
+    const auto size = Size(i);
+    if (size <= kLinearSearchSize) {
+      size_t n = 0;
+      for (size_t j = 0; j < size; ++j) n += begins[j] <= value;
+      return static_cast<ssize_t>(n) - 1;
+    }
+    return std::upper_bound(begins, begins + size, value) - begins - 1;
+  }
+
+  // Returns true if set i intersects [begin, end). Small sets are scanned
+  // branch-free, as in Find().
+  bool Intersects(size_t i, T begin, T end) const {
+    if (begin >= end) return false;
+    const auto size = Size(i);
+    const auto *begins = Begins(i);
+    const auto *ends = Ends(i);
+    if (size <= kLinearSearchSize) {
+      size_t n = 0;
+      for (size_t j = 0; j < size; ++j) {
+        n += (begins[j] < end) & (ends[j] > begin);
+      }
+      return n > 0;
+    }
+    // Only the last interval beginning before end can reach past begin.
+    const auto pos = Find(i, end - 1);
+    return pos >= 0 && ends[pos] > begin;
+  }
+
+  bool Member(size_t i, T value) const {
+    if (bitset_ids_.Size() > 0 && bitset_ids_[i] >= 0) {
+      const auto &bitset = bitsets_[bitset_ids_[i]];
+      const int64_t v = static_cast<int64_t>(value) - bitset.first;
+      if (v < 0 || v >= bitset.range) return false;
+      return (words_[bitset.offset + v / 64] >> (v % 64)) & 1;
+    }
+    const auto pos = Find(i, value);
+    return pos >= 0 && value < Ends(i)[pos];
+  }
+
+  // Reads the sets written by Write(). If memorymap is true, the arrays are
+  // memory-mapped when possible; source is the name of the file read. Returns
+  // false on error.
+  bool Read(std::istream &strm, bool memorymap, const std::string &source,
+            bool aligned) {
+    return begins_.Read(strm, memorymap, source, aligned) &&
+           ends_.Read(strm, memorymap, source, aligned) &&
+           offsets_.Read(strm, memorymap, source, aligned) &&
+           bitset_ids_.Read(strm, memorymap, source, aligned) &&
+           bitsets_.Read(strm, memorymap, source, aligned) &&
+           words_.Read(strm, memorymap, source, aligned) && offsets_.Size() > 0;
+  }
+
+  // Writes the sets, aligning each array if align is true. Returns false on
+  // error.
+  bool Write(std::ostream &strm, bool align) const {
+    return begins_.Write(strm, align) && ends_.Write(strm, align) &&
+           offsets_.Write(strm, align) && bitset_ids_.Write(strm, align) &&
+           bitsets_.Write(strm, align) && words_.Write(strm, align);
+  }
+
+ private:
+  struct Bitset {
+    int64_t first;   // Value of the first bit.
+    int64_t range;   // Number of bits.
+    int64_t offset;  // Position of the first word in words_.
+  };
+
+  // Array of trivially copyable values, allocated or memory-mapped.
+  template <class U>
+  class Array {
+   public:
+    void Assign(const std::vector<U> &values) {
+      region_.reset(MappedFile::AllocateType<U>(values.size()));
+      size_ = values.size();
+      data_ = static_cast<const U *>(region_->data());
+      if (size_ > 0) {
+        std::memcpy(region_->mutable_data(), values.data(), size_ * sizeof(U));
+      }
+    }
+
+    bool Read(std::istream &strm, bool memorymap, const std::string &source,
+              bool aligned) {
+      int64_t size = 0;
+      ReadType(strm, &size);
+      if (!strm || size < 0 || (aligned && !AlignInput(strm))) return false;
+      region_.reset(MappedFile::Map(strm, memorymap, source, size * sizeof(U)));
+      if (!strm || !region_) return false;
+      size_ = size;
+      data_ = static_cast<const U *>(region_->data());
+      return true;
+    }
+
+    bool Write(std::ostream &strm, bool align) const {
+      WriteType(strm, static_cast<int64_t>(size_));
+      if (align && !AlignOutput(strm)) return false;
+      strm.write(reinterpret_cast<const char *>(data_), size_ * sizeof(U));
+      return static_cast<bool>(strm);
+    }
+
+    size_t Size() const { return size_; }
+
+    const U *Data() const { return data_; }
+
+    const U &operator[](size_t i) const { return data_[i]; }
+
+   private:
+    std::unique_ptr<MappedFile> region_;
+    size_t size_ = 0;
+    const U *data_ = nullptr;
+  };
+
+  Array<T> begins_;              // Interval begins of all sets.
+  Array<T> ends_;                // Interval ends of all sets.
+  Array<int64_t> offsets_;       // Position of the first interval per set.
+  Array<int32_t> bitset_ids_;    // Bitset per set, or -1; empty if none.
+  Array<Bitset> bitsets_;        // Bitsets of the sets that have one.
+  Array<uint64_t> words_;        // Bits of all bitsets.
+};
+
 }  // namespace fst
 
 #endif  // FST_INTERVAL_SET_H_
@@ -21,7 +21,12 @@
 #ifndef FST_LABEL_REACHABLE_H_
 #define FST_LABEL_REACHABLE_H_
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <utility>
 #include <vector>
 
@@ -38,7 +43,30 @@
 
 namespace fst {
 
+// Written in place of the size of the label-to-index map when the map is
+// stored as a dense vector; only with FstWriteOptions::align, since older
+// readers cannot read it.
+inline constexpr int64_t kDenseLabel2Index = -1;
+
+// Written in place of the number of interval sets when they are stored as
+// CompactIntervalSets; only with FstWriteOptions::align, since older readers
+// cannot read it.
+inline constexpr int64_t kCompactIntervalSets = -1;
+
 // Stores shareable data for label reachable class copies.
+//
+// When the labels are compact (all positive, with the largest at most twice
+// their number), the label-to-index map is stored as a vector indexed by label.
+// It is written as such with FstWriteOptions::align, and otherwise as a hash
+// map, in the layout older readers expect. The hash map returned by
+// Label2Index() is then only built if requested.
+//
+// Queries use CompactIntervalSets, built from the interval sets. Once built by
+// LabelReachable or read from file, only that form is kept, and the IntervalSet
+// objects are only rebuilt if requested. When written with
+// FstWriteOptions::align, the interval sets are stored as aligned
+// CompactIntervalSets, which are memory-mapped when read in FstReadOptions::MAP
+// mode.
 template <typename Label>
 class LabelReachableData {
  public:
@@ -56,19 +84,53 @@ class LabelReachableData {
   bool ReachInput() const { return reach_input_; }
 
   std::vector<LabelIntervalSet> *MutableIntervalSets() {
+    BuildIntervalSets();
+    compact_ready_.store(false, std::memory_order_relaxed);
     return &interval_sets_;
   }
 
   const LabelIntervalSet &GetIntervalSet(int s) const {
+    BuildIntervalSets();
     return interval_sets_[s];
   }
 
-  int NumIntervalSets() const { return interval_sets_.size(); }
+  int NumIntervalSets() const {
+    return intervals_ready_.load(std::memory_order_acquire)
+               ? interval_sets_.size()
+               : compact_interval_sets_.NumSets();
+  }
 
+  // Builds the interval sets laid out for fast queries, and frees the
+  // IntervalSet objects, which are rebuilt from them if requested.
+  void FreezeIntervalSets() {
+    GetCompactIntervalSets();
+    std::lock_guard<std::mutex> lock(compact_mutex_);
+    std::vector<LabelIntervalSet>().swap(interval_sets_);
+    intervals_ready_.store(false, std::memory_order_release);
+  }
+
+  // Returns the interval sets laid out for fast queries. They are built on the
+  // first call after the interval sets are changed.
+  const CompactIntervalSets<Label> &GetCompactIntervalSets() const {
+    if (!compact_ready_.load(std::memory_order_acquire)) {
+      std::lock_guard<std::mutex> lock(compact_mutex_);
+      if (!compact_ready_.load(std::memory_order_relaxed)) {
+        compact_interval_sets_ = CompactIntervalSets<Label>(interval_sets_);
+        compact_ready_.store(true, std::memory_order_release);
+      }
+    }
+    return compact_interval_sets_;
+  }
+
+  // Returns the label-to-index map, reverting to the sparse representation.
   std::unordered_map<Label, Label> *MutableLabel2Index() {
     if (!have_relabel_data_) {
       FSTERROR() << "LabelReachableData: No relabeling data";
     }
+    BuildLabel2Index();
+    dense_ = false;
+    dense_label2index_.clear();
+    dense_label2index_.shrink_to_fit();
     return &label2index_;
   }
 
@@ -76,9 +138,73 @@ class LabelReachableData {
     if (!have_relabel_data_) {
       FSTERROR() << "LabelReachableData: No relabeling data";
     }
+    BuildLabel2Index();
     return &label2index_;
   }
 
+  // Returns the index of a label, or kNoLabel if it has none.
+  Label FindIndex(Label label) const {
+    if (!have_relabel_data_) {
+      FSTERROR() << "LabelReachableData: No relabeling data";
+    }
+    if (dense_) {
+      if (label == kNoLabel) return final_label_;
+      return label > 0 && static_cast<size_t>(label) < dense_label2index_.size()
+                 ? dense_label2index_[label]
+                 : kNoLabel;
+    }
+    const auto it = label2index_.find(label);
+    return it != label2index_.end() ? it->second : kNoLabel;
+  }
+
+  // Returns the number of labels with an index.
+  size_t Label2IndexSize() const {
+    return dense_ ? dense_size_ : label2index_.size();
+  }
+
+  // Calls f(label, index) for each label with an index.
+  template <class F>
+  void ForEachLabel2Index(F f) const {
+    if (!have_relabel_data_) {
+      FSTERROR() << "LabelReachableData: No relabeling data";
+    }
+    if (dense_) {
+      for (Label label = 1; label < dense_label2index_.size(); ++label) {
+        const auto index = dense_label2index_[label];
+        if (index != kNoLabel) f(label, index);
+      }
+      if (final_label_ != kNoLabel) f(kNoLabel, final_label_);
+    } else {
+      for (const auto &[label, index] : label2index_) f(label, index);
+    }
+  }
+
+  // Stores the label-to-index map as a dense vector if the labels are
+  // compact. Returns true if it is then dense.
+  bool CompactLabel2Index() {
+    if (dense_) return true;
+    Label max_label = 0;
+    for (const auto &[label, index] : label2index_) {
+      if (label == kNoLabel) {
+        if (index != final_label_) return false;
+        continue;
+      }
+      if (label <= 0) return false;
+      max_label = std::max(max_label, label);
+    }
+    if (static_cast<size_t>(max_label) > 2 * label2index_.size()) return false;
+    dense_label2index_.assign(max_label + 1, kNoLabel);
+    for (const auto &[label, index] : label2index_) {
+      if (label != kNoLabel) dense_label2index_[label] = index;
+    }
+    dense_size_ = label2index_.size();
+    dense_ = true;
+    std::unordered_map<Label, Label>().swap(label2index_);
+    return true;
+  }
+
+  bool DenseLabel2Index() const { return dense_; }
+
   void SetFinalLabel(Label final_label) { final_label_ = final_label; }
 
   Label FinalLabel() const { return final_label_; }
@@ -90,30 +216,142 @@ class LabelReachableData {
     ReadType(istrm, &data->reach_input_);
     ReadType(istrm, &data->keep_relabel_data_);
     data->have_relabel_data_ = data->keep_relabel_data_;
-    if (data->keep_relabel_data_) ReadType(istrm, &data->label2index_);
+    if (data->keep_relabel_data_) {
+      int64_t size = 0;
+      ReadType(istrm, &size);
+      if (size == kDenseLabel2Index) {
+        ReadType(istrm, &size);
+        data->dense_size_ = size;
+        ReadType(istrm, &data->dense_label2index_);
+        data->dense_ = true;
+      } else if (size >= 0) {
+        data->label2index_.reserve(size);
+        for (int64_t i = 0; i < size; ++i) {
+          std::pair<Label, Label> kv;
+          ReadType(istrm, &kv);
+          data->label2index_.insert(kv);
+        }
+      }
+      if (!istrm || size < 0) {
+        LOG(ERROR) << "LabelReachableData::Read: Bad label map: "
+                   << opts.source;
+        return nullptr;
+      }
+    }
     ReadType(istrm, &data->final_label_);
-    ReadType(istrm, &data->interval_sets_);
+    if (data->keep_relabel_data_) data->CompactLabel2Index();
+    int64_t nsets = 0;
+    ReadType(istrm, &nsets);
+    if (nsets == kCompactIntervalSets) {
+      if (!data->compact_interval_sets_.Read(
+              istrm, opts.mode == FstReadOptions::MAP, opts.source,
+              /*aligned=*/true)) {
+        LOG(ERROR) << "LabelReachableData::Read: Read failed: " << opts.source;
+        return nullptr;
+      }
+      data->compact_ready_ = true;
+      data->intervals_ready_ = false;
+    } else if (nsets >= 0) {
+      data->interval_sets_.resize(nsets);
+      for (auto &interval_set : data->interval_sets_) {
+        ReadType(istrm, &interval_set);
+      }
+      data->FreezeIntervalSets();
+    }
+    if (!istrm || (nsets < 0 && nsets != kCompactIntervalSets)) {
+      LOG(ERROR) << "LabelReachableData::Read: Bad interval sets: "
+                 << opts.source;
+      return nullptr;
+    }
     return data.release();
   }
 
   bool Write(std::ostream &ostrm, const FstWriteOptions &opts) const {
     WriteType(ostrm, reach_input_);
     WriteType(ostrm, keep_relabel_data_);
-    if (keep_relabel_data_) WriteType(ostrm, label2index_);
+    if (keep_relabel_data_) {
+      if (dense_ && opts.align) {
+        WriteType(ostrm, kDenseLabel2Index);
+        WriteType(ostrm, static_cast<int64_t>(dense_size_));
+        WriteType(ostrm, dense_label2index_);
+      } else if (dense_) {
+        WriteType(ostrm, static_cast<int64_t>(dense_size_));
+        ForEachLabel2Index([&ostrm](Label label, Label index) {
+          WriteType(ostrm, std::make_pair(label, index));
+        });
+      } else {
+        WriteType(ostrm, label2index_);
+      }
+    }
     WriteType(ostrm, FinalLabel());
-    WriteType(ostrm, interval_sets_);
+    if (opts.align) {
+      WriteType(ostrm, kCompactIntervalSets);
+      return GetCompactIntervalSets().Write(ostrm, /*align=*/true);
+    }
+    if (intervals_ready_.load(std::memory_order_acquire)) {
+      WriteType(ostrm, interval_sets_);
+    } else {
+      WriteType(ostrm, ExpandIntervalSets());
+    }
     return true;
   }
 
  private:
   LabelReachableData() {}
 
+  // Returns interval sets built from the compact interval sets.
+  std::vector<LabelIntervalSet> ExpandIntervalSets() const {
+    const auto &isets = compact_interval_sets_;
+    std::vector<LabelIntervalSet> interval_sets(isets.NumSets());
+    for (size_t s = 0; s < isets.NumSets(); ++s) {
+      auto *intervals = interval_sets[s].MutableIntervals();
+      for (size_t i = 0; i < isets.Size(s); ++i) {
+        intervals->emplace_back(isets.Begins(s)[i], isets.Ends(s)[i]);
+      }
+      interval_sets[s].Normalize();
+    }
+    return interval_sets;
+  }
+
+  // Fills in interval_sets_ from the compact interval sets, if not already
+  // done.
+  void BuildIntervalSets() const {
+    if (intervals_ready_.load(std::memory_order_acquire)) return;
+    std::lock_guard<std::mutex> lock(compact_mutex_);
+    if (intervals_ready_.load(std::memory_order_relaxed)) return;
+    interval_sets_ = ExpandIntervalSets();
+    intervals_ready_.store(true, std::memory_order_release);
+  }
+
+  // Fills in label2index_ from the dense vector, if not already done.
+  void BuildLabel2Index() const {
+    if (!dense_) return;
+    std::lock_guard<std::mutex> lock(label2index_mutex_);
+    if (!label2index_.empty()) return;
+    label2index_.reserve(dense_size_);
+    ForEachLabel2Index(
+        [this](Label label, Label index) { label2index_[label] = index; });
+  }
+
   bool reach_input_;                               // Input labels considered?
   bool keep_relabel_data_;                         // Save label2index_ to file?
   bool have_relabel_data_;                         // Using label2index_?
   Label final_label_;                              // Final label.
-  std::unordered_map<Label, Label> label2index_;  // Finds index for a label.
-  std::vector<LabelIntervalSet> interval_sets_;    // Interval sets per state.
+  bool dense_ = false;                             // Dense label2index_?
+  // Finds index for a label; if dense_, built from dense_label2index_ on
+  // request.
+  mutable std::unordered_map<Label, Label> label2index_;
+  mutable std::mutex label2index_mutex_;
+  std::vector<Label> dense_label2index_;  // Index per label, or kNoLabel.
+  size_t dense_size_ = 0;                 // Number of labels with an index.
+  // Interval sets per state, if intervals_ready_.
+  mutable std::vector<LabelIntervalSet> interval_sets_;
+  mutable std::atomic<bool> intervals_ready_{true};
+  // Interval sets for queries, if compact_ready_.
+  mutable CompactIntervalSets<Label> compact_interval_sets_;
+  mutable std::atomic<bool> compact_ready_{false};
+  // Guards building either representation from the other.
+  mutable std::mutex compact_mutex_;
 };
 
 // Apply a new state order to a vector of LabelIntervalSets. order[i] gives
@@ -171,7 +409,9 @@ class LabelLowerBound {
   // Positions `aiter` at the first Arc with `label >= match_label` in the
   // half-open interval `[aiter_begin, aiter_end)`.  Returns the position
   // of `aiter`.  `aiter` must be an iterator of the FST that was passed to
-  // `Init`.
+  // `Init`.  Since `LabelReachable` searches for increasing labels, each
+  // from where the previous search ended, the range is first narrowed by
+  // galloping from `aiter_begin`.
   template <class ArcIterator>
   ssize_t operator()(ArcIterator *aiter, ssize_t aiter_begin, ssize_t aiter_end,
                      Label match_label) const {
@@ -181,6 +421,17 @@ class LabelLowerBound {
                     kArcValueFlags);
     ssize_t low = aiter_begin;
     ssize_t high = aiter_end;
+    for (ssize_t step = 1; low < high; step *= 2) {
+      const ssize_t probe = std::min(low + step, high) - 1;
+      aiter->Seek(probe);
+      auto label = reach_input_ ? aiter->Value().ilabel : aiter->Value().olabel;
+      if (label < match_label) {
+        low = probe + 1;
+      } else {
+        high = probe;
+        break;
+      }
+    }
     while (low < high) {
       const ssize_t mid = low + (high - low) / 2;
       aiter->Seek(mid);
@@ -243,9 +494,11 @@ class LabelReachable {
 
   using Interval = typename LabelIntervalSet::Interval;
 
+  // The reachability intervals are computed with num_threads threads (zero
+  // requests one per hardware thread).
   LabelReachable(const Fst<Arc> &fst, bool reach_input,
                  std::unique_ptr<Accumulator> accumulator = nullptr,
-                 bool keep_relabel_data = true)
+                 bool keep_relabel_data = true, size_t num_threads = 1)
       : fst_(std::make_unique<VectorFst<Arc>>(fst)),
         s_(kNoStateId),
         data_(std::make_shared<Data>(reach_input, keep_relabel_data)),
@@ -253,7 +506,8 @@ class LabelReachable {
                                  : std::make_unique<Accumulator>()) {
     const auto ins = fst_->NumStates();
     TransformFst();
-    FindIntervals(ins);
+    FindIntervals(ins, num_threads);
+    data_->FreezeIntervalSets();
     fst_.reset();
   }
 
@@ -283,13 +537,12 @@ class LabelReachable {
   // Relabels w.r.t labels that give compact label sets.
   Label Relabel(Label label) {
     if (label == 0 || error_) return label;
-    const auto &label2index = *data_->Label2Index();
-    auto iter = label2index.find(label);
-    if (iter != label2index.end()) return iter->second;
+    const auto index = data_->FindIndex(label);
+    if (index != kNoLabel) return index;
     auto &relabel = oov_label2index_[label];
     if (!relabel) {
       // Adds new label.
-      relabel = label2index.size() + oov_label2index_.size() + 1;
+      relabel = data_->Label2IndexSize() + oov_label2index_.size() + 1;
     }
     return relabel;
   }
@@ -301,11 +554,10 @@ class LabelReachable {
       for (MutableArcIterator<MutableFst<Arc>> aiter(fst, siter.Value());
            !aiter.Done(); aiter.Next()) {
         auto arc = aiter.Value();
-        if (relabel_input) {
-          arc.ilabel = Relabel(arc.ilabel);
-        } else {
-          arc.olabel = Relabel(arc.olabel);
-        }
+        auto &label = relabel_input ? arc.ilabel : arc.olabel;
+        const auto relabel = Relabel(label);
+        if (relabel == label) continue;
+        label = relabel;
         aiter.SetValue(arc);
       }
     }
@@ -324,25 +576,23 @@ class LabelReachable {
   void RelabelPairs(std::vector<std::pair<Label, Label>> *pairs,
                     bool avoid_collisions = false) {
     pairs->clear();
-    const auto &label2index = *data_->Label2Index();
+    const auto size = data_->Label2IndexSize();
     // Maps labels to their new values in [1, label2index().size()].
-    for (const auto &kv : label2index) {
-      if (kv.second != data_->FinalLabel()) {
-        pairs->emplace_back(kv);
-      }
-    }
+    data_->ForEachLabel2Index([this, pairs](Label label, Label index) {
+      if (index != data_->FinalLabel()) pairs->emplace_back(label, index);
+    });
     // Maps oov labels to their values > label2index().size().
     pairs->insert(pairs->end(), oov_label2index_.begin(),
                   oov_label2index_.end());
     if (avoid_collisions) {
       // Ensures any label in [1, label2index().size()] is mapped either
       // by the above steps or to label2index() + 1 (to avoid collisions).
-      for (size_t i = 1; i <= label2index.size(); ++i) {
-        const auto it = label2index.find(i);
-        bool unmapped = it == label2index.end();
+      for (size_t i = 1; i <= size; ++i) {
+        const auto index = data_->FindIndex(i);
+        bool unmapped = index == kNoLabel;
         if (unmapped) unmapped = oov_label2index_.count(i) == 0;
-        if (unmapped || it->second == data_->FinalLabel()) {
-          pairs->emplace_back(i, label2index.size() + 1);
+        if (unmapped || index == data_->FinalLabel()) {
+          pairs->emplace_back(i, size + 1);
         }
       }
     }
@@ -352,6 +602,7 @@ class LabelReachable {
   // with arc iterator to be passed to Reach.
   void SetState(StateId s, StateId aiter_s = kNoStateId) {
     s_ = s;
+    isets_ = &data_->GetCompactIntervalSets();
     if (aiter_s != kNoStateId) {
       accumulator_->SetState(aiter_s);
       if (accumulator_->Error()) error_ = true;
@@ -363,13 +614,13 @@ class LabelReachable {
   // Original labels must be transformed by the Relabel methods above.
   bool Reach(Label label) const {
     if (label == 0 || error_) return false;
-    return data_->GetIntervalSet(s_).Member(label);
+    return isets_->Member(s_, label);
   }
 
   // Can reach final state (via epsilon transitions) from this state?
   bool ReachFinal() const {
     if (error_) return false;
-    return data_->GetIntervalSet(s_).Member(data_->FinalLabel());
+    return isets_->Member(s_, data_->FinalLabel());
   }
 
   // Initialize with secondary FST to be used with Reach(Iterator,...).
@@ -398,16 +649,33 @@ class LabelReachable {
   bool Reach(Iterator *aiter, ssize_t aiter_begin, ssize_t aiter_end,
              bool compute_weight) {
     if (error_) return false;
-    const auto &interval_set = data_->GetIntervalSet(s_);
+    const ssize_t size = isets_->Size(s_);
     ++ncalls_;
-    nintervals_ += interval_set.Size();
+    nintervals_ += size;
     reach_begin_ = -1;
     reach_end_ = -1;
     reach_weight_ = Weight::Zero();
     const auto flags = aiter->Flags();  // Save flags to restore them on exit.
     aiter->SetFlags(kArcNoCache, kArcNoCache);  // Makes caching optional.
+    if (aiter_begin < aiter_end) {
+      // Checks the label range of the arcs against the intervals first, so
+      // that neither is scanned when they cannot intersect.
+      aiter->SetFlags(reach_fst_input_ ? kArcILabelValue : kArcOLabelValue,
+                      kArcValueFlags);
+      aiter->Seek(aiter_end - 1);
+      const auto &last = aiter->Value();
+      const auto last_label = reach_fst_input_ ? last.ilabel : last.olabel;
+      aiter->Seek(aiter_begin);
+      const auto &first = aiter->Value();
+      const auto first_label = reach_fst_input_ ? first.ilabel : first.olabel;
+      aiter->SetFlags(kArcValueFlags, kArcValueFlags);
+      if (!isets_->Intersects(s_, first_label, last_label + 1)) {
+        aiter->SetFlags(flags, kArcFlags);  // Restores original flag values.
+        return false;
+      }
+    }
     aiter->Seek(aiter_begin);
-    if (2 * (aiter_end - aiter_begin) < interval_set.Size()) {
+    if (2 * (aiter_end - aiter_begin) < size) {
       // Checks each arc against intervals, setting arc iterator flags to only
       // compute the ilabel or olabel values, since they are the only values
       // required for most of the arcs processed.
@@ -444,11 +712,13 @@ class LabelReachable {
       }
     } else {
       // Checks each interval against arcs.
+      const auto *begins = isets_->Begins(s_);
+      const auto *ends = isets_->Ends(s_);
       auto begin_low = aiter_begin;
       auto end_low = aiter_begin;
-      for (const auto &interval : interval_set) {
-        begin_low = lower_bound_(aiter, end_low, aiter_end, interval.begin);
-        end_low = lower_bound_(aiter, begin_low, aiter_end, interval.end);
+      for (ssize_t i = 0; i < size; ++i) {
+        begin_low = lower_bound_(aiter, end_low, aiter_end, begins[i]);
+        end_low = lower_bound_(aiter, begin_low, aiter_end, ends[i]);
         if (end_low - begin_low > 0) {
           if (reach_begin_ < 0) reach_begin_ = begin_low;
           reach_end_ = end_low;
@@ -542,8 +812,9 @@ class LabelReachable {
     }
   }
 
-  void FindIntervals(StateId ins) {
-    StateReachable<Arc, Label, LabelIntervalSet> state_reachable(*fst_);
+  void FindIntervals(StateId ins, size_t num_threads) {
+    StateReachable<Arc, Label, LabelIntervalSet> state_reachable(*fst_,
+                                                                 num_threads);
     if (state_reachable.Error()) {
       error_ = true;
       return;
@@ -558,6 +829,7 @@ class LabelReachable {
       label2index[kv.first] = i;
       if (kv.first == kNoLabel) data_->SetFinalLabel(i);
     }
+    data_->CompactLabel2Index();
     label2state_.clear();
     double nintervals = 0;
     ssize_t non_intervals = 0;
@@ -578,6 +850,8 @@ class LabelReachable {
   std::unique_ptr<VectorFst<Arc>> fst_;
   // Current state
   StateId s_;
+  // Interval sets for queries, set with the current state.
+  const CompactIntervalSets<Label> *isets_ = nullptr;
   // Finds final state for a label
   std::unordered_map<Label, StateId> label2state_;
   // Iterator position of first match.
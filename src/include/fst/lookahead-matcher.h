@@ -37,6 +37,8 @@
 
 DECLARE_string(save_relabel_ipairs);
 DECLARE_string(save_relabel_opairs);
+DECLARE_bool(save_relabel_data);
+DECLARE_uint64(label_reachable_threads);
 
 namespace fst {
 
@@ -98,81 +100,8 @@ namespace fst {
 //  // implementations are useful for weight-pushing in composition.
 //  Weight LookAheadWeight() const override;
 // };
-
-// Look-ahead flags.
-// Matcher is a lookahead matcher when match_type is MATCH_INPUT.
-inline constexpr uint32_t kInputLookAheadMatcher = 0x00000010;
-
-// Matcher is a lookahead matcher when match_type is MATCH_OUTPUT.
-inline constexpr uint32_t kOutputLookAheadMatcher = 0x00000020;
-
-// Is a non-trivial implementation of LookAheadWeight() method defined and
-// if so, should it be used?
-inline constexpr uint32_t kLookAheadWeight = 0x00000040;
-
-// Is a non-trivial implementation of LookAheadPrefix() method defined and
-// if so, should it be used?
-inline constexpr uint32_t kLookAheadPrefix = 0x00000080;
-
-// Look-ahead of matcher FST non-epsilon arcs?
-inline constexpr uint32_t kLookAheadNonEpsilons = 0x00000100;
-
-// Look-ahead of matcher FST epsilon arcs?
-inline constexpr uint32_t kLookAheadEpsilons = 0x00000200;
-
-// Ignore epsilon paths for the lookahead prefix? This gives correct results in
-// composition only with an appropriate composition filter since it depends on
-// the filter blocking the ignored paths.
-inline constexpr uint32_t kLookAheadNonEpsilonPrefix = 0x00000400;
-
-// For LabelLookAheadMatcher, save relabeling data to file?
-inline constexpr uint32_t kLookAheadKeepRelabelData = 0x00000800;
-
-// Flags used for lookahead matchers.
-inline constexpr uint32_t kLookAheadFlags = 0x00000ff0;
-
-// LookAhead Matcher interface, templated on the Arc definition; used
-// for lookahead matcher specializations that are returned by the
-// InitMatcher() Fst method.
-template <class Arc>
-class LookAheadMatcherBase : public MatcherBase<Arc> {
- public:
-  using Label = typename Arc::Label;
-  using StateId = typename Arc::StateId;
-  using Weight = typename Arc::Weight;
-
-  virtual void InitLookAheadFst(const Fst<Arc> &, bool copy = false) = 0;
-  virtual bool LookAheadFst(const Fst<Arc> &, StateId) = 0;
-  virtual bool LookAheadLabel(Label) const = 0;
-
-  // Suggested concrete implementation of lookahead methods.
-
-  bool LookAheadPrefix(Arc *arc) const {
-    if (prefix_arc_.nextstate != kNoStateId) {
-      *arc = prefix_arc_;
-      return true;
-    } else {
-      return false;
-    }
-  }
-
-  Weight LookAheadWeight() const { return weight_; }
-
- protected:
-  // Concrete implementations for lookahead helper methods.
-
-  void ClearLookAheadWeight() { weight_ = Weight::One(); }
-
-  void SetLookAheadWeight(Weight weight) { weight_ = std::move(weight); }
-
-  void ClearLookAheadPrefix() { prefix_arc_.nextstate = kNoStateId; }
-
-  void SetLookAheadPrefix(Arc arc) { prefix_arc_ = std::move(arc); }
-
- private:
-  Arc prefix_arc_;
-  Weight weight_;
-};
+//
+// The look-ahead flags and LookAheadMatcherBase are defined in matcher.h.
 
 // Doesn't actually lookahead, just declares that the future looks good.
 template <class M>
@@ -600,7 +529,9 @@ class LabelLookAheadMatcher
                (!reach_input && (kFlags & kOutputLookAheadMatcher))) {
       label_reachable_ =
           std::make_unique<Reachable>(fst, reach_input, std::move(accumulator),
-                                       kFlags & kLookAheadKeepRelabelData);
+                                       (kFlags & kLookAheadKeepRelabelData) ||
+                                           FST_FLAGS_save_relabel_data,
+                                       FST_FLAGS_label_reachable_threads);
     }
   }
 
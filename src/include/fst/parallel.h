@@ -0,0 +1,80 @@
+// Copyright 2005-2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Simple fork-join parallelism for running independent tasks on a pool of
+// threads.
+
+#ifndef FST_PARALLEL_H_
+#define FST_PARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace fst {
+
+// Returns the number of threads to use when num_threads are requested, where
+// zero requests one thread per hardware thread.
+inline size_t NumWorkerThreads(size_t num_threads) {
+  if (num_threads > 0) return num_threads;
+  return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+// Calls f(i, t) for each i in [0, n), using up to num_threads threads (zero
+// requests one per hardware thread), and returns when all calls have finished.
+// The index t < NumWorkerThreads(num_threads) identifies the thread making the
+// call; calls with the same t never overlap, so f may use it to select
+// per-thread scratch space. Tasks are handed out dynamically, so they need not
+// be of similar cost. Calls for different i may run concurrently and in any
+// order; with a single thread, f is called in order on the calling thread.
+template <class F>
+void ParallelForWithThreadIndex(size_t n, size_t num_threads, F f) {
+  num_threads = std::min(NumWorkerThreads(num_threads), n);
+  if (num_threads <= 1) {
+    for (size_t i = 0; i < n; ++i) f(i, 0);
+    return;
+  }
+  std::atomic<size_t> next(0);
+  const auto work = [&f, &next, n](size_t t) {
+    for (auto i = next++; i < n; i = next++) f(i, t);
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (size_t t = 1; t < num_threads; ++t) threads.emplace_back(work, t);
+  work(0);
+  for (auto &thread : threads) thread.join();
+}
+
+// As above, but calls f(i) for each i in [0, n).
+template <class F>
+void ParallelFor(size_t n, size_t num_threads, F f) {
+  ParallelForWithThreadIndex(n, num_threads,
+                             [&f](size_t i, size_t) { f(i); });
+}
+
+// Overload taking a C-style callback and its context, for callers that cannot
+// pass a functor (e.g., Cython).
+inline void ParallelFor(size_t n, size_t num_threads,
+                        void (*f)(size_t, void *), void *data) {
+  ParallelFor(n, num_threads, [f, data](size_t i) { f(i, data); });
+}
+
+}  // namespace fst
+
+#endif  // FST_PARALLEL_H_
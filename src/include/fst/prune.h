@@ -20,6 +20,11 @@
 #ifndef FST_PRUNE_H_
 #define FST_PRUNE_H_
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -27,7 +32,12 @@
 #include <fst/log.h>
 
 #include <fst/arcfilter.h>
+#include <fst/cache.h>
+#include <fst/fst.h>
 #include <fst/heap.h>
+#include <fst/parallel.h>
+#include <fst/properties.h>
+#include <fst/queue.h>
 #include <fst/shortest-distance.h>
 
 
@@ -63,6 +73,28 @@ class PruneCompare {
 
 }  // namespace internal
 
+// Scratch space for Prune. Passing the same workspace to repeated calls (e.g.,
+// on many small FSTs) lets them reuse the per-state buffers and the heap rather
+// than allocating them anew each time. A workspace may only be used by one call
+// at a time.
+template <class Arc>
+struct PruneWorkspace {
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+  using StateHeap = Heap<StateId, internal::PruneCompare<StateId, Weight>>;
+
+  PruneWorkspace() = default;
+  PruneWorkspace(const PruneWorkspace &) = delete;
+  PruneWorkspace &operator=(const PruneWorkspace &) = delete;
+
+  std::vector<Weight> idistance;  // Shortest distance from the initial state.
+  std::vector<Weight> fdistance;  // Shortest distance to the final states.
+  std::vector<size_t> enqueued;
+  std::vector<bool> visited;
+  std::vector<StateId> states;  // Dead states or output state IDs.
+  StateHeap heap{internal::PruneCompare<StateId, Weight>(idistance, fdistance)};
+};
+
 template <class Arc, class ArcFilter>
 struct PruneOptions {
   using StateId = typename Arc::StateId;
@@ -72,13 +104,17 @@ struct PruneOptions {
                         StateId state_threshold = kNoStateId,
                         ArcFilter filter = ArcFilter(),
                         std::vector<Weight> *distance = nullptr,
-                        float delta = kDelta, bool threshold_initial = false)
+                        float delta = kDelta, bool threshold_initial = false,
+                        PruneWorkspace<Arc> *workspace = nullptr,
+                        size_t num_threads = 1)
       : weight_threshold(std::move(weight_threshold)),
         state_threshold(state_threshold),
         filter(std::move(filter)),
         distance(distance),
         delta(delta),
-        threshold_initial(threshold_initial) {}
+        threshold_initial(threshold_initial),
+        workspace(workspace),
+        num_threads(num_threads) {}
 
   // Pruning weight threshold.
   Weight weight_threshold;
@@ -96,8 +132,128 @@ struct PruneOptions {
   // keeping a state or arc (matters if the semiring is not
   // commutative).
   bool threshold_initial;
+  // If non-null, scratch space to use; owned by the caller.
+  PruneWorkspace<Arc> *workspace;
+  // Number of threads used by the version of Prune that modifies its input
+  // when there is no state threshold; 0 for one per hardware thread. If not 1,
+  // the FST must support concurrent reads (e.g., VectorFst). The version
+  // writing to another FST ignores it with a warning.
+  size_t num_threads;
 };
 
+namespace internal {
+
+// Parallel pruning of an FST without a state threshold. The shortest distances
+// from the initial state and to the final states are computed concurrently,
+// and the states, final weights and arcs to keep are then decided in parallel
+// over ranges of states. A state or arc is kept if the best successful path
+// through it is within the limit, which selects exactly what the search in
+// Prune keeps. The FST is then modified in place. The distances and the list
+// of states to delete are kept in opts.workspace if given.
+template <class Arc, class ArcFilter>
+void ParallelPrune(MutableFst<Arc> *fst,
+                   const PruneOptions<Arc, ArcFilter> &opts) {
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+  static constexpr uint8_t kKeepState = 0x01;
+  static constexpr uint8_t kPruneFinal = 0x02;
+  static constexpr uint8_t kPruneArcs = 0x04;
+  static constexpr size_t kStatesPerTask = 1024;
+  const auto ns = fst->NumStates();
+  const auto num_threads = NumWorkerThreads(opts.num_threads);
+  PruneWorkspace<Arc> own_workspace;
+  auto *workspace = opts.workspace ? opts.workspace : &own_workspace;
+  auto &idistance = workspace->idistance;
+  auto &tmp = workspace->fdistance;
+  {
+    const auto reverse_distance = [&]() {
+      ShortestDistance(*fst, &tmp, true, opts.delta);
+    };
+    std::thread reverse_thread;
+    if (!opts.distance && num_threads > 1) {
+      reverse_thread = std::thread(reverse_distance);
+    }
+    AutoQueue<StateId> queue(*fst, &idistance, opts.filter);
+    const ShortestDistanceOptions<Arc, AutoQueue<StateId>, ArcFilter> sopts(
+        &queue, opts.filter, kNoStateId, opts.delta);
+    ShortestDistance(*fst, &idistance, sopts);
+    if (reverse_thread.joinable()) {
+      reverse_thread.join();
+    } else if (!opts.distance) {
+      reverse_distance();
+    }
+  }
+  const auto *fdistance = opts.distance ? opts.distance : &tmp;
+  if ((opts.state_threshold == 0) || (fdistance->size() <= fst->Start()) ||
+      ((*fdistance)[fst->Start()] == Weight::Zero())) {
+    fst->DeleteStates();
+    return;
+  }
+  const auto limit =
+      opts.threshold_initial
+          ? Times(opts.weight_threshold, (*fdistance)[fst->Start()])
+          : Times((*fdistance)[fst->Start()], opts.weight_threshold);
+  const auto idist = [&idistance](StateId s) {
+    return s < idistance.size() ? idistance[s] : Weight::Zero();
+  };
+  const auto fdist = [fdistance](StateId s) {
+    return s < fdistance->size() ? (*fdistance)[s] : Weight::Zero();
+  };
+  const NaturalLess<Weight> less;
+  std::vector<uint8_t> flags(ns, 0);
+  std::vector<std::vector<Arc>> arcs(ns);
+  ParallelFor(
+      (ns + kStatesPerTask - 1) / kStatesPerTask, num_threads, [&](size_t i) {
+        const StateId end = std::min<StateId>((i + 1) * kStatesPerTask, ns);
+        for (StateId s = i * kStatesPerTask; s < end; ++s) {
+          const auto weight = idist(s);
+          if (weight == Weight::Zero() ||
+              less(limit, Times(weight, fdist(s)))) {
+            continue;
+          }
+          flags[s] = kKeepState;
+          if (less(limit, Times(weight, fst->Final(s)))) {
+            flags[s] |= kPruneFinal;
+          }
+          const auto prune = [&](const Arc &arc) {
+            return opts.filter(arc) &&
+                   less(limit, Times(Times(weight, arc.weight),
+                                     fdist(arc.nextstate)));
+          };
+          for (ArcIterator<Fst<Arc>> aiter(*fst, s); !aiter.Done();
+               aiter.Next()) {
+            if (prune(aiter.Value())) {
+              flags[s] |= kPruneArcs;
+              break;
+            }
+          }
+          if (!(flags[s] & kPruneArcs)) continue;
+          for (ArcIterator<Fst<Arc>> aiter(*fst, s); !aiter.Done();
+               aiter.Next()) {
+            if (!prune(aiter.Value())) arcs[s].push_back(aiter.Value());
+          }
+        }
+      });
+  auto &dead = workspace->states;
+  dead.clear();
+  for (StateId s = 0; s < ns; ++s) {
+    if (!(flags[s] & kKeepState)) {
+      dead.push_back(s);
+      continue;
+    }
+    if (flags[s] & kPruneFinal) fst->SetFinal(s, Weight::Zero());
+    if (flags[s] & kPruneArcs) {
+      fst->DeleteArcs(s);
+      fst->ReserveArcs(s, arcs[s].size());
+      for (const auto &arc : arcs[s]) fst->AddArc(s, arc);
+      std::vector<Arc>().swap(arcs[s]);
+    }
+  }
+  fst->DeleteStates(dead);
+}
+
+}  // namespace internal
+
 // Pruning algorithm: this version modifies its input and it takes an options
 // class as an argument. After pruning the FST contains states and arcs that
 // belong to a successful path in the FST whose weight is no more than the
@@ -107,32 +263,49 @@ struct PruneOptions {
 // have the path property. The weight of any cycle needs to be bounded; i.e.,
 //
 //   Plus(weight, Weight::One()) == Weight::One()
+//
+// Without a state threshold, the pruning can use several threads (see
+// PruneOptions::num_threads).
 template <class Arc, class ArcFilter>
 void Prune(MutableFst<Arc> *fst, const PruneOptions<Arc, ArcFilter> &opts =
                                      PruneOptions<Arc, ArcFilter>()) {
   using StateId = typename Arc::StateId;
   using Weight = typename Arc::Weight;
   static_assert(IsPath<Weight>::value, "Weight must have path property.");
-  using StateHeap = Heap<StateId, internal::PruneCompare<StateId, Weight>>;
+  using StateHeap = typename PruneWorkspace<Arc>::StateHeap;
   auto ns = fst->NumStates();
   if (ns < 1) return;
-  std::vector<Weight> idistance(ns, Weight::Zero());
-  std::vector<Weight> tmp;
+  if (opts.num_threads != 1 && opts.state_threshold == kNoStateId) {
+    internal::ParallelPrune(fst, opts);
+    return;
+  }
+  PruneWorkspace<Arc> own_workspace;
+  auto *workspace = opts.workspace ? opts.workspace : &own_workspace;
+  auto &idistance = workspace->idistance;
+  idistance.assign(ns, Weight::Zero());
   if (!opts.distance) {
-    tmp.reserve(ns);
-    ShortestDistance(*fst, &tmp, true, opts.delta);
+    ShortestDistance(*fst, &workspace->fdistance, true, opts.delta);
   }
-  const auto *fdistance = opts.distance ? opts.distance : &tmp;
+  const auto *fdistance =
+      opts.distance ? opts.distance : &workspace->fdistance;
   if ((opts.state_threshold == 0) || (fdistance->size() <= fst->Start()) ||
       ((*fdistance)[fst->Start()] == Weight::Zero())) {
     fst->DeleteStates();
     return;
   }
-  internal::PruneCompare<StateId, Weight> compare(idistance, *fdistance);
-  StateHeap heap(compare);
-  std::vector<bool> visited(ns, false);
-  std::vector<size_t> enqueued(ns, StateHeap::kNoKey);
-  std::vector<StateId> dead;
+  // The workspace heap orders states by the workspace distances, so a heap is
+  // built over the caller's distances when these are given instead (they may
+  // grow during the search; see Determinize).
+  StateHeap distance_heap(
+      internal::PruneCompare<StateId, Weight>(idistance, *fdistance));
+  auto &heap = opts.distance ? distance_heap : workspace->heap;
+  heap.Clear();
+  auto &visited = workspace->visited;
+  visited.assign(ns, false);
+  auto &enqueued = workspace->enqueued;
+  enqueued.assign(ns, StateHeap::kNoKey);
+  auto &dead = workspace->states;
+  dead.clear();
   dead.push_back(fst->AddState());
   NaturalLess<Weight> less;
   auto s = fst->Start();
@@ -202,9 +375,10 @@ void Prune(MutableFst<Arc> *fst, const PruneOptions<Arc, ArcFilter> &opts =
 template <class Arc>
 void Prune(MutableFst<Arc> *fst, typename Arc::Weight weight_threshold,
            typename Arc::StateId state_threshold = kNoStateId,
-           float delta = kDelta) {
+           float delta = kDelta, size_t num_threads = 1) {
   const PruneOptions<Arc, AnyArcFilter<Arc>> opts(
-      weight_threshold, state_threshold, AnyArcFilter<Arc>(), nullptr, delta);
+      weight_threshold, state_threshold, AnyArcFilter<Arc>(), nullptr, delta,
+      false, nullptr, num_threads);
   Prune(fst, opts);
 }
 
@@ -219,6 +393,9 @@ void Prune(MutableFst<Arc> *fst, typename Arc::Weight weight_threshold,
 // of any cycle needs to be bounded; i.e.,
 //
 //   Plus(weight, Weight::One()) == Weight::One()
+//
+// The pruning is a single search from the initial state, so opts.num_threads
+// is not used.
 template <class Arc, class ArcFilter>
 void Prune(
     const Fst<Arc> &ifst, MutableFst<Arc> *ofst,
@@ -226,7 +403,10 @@ void Prune(
   using StateId = typename Arc::StateId;
   using Weight = typename Arc::Weight;
   static_assert(IsPath<Weight>::value, "Weight must have path property.");
-  using StateHeap = Heap<StateId, internal::PruneCompare<StateId, Weight>>;
+  using StateHeap = typename PruneWorkspace<Arc>::StateHeap;
+  if (opts.num_threads != 1) {
+    LOG(WARNING) << "Prune: Ignoring num_threads when writing to another FST";
+  }
   ofst->DeleteStates();
   ofst->SetInputSymbols(ifst.InputSymbols());
   ofst->SetOutputSymbols(ifst.OutputSymbols());
@@ -236,19 +416,32 @@ void Prune(
       (opts.state_threshold == 0)) {
     return;
   }
-  std::vector<Weight> idistance;
-  std::vector<Weight> tmp;
-  if (!opts.distance) ShortestDistance(ifst, &tmp, true, opts.delta);
-  const auto *fdistance = opts.distance ? opts.distance : &tmp;
+  PruneWorkspace<Arc> own_workspace;
+  auto *workspace = opts.workspace ? opts.workspace : &own_workspace;
+  auto &idistance = workspace->idistance;
+  idistance.clear();
+  if (!opts.distance) {
+    ShortestDistance(ifst, &workspace->fdistance, true, opts.delta);
+  }
+  const auto *fdistance =
+      opts.distance ? opts.distance : &workspace->fdistance;
   if ((fdistance->size() <= ifst.Start()) ||
       ((*fdistance)[ifst.Start()] == Weight::Zero())) {
     return;
   }
-  internal::PruneCompare<StateId, Weight> compare(idistance, *fdistance);
-  StateHeap heap(compare);
-  std::vector<StateId> copy;
-  std::vector<size_t> enqueued;
-  std::vector<bool> visited;
+  // The workspace heap orders states by the workspace distances, so a heap is
+  // built over the caller's distances when these are given instead (they may
+  // grow during the search; see Determinize).
+  StateHeap distance_heap(
+      internal::PruneCompare<StateId, Weight>(idistance, *fdistance));
+  auto &heap = opts.distance ? distance_heap : workspace->heap;
+  heap.Clear();
+  auto &copy = workspace->states;
+  copy.clear();
+  auto &enqueued = workspace->enqueued;
+  enqueued.clear();
+  auto &visited = workspace->visited;
+  visited.clear();
   auto s = ifst.Start();
   const auto limit = opts.threshold_initial
                          ? Times(opts.weight_threshold, (*fdistance)[s])
@@ -330,6 +523,291 @@ void Prune(const Fst<Arc> &ifst, MutableFst<Arc> *ofst,
   Prune(ifst, ofst, opts);
 }
 
+template <class Arc,
+          class Estimate = NaturalAStarEstimate<typename Arc::StateId,
+                                                typename Arc::Weight>>
+struct PruneFstOptions : CacheOptions {
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  Weight weight_threshold;  // Pruning weight threshold.
+  StateId state_threshold;  // Pruning state threshold.
+  // Estimate of the shortest distance from each state to the final states,
+  // e.g., a NaturalAStarEstimate over a precomputed distance vector, which
+  // must then outlive the FST.
+  Estimate estimate;
+
+  PruneFstOptions(const CacheOptions &opts, Weight weight_threshold,
+                  Estimate estimate, StateId state_threshold = kNoStateId)
+      : CacheOptions(opts),
+        weight_threshold(std::move(weight_threshold)),
+        state_threshold(state_threshold),
+        estimate(std::move(estimate)) {}
+
+  PruneFstOptions(Weight weight_threshold, Estimate estimate,
+                  StateId state_threshold = kNoStateId)
+      : weight_threshold(std::move(weight_threshold)),
+        state_threshold(state_threshold),
+        estimate(std::move(estimate)) {}
+};
+
+namespace internal {
+
+// Implementation class for PruneFst.
+template <class Arc, class Estimate>
+class PruneFstImpl : public CacheImpl<Arc> {
+ public:
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  using Store = DefaultCacheStore<Arc>;
+  using State = typename Store::State;
+
+  using FstImpl<Arc>::Properties;
+  using FstImpl<Arc>::SetType;
+  using FstImpl<Arc>::SetProperties;
+  using FstImpl<Arc>::SetInputSymbols;
+  using FstImpl<Arc>::SetOutputSymbols;
+
+  using CacheBaseImpl<CacheState<Arc>>::HasArcs;
+  using CacheBaseImpl<CacheState<Arc>>::HasFinal;
+  using CacheBaseImpl<CacheState<Arc>>::HasStart;
+  using CacheBaseImpl<CacheState<Arc>>::PushArc;
+  using CacheBaseImpl<CacheState<Arc>>::SetArcs;
+  using CacheBaseImpl<CacheState<Arc>>::SetFinal;
+  using CacheBaseImpl<CacheState<Arc>>::SetStart;
+
+  PruneFstImpl(const Fst<Arc> &fst, const PruneFstOptions<Arc, Estimate> &opts)
+      : CacheImpl<Arc>(opts.state_threshold == kNoStateId
+                           ? CacheOptions(opts)
+                           : CacheOptions(false, opts.gc_limit)),
+        fst_(fst.Copy()),
+        weight_threshold_(opts.weight_threshold),
+        state_threshold_(opts.state_threshold),
+        estimate_(opts.estimate) {
+    SetType("prune");
+    // Pruned arcs can make states inaccessible and remove inaccessible states
+    // from the state iteration, so accessibility does not carry over.
+    SetProperties(DeleteArcsProperties(fst.Properties(kFstProperties, false)) &
+                      ~(kNotAccessible | kNotCoAccessible),
+                  kCopyProperties);
+    SetInputSymbols(fst.InputSymbols());
+    SetOutputSymbols(fst.OutputSymbols());
+  }
+
+  PruneFstImpl(const PruneFstImpl &impl)
+      : CacheImpl<Arc>(impl),
+        fst_(impl.fst_->Copy(true)),
+        weight_threshold_(impl.weight_threshold_),
+        state_threshold_(impl.state_threshold_),
+        estimate_(impl.estimate_) {
+    SetType("prune");
+    SetProperties(impl.Properties(), kCopyProperties);
+    SetInputSymbols(impl.InputSymbols());
+    SetOutputSymbols(impl.OutputSymbols());
+  }
+
+  StateId Start() {
+    if (!HasStart()) {
+      const auto start = fst_->Start();
+      if (less_(weight_threshold_, Weight::One()) || start == kNoStateId ||
+          !Discover(start)) {
+        SetStart(kNoStateId);
+      } else {
+        SetStart(start);
+      }
+    }
+    return CacheImpl<Arc>::Start();
+  }
+
+  Weight Final(StateId s) {
+    if (!HasFinal(s)) Expand(s);
+    return CacheImpl<Arc>::Final(s);
+  }
+
+  size_t NumArcs(StateId s) {
+    if (!HasArcs(s)) Expand(s);
+    return CacheImpl<Arc>::NumArcs(s);
+  }
+
+  size_t NumInputEpsilons(StateId s) {
+    if (!HasArcs(s)) Expand(s);
+    return CacheImpl<Arc>::NumInputEpsilons(s);
+  }
+
+  size_t NumOutputEpsilons(StateId s) {
+    if (!HasArcs(s)) Expand(s);
+    return CacheImpl<Arc>::NumOutputEpsilons(s);
+  }
+
+  uint64_t Properties() const override { return Properties(kFstProperties); }
+
+  // Sets error if found and returns other FST impl properties.
+  uint64_t Properties(uint64_t mask) const override {
+    if ((mask & kError) && fst_->Properties(kError, false)) {
+      SetProperties(kError, kError);
+    }
+    return FstImpl<Arc>::Properties(mask);
+  }
+
+  void InitArcIterator(StateId s, ArcIteratorData<Arc> *data) {
+    if (!HasArcs(s)) Expand(s);
+    CacheImpl<Arc>::InitArcIterator(s, data);
+  }
+
+  // Keeps the final weight and the arcs of the state whose estimated best
+  // completion is within the weight threshold of that of the state.
+  void Expand(StateId s) {
+    const auto &distance = estimate_(s);
+    if (distance == Weight::Zero()) {
+      SetFinal(s, Weight::Zero());
+      SetArcs(s);
+      return;
+    }
+    const auto limit = Times(distance, weight_threshold_);
+    const auto final_weight = fst_->Final(s);
+    SetFinal(s, less_(limit, final_weight) ? Weight::Zero() : final_weight);
+    for (ArcIterator<Fst<Arc>> aiter(*fst_, s); !aiter.Done(); aiter.Next()) {
+      const auto &arc = aiter.Value();
+      const auto &nextdistance = estimate_(arc.nextstate);
+      if (nextdistance == Weight::Zero() ||
+          less_(limit, Times(arc.weight, nextdistance)) ||
+          !Discover(arc.nextstate)) {
+        continue;
+      }
+      PushArc(s, arc);
+    }
+    SetArcs(s);
+  }
+
+ private:
+  // Returns false if the state is new and the state threshold has been
+  // reached, and otherwise records the state as part of the output.
+  bool Discover(StateId s) {
+    if (state_threshold_ == kNoStateId) return true;
+    if (s < discovered_.size() && discovered_[s]) return true;
+    if (num_discovered_ >= state_threshold_) return false;
+    if (s >= discovered_.size()) discovered_.resize(s + 1, false);
+    discovered_[s] = true;
+    ++num_discovered_;
+    return true;
+  }
+
+  std::unique_ptr<const Fst<Arc>> fst_;
+  const Weight weight_threshold_;
+  const StateId state_threshold_;
+  const Estimate estimate_;
+  NaturalLess<Weight> less_;
+  // States admitted so far under the state threshold.
+  std::vector<bool> discovered_;
+  StateId num_discovered_ = 0;
+};
+
+}  // namespace internal
+
+// Delayed pruning: this version prunes the input FST lazily as its states are
+// expanded, so that it can be placed within a pipeline of delayed FSTs (e.g.,
+// between a ComposeFst and a DeterminizeFst) without materializing it. Since
+// the shortest distance from the initial state is not known until the whole
+// FST has been visited, the beam is local: the final weight and each arc of a
+// state s are kept if their weight Times() the estimated distance to the final
+// states from where they lead, i.e.,
+//
+//   Times(arc.weight, estimate(arc.nextstate))
+//
+// is no more than estimate(s) Times() the weight threshold. States whose
+// estimate is Weight::Zero() are assumed not to reach a final state and lose
+// their arcs and final weight. With the exact shortest distances to the final
+// states as the estimate, the shortest path is always kept and, for the
+// tropical semiring, so is every state and arc kept by Prune. The estimate is
+// a function object mapping a state to a weight, such as NaturalAStarEstimate;
+// it only has to be consistent with the input up to the threshold.
+//
+// When the state threshold is not kNoStateId, arcs to new states are dropped
+// once that number of states has been reached, so which states are kept then
+// depends on the order in which states are expanded; the cache is not garbage
+// collected in that case so that the result is stable. Input state IDs are
+// preserved. Weights must have the path property.
+//
+// This class attaches interface to implementation and handles reference
+// counting, delegating most methods to ImplToFst.
+template <class A,
+          class E = NaturalAStarEstimate<typename A::StateId,
+                                         typename A::Weight>>
+class PruneFst : public ImplToFst<internal::PruneFstImpl<A, E>> {
+ public:
+  using Arc = A;
+  using Estimate = E;
+  using StateId = typename Arc::StateId;
+
+  using Store = DefaultCacheStore<Arc>;
+  using State = typename Store::State;
+  using Impl = internal::PruneFstImpl<Arc, Estimate>;
+
+  static_assert(IsPath<typename Arc::Weight>::value,
+                "Weight must have path property.");
+
+  friend class ArcIterator<PruneFst<Arc, Estimate>>;
+  friend class StateIterator<PruneFst<Arc, Estimate>>;
+
+  PruneFst(const Fst<Arc> &fst, const PruneFstOptions<Arc, Estimate> &opts)
+      : ImplToFst<Impl>(std::make_shared<Impl>(fst, opts)) {}
+
+  // See Fst<>::Copy() for doc.
+  PruneFst(const PruneFst &fst, bool safe = false)
+      : ImplToFst<Impl>(fst, safe) {}
+
+  // Get a copy of this PruneFst. See Fst<>::Copy() for further doc.
+  PruneFst *Copy(bool safe = false) const override {
+    return new PruneFst(*this, safe);
+  }
+
+  inline void InitStateIterator(StateIteratorData<Arc> *data) const override;
+
+  void InitArcIterator(StateId s, ArcIteratorData<Arc> *data) const override {
+    GetMutableImpl()->InitArcIterator(s, data);
+  }
+
+ private:
+  using ImplToFst<Impl>::GetImpl;
+  using ImplToFst<Impl>::GetMutableImpl;
+
+  PruneFst &operator=(const PruneFst &) = delete;
+};
+
+// Specialization for PruneFst.
+template <class Arc, class Estimate>
+class StateIterator<PruneFst<Arc, Estimate>>
+    : public CacheStateIterator<PruneFst<Arc, Estimate>> {
+ public:
+  explicit StateIterator(const PruneFst<Arc, Estimate> &fst)
+      : CacheStateIterator<PruneFst<Arc, Estimate>>(fst,
+                                                    fst.GetMutableImpl()) {}
+};
+
+// Specialization for PruneFst.
+template <class Arc, class Estimate>
+class ArcIterator<PruneFst<Arc, Estimate>>
+    : public CacheArcIterator<PruneFst<Arc, Estimate>> {
+ public:
+  using StateId = typename Arc::StateId;
+
+  ArcIterator(const PruneFst<Arc, Estimate> &fst, StateId s)
+      : CacheArcIterator<PruneFst<Arc, Estimate>>(fst.GetMutableImpl(), s) {
+    if (!fst.GetImpl()->HasArcs(s)) fst.GetMutableImpl()->Expand(s);
+  }
+};
+
+template <class Arc, class Estimate>
+inline void PruneFst<Arc, Estimate>::InitStateIterator(
+    StateIteratorData<Arc> *data) const {
+  data->base =
+      std::make_unique<StateIterator<PruneFst<Arc, Estimate>>>(*this);
+}
+
+// Useful alias when using StdArc.
+using StdPruneFst = PruneFst<StdArc>;
+
 }  // namespace fst
 
 #endif  // FST_PRUNE_H_
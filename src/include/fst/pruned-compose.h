@@ -0,0 +1,196 @@
+// Copyright 2005-2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Composition restricted to the states and arcs within a weight beam.
+
+#ifndef FST_PRUNED_COMPOSE_H_
+#define FST_PRUNED_COMPOSE_H_
+
+#include <cstddef>
+#include <vector>
+
+#include <fst/log.h>
+#include <fst/arc.h>
+#include <fst/compose.h>
+#include <fst/fst.h>
+#include <fst/heap.h>
+#include <fst/mutable-fst.h>
+#include <fst/prune.h>
+#include <fst/queue.h>
+#include <fst/shortest-distance.h>
+#include <fst/weight.h>
+
+namespace fst {
+
+// Computes Prune(Compose(ifst1, ifst2)) without building the states of the
+// composition that fall outside the beam. The output FST contains the states
+// and arcs that belong to a successful path of the composition whose weight is
+// no more than the weight of its shortest path Times() the weight threshold.
+// When the state threshold is not kNoStateId, the output FST is further
+// restricted to have no more than that number of states, as with Prune.
+//
+// The composition is expanded lazily in A* order: a composed state (s1, s2) is
+// ordered by Times() of its shortest distance from the initial state and the
+// estimate Times(d1[s1], d2[s2]), where di is the shortest distance to the
+// final states in the ith FST. Since the ith component of any successful path
+// from (s1, s2) costs at least di[si], the estimate is admissible (and
+// consistent), so the search can stop as soon as the best queued state lies
+// outside the beam of the best complete path found so far. The expanded part
+// is then pruned exactly with Prune.
+//
+// The caller may instead provide the estimates di, e.g., when composing many
+// FSTs with the same FST, or a cheaper lower bound. Each di[si] must then be no
+// worse than the shortest distance from si to the final states, i.e.,
+// Plus(di[si], d) == di[si] for that distance d; otherwise paths within the
+// beam may be missed. States past the end of di are taken to reach no final
+// state.
+//
+// The output labels of the first FST or the input labels of the second FST
+// must be sorted. The weights need to be commutative and have the path
+// property; as with Prune, the weight of any cycle needs to be bounded, i.e.,
+//
+//   Plus(weight, Weight::One()) == Weight::One()
+template <class Arc>
+void PrunedCompose(
+    const Fst<Arc> &ifst1, const Fst<Arc> &ifst2, MutableFst<Arc> *ofst,
+    typename Arc::Weight weight_threshold,
+    typename Arc::StateId state_threshold = kNoStateId, float delta = kDelta,
+    const std::vector<typename Arc::Weight> *estimate1 = nullptr,
+    const std::vector<typename Arc::Weight> *estimate2 = nullptr) {
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+  using M = Matcher<Fst<Arc>>;
+  using Filter = SequenceComposeFilter<M>;
+  using StateTable =
+      GenericComposeStateTable<Arc, typename Filter::FilterState>;
+  using StateHeap = Heap<StateId, internal::PruneCompare<StateId, Weight>,
+                         ShortestFirstHeapArity<Weight>::value>;
+  static_assert(IsPath<Weight>::value, "Weight must have path property.");
+  static_assert(Weight::Properties() & kCommutative,
+                "Weight must be commutative.");
+  ofst->DeleteStates();
+  // The composition takes ownership of the state table, which is used to map
+  // composed states back to their component states.
+  auto *state_table = new StateTable(ifst1, ifst2);
+  ComposeFstOptions<Arc, M, Filter, StateTable> copts(CacheOptions(), nullptr,
+                                                      nullptr, nullptr,
+                                                      state_table);
+  copts.gc_limit = 0;
+  const ComposeFst<Arc> cfst(ifst1, ifst2, copts);
+  ofst->SetInputSymbols(cfst.InputSymbols());
+  ofst->SetOutputSymbols(cfst.OutputSymbols());
+  if (cfst.Properties(kError, false)) {
+    ofst->SetProperties(kError, kError);
+    return;
+  }
+  NaturalLess<Weight> less;
+  if (less(weight_threshold, Weight::One()) || state_threshold == 0) return;
+  std::vector<Weight> distance1;
+  std::vector<Weight> distance2;
+  if (!estimate1) {
+    ShortestDistance(ifst1, &distance1, true, delta);
+    estimate1 = &distance1;
+  }
+  if (!estimate2) {
+    ShortestDistance(ifst2, &distance2, true, delta);
+    estimate2 = &distance2;
+  }
+  const auto &fdistance1 = *estimate1;
+  const auto &fdistance2 = *estimate2;
+  if ((fdistance1.size() == 1 && !fdistance1[0].Member()) ||
+      (fdistance2.size() == 1 && !fdistance2[0].Member())) {
+    ofst->SetProperties(kError, kError);
+    return;
+  }
+  // Composed state estimates, computed when the state is first reached.
+  std::vector<Weight> idistance;
+  std::vector<Weight> fdistance;
+  const auto estimate = [&](StateId s) {
+    const auto &tuple = state_table->Tuple(s);
+    const auto s1 = tuple.StateId1();
+    const auto s2 = tuple.StateId2();
+    if (s1 >= fdistance1.size() || s2 >= fdistance2.size()) {
+      return Weight::Zero();
+    }
+    return Times(fdistance1[s1], fdistance2[s2]);
+  };
+  auto s = cfst.Start();
+  if (s == kNoStateId) return;
+  internal::PruneCompare<StateId, Weight> compare(idistance, fdistance);
+  StateHeap heap(compare);
+  std::vector<StateId> copy;
+  std::vector<size_t> enqueued;
+  std::vector<bool> visited;
+  const auto resize = [&](StateId s) {
+    if (s < copy.size()) return;
+    copy.resize(s + 1, kNoStateId);
+    idistance.resize(s + 1, Weight::Zero());
+    fdistance.resize(s + 1, Weight::Zero());
+    enqueued.resize(s + 1, StateHeap::kNoKey);
+    visited.resize(s + 1, false);
+  };
+  resize(s);
+  fdistance[s] = estimate(s);
+  if (fdistance[s] == Weight::Zero()) return;
+  copy[s] = ofst->AddState();
+  ofst->SetStart(copy[s]);
+  idistance[s] = Weight::One();
+  enqueued[s] = heap.Insert(s);
+  // Best complete path found so far; the limit only decreases as it improves.
+  auto best = Weight::Zero();
+  auto limit = Weight::Zero();
+  while (!heap.Empty()) {
+    s = heap.Top();
+    heap.Pop();
+    enqueued[s] = StateHeap::kNoKey;
+    // All queued states are at least as bad as this one.
+    if (less(limit, Times(idistance[s], fdistance[s]))) break;
+    visited[s] = true;
+    const auto final_weight = cfst.Final(s);
+    if (final_weight != Weight::Zero()) {
+      ofst->SetFinal(copy[s], final_weight);
+      best = Plus(best, Times(idistance[s], final_weight));
+      limit = Times(best, weight_threshold);
+    }
+    for (ArcIterator<Fst<Arc>> aiter(cfst, s); !aiter.Done(); aiter.Next()) {
+      const auto &arc = aiter.Value();
+      const auto nextstate = arc.nextstate;
+      if (nextstate >= copy.size() || copy[nextstate] == kNoStateId) {
+        resize(nextstate);
+        fdistance[nextstate] = estimate(nextstate);
+      }
+      if (fdistance[nextstate] == Weight::Zero()) continue;
+      const auto weight = Times(idistance[s], arc.weight);
+      if (less(limit, Times(weight, fdistance[nextstate]))) continue;
+      if (less(weight, idistance[nextstate])) idistance[nextstate] = weight;
+      if (copy[nextstate] == kNoStateId) copy[nextstate] = ofst->AddState();
+      ofst->AddArc(copy[s], Arc(arc.ilabel, arc.olabel, arc.weight,
+                                copy[nextstate]));
+      if (visited[nextstate]) continue;
+      if (enqueued[nextstate] == StateHeap::kNoKey) {
+        enqueued[nextstate] = heap.Insert(nextstate);
+      } else {
+        heap.Update(enqueued[nextstate], nextstate);
+      }
+    }
+  }
+  Prune(ofst, weight_threshold, state_threshold, delta);
+}
+
+}  // namespace fst
+
+#endif  // FST_PRUNED_COMPOSE_H_
@@ -31,6 +31,7 @@
 
 #include <fst/arcfilter.h>
 #include <fst/connect.h>
+#include <fst/fst-decl.h>
 #include <fst/heap.h>
 #include <fst/topsort.h>
 #include <fst/weight.h>
@@ -197,10 +198,12 @@ class LifoQueue : public QueueBase<S> {
 // Shortest-first queue discipline, templated on the StateId and as well as a
 // comparison functor used to compare two StateIds. If a (single) state's order
 // changes, it can be reordered in the queue with a call to Update(). If update
-// is false, call to Update() does not reorder the queue.
+// is false, call to Update() does not reorder the queue. The heap type holding
+// the states can be changed, e.g., to a Heap of higher arity.
 //
 // This is not a final class.
-template <typename S, typename Compare, bool update = true>
+template <typename S, typename Compare, bool update = true,
+          typename StateHeap = Heap<S, Compare>>
 class ShortestFirstQueue : public QueueBase<S> {
  public:
   using StateId = S;
@@ -250,7 +253,7 @@ class ShortestFirstQueue : public QueueBase<S> {
   const Compare &GetCompare() const { return heap_.GetCompare(); }
 
  private:
-  Heap<StateId, Compare> heap_;
+  StateHeap heap_;
   std::vector<ssize_t> key_;
 };
 
@@ -290,20 +293,37 @@ struct ErrorLess {
 
 }  // namespace internal
 
+// Heap arity suited to shortest-first disciplines over the given weight, used
+// by PrunedCompose. Tropical weights are cheap to compare, which favors a
+// shallower 4-ary heap. AutoQueue and Prune keep binary heaps: the arity
+// changes the order in which states with equal weights are dequeued, and so
+// which states Prune keeps under a state threshold.
+template <class Weight>
+struct ShortestFirstHeapArity : std::integral_constant<int, 2> {};
+
+template <class T>
+struct ShortestFirstHeapArity<TropicalWeightTpl<T>>
+    : std::integral_constant<int, 4> {};
+
 // Shortest-first queue discipline, templated on the StateId and Weight, is
 // specialized to use the weight's natural order for the comparison function.
-// Requires Weight is idempotent (due to use of NaturalLess).
-template <typename S, typename Weight>
+// Requires Weight is idempotent (due to use of NaturalLess). The states are
+// kept in a heap of the given arity.
+template <typename S, typename Weight, int HeapArity = 2>
 class NaturalShortestFirstQueue
     : public ShortestFirstQueue<
-          S, internal::StateWeightCompare<S, NaturalLess<Weight>>> {
+          S, internal::StateWeightCompare<S, NaturalLess<Weight>>, true,
+          Heap<S, internal::StateWeightCompare<S, NaturalLess<Weight>>,
+               HeapArity>> {
  public:
   using StateId = S;
   using Less = NaturalLess<Weight>;
   using Compare = internal::StateWeightCompare<StateId, Less>;
 
   explicit NaturalShortestFirstQueue(const std::vector<Weight> &distance)
-      : ShortestFirstQueue<StateId, Compare>(Compare(distance, Less())) {}
+      : ShortestFirstQueue<StateId, Compare, true,
+                           Heap<StateId, Compare, HeapArity>>(
+            Compare(distance, Less())) {}
 
   ~NaturalShortestFirstQueue() override = default;
 };
@@ -822,12 +842,11 @@ class NaturalAStarEstimate {
   NaturalAStarEstimate(const std::vector<Weight> &beta) : beta_(beta) {}
 
   const Weight &operator()(StateId s) const {
+    static const Weight kZero = Weight::Zero();
     return (s < beta_.size()) ? beta_[s] : kZero;
   }
 
  private:
-  static constexpr Weight kZero = Weight::Zero();
-
   const std::vector<Weight> &beta_;
 };
 
@@ -0,0 +1,287 @@
+// Copyright 2005-2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Functions to compute a state order that improves the memory locality of an
+// FST, and to renumber its states accordingly.
+
+#ifndef FST_REORDER_H_
+#define FST_REORDER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <fst/log.h>
+#include <fst/fst.h>
+#include <fst/mutable-fst.h>
+#include <fst/randgen.h>
+#include <fst/statesort.h>
+
+namespace fst {
+
+// How states are ordered:
+//
+// BFS: breadth-first from the start state, following arcs in arc order; this
+//   keeps the states a search expands together adjacent.
+// DFS: depth-first (preorder) from the start state, following arcs in arc
+//   order; this keeps the states along a path adjacent.
+// RCM: reverse Cuthill-McKee order of the underlying undirected graph, which
+//   reduces the largest difference between the IDs of adjacent states.
+// FREQUENCY: by decreasing number of visits in paths sampled from the start
+//   state (as RandGen does), ties broken in breadth-first order; this packs
+//   the states most often visited together.
+//
+// The states not reached from the start state are then ordered likewise,
+// starting from the lowest such state ID. Without a start state, the states
+// keep their order.
+enum class StateReorderType : uint8_t { BFS, DFS, RCM, FREQUENCY };
+
+template <class Selector>
+struct StateReorderOptions {
+  StateReorderType type;
+  // Arc selector used to sample paths with StateReorderType::FREQUENCY.
+  Selector selector;
+  // Number of paths sampled with StateReorderType::FREQUENCY.
+  int32_t npath;
+  // Maximum number of arcs in a sampled path.
+  int32_t max_length;
+
+  explicit StateReorderOptions(
+      StateReorderType type = StateReorderType::BFS,
+      const Selector &selector = Selector(), int32_t npath = 1000,
+      int32_t max_length = std::numeric_limits<int32_t>::max())
+      : type(type), selector(selector), npath(npath), max_length(max_length) {}
+};
+
+namespace internal {
+
+// Appends to the sequence the states reached from the states in it (from
+// position begin onward) and not marked as visited, in breadth-first order.
+template <class Arc>
+void BfsStateSequence(const Fst<Arc> &fst, size_t begin,
+                      std::vector<typename Arc::StateId> *sequence,
+                      std::vector<bool> *visited) {
+  for (auto i = begin; i < sequence->size(); ++i) {
+    for (ArcIterator<Fst<Arc>> aiter(fst, (*sequence)[i]); !aiter.Done();
+         aiter.Next()) {
+      const auto nextstate = aiter.Value().nextstate;
+      if ((*visited)[nextstate]) continue;
+      (*visited)[nextstate] = true;
+      sequence->push_back(nextstate);
+    }
+  }
+}
+
+// Appends to the sequence the states reached from the state and not marked as
+// visited, in depth-first preorder.
+template <class Arc>
+void DfsStateSequence(const Fst<Arc> &fst, typename Arc::StateId root,
+                      std::vector<typename Arc::StateId> *sequence,
+                      std::vector<bool> *visited) {
+  using StateId = typename Arc::StateId;
+  std::vector<StateId> stack = {root};
+  std::vector<StateId> nextstates;
+  while (!stack.empty()) {
+    const auto s = stack.back();
+    stack.pop_back();
+    if ((*visited)[s]) continue;
+    (*visited)[s] = true;
+    sequence->push_back(s);
+    nextstates.clear();
+    for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      const auto nextstate = aiter.Value().nextstate;
+      if (!(*visited)[nextstate]) nextstates.push_back(nextstate);
+    }
+    stack.insert(stack.end(), nextstates.rbegin(), nextstates.rend());
+  }
+}
+
+// Returns the states in breadth-first (or depth-first) order, the start state
+// first.
+template <class Arc>
+std::vector<typename Arc::StateId> SearchStateSequence(const Fst<Arc> &fst,
+                                                       size_t num_states,
+                                                       bool depth_first) {
+  using StateId = typename Arc::StateId;
+  std::vector<StateId> sequence;
+  sequence.reserve(num_states);
+  std::vector<bool> visited(num_states, false);
+  auto root = fst.Start();
+  for (StateId next = 0; root != kNoStateId;) {
+    if (depth_first) {
+      DfsStateSequence(fst, root, &sequence, &visited);
+    } else {
+      visited[root] = true;
+      const auto begin = sequence.size();
+      sequence.push_back(root);
+      BfsStateSequence(fst, begin, &sequence, &visited);
+    }
+    while (next < num_states && visited[next]) ++next;
+    root = next < num_states ? next : kNoStateId;
+  }
+  return sequence;
+}
+
+// Returns the states in reverse Cuthill-McKee order: breadth-first in the
+// undirected graph of the FST, neighbors by increasing degree, reversed.
+template <class Arc>
+std::vector<typename Arc::StateId> RcmStateSequence(const Fst<Arc> &fst,
+                                                    size_t num_states) {
+  using StateId = typename Arc::StateId;
+  // Adjacency lists of the undirected graph, with offsets[s] the position of
+  // the neighbors of s; self-loops are ignored.
+  std::vector<size_t> offsets(num_states + 1, 0);
+  for (StateId s = 0; s < num_states; ++s) {
+    for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      const auto nextstate = aiter.Value().nextstate;
+      if (nextstate == s) continue;
+      ++offsets[s + 1];
+      ++offsets[nextstate + 1];
+    }
+  }
+  for (size_t s = 0; s < num_states; ++s) offsets[s + 1] += offsets[s];
+  std::vector<StateId> neighbors(offsets.back());
+  {
+    auto positions = offsets;
+    for (StateId s = 0; s < num_states; ++s) {
+      for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+        const auto nextstate = aiter.Value().nextstate;
+        if (nextstate == s) continue;
+        neighbors[positions[s]++] = nextstate;
+        neighbors[positions[nextstate]++] = s;
+      }
+    }
+  }
+  const auto degree = [&offsets](StateId s) {
+    return offsets[s + 1] - offsets[s];
+  };
+  std::vector<StateId> sequence;
+  sequence.reserve(num_states);
+  std::vector<bool> visited(num_states, false);
+  auto root = fst.Start();
+  for (StateId next = 0; root != kNoStateId;) {
+    visited[root] = true;
+    sequence.push_back(root);
+    for (auto i = sequence.size() - 1; i < sequence.size(); ++i) {
+      const auto s = sequence[i];
+      const auto begin = sequence.size();
+      for (auto j = offsets[s]; j < offsets[s + 1]; ++j) {
+        const auto neighbor = neighbors[j];
+        if (visited[neighbor]) continue;
+        visited[neighbor] = true;
+        sequence.push_back(neighbor);
+      }
+      std::stable_sort(sequence.begin() + begin, sequence.end(),
+                       [&degree](StateId x, StateId y) {
+                         return degree(x) < degree(y);
+                       });
+    }
+    while (next < num_states && visited[next]) ++next;
+    root = next < num_states ? next : kNoStateId;
+  }
+  std::reverse(sequence.begin(), sequence.end());
+  return sequence;
+}
+
+// Returns the states by decreasing number of visits in the paths sampled with
+// the selector, ties broken in breadth-first order.
+template <class Arc, class Selector>
+std::vector<typename Arc::StateId> FrequencyStateSequence(
+    const Fst<Arc> &fst, size_t num_states,
+    const StateReorderOptions<Selector> &opts) {
+  using StateId = typename Arc::StateId;
+  std::vector<uint64_t> visits(num_states, 0);
+  const auto start = fst.Start();
+  for (int32_t n = 0; start != kNoStateId && n < opts.npath; ++n) {
+    auto s = start;
+    ++visits[s];
+    for (int32_t length = 0; length < opts.max_length; ++length) {
+      const auto narcs = fst.NumArcs(s);
+      if (narcs == 0) break;
+      const auto i = opts.selector(fst, s);
+      if (i >= narcs) break;
+      ArcIterator<Fst<Arc>> aiter(fst, s);
+      aiter.Seek(i);
+      s = aiter.Value().nextstate;
+      ++visits[s];
+    }
+  }
+  auto sequence = SearchStateSequence(fst, num_states, false);
+  std::stable_sort(sequence.begin(), sequence.end(),
+                   [&visits](StateId x, StateId y) {
+                     return visits[x] > visits[y];
+                   });
+  return sequence;
+}
+
+}  // namespace internal
+
+// Computes a state order as taken by StateSort: order[s] is the new ID of the
+// state s. See StateReorderType for the orders available.
+//
+// Complexity:
+//
+//   BFS, DFS: O(V + E)
+//   RCM: O(V log V + E log E)
+//   FREQUENCY: O(V log V + E + npath * max_length * C)
+//
+// where C is the cost of selecting an arc.
+template <class Arc, class Selector>
+void StateReorder(const Fst<Arc> &fst,
+                  std::vector<typename Arc::StateId> *order,
+                  const StateReorderOptions<Selector> &opts) {
+  using StateId = typename Arc::StateId;
+  const auto num_states = CountStates(fst);
+  std::vector<StateId> sequence;
+  switch (opts.type) {
+    case StateReorderType::BFS:
+    case StateReorderType::DFS:
+      sequence = internal::SearchStateSequence(
+          fst, num_states, opts.type == StateReorderType::DFS);
+      break;
+    case StateReorderType::RCM:
+      sequence = internal::RcmStateSequence(fst, num_states);
+      break;
+    case StateReorderType::FREQUENCY:
+      sequence = internal::FrequencyStateSequence(fst, num_states, opts);
+      break;
+  }
+  // Keeps the order of the states if there is no start state, as none are
+  // reached then.
+  if (sequence.empty()) {
+    for (StateId s = 0; s < num_states; ++s) sequence.push_back(s);
+  }
+  order->assign(num_states, kNoStateId);
+  for (StateId i = 0; i < num_states; ++i) (*order)[sequence[i]] = i;
+}
+
+// Renumbers the states of the FST in the order computed as above. The result
+// is best stored as a ConstFst or CompactFst, whose state and arc arrays then
+// follow the same order.
+template <class Arc, class Selector = UniformArcSelector<Arc>>
+void StateReorder(MutableFst<Arc> *fst,
+                  const StateReorderOptions<Selector> &opts =
+                      StateReorderOptions<Selector>()) {
+  std::vector<typename Arc::StateId> order;
+  StateReorder(*fst, &order, opts);
+  StateSort(fst, order);
+}
+
+}  // namespace fst
+
+#endif  // FST_REORDER_H_
@@ -20,8 +20,10 @@
 #ifndef FST_REPLACE_UTIL_H_
 #define FST_REPLACE_UTIL_H_
 
+#include <algorithm>
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -51,6 +53,18 @@ enum ReplaceLabelType {
   REPLACE_LABEL_BOTH = 4
 };
 
+// Returns true if label type on arc results in epsilon input label.
+inline bool EpsilonOnInput(ReplaceLabelType label_type) {
+  return label_type == REPLACE_LABEL_NEITHER ||
+         label_type == REPLACE_LABEL_OUTPUT;
+}
+
+// Returns true if label type on arc results in epsilon input label.
+inline bool EpsilonOnOutput(ReplaceLabelType label_type) {
+  return label_type == REPLACE_LABEL_NEITHER ||
+         label_type == REPLACE_LABEL_INPUT;
+}
+
 // By default ReplaceUtil will copy the input label of the replace arc.
 // The call_label_type and return_label_type options specify how to manage
 // the labels of the call arc and the return arc of the replace FST
@@ -638,6 +652,181 @@ void ReplaceUtil<Arc>::GetSCCProperties() const {
   }
 }
 
+// Summary of the labels that may be read first in the components of an RTN,
+// used by ReplaceFstMatcher to look ahead past call arcs in composition. For
+// each side (input or output) of the replace FST and each component FST, it
+// holds the labels that may be read first on entering the component, following
+// epsilons and calls into other components; whether the component may be
+// traversed without reading any label; and the nonterminal labels found on the
+// arcs of the component. The label types and labels of the call and return
+// arcs are as in ReplaceFstOptions. As in ReplaceFstImpl, components are
+// indexed from 1 and nonterminals are recognized by their output labels.
+template <class Arc>
+class ReplaceLabelSummary {
+ public:
+  using Label = typename Arc::Label;
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  using NonTerminalHash = std::unordered_map<Label, Label>;
+
+  // Constructs from ReplaceFst internals; FST ownership is retained by caller.
+  ReplaceLabelSummary(
+      const std::vector<std::unique_ptr<const Fst<Arc>>> &fst_array,
+      const NonTerminalHash &nonterminal_hash,
+      ReplaceLabelType call_label_type, ReplaceLabelType return_label_type,
+      Label call_output_label, Label return_label);
+
+  // Returns the labels, sorted, that may be read first on the given side on
+  // entering the component.
+  const std::vector<Label> &FirstLabels(Label fst_id, bool input) const {
+    return sides_[input].first_labels[fst_id];
+  }
+
+  // Can the component be traversed without reading a label on the given side?
+  bool Nullable(Label fst_id, bool input) const {
+    return sides_[input].nullable[fst_id];
+  }
+
+  // Returns the nonterminal labels, sorted, found on the given side of the
+  // arcs of the component.
+  const std::vector<Label> &NonTerminalLabels(Label fst_id,
+                                              bool input) const {
+    return sides_[input].nonterminal_labels[fst_id];
+  }
+
+  // Appends the labels that may be read first on the given side from state s
+  // of a component FST, possibly repeated, and returns true if a final state
+  // of the component may be reached without reading a label.
+  bool EpsilonClosure(const Fst<Arc> &fst, StateId s, bool input,
+                      std::vector<Label> *labels) const;
+
+  // Returns the label on the given side of the call arc replacing the arc.
+  Label CallLabel(const Arc &arc, bool input) const {
+    if (input) return EpsilonOnInput(call_label_type_) ? 0 : arc.ilabel;
+    if (EpsilonOnOutput(call_label_type_)) return 0;
+    return call_output_label_ == kNoLabel ? arc.olabel : call_output_label_;
+  }
+
+  // Returns the label on the given side of the return arcs.
+  Label ReturnLabel(bool input) const {
+    const bool epsilon = input ? EpsilonOnInput(return_label_type_)
+                               : EpsilonOnOutput(return_label_type_);
+    return epsilon ? 0 : return_label_;
+  }
+
+ private:
+  struct Side {
+    std::vector<std::vector<Label>> first_labels;
+    std::vector<bool> nullable;
+    std::vector<std::vector<Label>> nonterminal_labels;
+  };
+
+  NonTerminalHash nonterminal_hash_;
+  ReplaceLabelType call_label_type_;
+  ReplaceLabelType return_label_type_;
+  Label call_output_label_;
+  Label return_label_;
+  std::vector<bool> has_start_;  // Components with a start state.
+  Side sides_[2];                // Output side, then input side.
+};
+
+template <class Arc>
+ReplaceLabelSummary<Arc>::ReplaceLabelSummary(
+    const std::vector<std::unique_ptr<const Fst<Arc>>> &fst_array,
+    const NonTerminalHash &nonterminal_hash, ReplaceLabelType call_label_type,
+    ReplaceLabelType return_label_type, Label call_output_label,
+    Label return_label)
+    : nonterminal_hash_(nonterminal_hash),
+      call_label_type_(call_label_type),
+      return_label_type_(return_label_type),
+      call_output_label_(call_output_label),
+      return_label_(return_label),
+      has_start_(fst_array.size(), false) {
+  for (Label i = 1; i < fst_array.size(); ++i) {
+    has_start_[i] = fst_array[i]->Start() != kNoStateId;
+  }
+  for (const bool input : {false, true}) {
+    auto &side = sides_[input];
+    side.first_labels.resize(fst_array.size());
+    side.nullable.resize(fst_array.size(), false);
+    side.nonterminal_labels.resize(fst_array.size());
+    // Since components may call each other recursively, the first labels and
+    // nullability are computed as a least fixed point.
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (Label i = 1; i < fst_array.size(); ++i) {
+        if (!has_start_[i]) continue;
+        std::vector<Label> labels;
+        const bool nullable = EpsilonClosure(
+            *fst_array[i], fst_array[i]->Start(), input, &labels);
+        std::sort(labels.begin(), labels.end());
+        labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+        if (nullable != side.nullable[i] || labels != side.first_labels[i]) {
+          side.nullable[i] = nullable;
+          side.first_labels[i] = std::move(labels);
+          changed = true;
+        }
+      }
+    }
+    for (Label i = 1; i < fst_array.size(); ++i) {
+      auto &labels = side.nonterminal_labels[i];
+      for (StateIterator<Fst<Arc>> siter(*fst_array[i]); !siter.Done();
+           siter.Next()) {
+        for (ArcIterator<Fst<Arc>> aiter(*fst_array[i], siter.Value());
+             !aiter.Done(); aiter.Next()) {
+          const auto &arc = aiter.Value();
+          const auto label = input ? arc.ilabel : arc.olabel;
+          if (nonterminal_hash_.count(label)) labels.push_back(label);
+        }
+      }
+      std::sort(labels.begin(), labels.end());
+      labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+    }
+  }
+}
+
+template <class Arc>
+bool ReplaceLabelSummary<Arc>::EpsilonClosure(
+    const Fst<Arc> &fst, StateId s, bool input,
+    std::vector<Label> *labels) const {
+  const auto &side = sides_[input];
+  bool final = false;
+  std::unordered_set<StateId> visited = {s};
+  std::vector<StateId> queue = {s};
+  while (!queue.empty()) {
+    const auto state = queue.back();
+    queue.pop_back();
+    if (fst.Final(state) != Weight::Zero()) final = true;
+    for (ArcIterator<Fst<Arc>> aiter(fst, state); !aiter.Done();
+         aiter.Next()) {
+      const auto &arc = aiter.Value();
+      const auto it = arc.olabel == 0 ? nonterminal_hash_.end()
+                                      : nonterminal_hash_.find(arc.olabel);
+      auto label = input ? arc.ilabel : arc.olabel;
+      if (it != nonterminal_hash_.end()) {  // Call arc.
+        const auto nonterminal = it->second;
+        // Calls to empty components are deleted.
+        if (!has_start_[nonterminal]) continue;
+        label = CallLabel(arc, input);
+        if (label == 0) {
+          const auto &first_labels = side.first_labels[nonterminal];
+          labels->insert(labels->end(), first_labels.begin(),
+                         first_labels.end());
+          if (!side.nullable[nonterminal]) continue;
+          label = ReturnLabel(input);
+        }
+      }
+      if (label != 0) {
+        labels->push_back(label);
+      } else if (visited.insert(arc.nextstate).second) {
+        queue.push_back(arc.nextstate);
+      }
+    }
+  }
+  return final;
+}
+
 }  // namespace fst
 
 #endif  // FST_REPLACE_UTIL_H_
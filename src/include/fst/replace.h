@@ -20,9 +20,13 @@
 #ifndef FST_REPLACE_H_
 #define FST_REPLACE_H_
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <memory>
 #include <set>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -32,6 +36,7 @@
 #include <fst/expanded-fst.h>
 #include <fst/fst-decl.h>  // For optional argument declarations.
 #include <fst/fst.h>
+#include <fst/lock.h>
 #include <fst/matcher.h>
 #include <fst/replace-util.h>
 #include <fst/state-table.h>
@@ -339,6 +344,237 @@ class DefaultReplaceStateTable
   StackPrefixTable prefix_table_;
 };
 
+// Arcs of a ReplaceFst state, together with their epsilon counts, as shared
+// among copies of the FST; see ConcurrentReplaceStateTable.
+template <class Arc>
+struct ReplaceExpandedState {
+  std::vector<Arc> arcs;
+  size_t niepsilons = 0;
+  size_t noepsilons = 0;
+};
+
+namespace internal {
+
+// Append-only array with stable element addresses, which may be shared among
+// threads. Slots are claimed with an atomic counter and storage is allocated
+// in chunks as needed, so that reading an element never locks. Chunk k holds
+// kFirstChunkSize << k elements, so that small arrays stay small and at most
+// half of the storage is unused. A thread may read an element once its index
+// has been handed to it through some other synchronization (e.g., a mutex or
+// an atomic).
+template <class T>
+class ConcurrentChunkedArray {
+ public:
+  static constexpr int kFirstChunkBits = 6;
+  static constexpr size_t kFirstChunkSize = size_t{1} << kFirstChunkBits;
+  static constexpr int kMaxChunks = 64 - kFirstChunkBits;
+
+  ConcurrentChunkedArray() : size_(0) {
+    for (auto &chunk : chunks_) chunk.store(nullptr, std::memory_order_relaxed);
+  }
+
+  ~ConcurrentChunkedArray() {
+    for (auto &chunk : chunks_) {
+      delete[] chunk.load(std::memory_order_relaxed);
+    }
+  }
+
+  // Claims a new value-initialized slot, returning its index.
+  size_t Append() {
+    const auto index = size_.fetch_add(1, std::memory_order_relaxed);
+    const auto bit = HighBit(index + kFirstChunkSize);
+    auto &chunk = chunks_[bit - kFirstChunkBits];
+    if (!chunk.load(std::memory_order_acquire)) {
+      auto *storage = new T[size_t{1} << bit]();
+      T *expected = nullptr;
+      if (!chunk.compare_exchange_strong(expected, storage,
+                                         std::memory_order_acq_rel)) {
+        delete[] storage;
+      }
+    }
+    return index;
+  }
+
+  T &operator[](size_t index) const {
+    const auto position = index + kFirstChunkSize;
+    const auto bit = HighBit(position);
+    return chunks_[bit - kFirstChunkBits].load(
+        std::memory_order_acquire)[position - (size_t{1} << bit)];
+  }
+
+  size_t Size() const { return size_.load(std::memory_order_acquire); }
+
+ private:
+  // Returns the position of the highest set bit of a non-zero value.
+  static int HighBit(uint64_t value) {
+    int bit = 0;
+    for (int shift = 32; shift > 0; shift >>= 1) {
+      if (value >> shift) {
+        value >>= shift;
+        bit += shift;
+      }
+    }
+    return bit;
+  }
+
+  std::atomic<size_t> size_;
+  std::atomic<T *> chunks_[kMaxChunks];
+
+  ConcurrentChunkedArray(const ConcurrentChunkedArray &) = delete;
+  ConcurrentChunkedArray &operator=(const ConcurrentChunkedArray &) = delete;
+};
+
+// Bijective map between keys of type T and dense IDs of type I, which may be
+// shared among threads. Looking up an ID by key locks one of kNumShards
+// shards, chosen by hash; looking up an entry by ID does not lock. The Entry
+// type holds the key as member `key`, along with any other per-ID data.
+template <class I, class T, class H, class Entry>
+class ConcurrentBiTable {
+ public:
+  static constexpr size_t kNumShards = 64;
+
+  ConcurrentBiTable() = default;
+
+  I FindId(const T &key) {
+    auto &shard = shards_[hash_(key) % kNumShards];
+    {
+      ReaderMutexLock lock(&shard.mutex);
+      const auto it = shard.ids.find(key);
+      if (it != shard.ids.end()) return it->second;
+    }
+    MutexLock lock(&shard.mutex);
+    const auto it = shard.ids.find(key);
+    if (it != shard.ids.end()) return it->second;
+    const auto id = static_cast<I>(entries_.Append());
+    entries_[id].key = key;
+    shard.ids.emplace(key, id);
+    return id;
+  }
+
+  Entry &FindEntry(I id) const { return entries_[id]; }
+
+  size_t Size() const { return entries_.Size(); }
+
+ private:
+  struct Shard {
+    Mutex mutex;
+    std::unordered_map<T, I, H> ids;
+  };
+
+  H hash_;
+  Shard shards_[kNumShards];
+  ConcurrentChunkedArray<Entry> entries_;
+
+  ConcurrentBiTable(const ConcurrentBiTable &) = delete;
+  ConcurrentBiTable &operator=(const ConcurrentBiTable &) = delete;
+};
+
+// Whether a replace state table shares expanded states among the copies of a
+// ReplaceFst, as ConcurrentReplaceStateTable does.
+template <class StateTable, class = void>
+struct SharesReplaceExpandedStates : std::false_type {};
+
+template <class StateTable>
+struct SharesReplaceExpandedStates<
+    StateTable, std::void_t<typename StateTable::ExpandedState>>
+    : std::true_type {};
+
+}  // namespace internal
+
+// A replace state table that may be shared among threads. Unlike the other
+// replace state tables, copies share all state with the original, so that the
+// thread-safe copies of a ReplaceFst (i.e., Copy(true)) agree on state IDs.
+// The copies also share expanded states: each state is expanded once, by
+// whichever thread first visits it, and its arcs are stored once for all
+// threads rather than in the private cache of each copy. Expanded states are
+// kept as long as some copy uses the table. Looking up tuples and stack
+// prefixes by ID does not lock; looking up IDs locks one of several shards.
+template <class Arc, class P = ssize_t>
+class ConcurrentReplaceStateTable {
+ public:
+  using Label = typename Arc::Label;
+  using StateId = typename Arc::StateId;
+
+  using PrefixId = P;
+  using StateTuple = ReplaceStateTuple<StateId, PrefixId>;
+  using StackPrefix = ReplaceStackPrefix<Label, StateId>;
+  using ExpandedState = ReplaceExpandedState<Arc>;
+
+  ConcurrentReplaceStateTable(
+      const std::vector<std::pair<Label, const Fst<Arc> *>> &, Label)
+      : shared_(std::make_shared<Shared>()) {}
+
+  ConcurrentReplaceStateTable(const ConcurrentReplaceStateTable &table)
+      : shared_(table.shared_) {}
+
+  StateId FindState(const StateTuple &tuple) {
+    return shared_->states.FindId(tuple);
+  }
+
+  const StateTuple &Tuple(StateId id) const {
+    return shared_->states.FindEntry(id).key;
+  }
+
+  PrefixId FindPrefixId(const StackPrefix &prefix) {
+    return shared_->prefixes.FindId(prefix);
+  }
+
+  const StackPrefix &GetStackPrefix(PrefixId id) const {
+    return shared_->prefixes.FindEntry(id).key;
+  }
+
+  // Returns the expanded state with the given ID, or nullptr if it has not
+  // been expanded yet.
+  const ExpandedState *FindExpandedState(StateId id) const {
+    return shared_->states.FindEntry(id).expanded.load(
+        std::memory_order_acquire);
+  }
+
+  // Stores the expanded state with the given ID, unless another thread did
+  // so first, and returns the stored one.
+  const ExpandedState *SetExpandedState(
+      StateId id, std::unique_ptr<ExpandedState> expanded) {
+    auto &slot = shared_->states.FindEntry(id).expanded;
+    const ExpandedState *expected = nullptr;
+    if (slot.compare_exchange_strong(expected, expanded.get(),
+                                     std::memory_order_acq_rel)) {
+      return expanded.release();
+    }
+    return expected;
+  }
+
+ private:
+  struct StateEntry {
+    StateTuple key;
+    std::atomic<const ExpandedState *> expanded{nullptr};
+  };
+
+  struct PrefixEntry {
+    StackPrefix key;
+  };
+
+  struct Shared {
+    // The empty stack prefix has ID 0, as ReplaceFstImpl requires.
+    Shared() { prefixes.FindId(StackPrefix()); }
+
+    ~Shared() {
+      for (size_t s = 0; s < states.Size(); ++s) {
+        delete states.FindEntry(s).expanded.load(std::memory_order_relaxed);
+      }
+    }
+
+    internal::ConcurrentBiTable<StateId, StateTuple,
+                                ReplaceHash<StateId, PrefixId>, StateEntry>
+        states;
+    internal::ConcurrentBiTable<PrefixId, StackPrefix,
+                                ReplaceStackPrefixHash<Label, StateId>,
+                                PrefixEntry>
+        prefixes;
+  };
+
+  std::shared_ptr<Shared> shared_;
+};
+
 // By default ReplaceFst will copy the input label of the replace arc.
 // The call_label_type and return_label_type options specify how to manage
 // the labels of the call arc and the return arc of the replace FST
@@ -362,6 +598,10 @@ struct ReplaceFstOptions : CacheImplOptions<CacheStore> {
   bool take_ownership = false;
   // Pointer to optional pre-constructed state table.
   StateTable *state_table = nullptr;
+  // Precompute a ReplaceLabelSummary of the input FSTs? If so, the matcher
+  // returned by InitMatcher() looks ahead past call arcs, which lets
+  // composition skip components that cannot match.
+  bool compute_label_summary = false;
 
   explicit ReplaceFstOptions(const CacheImplOptions<CacheStore> &opts,
                              Label root = kNoLabel)
@@ -416,18 +656,6 @@ class ReplaceFstMatcher;
 template <class Arc>
 using FstList = std::vector<std::pair<typename Arc::Label, const Fst<Arc> *>>;
 
-// Returns true if label type on arc results in epsilon input label.
-inline bool EpsilonOnInput(ReplaceLabelType label_type) {
-  return label_type == REPLACE_LABEL_NEITHER ||
-         label_type == REPLACE_LABEL_OUTPUT;
-}
-
-// Returns true if label type on arc results in epsilon input label.
-inline bool EpsilonOnOutput(ReplaceLabelType label_type) {
-  return label_type == REPLACE_LABEL_NEITHER ||
-         label_type == REPLACE_LABEL_INPUT;
-}
-
 // Returns true if for either the call or return arc ilabel != olabel.
 template <class Label>
 bool ReplaceTransducer(ReplaceLabelType call_label_type,
@@ -501,6 +729,11 @@ class ReplaceFstImpl
   using StackPrefix = ReplaceStackPrefix<Label, StateId>;
   using NonTerminalHash = std::unordered_map<Label, Label>;
 
+  // Whether expanded states are shared among copies through the state table
+  // rather than cached per copy.
+  static constexpr bool kSharedExpansion =
+      internal::SharesReplaceExpandedStates<StateTable>::value;
+
   using FstImpl<Arc>::SetType;
   using FstImpl<Arc>::SetProperties;
   using FstImpl<Arc>::WriteHeader;
@@ -570,6 +803,11 @@ class ReplaceFstImpl
                                        &all_non_empty_and_sorted));
     // Enables optional caching as long as sorted and all non-empty.
     always_cache_ = !all_non_empty_and_sorted;
+    if (opts.compute_label_summary) {
+      label_summary_ = std::make_shared<const ReplaceLabelSummary<Arc>>(
+          fst_array_, nonterminal_hash_, call_label_type_, return_label_type_,
+          call_output_label_, return_label_);
+    }
     VLOG(2) << "ReplaceFstImpl::ReplaceFstImpl: always_cache = "
             << (always_cache_ ? "true" : "false");
   }
@@ -584,7 +822,8 @@ class ReplaceFstImpl
         state_table_(new StateTable(*(impl.state_table_))),
         nonterminal_set_(impl.nonterminal_set_),
         nonterminal_hash_(impl.nonterminal_hash_),
-        root_(impl.root_) {
+        root_(impl.root_),
+        label_summary_(impl.label_summary_) {
     SetType("replace");
     SetProperties(impl.Properties(), kCopyProperties);
     SetInputSymbols(impl.InputSymbols());
@@ -625,19 +864,23 @@ class ReplaceFstImpl
   }
 
   Weight Final(StateId s) {
-    if (HasFinal(s)) return CacheImpl::Final(s);
+    if (!kSharedExpansion && HasFinal(s)) return CacheImpl::Final(s);
     const auto &tuple = state_table_->Tuple(s);
     auto weight = Weight::Zero();
     if (tuple.prefix_id == 0) {
       const auto fst_state = tuple.fst_state;
       weight = fst_array_[tuple.fst_id]->Final(fst_state);
     }
-    if (always_cache_ || HasArcs(s)) SetFinal(s, weight);
+    if (!kSharedExpansion && (always_cache_ || HasArcs(s))) {
+      SetFinal(s, weight);
+    }
     return weight;
   }
 
   size_t NumArcs(StateId s) {
-    if (HasArcs(s)) {
+    if constexpr (kSharedExpansion) {
+      return GetExpandedState(s).arcs.size();
+    } else if (HasArcs(s)) {
       return CacheImpl::NumArcs(s);
     } else if (always_cache_) {  // If always caching, expands and caches state.
       Expand(s);
@@ -667,7 +910,9 @@ class ReplaceFstImpl
   }
 
   size_t NumInputEpsilons(StateId s) {
-    if (HasArcs(s)) {
+    if constexpr (kSharedExpansion) {
+      return GetExpandedState(s).niepsilons;
+    } else if (HasArcs(s)) {
       return CacheImpl::NumInputEpsilons(s);
     } else if (always_cache_ || !Properties(kILabelSorted)) {
       // If always caching or if the number of input epsilons is too expensive
@@ -703,7 +948,9 @@ class ReplaceFstImpl
   }
 
   size_t NumOutputEpsilons(StateId s) {
-    if (HasArcs(s)) {
+    if constexpr (kSharedExpansion) {
+      return GetExpandedState(s).noepsilons;
+    } else if (HasArcs(s)) {
       return CacheImpl::NumOutputEpsilons(s);
     } else if (always_cache_ || !Properties(kOLabelSorted)) {
       // If always caching or if the number of output epsilons is too expensive
@@ -755,6 +1002,14 @@ class ReplaceFstImpl
   // Returns the base arc iterator, and if arcs have not been computed yet,
   // extends and recurses for new arcs.
   void InitArcIterator(StateId s, ArcIteratorData<Arc> *data) {
+    if constexpr (kSharedExpansion) {
+      const auto &expanded = GetExpandedState(s);
+      data->base = nullptr;
+      data->arcs = expanded.arcs.data();
+      data->narcs = expanded.arcs.size();
+      data->ref_count = nullptr;
+      return;
+    }
     if (!HasArcs(s)) Expand(s);
     CacheImpl::InitArcIterator(s, data);
     // TODO(allauzen): Set behaviour of generic iterator.
@@ -780,6 +1035,31 @@ class ReplaceFstImpl
     SetArcs(s);
   }
 
+  // Returns the expanded state shared among copies, expanding it if no copy
+  // has done so yet.
+  const auto &GetExpandedState(StateId s) {
+    if (const auto *expanded = state_table_->FindExpandedState(s)) {
+      return *expanded;
+    }
+    auto expanded = std::make_unique<typename StateTable::ExpandedState>();
+    const auto tuple = state_table_->Tuple(s);
+    if (tuple.fst_state != kNoStateId) {
+      ArcIterator<Fst<Arc>> aiter(*fst_array_[tuple.fst_id], tuple.fst_state);
+      Arc arc;
+      if (ComputeFinalArc(tuple, &arc)) expanded->arcs.push_back(arc);
+      for (; !aiter.Done(); aiter.Next()) {
+        if (ComputeArc(tuple, aiter.Value(), &arc)) {
+          expanded->arcs.push_back(arc);
+        }
+      }
+      for (const auto &arc : expanded->arcs) {
+        if (arc.ilabel == 0) ++expanded->niepsilons;
+        if (arc.olabel == 0) ++expanded->noepsilons;
+      }
+    }
+    return *state_table_->SetExpandedState(s, std::move(expanded));
+  }
+
   void Expand(StateId s, const StateTuple &tuple,
               const ArcIteratorData<Arc> &data) {
     if (tuple.fst_state == kNoStateId) {  // Local FST is empty.
@@ -887,12 +1167,18 @@ class ReplaceFstImpl
   // Returns the arc iterator flags supported by this FST.
   uint8_t ArcIteratorFlags() const {
     uint8_t flags = kArcValueFlags;
-    if (!always_cache_) flags |= kArcNoCache;
+    if (!always_cache_ && !kSharedExpansion) flags |= kArcNoCache;
     return flags;
   }
 
   StateTable *GetStateTable() const { return state_table_.get(); }
 
+  // Returns the label summary of the components, or nullptr if it was not
+  // requested.
+  const ReplaceLabelSummary<Arc> *GetLabelSummary() const {
+    return label_summary_.get();
+  }
+
   const Fst<Arc> *GetFst(Label fst_id) const {
     return fst_array_[fst_id].get();
   }
@@ -942,6 +1228,9 @@ class ReplaceFstImpl
   NonTerminalHash nonterminal_hash_;
   std::vector<std::unique_ptr<const Fst<Arc>>> fst_array_;
   Label root_;
+
+  // Optional label summary of the components, shared among copies.
+  std::shared_ptr<const ReplaceLabelSummary<Arc>> label_summary_;
 };
 
 }  // namespace internal
@@ -1101,6 +1390,15 @@ class ArcIterator<ReplaceFst<Arc, StateTable, CacheStore>> {
         final_flags_(0) {
     cache_data_.ref_count = nullptr;
     local_data_.ref_count = nullptr;
+    // If expanded states are shared among copies, uses the shared arcs array.
+    if constexpr (ReplaceFst<Arc, StateTable,
+                             CacheStore>::Impl::kSharedExpansion) {
+      fst_.GetMutableImpl()->InitArcIterator(s_, &cache_data_);
+      num_arcs_ = cache_data_.narcs;
+      arcs_ = cache_data_.arcs;
+      data_flags_ = kArcValueFlags;
+      return;
+    }
     // If FST does not support optional caching, forces caching.
     if (!(fst_.GetImpl()->ArcIteratorFlags() & kArcNoCache) &&
         !(fst_.GetImpl()->HasArcs(s_))) {
@@ -1270,7 +1568,7 @@ class ArcIterator<ReplaceFst<Arc, StateTable, CacheStore>> {
 };
 
 template <class Arc, class StateTable, class CacheStore>
-class ReplaceFstMatcher : public MatcherBase<Arc> {
+class ReplaceFstMatcher : public LookAheadMatcherBase<Arc> {
  public:
   using Label = typename Arc::Label;
   using StateId = typename Arc::StateId;
@@ -1281,12 +1579,16 @@ class ReplaceFstMatcher : public MatcherBase<Arc> {
 
   using StateTuple = typename StateTable::StateTuple;
 
+  using LookAheadMatcherBase<Arc>::ClearLookAheadPrefix;
+  using LookAheadMatcherBase<Arc>::ClearLookAheadWeight;
+
   // This makes a copy of the FST.
   ReplaceFstMatcher(const ReplaceFst<Arc, StateTable, CacheStore> &fst,
                     MatchType match_type)
       : owned_fst_(fst.Copy()),
         fst_(*owned_fst_),
         impl_(fst_.GetMutableImpl()),
+        label_summary_(impl_->GetLabelSummary()),
         s_(fst::kNoStateId),
         match_type_(match_type),
         current_loop_(false),
@@ -1303,6 +1605,7 @@ class ReplaceFstMatcher : public MatcherBase<Arc> {
                     MatchType match_type)
       : fst_(*fst),
         impl_(fst_.GetMutableImpl()),
+        label_summary_(impl_->GetLabelSummary()),
         s_(fst::kNoStateId),
         match_type_(match_type),
         current_loop_(false),
@@ -1319,6 +1622,7 @@ class ReplaceFstMatcher : public MatcherBase<Arc> {
       : owned_fst_(matcher.fst_.Copy(safe)),
         fst_(*owned_fst_),
         impl_(fst_.GetMutableImpl()),
+        label_summary_(impl_->GetLabelSummary()),
         s_(fst::kNoStateId),
         match_type_(matcher.match_type_),
         current_loop_(false),
@@ -1333,14 +1637,23 @@ class ReplaceFstMatcher : public MatcherBase<Arc> {
   // Creates a local matcher for each component FST in the RTN. LocalMatcher is
   // a multi-epsilon wrapper matcher. MultiEpsilonMatcher is used to match each
   // non-terminal arc, since these non-terminal
-  // turn into epsilons on recursion.
+  // turn into epsilons on recursion. Given a label summary, only the
+  // non-terminals found in each component are added to its matcher.
   void InitMatchers() {
     const auto &fst_array = impl_->fst_array_;
     matcher_.resize(fst_array.size());
+    closures_.resize(fst_array.size());
     for (Label i = 0; i < fst_array.size(); ++i) {
       if (fst_array[i]) {
         matcher_[i] = std::make_unique<LocalMatcher>(
             *fst_array[i], match_type_, kMultiEpsList);
+        if (label_summary_) {
+          for (const auto label :
+               label_summary_->NonTerminalLabels(i, MatchInput())) {
+            matcher_[i]->AddMultiEpsLabel(label);
+          }
+          continue;
+        }
         auto it = impl_->nonterminal_set_.begin();
         for (; it != impl_->nonterminal_set_.end(); ++it) {
           matcher_[i]->AddMultiEpsLabel(*it);
@@ -1373,10 +1686,48 @@ class ReplaceFstMatcher : public MatcherBase<Arc> {
 
   uint64_t Properties(uint64_t props) const override { return props; }
 
+  // Given a label summary, this is a look-ahead matcher on its match side.
+  uint32_t Flags() const override {
+    if (!label_summary_) return 0;
+    return (MatchInput() ? kInputLookAheadMatcher : kOutputLookAheadMatcher) |
+           kLookAheadEpsilons | kLookAheadNonEpsilons;
+  }
+
+  void InitLookAheadFst(const Fst<Arc> &, bool copy = false) override {}
+
+  // Are there paths from state s of the look-ahead FST that can be read from
+  // the current state? Answers true without a label summary.
+  bool LookAheadFst(const Fst<Arc> &fst, StateId s) final {
+    ClearLookAheadWeight();
+    ClearLookAheadPrefix();
+    if (!label_summary_) return true;
+    SetReachState();
+    if (reach_final_ && fst.Final(s) != Weight::Zero()) return true;
+    for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      const auto &arc = aiter.Value();
+      const auto label = MatchInput() ? arc.olabel : arc.ilabel;
+      if (label == 0 || std::binary_search(reach_labels_.begin(),
+                                           reach_labels_.end(), label)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Can the label be read from the current state after possibly following
+  // epsilon transitions? Answers true without a label summary.
+  bool LookAheadLabel(Label label) const final {
+    if (label == 0 || !label_summary_) return true;
+    SetReachState();
+    return std::binary_search(reach_labels_.begin(), reach_labels_.end(),
+                              label);
+  }
+
   // Sets the state from which our matching happens.
   void SetState(StateId s) final {
     if (s_ == s) return;
     s_ = s;
+    reach_set_state_ = false;
     tuple_ = impl_->GetStateTable()->Tuple(s_);
     if (tuple_.fst_state == kNoStateId) {
       done_ = true;
@@ -1445,11 +1796,81 @@ class ReplaceFstMatcher : public MatcherBase<Arc> {
   ssize_t Priority(StateId s) final { return fst_.NumArcs(s); }
 
  private:
+  // Labels that may be read first from a component state, sorted, and whether
+  // a final state of the component may be reached without reading one.
+  struct EpsilonClosure {
+    std::vector<Label> labels;
+    bool final;
+  };
+
+  bool MatchInput() const { return match_type_ == MATCH_INPUT; }
+
+  // Returns the epsilon closure of a component state, computing it from the
+  // label summary the first time.
+  const EpsilonClosure &GetEpsilonClosure(Label fst_id, StateId s) const {
+    auto &closures = closures_[fst_id];
+    auto it = closures.find(s);
+    if (it == closures.end()) {
+      EpsilonClosure closure;
+      closure.final = label_summary_->EpsilonClosure(
+          *impl_->fst_array_[fst_id], s, MatchInput(), &closure.labels);
+      std::sort(closure.labels.begin(), closure.labels.end());
+      closure.labels.erase(
+          std::unique(closure.labels.begin(), closure.labels.end()),
+          closure.labels.end());
+      it = closures.emplace(s, std::move(closure)).first;
+    }
+    return it->second;
+  }
+
+  // Computes the labels that may be read first from the current state, and
+  // whether it may reach a final state without reading one. The closure of
+  // the component state is extended through the return arcs, up the stack,
+  // for as long as the component may be left without reading a label.
+  void SetReachState() const {
+    if (reach_set_state_) return;
+    reach_set_state_ = true;
+    reach_labels_.clear();
+    reach_final_ = false;
+    if (tuple_.fst_state == kNoStateId) return;
+    const auto &stack =
+        impl_->GetStateTable()->GetStackPrefix(tuple_.prefix_id);
+    auto fst_id = tuple_.fst_id;
+    auto fst_state = tuple_.fst_state;
+    for (auto depth = stack.Depth();;) {
+      const auto &closure = GetEpsilonClosure(fst_id, fst_state);
+      reach_labels_.insert(reach_labels_.end(), closure.labels.begin(),
+                           closure.labels.end());
+      if (!closure.final) break;
+      if (depth == 0) {
+        reach_final_ = true;
+        break;
+      }
+      const auto return_label = label_summary_->ReturnLabel(MatchInput());
+      if (return_label != 0) {
+        reach_labels_.push_back(return_label);
+        break;
+      }
+      const auto &top = stack.prefix_[--depth];
+      fst_id = top.fst_id;
+      fst_state = top.nextstate;
+    }
+    std::sort(reach_labels_.begin(), reach_labels_.end());
+    reach_labels_.erase(std::unique(reach_labels_.begin(), reach_labels_.end()),
+                        reach_labels_.end());
+  }
+
   std::unique_ptr<const ReplaceFst<Arc, StateTable, CacheStore>> owned_fst_;
   const ReplaceFst<Arc, StateTable, CacheStore> &fst_;
   internal::ReplaceFstImpl<Arc, StateTable, CacheStore> *impl_;
+  const ReplaceLabelSummary<Arc> *label_summary_;  // Optional.
   LocalMatcher *current_matcher_;
   std::vector<std::unique_ptr<LocalMatcher>> matcher_;
+  // Epsilon closures of the component states, by component.
+  mutable std::vector<std::unordered_map<StateId, EpsilonClosure>> closures_;
+  mutable std::vector<Label> reach_labels_;  // Look-ahead labels for s_.
+  mutable bool reach_final_;                 // Look-ahead finality for s_.
+  mutable bool reach_set_state_ = false;     // Look-ahead computed for s_?
   StateId s_;             // Current state.
   Label label_;           // Current label.
   MatchType match_type_;  // Supplied by caller.
@@ -20,9 +20,13 @@
 #ifndef FST_RMEPSILON_H_
 #define FST_RMEPSILON_H_
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <stack>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -33,6 +37,7 @@
 #include <fst/connect.h>
 #include <fst/factor-weight.h>
 #include <fst/invert.h>
+#include <fst/parallel.h>
 #include <fst/prune.h>
 #include <fst/queue.h>
 #include <fst/shortest-distance.h>
@@ -51,16 +56,19 @@ struct RmEpsilonOptions
   bool connect;             // Connect output
   Weight weight_threshold;  // Pruning weight threshold.
   StateId state_threshold;  // Pruning state threshold.
+  size_t num_threads;       // Threads computing closures; 0 for all cores.
 
   explicit RmEpsilonOptions(Queue *queue, float delta = kShortestDelta,
                             bool connect = true,
                             Weight weight_threshold = Weight::Zero(),
-                            StateId state_threshold = kNoStateId)
+                            StateId state_threshold = kNoStateId,
+                            size_t num_threads = 1)
       : ShortestDistanceOptions<Arc, Queue, EpsilonArcFilter<Arc>>(
             queue, EpsilonArcFilter<Arc>(), kNoStateId, delta),
         connect(connect),
         weight_threshold(std::move(weight_threshold)),
-        state_threshold(state_threshold) {}
+        state_threshold(state_threshold),
+        num_threads(num_threads) {}
 };
 
 namespace internal {
@@ -193,6 +201,96 @@ void RmEpsilonState<Arc, Queue>::Expand(typename Arc::StateId source) {
   ++expand_id_;
 }
 
+// Number of states whose closures are computed concurrently between updates
+// of the FST in the parallel epsilon removal.
+inline constexpr size_t kRmEpsilonBatchSize = 1024;
+
+// Constructs a queue of the given type for computing the epsilon-closures of
+// the FST with the given distance vector, or returns null if it is not known
+// how to construct one.
+template <class Queue, class Arc>
+std::unique_ptr<Queue> MakeRmEpsilonQueue(
+    const Fst<Arc> &fst, const std::vector<typename Arc::Weight> *distance) {
+  using Weight = typename Arc::Weight;
+  using Filter = EpsilonArcFilter<Arc>;
+  if constexpr (std::is_constructible_v<Queue, const Fst<Arc> &,
+                                        const std::vector<Weight> *, Filter>) {
+    return std::make_unique<Queue>(fst, distance, Filter());
+  } else if constexpr (std::is_constructible_v<Queue,
+                                               const std::vector<Weight> &>) {
+    return std::make_unique<Queue>(*distance);
+  } else if constexpr (std::is_constructible_v<Queue, const Fst<Arc> &,
+                                               Filter>) {
+    return std::make_unique<Queue>(fst, Filter());
+  } else if constexpr (std::is_default_constructible_v<Queue>) {
+    return std::make_unique<Queue>();
+  } else {
+    return nullptr;
+  }
+}
+
+// Replaces the arcs and final weights of the given states, in order, by those
+// of their epsilon-closures, computing the closures of up to
+// kRmEpsilonBatchSize states at a time with opts.num_threads threads. Each
+// thread has its own closure computation state; the first one uses the
+// caller's queue and distance vector. The FST is only modified between
+// batches, so the closures of later batches benefit from the epsilon
+// transitions already removed, as in the sequential algorithm. Returns false
+// on error.
+template <class Arc, class Queue>
+bool ParallelRmEpsilon(MutableFst<Arc> *fst,
+                       std::vector<typename Arc::Weight> *distance,
+                       const RmEpsilonOptions<Arc, Queue> &opts,
+                       const std::vector<typename Arc::StateId> &states) {
+  using Weight = typename Arc::Weight;
+  if (states.empty()) return true;
+  const auto num_threads =
+      std::min(NumWorkerThreads(opts.num_threads), states.size());
+  std::vector<std::vector<Weight>> distances(num_threads - 1);
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::unique_ptr<RmEpsilonState<Arc, Queue>>> rmeps_states;
+  rmeps_states.push_back(
+      std::make_unique<RmEpsilonState<Arc, Queue>>(*fst, distance, opts));
+  for (auto &tdistance : distances) {
+    auto queue = MakeRmEpsilonQueue<Queue>(*fst, &tdistance);
+    if (!queue) break;
+    RmEpsilonOptions<Arc, Queue> topts(opts);
+    topts.state_queue = queue.get();
+    topts.workspace = nullptr;
+    rmeps_states.push_back(
+        std::make_unique<RmEpsilonState<Arc, Queue>>(*fst, &tdistance, topts));
+    queues.push_back(std::move(queue));
+  }
+  if (rmeps_states.size() < num_threads) {
+    VLOG(1) << "RmEpsilon: Cannot construct queues for worker threads";
+  }
+  std::vector<std::vector<Arc>> arcs(kRmEpsilonBatchSize);
+  std::vector<Weight> finals(kRmEpsilonBatchSize);
+  for (size_t begin = 0; begin < states.size(); begin += kRmEpsilonBatchSize) {
+    const auto size = std::min(kRmEpsilonBatchSize, states.size() - begin);
+    ParallelForWithThreadIndex(
+        size, rmeps_states.size(), [&](size_t i, size_t t) {
+          auto &rmeps_state = *rmeps_states[t];
+          rmeps_state.Expand(states[begin + i]);
+          arcs[i].swap(rmeps_state.Arcs());
+          finals[i] = rmeps_state.Final();
+        });
+    for (size_t i = 0; i < size; ++i) {
+      const auto state = states[begin + i];
+      fst->SetFinal(state, finals[i]);
+      fst->DeleteArcs(state);
+      fst->ReserveArcs(state, arcs[i].size());
+      for (auto it = arcs[i].rbegin(); it != arcs[i].rend(); ++it) {
+        fst->AddArc(state, *it);
+      }
+    }
+  }
+  for (const auto &rmeps_state : rmeps_states) {
+    if (rmeps_state->Error()) return false;
+  }
+  return true;
+}
+
 }  // namespace internal
 
 // Removes epsilon-transitions (when both the input and output label are an
@@ -202,7 +300,10 @@ void RmEpsilonState<Arc, Queue>::Expand(typename Arc::StateId source) {
 //
 // The distance vector will be used to hold the shortest distances during the
 // epsilon-closure computation. The state queue discipline and convergence delta
-// are taken in the options argument.
+// are taken in the options argument. When opts.num_threads is not 1, the
+// epsilon-closures are computed in parallel; each additional thread then uses
+// its own queue of the same type, constructed from the FST (see
+// internal::MakeRmEpsilonQueue), and its own distance vector.
 template <class Arc, class Queue>
 void RmEpsilon(MutableFst<Arc> *fst,
                std::vector<typename Arc::Weight> *distance,
@@ -258,24 +359,41 @@ void RmEpsilon(MutableFst<Arc> *fst,
       }
     }
   }
-  internal::RmEpsilonState<Arc, Queue> rmeps_state(*fst, distance, opts);
-  while (!states.empty()) {
-    const auto state = states.back();
-    states.pop_back();
-    if (!noneps_in[state] &&
-        (opts.connect || opts.weight_threshold != Weight::Zero() ||
-         opts.state_threshold != kNoStateId)) {
-      continue;
+  bool error = false;
+  if (opts.num_threads == 1) {
+    internal::RmEpsilonState<Arc, Queue> rmeps_state(*fst, distance, opts);
+    while (!states.empty()) {
+      const auto state = states.back();
+      states.pop_back();
+      if (!noneps_in[state] &&
+          (opts.connect || opts.weight_threshold != Weight::Zero() ||
+           opts.state_threshold != kNoStateId)) {
+        continue;
+      }
+      rmeps_state.Expand(state);
+      fst->SetFinal(state, rmeps_state.Final());
+      fst->DeleteArcs(state);
+      auto &arcs = rmeps_state.Arcs();
+      fst->ReserveArcs(state, arcs.size());
+      while (!arcs.empty()) {
+        fst->AddArc(state, arcs.back());
+        arcs.pop_back();
+      }
     }
-    rmeps_state.Expand(state);
-    fst->SetFinal(state, rmeps_state.Final());
-    fst->DeleteArcs(state);
-    auto &arcs = rmeps_state.Arcs();
-    fst->ReserveArcs(state, arcs.size());
-    while (!arcs.empty()) {
-      fst->AddArc(state, arcs.back());
-      arcs.pop_back();
+    error = rmeps_state.Error();
+  } else {
+    // Expands the same states in the same order as above.
+    std::vector<StateId> expand_states;
+    expand_states.reserve(states.size());
+    for (auto it = states.rbegin(); it != states.rend(); ++it) {
+      if (!noneps_in[*it] &&
+          (opts.connect || opts.weight_threshold != Weight::Zero() ||
+           opts.state_threshold != kNoStateId)) {
+        continue;
+      }
+      expand_states.push_back(*it);
     }
+    error = !internal::ParallelRmEpsilon(fst, distance, opts, expand_states);
   }
   if (opts.connect || opts.weight_threshold != Weight::Zero() ||
       opts.state_threshold != kNoStateId) {
@@ -283,7 +401,7 @@ void RmEpsilon(MutableFst<Arc> *fst,
       if (!noneps_in[s]) fst->DeleteArcs(s);
     }
   }
-  if (rmeps_state.Error()) fst->SetProperties(kError, kError);
+  if (error) fst->SetProperties(kError, kError);
   fst->SetProperties(
       RmEpsilonProperties(fst->Properties(kFstProperties, false)),
       kFstProperties);
@@ -344,16 +462,302 @@ void RmEpsilon(MutableFst<Arc> *fst, bool connect = true,
 
 struct RmEpsilonFstOptions : CacheOptions {
   float delta;
+  // Keeps the epsilon-closures of all states visited during expansion, so
+  // that expansions sharing epsilon subgraphs compute them only once.
+  bool cache_closures;
 
   explicit RmEpsilonFstOptions(const CacheOptions &opts,
-                               float delta = kShortestDelta)
-      : CacheOptions(opts), delta(delta) {}
+                               float delta = kShortestDelta,
+                               bool cache_closures = false)
+      : CacheOptions(opts), delta(delta), cache_closures(cache_closures) {}
 
-  explicit RmEpsilonFstOptions(float delta = kShortestDelta) : delta(delta) {}
+  explicit RmEpsilonFstOptions(float delta = kShortestDelta,
+                               bool cache_closures = false)
+      : delta(delta), cache_closures(cache_closures) {}
 };
 
 namespace internal {
 
+// Memoized epsilon-closures for delayed epsilon removal. The closure of a
+// state, i.e., its arcs and final weight after epsilon removal, is composed
+// from the closures of the states it reaches by epsilon transitions. The
+// states are closed a strongly connected component (SCC) of the epsilon graph
+// at a time, in the order Tarjan's algorithm finishes them, so the closures of
+// all the states leaving a component are known when it is closed. Within a
+// non-trivial component, the epsilon distances between its states are computed
+// with a shortest-distance restricted to the component. The closure of every
+// state visited is kept.
+template <class Arc>
+class RmEpsilonClosureCache {
+ public:
+  using Label = typename Arc::Label;
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  struct Closure {
+    Weight final_weight = Weight::Zero();
+    std::vector<Arc> arcs;
+  };
+
+  RmEpsilonClosureCache(const Fst<Arc> &fst, float delta)
+      : fst_(fst),
+        sd_state_(fst_, &distance_,
+                  ShortestDistanceOptions<Arc, FifoQueue<StateId>,
+                                          ComponentArcFilter>(
+                      &queue_, ComponentArcFilter(&component_, &scc_id_),
+                      kNoStateId, delta),
+                  true) {}
+
+  // Returns the epsilon-closure of the state.
+  const Closure &Find(StateId s) {
+    if (IsCached(s)) {
+      ++hits_;
+    } else {
+      Visit(s);
+    }
+    return *closures_[s];
+  }
+
+  // Number of closures looked up, by Find or when composing a closure, that
+  // were already cached.
+  size_t Hits() const { return hits_; }
+
+  // Number of closures computed.
+  size_t Misses() const { return misses_; }
+
+  bool Error() const { return sd_state_.Error(); }
+
+ private:
+  // Keeps the epsilon transitions within the SCC being closed.
+  class ComponentArcFilter {
+   public:
+    ComponentArcFilter(const std::vector<StateId> *component,
+                       const StateId *scc_id)
+        : component_(component), scc_id_(scc_id) {}
+
+    bool operator()(const Arc &arc) const {
+      return arc.ilabel == 0 && arc.olabel == 0 &&
+             arc.nextstate < component_->size() &&
+             (*component_)[arc.nextstate] == *scc_id_;
+    }
+
+   private:
+    const std::vector<StateId> *component_;
+    const StateId *scc_id_;
+  };
+
+  struct DfsState {
+    DfsState(const Fst<Arc> &fst, StateId state)
+        : state(state), aiter(std::make_unique<ArcIterator<Fst<Arc>>>(fst,
+                                                                      state)) {}
+
+    StateId state;
+    std::unique_ptr<ArcIterator<Fst<Arc>>> aiter;
+  };
+
+  struct Element {
+    Label ilabel;
+    Label olabel;
+    StateId nextstate;
+
+    bool operator==(const Element &element) const {
+      return ilabel == element.ilabel && olabel == element.olabel &&
+             nextstate == element.nextstate;
+    }
+  };
+
+  struct ElementHash {
+    size_t operator()(const Element &element) const {
+      static constexpr size_t prime0 = 7853;
+      static constexpr size_t prime1 = 7867;
+      return static_cast<size_t>(element.nextstate) +
+             static_cast<size_t>(element.ilabel) * prime0 +
+             static_cast<size_t>(element.olabel) * prime1;
+    }
+  };
+
+  static bool IsEpsilon(const Arc &arc) {
+    return arc.ilabel == 0 && arc.olabel == 0;
+  }
+
+  bool IsCached(StateId s) const {
+    return s < closures_.size() && closures_[s] != nullptr;
+  }
+
+  // Grows the per-state vectors to include the state.
+  void Resize(StateId s) {
+    if (s < closures_.size()) return;
+    closures_.resize(s + 1);
+    dfnumber_.resize(s + 1, kNoStateId);
+    lowlink_.resize(s + 1, kNoStateId);
+    onstack_.resize(s + 1, false);
+    component_.resize(s + 1, kNoStateId);
+  }
+
+  void PushState(StateId s) {
+    Resize(s);
+    dfnumber_[s] = lowlink_[s] = nstates_++;
+    onstack_[s] = true;
+    scc_stack_.push_back(s);
+    dfs_stack_.emplace_back(fst_, s);
+  }
+
+  // Starts adding to the closure.
+  void BeginClosure(Closure *closure) {
+    closure->final_weight = Weight::Zero();
+    closure->arcs.clear();
+  }
+
+  // Finishes adding to the closure, removing its arcs from the element map so
+  // that the map only ever holds the arcs of one closure.
+  void EndClosure(const Closure &closure) {
+    for (const auto &arc : closure.arcs) {
+      element_map_.erase(Element{arc.ilabel, arc.olabel, arc.nextstate});
+    }
+  }
+
+  // Adds the arc, weighted on the left, to the closure being built, summing it
+  // with any arc already added with the same labels and destination.
+  void AddArc(const Weight &weight, const Arc &arc, Closure *closure) {
+    const auto [it, success] = element_map_.emplace(
+        Element{arc.ilabel, arc.olabel, arc.nextstate}, closure->arcs.size());
+    if (!success) {
+      auto &sum = closure->arcs[it->second].weight;
+      sum = Plus(sum, Times(weight, arc.weight));
+      return;
+    }
+    closure->arcs.emplace_back(arc.ilabel, arc.olabel,
+                               Times(weight, arc.weight), arc.nextstate);
+  }
+
+  // Adds a closure, weighted on the left, to the closure being built.
+  void AddClosure(const Weight &weight, const Closure &from, Closure *to) {
+    to->final_weight = Plus(to->final_weight, Times(weight, from.final_weight));
+    for (const auto &arc : from.arcs) AddArc(weight, arc, to);
+  }
+
+  void Visit(StateId s);
+
+  void CloseComponent();
+
+  const Fst<Arc> &fst_;
+  std::vector<std::unique_ptr<Closure>> closures_;
+  // Tarjan's algorithm state.
+  std::vector<StateId> dfnumber_;
+  std::vector<StateId> lowlink_;
+  std::vector<bool> onstack_;
+  std::vector<StateId> scc_stack_;
+  std::vector<DfsState> dfs_stack_;
+  StateId nstates_ = 0;
+  // States of the SCC being closed and their closures through the epsilon
+  // transitions leaving it.
+  std::vector<StateId> scc_states_;
+  std::vector<Closure> exit_closures_;
+  // SCC ID of each state, when it is being closed.
+  std::vector<StateId> component_;
+  StateId scc_id_ = 0;
+  // Epsilon distances within the SCC being closed.
+  std::vector<Weight> distance_;
+  FifoQueue<StateId> queue_;
+  ShortestDistanceState<Arc, FifoQueue<StateId>, ComponentArcFilter> sd_state_;
+  // Maps an element to its position in the arcs of the closure being built.
+  std::unordered_map<Element, size_t, ElementHash> element_map_;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+
+  RmEpsilonClosureCache(const RmEpsilonClosureCache &) = delete;
+  RmEpsilonClosureCache &operator=(const RmEpsilonClosureCache &) = delete;
+};
+
+template <class Arc>
+void RmEpsilonClosureCache<Arc>::Visit(StateId s) {
+  PushState(s);
+  while (!dfs_stack_.empty()) {
+    const auto state = dfs_stack_.back().state;
+    auto &aiter = *dfs_stack_.back().aiter;
+    auto nextstate = kNoStateId;
+    for (; !aiter.Done(); aiter.Next()) {
+      const auto &arc = aiter.Value();
+      if (!IsEpsilon(arc) || IsCached(arc.nextstate)) continue;
+      Resize(arc.nextstate);
+      if (dfnumber_[arc.nextstate] == kNoStateId) {
+        nextstate = arc.nextstate;
+        aiter.Next();
+        break;
+      }
+      if (onstack_[arc.nextstate]) {
+        lowlink_[state] = std::min(lowlink_[state], dfnumber_[arc.nextstate]);
+      }
+    }
+    if (nextstate != kNoStateId) {
+      PushState(nextstate);
+      continue;
+    }
+    dfs_stack_.pop_back();
+    if (!dfs_stack_.empty()) {
+      auto &lowlink = lowlink_[dfs_stack_.back().state];
+      lowlink = std::min(lowlink, lowlink_[state]);
+    }
+    if (lowlink_[state] == dfnumber_[state]) {
+      scc_states_.clear();
+      StateId member;
+      do {
+        member = scc_stack_.back();
+        scc_stack_.pop_back();
+        onstack_[member] = false;
+        scc_states_.push_back(member);
+      } while (member != state);
+      CloseComponent();
+    }
+  }
+}
+
+template <class Arc>
+void RmEpsilonClosureCache<Arc>::CloseComponent() {
+  ++scc_id_;
+  for (const auto s : scc_states_) component_[s] = scc_id_;
+  // Computes the closure of each state through the arcs leaving the SCC.
+  bool trivial = scc_states_.size() == 1;
+  exit_closures_.resize(scc_states_.size());
+  for (size_t i = 0; i < scc_states_.size(); ++i) {
+    const auto s = scc_states_[i];
+    auto *closure = &exit_closures_[i];
+    BeginClosure(closure);
+    closure->final_weight = fst_.Final(s);
+    for (ArcIterator<Fst<Arc>> aiter(fst_, s); !aiter.Done(); aiter.Next()) {
+      const auto &arc = aiter.Value();
+      if (!IsEpsilon(arc)) {
+        AddArc(Weight::One(), arc, closure);
+      } else if (component_[arc.nextstate] == scc_id_) {
+        trivial = false;
+      } else {
+        ++hits_;
+        AddClosure(arc.weight, *closures_[arc.nextstate], closure);
+      }
+    }
+    EndClosure(*closure);
+  }
+  misses_ += scc_states_.size();
+  if (trivial) {
+    closures_[scc_states_[0]] =
+        std::make_unique<Closure>(std::move(exit_closures_[0]));
+    return;
+  }
+  // Composes the closure of each state with those of the SCC states it reaches.
+  for (const auto s : scc_states_) {
+    sd_state_.ShortestDistance(s);
+    auto closure = std::make_unique<Closure>();
+    BeginClosure(closure.get());
+    for (size_t i = 0; i < scc_states_.size(); ++i) {
+      const auto t = scc_states_[i];
+      if (t >= distance_.size() || distance_[t] == Weight::Zero()) continue;
+      AddClosure(distance_[t], exit_closures_[i], closure.get());
+    }
+    EndClosure(*closure);
+    closures_[s] = std::move(closure);
+  }
+}
+
 // Implementation of delayed RmEpsilonFst.
 template <class Arc>
 class RmEpsilonFstImpl : public CacheImpl<Arc> {
@@ -384,7 +788,11 @@ class RmEpsilonFstImpl : public CacheImpl<Arc> {
         delta_(opts.delta),
         rmeps_state_(
             *fst_, &distance_,
-            RmEpsilonOptions<Arc, FifoQueue<StateId>>(&queue_, delta_, false)) {
+            RmEpsilonOptions<Arc, FifoQueue<StateId>>(&queue_, delta_, false)),
+        closure_cache_(opts.cache_closures
+                           ? std::make_unique<RmEpsilonClosureCache<Arc>>(
+                                 *fst_, delta_)
+                           : nullptr) {
     SetType("rmepsilon");
     SetProperties(
         RmEpsilonProperties(fst.Properties(kFstProperties, false), true),
@@ -399,7 +807,11 @@ class RmEpsilonFstImpl : public CacheImpl<Arc> {
         delta_(impl.delta_),
         rmeps_state_(
             *fst_, &distance_,
-            RmEpsilonOptions<Arc, FifoQueue<StateId>>(&queue_, delta_, false)) {
+            RmEpsilonOptions<Arc, FifoQueue<StateId>>(&queue_, delta_, false)),
+        closure_cache_(impl.closure_cache_
+                           ? std::make_unique<RmEpsilonClosureCache<Arc>>(
+                                 *fst_, delta_)
+                           : nullptr) {
     SetType("rmepsilon");
     SetProperties(impl.Properties(), kCopyProperties);
     SetInputSymbols(impl.InputSymbols());
@@ -436,7 +848,8 @@ class RmEpsilonFstImpl : public CacheImpl<Arc> {
   // Sets error if found and returns other FST impl properties.
   uint64_t Properties(uint64_t mask) const override {
     if ((mask & kError) &&
-        (fst_->Properties(kError, false) || rmeps_state_.Error())) {
+        (fst_->Properties(kError, false) || rmeps_state_.Error() ||
+         (closure_cache_ && closure_cache_->Error()))) {
       SetProperties(kError, kError);
     }
     return FstImpl<Arc>::Properties(mask);
@@ -447,7 +860,22 @@ class RmEpsilonFstImpl : public CacheImpl<Arc> {
     CacheImpl<Arc>::InitArcIterator(s, data);
   }
 
+  size_t NumClosureCacheHits() const {
+    return closure_cache_ ? closure_cache_->Hits() : 0;
+  }
+
+  size_t NumClosureCacheMisses() const {
+    return closure_cache_ ? closure_cache_->Misses() : 0;
+  }
+
   void Expand(StateId s) {
+    if (closure_cache_) {
+      const auto &closure = closure_cache_->Find(s);
+      SetFinal(s, closure.final_weight);
+      for (const auto &arc : closure.arcs) PushArc(s, arc);
+      SetArcs(s);
+      return;
+    }
     rmeps_state_.Expand(s);
     SetFinal(s, rmeps_state_.Final());
     auto &arcs = rmeps_state_.Arcs();
@@ -464,6 +892,7 @@ class RmEpsilonFstImpl : public CacheImpl<Arc> {
   std::vector<Weight> distance_;
   FifoQueue<StateId> queue_;
   internal::RmEpsilonState<Arc, FifoQueue<StateId>> rmeps_state_;
+  std::unique_ptr<RmEpsilonClosureCache<Arc>> closure_cache_;
 };
 
 }  // namespace internal
@@ -527,6 +956,17 @@ class RmEpsilonFst : public ImplToFst<internal::RmEpsilonFstImpl<A>> {
     GetMutableImpl()->InitArcIterator(s, data);
   }
 
+  // With RmEpsilonFstOptions::cache_closures, returns the number of
+  // epsilon-closures found in the cache and the number computed so far,
+  // respectively; useful to tell whether caching pays off for a given input.
+  size_t NumClosureCacheHits() const {
+    return GetImpl()->NumClosureCacheHits();
+  }
+
+  size_t NumClosureCacheMisses() const {
+    return GetImpl()->NumClosureCacheMisses();
+  }
+
  private:
   using ImplToFst<Impl>::GetImpl;
   using ImplToFst<Impl>::GetMutableImpl;
@@ -0,0 +1,211 @@
+// Copyright 2005-2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Bulk conversion between the arcs of an FST and parallel arrays of arc
+// attributes, one entry per arc, so that callers (e.g., the Python extension)
+// can move many arcs across an API boundary without per-arc objects. Weights
+// are represented by their floating-point value, which suits all the arc types
+// registered with the scripting API.
+
+#ifndef FST_SCRIPT_ARC_ARRAYS_H_
+#define FST_SCRIPT_ARC_ARRAYS_H_
+
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+#include <fst/log.h>
+#include <fst/expanded-fst.h>
+#include <fst/fst.h>
+#include <fst/mutable-fst.h>
+#include <fst/script/arg-packs.h>
+#include <fst/script/fst-class.h>
+
+namespace fst {
+namespace script {
+
+// Arc attribute arrays filled in by GetArcArrays; entry i of each array
+// describes the i-th arc.
+struct ArcArrays {
+  int64_t *states;  // Source states.
+  int64_t *ilabels;
+  int64_t *olabels;
+  double *weights;
+  int64_t *nextstates;
+};
+
+// Arc attribute arrays read by SetArcArrays.
+struct ConstArcArrays {
+  const int64_t *states;  // Source states.
+  const int64_t *ilabels;
+  const int64_t *olabels;
+  const double *weights;
+  const int64_t *nextstates;
+};
+
+namespace internal {
+
+// Calls f(s) for the given state, or for every state if s is kNoStateId.
+template <class Arc, class F>
+void ForEachState(const Fst<Arc> &fst, typename Arc::StateId s, F f) {
+  if (s != kNoStateId) {
+    f(s);
+    return;
+  }
+  for (StateIterator<Fst<Arc>> siter(fst); !siter.Done(); siter.Next()) {
+    f(siter.Value());
+  }
+}
+
+}  // namespace internal
+
+// Returns the number of arcs leaving the state, or the number of arcs in the
+// FST if the state is kNoStateId.
+using FstCountArcsInnerArgs = std::pair<const FstClass &, int64_t>;
+
+using FstCountArcsArgs = WithReturnValue<int64_t, FstCountArcsInnerArgs>;
+
+template <class Arc>
+void CountArcs(FstCountArcsArgs *args) {
+  const Fst<Arc> &fst = *std::get<0>(args->args).GetFst<Arc>();
+  int64_t narcs = 0;
+  internal::ForEachState(fst, std::get<1>(args->args),
+                         [&](typename Arc::StateId s) {
+                           narcs += fst.NumArcs(s);
+                         });
+  args->retval = narcs;
+}
+
+int64_t CountArcs(const FstClass &fst, int64_t state = kNoStateId);
+
+// Returns the number of states in the FST.
+using FstCountStatesArgs = WithReturnValue<int64_t, const FstClass &>;
+
+template <class Arc>
+void CountStates(FstCountStatesArgs *args) {
+  args->retval = fst::CountStates(*args->args.GetFst<Arc>());
+}
+
+int64_t CountStates(const FstClass &fst);
+
+// Writes the arcs leaving the state, or all arcs in state order if the state
+// is kNoStateId, to arrays of the size given by CountArcs.
+using FstGetArcArraysArgs =
+    std::tuple<const FstClass &, int64_t, const ArcArrays &>;
+
+template <class Arc>
+void GetArcArrays(FstGetArcArraysArgs *args) {
+  const Fst<Arc> &fst = *std::get<0>(*args).GetFst<Arc>();
+  const auto &arrays = std::get<2>(*args);
+  int64_t i = 0;
+  internal::ForEachState(
+      fst, std::get<1>(*args), [&](typename Arc::StateId s) {
+        for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done();
+             aiter.Next(), ++i) {
+          const auto &arc = aiter.Value();
+          arrays.states[i] = s;
+          arrays.ilabels[i] = arc.ilabel;
+          arrays.olabels[i] = arc.olabel;
+          arrays.weights[i] = arc.weight.Value();
+          arrays.nextstates[i] = arc.nextstate;
+        }
+      });
+}
+
+void GetArcArrays(const FstClass &fst, int64_t state, const ArcArrays &arrays);
+
+// Writes the final weights of all states to an array of the size given by
+// CountStates.
+using FstGetFinalWeightsArgs = std::pair<const FstClass &, double *>;
+
+template <class Arc>
+void GetFinalWeights(FstGetFinalWeightsArgs *args) {
+  const Fst<Arc> &fst = *std::get<0>(*args).GetFst<Arc>();
+  auto *finals = std::get<1>(*args);
+  for (StateIterator<Fst<Arc>> siter(fst); !siter.Done(); siter.Next()) {
+    const auto s = siter.Value();
+    finals[s] = fst.Final(s).Value();
+  }
+}
+
+void GetFinalWeights(const FstClass &fst, double *finals);
+
+// Replaces the contents of the FST with num_states states, the given start
+// state, final weights (unless null) and num_arcs arcs. Returns false if a
+// state ID is out of range, in which case the FST is left empty. A start state
+// of zero is accepted with no states, giving the empty FST.
+using FstSetArcArraysInnerArgs =
+    std::tuple<MutableFstClass *, int64_t, int64_t, const double *, int64_t,
+               const ConstArcArrays &>;
+
+using FstSetArcArraysArgs = WithReturnValue<bool, FstSetArcArraysInnerArgs>;
+
+template <class Arc>
+void SetArcArrays(FstSetArcArraysArgs *args) {
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+  MutableFst<Arc> *fst = std::get<0>(args->args)->GetMutableFst<Arc>();
+  const StateId num_states = std::get<1>(args->args);
+  StateId start = std::get<2>(args->args);
+  const double *finals = std::get<3>(args->args);
+  const int64_t num_arcs = std::get<4>(args->args);
+  const auto &arrays = std::get<5>(args->args);
+  fst->DeleteStates();
+  args->retval = false;
+  if (num_states == 0 && start == 0) start = kNoStateId;
+  if (num_states < 0 || start < kNoStateId || start >= num_states) {
+    FSTERROR() << "SetArcArrays: Start state out of range: " << start;
+    return;
+  }
+  // Counts the arcs per state first, so that storage is allocated once.
+  std::vector<size_t> counts(num_states, 0);
+  for (int64_t i = 0; i < num_arcs; ++i) {
+    const auto s = arrays.states[i];
+    const auto nextstate = arrays.nextstates[i];
+    if (s < 0 || s >= num_states || nextstate < 0 ||
+        nextstate >= num_states) {
+      FSTERROR() << "SetArcArrays: State ID out of range in arc " << i;
+      return;
+    }
+    ++counts[s];
+  }
+  fst->ReserveStates(num_states);
+  fst->AddStates(num_states);
+  for (StateId s = 0; s < num_states; ++s) fst->ReserveArcs(s, counts[s]);
+  for (int64_t i = 0; i < num_arcs; ++i) {
+    fst->AddArc(arrays.states[i],
+                Arc(arrays.ilabels[i], arrays.olabels[i],
+                    Weight(arrays.weights[i]), arrays.nextstates[i]));
+  }
+  if (finals) {
+    for (StateId s = 0; s < num_states; ++s) {
+      const Weight final_weight(finals[s]);
+      if (final_weight != Weight::Zero()) fst->SetFinal(s, final_weight);
+    }
+  }
+  fst->SetStart(start);
+  args->retval = true;
+}
+
+bool SetArcArrays(MutableFstClass *fst, int64_t num_states, int64_t start,
+                  const double *finals, int64_t num_arcs,
+                  const ConstArcArrays &arrays);
+
+}  // namespace script
+}  // namespace fst
+
+#endif  // FST_SCRIPT_ARC_ARRAYS_H_
@@ -20,6 +20,7 @@
 
 #include <cstdint>
 #include <utility>
+#include <vector>
 
 #include <fst/arcsort.h>
 #include <fst/script/fst-class.h>
@@ -50,6 +51,11 @@ void ArcSort(FstArcSortArgs *args) {
 
 void ArcSort(MutableFstClass *ofst, ArcSortType);
 
+// Batch version, looking up the operation once per run of FSTs with the same
+// arc type. FSTs of an arc type with no such operation get the kError
+// property.
+void ArcSort(const std::vector<MutableFstClass *> &fsts, ArcSortType);
+
 }  // namespace script
 }  // namespace fst
 
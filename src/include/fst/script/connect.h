@@ -18,6 +18,8 @@
 #ifndef FST_SCRIPT_CONNECT_H_
 #define FST_SCRIPT_CONNECT_H_
 
+#include <vector>
+
 #include <fst/connect.h>
 #include <fst/script/fst-class.h>
 
@@ -31,6 +33,11 @@ void Connect(MutableFstClass *fst) {
 
 void Connect(MutableFstClass *fst);
 
+// Batch version, looking up the operation once per run of FSTs with the same
+// arc type. FSTs of an arc type with no such operation get the kError
+// property.
+void Connect(const std::vector<MutableFstClass *> &fsts);
+
 }  // namespace script
 }  // namespace fst
 
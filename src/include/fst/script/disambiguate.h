@@ -18,6 +18,7 @@
 #ifndef FST_SCRIPT_DISAMBIGUATE_H_
 #define FST_SCRIPT_DISAMBIGUATE_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <tuple>
 #include <utility>
@@ -34,14 +35,16 @@ struct DisambiguateOptions {
   const WeightClass &weight_threshold;
   const int64_t state_threshold;
   const int64_t subsequential_label;
+  const size_t num_threads;
 
   DisambiguateOptions(float delta, const WeightClass &weight_threshold,
                       int64_t state_threshold = kNoStateId,
-                      int64_t subsequential_label = 0)
+                      int64_t subsequential_label = 0, size_t num_threads = 1)
       : delta(delta),
         weight_threshold(weight_threshold),
         state_threshold(state_threshold),
-        subsequential_label(subsequential_label) {}
+        subsequential_label(subsequential_label),
+        num_threads(num_threads) {}
 };
 
 using FstDisambiguateArgs = std::tuple<const FstClass &, MutableFstClass *,
@@ -56,7 +59,8 @@ void Disambiguate(FstDisambiguateArgs *args) {
   const auto weight_threshold = *opts.weight_threshold.GetWeight<Weight>();
   const fst::DisambiguateOptions<Arc> disargs(opts.delta, weight_threshold,
                                                   opts.state_threshold,
-                                                  opts.subsequential_label);
+                                                  opts.subsequential_label,
+                                                  opts.num_threads);
   Disambiguate(ifst, ofst, disargs);
 }
 
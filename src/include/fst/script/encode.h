@@ -18,6 +18,7 @@
 #ifndef FST_SCRIPT_ENCODE_H_
 #define FST_SCRIPT_ENCODE_H_
 
+#include <cstddef>
 #include <tuple>
 #include <utility>
 
@@ -28,16 +29,18 @@
 namespace fst {
 namespace script {
 
-using FstEncodeArgs = std::tuple<MutableFstClass *, EncodeMapperClass *>;
+using FstEncodeArgs =
+    std::tuple<MutableFstClass *, EncodeMapperClass *, size_t>;
 
 template <class Arc>
 void Encode(FstEncodeArgs *args) {
   MutableFst<Arc> *fst = std::get<0>(*args)->GetMutableFst<Arc>();
   EncodeMapper<Arc> *mapper = std::get<1>(*args)->GetEncodeMapper<Arc>();
-  Encode(fst, mapper);
+  Encode(fst, mapper, std::get<2>(*args));
 }
 
-void Encode(MutableFstClass *fst, EncodeMapperClass *mapper);
+void Encode(MutableFstClass *fst, EncodeMapperClass *mapper,
+            size_t num_threads = 1);
 
 }  // namespace script
 }  // namespace fst
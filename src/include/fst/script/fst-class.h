@@ -76,7 +76,9 @@ class FstClassImplBase : public FstClassBase {
   virtual bool AddArc(int64_t, const ArcClass &) = 0;
   virtual int64_t AddState() = 0;
   virtual void AddStates(size_t) = 0;
-  virtual FstClassImplBase *Copy() = 0;
+  // If safe is true, the copy may be used in a different thread than the
+  // original (see Fst::Copy).
+  virtual FstClassImplBase *Copy(bool safe = false) = 0;
   virtual bool DeleteArcs(int64_t, size_t) = 0;
   virtual bool DeleteArcs(int64_t) = 0;
   virtual bool DeleteStates(const std::vector<int64_t> &) = 0;
@@ -131,7 +133,9 @@ class FstClassImpl : public FstClassImplBase {
 
   const std::string &ArcType() const final { return Arc::Type(); }
 
-  FstClassImpl *Copy() final { return new FstClassImpl<Arc>(*impl_); }
+  FstClassImpl *Copy(bool safe = false) final {
+    return new FstClassImpl<Arc>(std::unique_ptr<Fst<Arc>>(impl_->Copy(safe)));
+  }
 
   // Warning: calling this method casts the FST to a mutable FST.
   bool DeleteArcs(int64_t s, size_t n) final {
@@ -313,6 +317,11 @@ class FstClass : public FstClassBase {
   FstClass(const FstClass &other)
       : impl_(other.impl_ == nullptr ? nullptr : other.impl_->Copy()) {}
 
+  // If safe is true, the copy may be used in a different thread than the
+  // original, even when the underlying FST has a shared cache.
+  FstClass(const FstClass &other, bool safe)
+      : impl_(other.impl_ == nullptr ? nullptr : other.impl_->Copy(safe)) {}
+
   FstClass &operator=(const FstClass &other) {
     impl_.reset(other.impl_ == nullptr ? nullptr : other.impl_->Copy());
     return *this;
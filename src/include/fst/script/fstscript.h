@@ -45,6 +45,7 @@
 #include <fst/script/script-impl.h>
 
 // Operations.
+#include <fst/script/arc-arrays.h>
 #include <fst/script/arcsort.h>
 #include <fst/script/closure.h>
 #include <fst/script/compile.h>
@@ -74,6 +75,7 @@
 #include <fst/script/randequivalent.h>
 #include <fst/script/randgen.h>
 #include <fst/script/relabel.h>
+#include <fst/script/reorder.h>
 #include <fst/script/replace.h>
 #include <fst/script/reverse.h>
 #include <fst/script/reweight.h>
@@ -150,6 +152,7 @@ class AllFstOperationsRegisterer {
     REGISTER_FST_OPERATION(ShortestDistance, Arc, FstShortestDistanceArgs2);
     REGISTER_FST_OPERATION(ShortestDistance, Arc, FstShortestDistanceArgs3);
     REGISTER_FST_OPERATION(ShortestPath, Arc, FstShortestPathArgs);
+    REGISTER_FST_OPERATION(StateReorder, Arc, FstStateReorderArgs);
     REGISTER_FST_OPERATION(Synchronize, Arc, FstSynchronizeArgs);
     REGISTER_FST_OPERATION(TopSort, Arc, FstTopSortArgs);
     REGISTER_FST_OPERATION(Union, Arc, FstUnionArgs1);
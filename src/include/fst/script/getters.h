@@ -33,6 +33,7 @@
 #include <fst/push.h>               // For kPushWeights (etc.).
 #include <fst/queue.h>              // For QueueType.
 #include <fst/rational.h>           // For ClosureType.
+#include <fst/reorder.h>            // For StateReorderType.
 #include <fst/string.h>             // For TokenType.
 #include <fst/script/arcfilter-impl.h>  // For ArcFilterType.
 #include <fst/script/arcsort.h>         // For ArcSortType.
@@ -82,6 +83,8 @@ bool GetReplaceLabelType(std::string_view str, bool epsilon_on_replace,
 
 bool GetReweightType(std::string_view str, ReweightType *reweight_type);
 
+bool GetStateReorderType(std::string_view str, StateReorderType *reorder_type);
+
 bool GetTokenType(std::string_view str, TokenType *token_type);
 
 }  // namespace script
@@ -18,9 +18,11 @@
 #ifndef FST_SCRIPT_PRUNE_H_
 #define FST_SCRIPT_PRUNE_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include <fst/prune.h>
 #include <fst/script/fst-class.h>
@@ -46,8 +48,8 @@ void Prune(FstPruneArgs1 *args) {
   }
 }
 
-using FstPruneArgs2 =
-    std::tuple<MutableFstClass *, const WeightClass &, int64_t, float>;
+using FstPruneArgs2 = std::tuple<MutableFstClass *, const WeightClass &,
+                                 int64_t, float, size_t>;
 
 template <class Arc>
 void Prune(FstPruneArgs2 *args) {
@@ -55,7 +57,8 @@ void Prune(FstPruneArgs2 *args) {
   MutableFst<Arc> *fst = std::get<0>(*args)->GetMutableFst<Arc>();
   if constexpr (IsPath<Weight>::value) {
     const auto weight_threshold = *std::get<1>(*args).GetWeight<Weight>();
-    Prune(fst, weight_threshold, std::get<2>(*args), std::get<3>(*args));
+    Prune(fst, weight_threshold, std::get<2>(*args), std::get<3>(*args),
+          std::get<4>(*args));
   } else {
     FSTERROR() << "Prune: Weight must have path property: " << Weight::Type();
     fst->SetProperties(kError, kError);
@@ -67,6 +70,14 @@ void Prune(const FstClass &ifst, MutableFstClass *ofst,
            int64_t state_threshold = kNoStateId, float delta = kDelta);
 
 void Prune(MutableFstClass *fst, const WeightClass &weight_threshold,
+           int64_t state_threshold = kNoStateId, float delta = kDelta,
+           size_t num_threads = 1);
+
+// Batch version of the above, looking up the operation once per run of FSTs
+// with the same arc type. FSTs whose weight type differs from that of the
+// threshold, or of an arc type with no such operation, get the kError property.
+void Prune(const std::vector<MutableFstClass *> &fsts,
+           const WeightClass &weight_threshold,
            int64_t state_threshold = kNoStateId, float delta = kDelta);
 
 }  // namespace script
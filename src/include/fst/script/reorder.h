@@ -0,0 +1,84 @@
+// Copyright 2005-2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+
+#ifndef FST_SCRIPT_REORDER_H_
+#define FST_SCRIPT_REORDER_H_
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <tuple>
+
+#include <fst/randgen.h>
+#include <fst/reorder.h>
+#include <fst/script/fst-class.h>
+#include <fst/script/script-impl.h>
+
+namespace fst {
+namespace script {
+
+using FstStateReorderArgs =
+    std::tuple<MutableFstClass *,
+               const StateReorderOptions<RandArcSelection> &, uint64_t>;
+
+template <class Arc>
+void StateReorder(FstStateReorderArgs *args) {
+  MutableFst<Arc> *fst = std::get<0>(*args)->GetMutableFst<Arc>();
+  const auto &opts = std::get<1>(*args);
+  const uint64_t seed = std::get<2>(*args);
+  switch (opts.selector) {
+    case RandArcSelection::UNIFORM: {
+      const StateReorderOptions<UniformArcSelector<Arc>> ropts(
+          opts.type, UniformArcSelector<Arc>(seed), opts.npath,
+          opts.max_length);
+      StateReorder(fst, ropts);
+      return;
+    }
+    case RandArcSelection::FAST_LOG_PROB: {
+      const StateReorderOptions<FastLogProbArcSelector<Arc>> ropts(
+          opts.type, FastLogProbArcSelector<Arc>(seed), opts.npath,
+          opts.max_length);
+      StateReorder(fst, ropts);
+      return;
+    }
+    case RandArcSelection::LOG_PROB: {
+      const StateReorderOptions<LogProbArcSelector<Arc>> ropts(
+          opts.type, LogProbArcSelector<Arc>(seed), opts.npath,
+          opts.max_length);
+      StateReorder(fst, ropts);
+      return;
+    }
+  }
+}
+
+void StateReorder(MutableFstClass *fst,
+                  const StateReorderOptions<RandArcSelection> &opts =
+                      StateReorderOptions<RandArcSelection>(
+                          StateReorderType::BFS, RandArcSelection::UNIFORM),
+                  uint64_t seed = std::random_device()());
+
+// Returns a copy of the FST with its states renumbered, of the same FST type as
+// the input, so that a ConstFst or CompactFst keeps its type with its state and
+// arc arrays in the new order; returns nullptr if it cannot be converted back.
+std::unique_ptr<FstClass> StateReorder(
+    const FstClass &fst, const StateReorderOptions<RandArcSelection> &opts,
+    uint64_t seed = std::random_device()());
+
+}  // namespace script
+}  // namespace fst
+
+#endif  // FST_SCRIPT_REORDER_H_
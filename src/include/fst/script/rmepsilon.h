@@ -18,6 +18,7 @@
 #ifndef FST_SCRIPT_RMEPSILON_H_
 #define FST_SCRIPT_RMEPSILON_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <utility>
 #include <vector>
@@ -36,15 +37,18 @@ struct RmEpsilonOptions : public ShortestDistanceOptions {
   const bool connect;
   const WeightClass &weight_threshold;
   const int64_t state_threshold;
+  const size_t num_threads;
 
   RmEpsilonOptions(QueueType queue_type, bool connect,
                    const WeightClass &weight_threshold,
-                   int64_t state_threshold = kNoStateId, float delta = kDelta)
+                   int64_t state_threshold = kNoStateId, float delta = kDelta,
+                   size_t num_threads = 1)
       : ShortestDistanceOptions(queue_type, ArcFilterType::EPSILON, kNoStateId,
                                 delta),
         connect(connect),
         weight_threshold(weight_threshold),
-        state_threshold(state_threshold) {}
+        state_threshold(state_threshold),
+        num_threads(num_threads) {}
 };
 
 namespace internal {
@@ -58,7 +62,8 @@ void RmEpsilon(MutableFst<Arc> *fst,
   using Weight = typename Arc::Weight;
   const fst::RmEpsilonOptions<Arc, Queue> ropts(
       queue, opts.delta, opts.connect,
-      *opts.weight_threshold.GetWeight<Weight>(), opts.state_threshold);
+      *opts.weight_threshold.GetWeight<Weight>(), opts.state_threshold,
+      opts.num_threads);
   RmEpsilon(fst, distance, ropts);
 }
 
@@ -240,6 +240,13 @@ void ShortestDistance(const FstClass &ifst, std::vector<WeightClass> *distance,
 WeightClass ShortestDistance(const FstClass &ifst,
                              double delta = fst::kShortestDelta);
 
+// Batch version of the above, computing the shortest distance of each FST;
+// looks up the operation once per run of FSTs with the same arc type. The
+// distance of an FST of an arc type with no such operation has no weight type.
+void ShortestDistance(const std::vector<const FstClass *> &fsts,
+                      std::vector<WeightClass> *distances,
+                      double delta = fst::kShortestDelta);
+
 }  // namespace script
 }  // namespace fst
 
@@ -38,6 +38,22 @@ namespace fst {
 // A representable float for shortest distance and shortest path algorithms.
 inline constexpr float kShortestDelta = 1e-6;
 
+// Scratch space for the shortest-distance algorithm. Passing the same
+// workspace to repeated calls (e.g., on many small FSTs) lets them reuse its
+// per-state buffers rather than allocating them anew each time; the distance
+// vector and the queue, which are supplied by the caller, can likewise be
+// reused. A workspace may only be used by one computation at a time.
+template <class Arc>
+struct ShortestDistanceWorkspace {
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  std::vector<Adder<Weight>> adder;   // Sums distance accurately.
+  std::vector<Adder<Weight>> radder;  // Relaxation distance.
+  std::vector<bool> enqueued;         // Is state enqueued?
+  std::vector<StateId> sources;       // Source ID for ith state, if retained.
+};
+
 template <class Arc, class Queue, class ArcFilter>
 struct ShortestDistanceOptions {
   using StateId = typename Arc::StateId;
@@ -55,15 +71,19 @@ struct ShortestDistanceOptions {
                          // queue discipline is shortest-first and all the
                          // weights in the FST are between One() and Zero()
                          // according to NaturalLess.
+  ShortestDistanceWorkspace<Arc> *workspace;  // If non-null, scratch space to
+                                              // use; owned by caller.
 
   ShortestDistanceOptions(Queue *state_queue, ArcFilter arc_filter,
                           StateId source = kNoStateId,
-                          float delta = kShortestDelta, bool first_path = false)
+                          float delta = kShortestDelta, bool first_path = false,
+                          ShortestDistanceWorkspace<Arc> *workspace = nullptr)
       : state_queue(state_queue),
         arc_filter(arc_filter),
         source(source),
         delta(delta),
-        first_path(first_path) {}
+        first_path(first_path),
+        workspace(workspace) {}
 };
 
 namespace internal {
@@ -92,9 +112,18 @@ class ShortestDistanceState {
         weight_equal_(opts.delta),
         first_path_(opts.first_path),
         retain_(retain),
+        workspace_(opts.workspace ? opts.workspace : &own_workspace_),
+        adder_(workspace_->adder),
+        radder_(workspace_->radder),
+        enqueued_(workspace_->enqueued),
+        sources_(workspace_->sources),
         source_id_(0),
         error_(false) {
     distance_->clear();
+    adder_.clear();
+    radder_.clear();
+    enqueued_.clear();
+    sources_.clear();
     if (fst.Properties(kExpanded, false) == kExpanded) {
       const auto num_states = CountStates(fst);
       distance_->reserve(num_states);
@@ -104,6 +133,9 @@ class ShortestDistanceState {
     }
   }
 
+  ShortestDistanceState(const ShortestDistanceState &) = delete;
+  ShortestDistanceState &operator=(const ShortestDistanceState &) = delete;
+
   void ShortestDistance(StateId source);
 
   bool Error() const { return error_; }
@@ -134,12 +166,14 @@ class ShortestDistanceState {
   const bool first_path_;
   const bool retain_;  // Retain and reuse information across calls.
 
-  std::vector<Adder<Weight>> adder_;   // Sums distance_ accurately.
-  std::vector<Adder<Weight>> radder_;  // Relaxation distance.
-  std::vector<bool> enqueued_;         // Is state enqueued?
-  std::vector<StateId> sources_;       // Source ID for ith state in distance_,
-                                       // (r)adder_, and enqueued_ if retained.
-  StateId source_id_;                  // Unique ID characterizing each call.
+  ShortestDistanceWorkspace<Arc> own_workspace_;  // Used if none is given.
+  ShortestDistanceWorkspace<Arc> *workspace_;
+  std::vector<Adder<Weight>> &adder_;   // Sums distance_ accurately.
+  std::vector<Adder<Weight>> &radder_;  // Relaxation distance.
+  std::vector<bool> &enqueued_;         // Is state enqueued?
+  std::vector<StateId> &sources_;  // Source ID for ith state in distance_,
+                                   // (r)adder_, and enqueued_ if retained.
+  StateId source_id_;              // Unique ID characterizing each call.
   bool error_;
 };
 
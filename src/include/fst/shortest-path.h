@@ -20,8 +20,10 @@
 #ifndef FST_SHORTEST_PATH_H_
 #define FST_SHORTEST_PATH_H_
 
+#include <algorithm>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -518,6 +520,224 @@ void ShortestPath(const Fst<Arc> &ifst, MutableFst<Arc> *ofst,
   ShortestPath(ifst, ofst, &distance, opts);
 }
 
+// Lazy k-shortest-paths iterator. Whereas ShortestPath builds all n shortest
+// paths into an FST, this enumerates the successful paths of the input FST
+// one at a time, in order of increasing weight w.r.t. the natural semiring
+// order, so that callers can stop whenever they like without choosing n in
+// advance or materializing the paths.
+//
+// It runs the search of the n-shortest-path algorithm (see NShortestPath
+// above) on demand. After the shortest distances are computed, each call to
+// Next() pops partial paths from a heap ordered by their weight times the
+// shortest distance to completion, expanding them until the next complete path
+// is found. Since the shortest distances are exact, complete paths come off
+// the heap in order, and the work done is roughly proportional to the number
+// and length of the paths enumerated so far.
+//
+// When unique is true, only the best path for each distinct input string is
+// returned, by searching a lazily-determinized FST as ShortestPath does; the
+// input must then be an acceptor (epsilons are treated as regular symbols),
+// and the weights of the individual arcs of a path (though not their product)
+// may differ from those in the input.
+//
+// The weights need to be left and right distributive (kSemiring) and have the
+// path (kPath) property. Arc weights must satisfy the property that the sum of
+// the weights of one or more paths from some state S to T is never Zero().
+template <class Arc>
+class ShortestPathIterator {
+ public:
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+  using RevArc = ReverseArc<Arc>;
+
+  explicit ShortestPathIterator(const Fst<Arc> &ifst, bool unique = false,
+                                float delta = kShortestDelta)
+      : compare_(pairs_, unique ? udistance_ : distance_, delta) {
+    static_assert((Weight::Properties() & kPath) == kPath,
+                  "Weight must have path property.");
+    static_assert((Weight::Properties() & kSemiring) == kSemiring,
+                  "Weight must be distributive.");
+    if (ifst.Properties(kError, false)) error_ = true;
+    ShortestDistance(ifst, &distance_, false, delta);
+    if (distance_.size() == 1 && !distance_[0].Member()) {
+      error_ = true;
+      done_ = true;
+      return;
+    }
+    // As in ShortestPath, the search runs over the reverse of the input, so
+    // the distance from its superinitial state is added at the front.
+    Reverse(ifst, &rfst_);
+    auto d = Weight::Zero();
+    for (ArcIterator<VectorFst<RevArc>> aiter(rfst_, 0); !aiter.Done();
+         aiter.Next()) {
+      const auto &arc = aiter.Value();
+      const auto state = arc.nextstate - 1;
+      if (state < distance_.size()) {
+        d = Plus(d, Times(arc.weight.Reverse(), distance_[state]));
+      }
+    }
+    distance_.insert(distance_.begin(), d);
+    if (unique) {
+      const DeterminizeFstOptions<RevArc> dopts(delta);
+      dfst_ = std::make_unique<DeterminizeFst<RevArc>>(rfst_, &distance_,
+                                                       &udistance_, dopts);
+      if (dfst_->Properties(kError, false)) error_ = true;
+    }
+    const auto start = SearchFst().Start();
+    if (!error_ && start != kNoStateId) {
+      AddNode(start, Weight::One(), kNoNode,
+              RevArc(0, 0, RevArc::Weight::One(), start));
+    }
+    Next();
+  }
+
+  // Returns true when there are no more paths.
+  bool Done() const { return done_; }
+
+  // Advances to the next shortest path.
+  void Next() {
+    while (!heap_.empty()) {
+      std::pop_heap(heap_.begin(), heap_.end(), compare_);
+      const auto node = heap_.back();
+      heap_.pop_back();
+      const auto [state, weight] = pairs_[node];
+      if (state == kNoStateId) {
+        SetPath(node);
+        return;
+      }
+      const auto &search = SearchFst();
+      for (ArcIterator<Fst<RevArc>> aiter(search, state); !aiter.Done();
+           aiter.Next()) {
+        const auto &arc = aiter.Value();
+        AddNode(arc.nextstate, Times(arc.weight.Reverse(), weight), node, arc);
+      }
+      const auto final_weight = search.Final(state).Reverse();
+      if (final_weight != Weight::Zero()) {
+        AddNode(kNoStateId, Times(final_weight, weight), node,
+                RevArc(0, 0, final_weight.Reverse(), kNoStateId));
+      }
+    }
+    done_ = true;
+    arcs_.clear();
+  }
+
+  // The arcs of the current path, from the initial state, with the
+  // destination states they have in the input FST (or kNoStateId if unique
+  // paths were requested).
+  const std::vector<Arc> &Arcs() const { return arcs_; }
+
+  // The weight of the current path, including the final weight.
+  const Weight &PathWeight() const { return weight_; }
+
+  // Returns true if an error was encountered, in which case Done() is true.
+  bool Error() const { return error_; }
+
+ private:
+  static constexpr size_t kNoNode = -1;
+
+  // Heap order on partial paths, by their weight times the shortest distance
+  // to completion. Unlike ShortestPathCompare, complete paths win ties, so
+  // that a path is returned as soon as it is known to be among the best; this
+  // also ensures progress when there are infinitely many paths of equal
+  // weight (e.g., with cycles of weight One()).
+  class Compare {
+   public:
+    Compare(const std::vector<std::pair<StateId, Weight>> &pairs,
+            const std::vector<Weight> &distance, float delta)
+        : pairs_(pairs), distance_(distance), delta_(delta) {}
+
+    bool operator()(size_t x, size_t y) const {
+      const auto &px = pairs_[x];
+      const auto &py = pairs_[y];
+      const auto wx = Times(Distance(px.first), px.second);
+      const auto wy = Times(Distance(py.first), py.second);
+      if (px.first == kNoStateId && py.first != kNoStateId) {
+        return less_(wy, wx) && !ApproxEqual(wx, wy, delta_);
+      } else if (py.first == kNoStateId && px.first != kNoStateId) {
+        return less_(wy, wx) || ApproxEqual(wx, wy, delta_);
+      } else {
+        return less_(wy, wx);
+      }
+    }
+
+   private:
+    // Nodes are only added for states with a known, non-Zero() distance.
+    Weight Distance(StateId state) const {
+      return state == kNoStateId ? Weight::One() : distance_[state];
+    }
+
+    const std::vector<std::pair<StateId, Weight>> &pairs_;
+    const std::vector<Weight> &distance_;
+    const float delta_;
+    const NaturalLess<Weight> less_;
+  };
+
+  const Fst<RevArc> &SearchFst() const {
+    return dfst_ ? static_cast<const Fst<RevArc> &>(*dfst_) : rfst_;
+  }
+
+  // Adds a partial path, extending that of the parent by the (reverse) arc,
+  // to the heap, unless it cannot be completed.
+  void AddNode(StateId state, Weight weight, size_t parent, const RevArc &arc) {
+    if (state != kNoStateId) {
+      const auto &distance = dfst_ ? udistance_ : distance_;
+      if (state >= distance.size() || distance[state] == Weight::Zero()) return;
+    }
+    const auto node = pairs_.size();
+    pairs_.emplace_back(state, std::move(weight));
+    parents_.push_back(parent);
+    rarcs_.push_back(arc);
+    heap_.push_back(node);
+    std::push_heap(heap_.begin(), heap_.end(), compare_);
+  }
+
+  // Reads the complete path ending in the node off the search tree. The path
+  // runs backwards in the reverse FST, so following parents from the node
+  // visits the arcs of the input FST in order; the first step carries the
+  // residual weight (if any) at the initial state, and the last the final
+  // weight.
+  void SetPath(size_t node) {
+    arcs_.clear();
+    weight_ = rarcs_[node].weight.Reverse();
+    for (auto n = parents_[node]; parents_[n] != kNoNode; n = parents_[n]) {
+      const auto parent = parents_[n];
+      const auto &rarc = rarcs_[n];
+      if (parents_[parent] == kNoNode) {
+        // Arc from the superinitial state of the reverse FST.
+        weight_ = Times(weight_, rarc.weight.Reverse());
+        break;
+      }
+      const auto nextstate = dfst_ ? kNoStateId : pairs_[parent].first - 1;
+      arcs_.emplace_back(rarc.ilabel, rarc.olabel, rarc.weight.Reverse(),
+                         nextstate);
+      weight_ = Times(weight_, arcs_.back().weight);
+    }
+  }
+
+  VectorFst<RevArc> rfst_;
+  std::unique_ptr<DeterminizeFst<RevArc>> dfst_;
+  // Shortest distances from the initial state in the input FST, preceded by
+  // that of the superinitial state in the reverse FST.
+  std::vector<Weight> distance_;
+  std::vector<Weight> udistance_;  // Same for the determinized FST.
+  // Search tree: each node is a partial path, given by the state it reaches
+  // in the search FST (kNoStateId once complete) and its weight (that of a
+  // suffix of a path in the input FST), its parent and the arc taken from the
+  // parent.
+  std::vector<std::pair<StateId, Weight>> pairs_;
+  std::vector<size_t> parents_;
+  std::vector<RevArc> rarcs_;
+  std::vector<size_t> heap_;
+  const Compare compare_;
+  std::vector<Arc> arcs_;
+  Weight weight_ = Weight::Zero();
+  bool done_ = false;
+  bool error_ = false;
+
+  ShortestPathIterator(const ShortestPathIterator &) = delete;
+  ShortestPathIterator &operator=(const ShortestPathIterator &) = delete;
+};
+
 }  // namespace fst
 
 #endif  // FST_SHORTEST_PATH_H_
@@ -21,6 +21,8 @@
 #ifndef FST_STATE_REACHABLE_H_
 #define FST_STATE_REACHABLE_H_
 
+#include <algorithm>
+#include <cstddef>
 #include <vector>
 
 #include <fst/log.h>
@@ -29,6 +31,7 @@
 #include <fst/dfs-visit.h>
 #include <fst/fst.h>
 #include <fst/interval-set.h>
+#include <fst/parallel.h>
 #include <fst/vector-fst.h>
 
 
@@ -129,10 +132,73 @@ class IntervalReachVisitor {
   bool error_;
 };
 
+// Assigns the same final state indices as IntervalReachVisitor, when its
+// state2index map is empty, and records the states in finish order, which is a
+// reverse topological order of the (acyclic) input. The interval sets can then
+// be computed from this in any order that visits successors first.
+template <class Arc, class I = typename Arc::StateId>
+class ReachIndexVisitor {
+ public:
+  using StateId = typename Arc::StateId;
+  using Weight = typename Arc::Weight;
+
+  using Index = I;
+
+  ReachIndexVisitor(const Fst<Arc> &fst, std::vector<Index> *state2index,
+                    std::vector<StateId> *finish)
+      : fst_(fst),
+        state2index_(state2index),
+        finish_(finish),
+        index_(1),
+        error_(false) {
+    state2index_->clear();
+    finish_->clear();
+  }
+
+  void InitVisit(const Fst<Arc> &) { error_ = false; }
+
+  bool InitState(StateId s, StateId r) {
+    while (state2index_->size() <= s) state2index_->push_back(-1);
+    if (fst_.Final(s) != Weight::Zero()) (*state2index_)[s] = index_++;
+    return true;
+  }
+
+  constexpr bool TreeArc(StateId, const Arc &) const { return true; }
+
+  bool BackArc(StateId s, const Arc &arc) {
+    FSTERROR() << "ReachIndexVisitor: Cyclic input";
+    error_ = true;
+    return false;
+  }
+
+  constexpr bool ForwardOrCrossArc(StateId, const Arc &) const { return true; }
+
+  void FinishState(StateId s, StateId p, const Arc *) { finish_->push_back(s); }
+
+  void FinishVisit() {}
+
+  bool Error() const { return error_; }
+
+ private:
+  const Fst<Arc> &fst_;
+  std::vector<Index> *state2index_;
+  std::vector<StateId> *finish_;
+  Index index_;
+  bool error_;
+};
+
+// Number of states whose interval sets are computed by one task in the
+// multi-threaded StateReachable.
+inline constexpr size_t kStateReachableChunkSize = 64;
+
 // Tests reachability of final states from a given state. To test for
 // reachability from a state s, first do SetState(s). Then a final state f can
 // be reached from state s of FST iff Reach(f) is true. The input can be cyclic,
 // but no cycle may contain a final state.
+//
+// The interval sets can be computed with several threads (zero requests one
+// per hardware thread); the result is the same as with one thread. The input
+// must then support concurrent reads.
 template <class Arc, class I = typename Arc::StateId, class S = IntervalSet<I>>
 class StateReachable {
  public:
@@ -144,7 +210,8 @@ class StateReachable {
   using ISet = S;
   using Interval = typename ISet::Interval;
 
-  explicit StateReachable(const Fst<Arc> &fst) : error_(false) {
+  explicit StateReachable(const Fst<Arc> &fst, size_t num_threads = 1)
+      : num_threads_(num_threads), error_(false) {
     if (fst.Properties(kAcyclic, true)) {
       AcyclicStateReachable(fst);
     } else {
@@ -184,18 +251,78 @@ class StateReachable {
 
  private:
   void AcyclicStateReachable(const Fst<Arc> &fst) {
+    if (NumWorkerThreads(num_threads_) > 1) {
+      ParallelAcyclicStateReachable(fst);
+      return;
+    }
     IntervalReachVisitor<Arc, StateId, ISet> reach_visitor(fst, &isets_,
                                                            &state2index_);
     DfsVisit(fst, &reach_visitor);
     if (reach_visitor.Error()) error_ = true;
   }
 
+  // The interval set of a state is the union of its own tree interval, if
+  // final, and those of its successors. The states are grouped by their height
+  // (the length of the longest path to a state without arcs), and the sets of
+  // the states of each height are computed in parallel, lowest first.
+  void ParallelAcyclicStateReachable(const Fst<Arc> &fst) {
+    std::vector<StateId> finish;
+    ReachIndexVisitor<Arc, Index> index_visitor(fst, &state2index_, &finish);
+    DfsVisit(fst, &index_visitor);
+    if (index_visitor.Error()) {
+      error_ = true;
+      return;
+    }
+    isets_.clear();
+    isets_.resize(state2index_.size());
+    // Finds the heights and sorts the states by height.
+    std::vector<size_t> height(state2index_.size(), 0);
+    std::vector<size_t> offsets;
+    for (const auto s : finish) {
+      for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done(); aiter.Next()) {
+        height[s] = std::max(height[s], height[aiter.Value().nextstate] + 1);
+      }
+      if (height[s] + 1 >= offsets.size()) offsets.resize(height[s] + 2, 0);
+      ++offsets[height[s] + 1];
+    }
+    for (size_t h = 1; h < offsets.size(); ++h) offsets[h] += offsets[h - 1];
+    std::vector<StateId> order(finish.size());
+    {
+      auto next = offsets;
+      for (const auto s : finish) order[next[height[s]]++] = s;
+    }
+    for (size_t h = 0; h + 1 < offsets.size(); ++h) {
+      const auto begin = offsets[h];
+      const auto end = offsets[h + 1];
+      const auto num_chunks = (end - begin + kStateReachableChunkSize - 1) /
+                              kStateReachableChunkSize;
+      ParallelFor(num_chunks, num_threads_, [&](size_t c) {
+        const auto chunk_begin = begin + c * kStateReachableChunkSize;
+        const auto chunk_end =
+            std::min(end, chunk_begin + kStateReachableChunkSize);
+        for (auto i = chunk_begin; i < chunk_end; ++i) {
+          const auto s = order[i];
+          auto &iset = isets_[s];
+          const auto index = state2index_[s];
+          if (index >= 0) {
+            iset.MutableIntervals()->push_back(Interval(index, index + 1));
+          }
+          for (ArcIterator<Fst<Arc>> aiter(fst, s); !aiter.Done();
+               aiter.Next()) {
+            iset.Union(isets_[aiter.Value().nextstate]);
+          }
+          iset.Normalize();
+        }
+      });
+    }
+  }
+
   void CyclicStateReachable(const Fst<Arc> &fst) {
     // Finds state reachability on the acyclic condensation FST.
     VectorFst<Arc> cfst;
     std::vector<StateId> scc;
     Condense(fst, &cfst, &scc);
-    StateReachable reachable(cfst);
+    StateReachable reachable(cfst, num_threads_);
     if (reachable.Error()) {
       error_ = true;
       return;
@@ -226,6 +353,7 @@ class StateReachable {
   }
 
   StateId s_;                       // Current state.
+  size_t num_threads_;              // Number of threads.
   std::vector<ISet> isets_;         // Interval sets per state.
   std::vector<Index> state2index_;  // Finds index for a final state.
   bool error_;
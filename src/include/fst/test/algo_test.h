@@ -20,13 +20,25 @@
 #ifndef FST_TEST_ALGO_TEST_H_
 #define FST_TEST_ALGO_TEST_H_
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <map>
 #include <memory>
 #include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include <fst/log.h>
 #include <fst/fstlib.h>
+#include <fstream>
+#include <fst/parallel.h>
 #include <fst/weight.h>
 #include <fst/test/rand-fst.h>
 
@@ -86,6 +98,57 @@ inline void LookAheadCompose(const Fst<StdArc> &ifst1, const Fst<StdArc> &ifst2,
   }
 }
 
+// Generic - no lookahead.
+template <class Arc>
+void MappedLookAheadCompose(const Fst<Arc> &ifst1, const Fst<Arc> &ifst2,
+                            MutableFst<Arc> *ofst) {
+  Compose(ifst1, ifst2, ofst);
+}
+
+// Specialized and epsilon olabel acyclic - lookahead through an FST written
+// aligned and read back memory-mapped, which relabels ifst2 with its saved
+// relabeling data. Checks the result against an FST written unaligned.
+inline void MappedLookAheadCompose(const Fst<StdArc> &ifst1,
+                                   const Fst<StdArc> &ifst2,
+                                   MutableFst<StdArc> *ofst) {
+  std::vector<StdArc::StateId> order;
+  bool acyclic;
+  TopOrderVisitor<StdArc> visitor(&order, &acyclic);
+  DfsVisit(ifst1, &visitor, OutputEpsilonArcFilter<StdArc>());
+  if (!acyclic) {
+    Compose(ifst1, ifst2, ofst);
+    return;
+  }
+  const bool save_relabel_data = FST_FLAGS_save_relabel_data;
+  FST_FLAGS_save_relabel_data = true;
+  const StdOLabelLookAheadFst lfst1(ifst1);
+  FST_FLAGS_save_relabel_data = save_relabel_data;
+  std::vector<std::unique_ptr<StdOLabelLookAheadFst>> rfsts;
+  for (const bool align : {true, false}) {
+    const std::string source = FST_FLAGS_tmpdir + "/algo_test.lookahead";
+    {
+      std::ofstream ostrm(source, std::ios_base::out | std::ios_base::binary);
+      FstWriteOptions wopts(source);
+      wopts.align = align;
+      CHECK(lfst1.Write(ostrm, wopts));
+    }
+    std::ifstream istrm(source, std::ios_base::in | std::ios_base::binary);
+    FstReadOptions ropts(source);
+    ropts.mode = align ? FstReadOptions::MAP : FstReadOptions::READ;
+    rfsts.emplace_back(StdOLabelLookAheadFst::Read(istrm, ropts));
+    CHECK(rfsts.back());
+    std::remove(source.c_str());
+  }
+  std::vector<StdVectorFst> results(rfsts.size());
+  for (size_t i = 0; i < rfsts.size(); ++i) {
+    StdVectorFst lfst2(ifst2);
+    LabelLookAheadRelabeler<StdArc>::Relabel(&lfst2, *rfsts[i], true);
+    Compose(*rfsts[i], lfst2, &results[i]);
+  }
+  CHECK(Equal(results[0], results[1]));
+  *ofst = results[0];
+}
+
 // This class tests a variety of identities and properties that must
 // hold for various algorithms on weighted FSTs.
 template <class Arc>
@@ -113,6 +176,7 @@ class WeightedTester {
     TestSort(T1);
     TestOptimize(T1);
     TestSearch(T1);
+    TestWorkspaces(T1, T2, T3);
   }
 
  private:
@@ -332,6 +396,50 @@ class WeightedTester {
 
       CHECK(Equiv(C, P));
     }
+
+    {
+      VLOG(1) << "Check replace with a state table shared among threads.";
+      using StateTable = ConcurrentReplaceStateTable<Arc>;
+      static constexpr Label kRoot = 1000;
+      static constexpr Label kNonterminal1 = 1001;
+      static constexpr Label kNonterminal2 = 1002;
+      VectorFst<Arc> root;
+      root.AddStates(3);
+      root.SetStart(0);
+      root.AddArc(0, Arc(kNonterminal1, kNonterminal1, Weight::One(), 1));
+      root.AddArc(1, Arc(kNonterminal2, kNonterminal2, Weight::One(), 2));
+      root.SetFinal(2, Weight::One());
+      const FstList<Arc> fst_list = {
+          {kRoot, &root}, {kNonterminal1, &T1}, {kNonterminal2, &T2}};
+      const ReplaceFstOptions<Arc, StateTable> opts(
+          kRoot, REPLACE_LABEL_NEITHER, REPLACE_LABEL_NEITHER, 0);
+      ReplaceFst<Arc, StateTable> R(fst_list, opts);
+      std::vector<VectorFst<Arc>> copies(4);
+      ParallelFor(copies.size(), copies.size(), [&R, &copies](size_t i) {
+        std::unique_ptr<Fst<Arc>> copy(R.Copy(/*safe=*/true));
+        copies[i] = *copy;
+      });
+      ConcatFst<Arc> C(T1, T2);
+      CHECK(Equiv(copies[0], C));
+      for (const auto &copy : copies) CHECK(Equal(copy, copies[0]));
+    }
+
+    {
+      VLOG(1) << "Check chunked arrays shared among threads.";
+      static constexpr size_t kNumThreads = 4;
+      static constexpr size_t kNumAppends = 5000;
+      internal::ConcurrentChunkedArray<size_t> array;
+      const auto *first = &array[array.Append()];
+      ParallelFor(kNumThreads, kNumThreads, [&array](size_t) {
+        for (size_t i = 0; i < kNumAppends; ++i) {
+          const auto index = array.Append();
+          array[index] = index;
+        }
+      });
+      CHECK_EQ(array.Size(), kNumThreads * kNumAppends + 1);
+      CHECK_EQ(&array[0], first);
+      for (size_t i = 1; i < array.Size(); ++i) CHECK_EQ(array[i], i);
+    }
   }
 
   // Tests map-based operations.
@@ -438,6 +546,54 @@ class WeightedTester {
       }
       EncodeMapper<Arc> encoder(encode_props, ENCODE);
       Encode(&D, &encoder);
+
+      VLOG(1) << "Check parallel encoding and aligned encode table I/O.";
+      VectorFst<Arc> P(T);
+      EncodeMapper<Arc> pencoder(encode_props, ENCODE);
+      Encode(&P, &pencoder, 4);
+      CHECK(Equal(P, D));
+      std::stringstream strm;
+      FstWriteOptions wopts;
+      wopts.align = true;
+      CHECK(pencoder.Write(strm, wopts));
+      std::unique_ptr<EncodeMapper<Arc>> rencoder(
+          EncodeMapper<Arc>::Read(strm, FstReadOptions()));
+      CHECK(rencoder);
+      Decode(&P, *rencoder);
+      CHECK(Equiv(P, T));
+
+      VLOG(1) << "Check memory-mapped encode tables.";
+      const std::string source = FST_FLAGS_tmpdir + "/algo_test.encoder";
+      {
+        std::ofstream ostrm(source, std::ios_base::out | std::ios_base::binary);
+        CHECK(pencoder.Write(ostrm, wopts));
+      }
+      FstReadOptions ropts(source);
+      ropts.mode = FstReadOptions::MAP;
+      std::ifstream istrm(source, std::ios_base::in | std::ios_base::binary);
+      std::unique_ptr<EncodeMapper<Arc>> mencoder(
+          EncodeMapper<Arc>::Read(istrm, ropts));
+      CHECK(mencoder);
+      VectorFst<Arc> M(D);
+      Decode(&M, *mencoder);
+      CHECK(Equiv(M, T));
+      // Encoding arcs with new triples copies the mapped table to memory.
+      VectorFst<Arc> N(T);
+      if (N.Start() != kNoStateId) {
+        const auto s = N.AddState();
+        N.SetFinal(s);
+        // Labels beyond those of the random FSTs.
+        N.AddArc(N.Start(), Arc(1000, 1001, generate_(), s));
+      }
+      VectorFst<Arc> N1(N);
+      VectorFst<Arc> N2(N);
+      Encode(&N1, &pencoder);
+      Encode(&N2, mencoder.get());
+      CHECK(Equal(N1, N2));
+      Decode(&N2, *mencoder);
+      CHECK(Equiv(N2, N));
+      std::remove(source.c_str());
+
       Decode(&D, encoder);
       CHECK(Equiv(D, T));
     }
@@ -526,6 +682,40 @@ class WeightedTester {
       CHECK(Equiv(C1, U2));
     }
 
+    {
+      VLOG(1) << "Check composition with replace look-ahead.";
+      // Negative nonterminals keep the replace FST input label sorted.
+      static constexpr Label kRoot = -1;
+      static constexpr Label kNonterminal1 = -2;
+      static constexpr Label kNonterminal2 = -3;
+      VectorFst<Arc> root;
+      root.AddStates(3);
+      root.SetStart(0);
+      root.AddArc(0, Arc(kNonterminal2, kNonterminal2, Weight::One(), 1));
+      root.AddArc(0, Arc(kNonterminal1, kNonterminal1, Weight::One(), 1));
+      root.AddArc(1, Arc(kNonterminal1, kNonterminal1, Weight::One(), 2));
+      root.SetFinal(1, Weight::One());
+      root.SetFinal(2, Weight::One());
+      VectorFst<Arc> R2(T2);
+      ArcSort(&R2, icomp);
+      const FstList<Arc> fst_list = {
+          {kRoot, &root}, {kNonterminal1, &S3}, {kNonterminal2, &R2}};
+      ReplaceFstOptions<Arc> opts(kRoot, REPLACE_LABEL_NEITHER,
+                                  REPLACE_LABEL_NEITHER, 0);
+      opts.compute_label_summary = true;
+      ReplaceFst<Arc> R(fst_list, opts);
+      // Replace FSTs with empty components do not provide a matcher.
+      if (S3.Start() != kNoStateId && R2.Start() != kNoStateId) {
+        CHECK_EQ(LookAheadMatchType<Arc>(S1, R), MATCH_INPUT);
+      }
+      ComposeFst<Arc> C1(S1, R);
+
+      VectorFst<Arc> V(R);
+      ComposeFst<Arc> C2(S1, V);
+
+      CHECK(Equiv(C1, C2));
+    }
+
     VectorFst<Arc> A1(S1);
     VectorFst<Arc> A2(S2);
     VectorFst<Arc> A3(S3);
@@ -577,6 +767,124 @@ class WeightedTester {
       Compose(S1, S2, &C1);
       LookAheadCompose(S1, S2, &C2);
       CHECK(Equiv(C1, C2));
+      VectorFst<Arc> C3;
+      MappedLookAheadCompose(S1, S2, &C3);
+      CHECK(Equiv(C1, C3));
+    }
+
+    {
+      VLOG(1) << "Check parallel label reachability and its serialization.";
+      LabelReachable<Arc> R1(S1, /*reach_input=*/false);
+      LabelReachable<Arc> R2(S1, /*reach_input=*/false, nullptr,
+                             /*keep_relabel_data=*/true, /*num_threads=*/2);
+      CHECK(!R1.Error() && !R2.Error());
+      const auto &data1 = *R1.GetData();
+      std::stringstream strm;
+      R2.GetData()->Write(strm, FstWriteOptions());
+      {
+        // Without alignment, the label map is written as a hash map, in the
+        // layout older readers expect.
+        std::stringstream lstrm(strm.str());
+        bool reach_input = true;
+        bool keep_relabel_data = false;
+        int64_t size = -1;
+        ReadType(lstrm, &reach_input);
+        ReadType(lstrm, &keep_relabel_data);
+        ReadType(lstrm, &size);
+        CHECK(!reach_input && keep_relabel_data);
+        CHECK_EQ(size, static_cast<int64_t>(data1.Label2IndexSize()));
+        // Other negative sizes are rejected.
+        std::stringstream bstrm;
+        WriteType(bstrm, false);
+        WriteType(bstrm, true);
+        WriteType(bstrm, int64_t{-2});
+        CHECK(!LabelReachableData<Label>::Read(bstrm, FstReadOptions()));
+        std::stringstream sstrm;
+        WriteType(sstrm, false);
+        WriteType(sstrm, false);
+        WriteType(sstrm, Label{kNoLabel});
+        WriteType(sstrm, int64_t{-2});
+        CHECK(!LabelReachableData<Label>::Read(sstrm, FstReadOptions()));
+      }
+      std::unique_ptr<LabelReachableData<Label>> data2(
+          LabelReachableData<Label>::Read(strm, FstReadOptions()));
+      CHECK(data2);
+      CHECK_EQ(data1.NumIntervalSets(), data2->NumIntervalSets());
+      for (int s = 0; s < data1.NumIntervalSets(); ++s) {
+        CHECK(data1.GetIntervalSet(s) == data2->GetIntervalSet(s));
+      }
+      CHECK_EQ(data1.FinalLabel(), data2->FinalLabel());
+      CHECK_EQ(data1.Label2IndexSize(), data2->Label2IndexSize());
+      CHECK_EQ(data1.DenseLabel2Index(), data2->DenseLabel2Index());
+      CHECK(*data1.Label2Index() == *data2->Label2Index());
+
+      VLOG(1) << "Check aligned serialization of label reachability.";
+      std::stringstream astrm;
+      FstWriteOptions wopts;
+      wopts.align = true;
+      CHECK(data2->Write(astrm, wopts));
+      std::unique_ptr<LabelReachableData<Label>> data3(
+          LabelReachableData<Label>::Read(astrm, FstReadOptions()));
+      // Reads the same data back from a file, memory-mapped.
+      const std::string source = FST_FLAGS_tmpdir + "/algo_test.reachable";
+      {
+        std::ofstream ostrm(source, std::ios_base::out | std::ios_base::binary);
+        CHECK(data2->Write(ostrm, wopts));
+      }
+      std::ifstream istrm(source, std::ios_base::in | std::ios_base::binary);
+      FstReadOptions ropts(source);
+      ropts.mode = FstReadOptions::MAP;
+      std::unique_ptr<LabelReachableData<Label>> data4(
+          LabelReachableData<Label>::Read(istrm, ropts));
+      const Label max_label = data1.Label2IndexSize() + 2;
+      for (const auto *data : {data3.get(), data4.get()}) {
+        CHECK(data);
+        CHECK_EQ(data1.NumIntervalSets(), data->NumIntervalSets());
+        for (int s = 0; s < data1.NumIntervalSets(); ++s) {
+          for (Label label = -1; label <= max_label; ++label) {
+            CHECK_EQ(data1.GetCompactIntervalSets().Member(s, label),
+                     data->GetCompactIntervalSets().Member(s, label));
+          }
+          CHECK(data1.GetIntervalSet(s) == data->GetIntervalSet(s));
+        }
+        CHECK(*data1.Label2Index() == *data->Label2Index());
+      }
+      data4.reset();
+      std::remove(source.c_str());
+
+      VLOG(1) << "Check compact interval set membership.";
+      const auto &isets = data1.GetCompactIntervalSets();
+      CHECK_EQ(isets.NumSets(), data1.NumIntervalSets());
+      for (int s = 0; s < data1.NumIntervalSets(); ++s) {
+        for (Label label = -1; label <= max_label; ++label) {
+          CHECK_EQ(isets.Member(s, label),
+                   data1.GetIntervalSet(s).Member(label));
+        }
+      }
+    }
+
+    if constexpr (IsPath<Weight>::value) {
+      VLOG(1) << "Check pruned composition equiv prune(composition).";
+      const Weight threshold = generate_();
+      VectorFst<Arc> C1, C2;
+      Compose(S1, S2, &C1);
+      Prune(&C1, threshold);
+      PrunedCompose(S1, S2, &C2, threshold);
+      CHECK(Equiv(C1, C2));
+      // With the exact estimates given, and with looser ones.
+      std::vector<Weight> distance1;
+      std::vector<Weight> distance2;
+      ShortestDistance(S1, &distance1, true);
+      ShortestDistance(S2, &distance2, true);
+      VectorFst<Arc> C3;
+      PrunedCompose(S1, S2, &C3, threshold, kNoStateId, kDelta, &distance1,
+                    &distance2);
+      CHECK(Equal(C2, C3));
+      for (auto &weight : distance2) weight = Plus(weight, Weight::One());
+      VectorFst<Arc> C4;
+      PrunedCompose(S1, S2, &C4, threshold, kNoStateId, kDelta, nullptr,
+                    &distance2);
+      CHECK(Equiv(C1, C4));
     }
   }
 
@@ -618,6 +926,57 @@ class WeightedTester {
       CHECK(Equiv(T, S1));
     }
 
+    {
+      VLOG(1) << "Check reordered Fst is equivalent to its input.";
+      for (const auto type :
+           {StateReorderType::BFS, StateReorderType::DFS,
+            StateReorderType::RCM, StateReorderType::FREQUENCY}) {
+        VectorFst<Arc> S1(T);
+        const StateReorderOptions<UniformArcSelector<Arc>> opts(
+            type, UniformArcSelector<Arc>(rand_()), 100, 100);
+        StateReorder(&S1, opts);
+        CHECK(Equiv(T, S1));
+        if (type == StateReorderType::BFS && T.Start() != kNoStateId) {
+          CHECK_EQ(S1.Start(), 0);
+        }
+      }
+    }
+
+    {
+      VLOG(1) << "Check state orders of a fixed Fst.";
+      // 0 -> {3, 1}, 1 -> {4, 2}, 2 -> 5, 3 -> 2, 4 -> 5, and 6 -> 0, with
+      // state 6 not reached from the start state 0.
+      VectorFst<Arc> V;
+      for (int i = 0; i < 7; ++i) V.AddState();
+      V.SetStart(0);
+      V.SetFinal(5, Weight::One());
+      for (const auto &[s, nextstate] :
+           std::vector<std::pair<StateId, StateId>>{
+               {0, 3}, {0, 1}, {1, 4}, {1, 2}, {2, 5}, {3, 2}, {4, 5},
+               {6, 0}}) {
+        V.AddArc(s, Arc(1, 1, Weight::One(), nextstate));
+      }
+      using Options = StateReorderOptions<UniformArcSelector<Arc>>;
+      std::vector<StateId> order;
+      // BFS: 0 3 1 2 4 5, then 6.
+      StateReorder(V, &order, Options(StateReorderType::BFS));
+      CHECK(order == std::vector<StateId>({0, 2, 3, 1, 4, 5, 6}));
+      // DFS: 0 3 2 5 1 4, then 6.
+      StateReorder(V, &order, Options(StateReorderType::DFS));
+      CHECK(order == std::vector<StateId>({0, 4, 2, 1, 5, 3, 6}));
+      // RCM: breadth-first from 0 over undirected edges, neighbors by
+      // increasing degree, is 0 6 3 1 2 4 5; reversed, 5 4 2 1 3 6 0.
+      StateReorder(V, &order, Options(StateReorderType::RCM));
+      CHECK(order == std::vector<StateId>({6, 3, 2, 4, 1, 0, 5}));
+      // Without a start state, the order is unchanged.
+      V.SetStart(kNoStateId);
+      for (const auto type : {StateReorderType::BFS, StateReorderType::DFS,
+                              StateReorderType::RCM}) {
+        StateReorder(V, &order, Options(type));
+        CHECK(order == std::vector<StateId>({0, 1, 2, 3, 4, 5, 6}));
+      }
+    }
+
     {
       VLOG(1) << "Check reverse(reverse(T)) = T";
       for (int i = 0; i < 2; ++i) {
@@ -657,6 +1016,37 @@ class WeightedTester {
       RmEpsilonFst<Arc> R2(T);
       CHECK(Equiv(R1, R2));
 
+      VLOG(1) << "Check delayed epsilon removal with cached closures.";
+      RmEpsilonFst<Arc> R3(T, RmEpsilonFstOptions(kShortestDelta, true));
+      CHECK(Equiv(R1, R3));
+
+      VLOG(1) << "Check parallel and sequential epsilon removal "
+              << "are equivalent.";
+      {
+        using Queue = FifoQueue<StateId>;
+        std::vector<Weight> distance;
+        Queue queue;
+        VectorFst<Arc> S(T);
+        RmEpsilon(&S, &distance, RmEpsilonOptions<Arc, Queue>(&queue));
+        std::vector<Weight> sdistance;
+        ShortestDistance(S, &sdistance, true);
+        for (const size_t num_threads : {2, 3, 0}) {
+          VectorFst<Arc> P(T);
+          RmEpsilon(&P, &distance,
+                    RmEpsilonOptions<Arc, Queue>(
+                        &queue, kShortestDelta, /*connect=*/true,
+                        Weight::Zero(), kNoStateId, num_threads));
+          CHECK(Equiv(S, P));
+          std::vector<Weight> pdistance;
+          ShortestDistance(P, &pdistance, true);
+          const auto sw = S.Start() < sdistance.size() ? sdistance[S.Start()]
+                                                       : Weight::Zero();
+          const auto pw = P.Start() < pdistance.size() ? pdistance[P.Start()]
+                                                       : Weight::Zero();
+          CHECK(ApproxEqual(sw, pw, kTestDelta));
+        }
+      }
+
       VLOG(1) << "Check an FST with a large proportion"
               << " of epsilon transitions:";
       // Maps all transitions of T to epsilon-transitions and append
@@ -683,6 +1073,10 @@ class WeightedTester {
       ShortestDistance(U2, &d, true);
       Weight w2 = U2.Start() < d.size() ? d[U2.Start()] : Weight::Zero();
       CHECK(ApproxEqual(w, w2, kTestDelta));
+      RmEpsilonFst<Arc> U3(U, RmEpsilonFstOptions(kShortestDelta, true));
+      ShortestDistance(U3, &d, true);
+      Weight w3 = U3.Start() < d.size() ? d[U3.Start()] : Weight::Zero();
+      CHECK(ApproxEqual(w, w3, kTestDelta));
     }
 
     if ((wprops & kSemiring) == kSemiring && tprops & kAcyclic) {
@@ -698,6 +1092,76 @@ class WeightedTester {
         CHECK(Equiv(T, DT));
       }
 
+      {
+        VLOG(1) << "Check flat label grouping matches default determinization";
+        using Filter = FlatDeterminizeFilter<Arc>;
+        const DeterminizeFstOptions<Arc, DefaultCommonDivisor<Weight>, Filter>
+            opts;
+        const DeterminizeFst<Arc> D1(A, opts);
+        CHECK(Equal(D, D1));
+        DeterminizeFstOptions<Arc, DefaultCommonDivisor<Weight>, Filter> topts;
+        topts.type = DETERMINIZE_NONFUNCTIONAL;
+        const DeterminizeFst<Arc> DT1(T, topts);
+        CHECK(Equiv(T, DT1));
+      }
+
+      {
+        VLOG(1) << "Check compact subsets match default determinization";
+        using StateTable = CompactDeterminizeStateTable<Arc, CharFilterState>;
+        const DeterminizeFstOptions<Arc, DefaultCommonDivisor<Weight>,
+                                    DefaultDeterminizeFilter<Arc>, StateTable>
+            opts;
+        const DeterminizeFst<Arc> D1(A, opts);
+        CHECK(Equal(D, D1));
+        // Uses a coarser quantization, also for hashing subsets.
+        static constexpr float kCoarseDelta = 1.0 / 16;
+        DeterminizeFstOptions<Arc> dopts;
+        dopts.delta = kCoarseDelta;
+        DeterminizeFstOptions<Arc, DefaultCommonDivisor<Weight>,
+                              DefaultDeterminizeFilter<Arc>, StateTable>
+            copts;
+        copts.delta = kCoarseDelta;
+        copts.state_table = new StateTable(kCoarseDelta);
+        const DeterminizeFst<Arc> D2(A, dopts);
+        const DeterminizeFst<Arc> D3(A, copts);
+        CHECK(Equal(D2, D3));
+        // Transducer determinization, where the table is rebound to the
+        // Gallic arc type, with the residual output strings on final states
+        // moved to arcs with a subsequential label.
+        DeterminizeFstOptions<Arc> topts;
+        topts.type = DETERMINIZE_NONFUNCTIONAL;
+        topts.subsequential_label = 7;
+        topts.increment_subsequential_label = true;
+        DeterminizeFstOptions<Arc, DefaultCommonDivisor<Weight>,
+                              DefaultDeterminizeFilter<Arc>, StateTable>
+            ctopts;
+        ctopts.type = topts.type;
+        ctopts.subsequential_label = topts.subsequential_label;
+        ctopts.increment_subsequential_label = true;
+        const DeterminizeFst<Arc> DT1(T, topts);
+        const DeterminizeFst<Arc> DT2(T, ctopts);
+        CHECK(Equal(DT1, DT2));
+      }
+
+      if ((wprops & (kPath | kCommutative)) == (kPath | kCommutative)) {
+        VLOG(1) << "Check final distances of compact subsets";
+        using StateTable = CompactDeterminizeStateTable<Arc, CharFilterState>;
+        const DeterminizeFstOptions<Arc, DefaultCommonDivisor<Weight>,
+                                    DefaultDeterminizeFilter<Arc>, StateTable>
+            copts;
+        std::vector<Weight> idistance;
+        ShortestDistance(A, &idistance, true);
+        std::vector<Weight> odistance1;
+        std::vector<Weight> odistance2;
+        const VectorFst<Arc> D1(DeterminizeFst<Arc>(
+            A, &idistance, &odistance1, DeterminizeFstOptions<Arc>()));
+        const VectorFst<Arc> D2(
+            DeterminizeFst<Arc>(A, &idistance, &odistance2, copts));
+        CHECK(Equal(D1, D2));
+        CHECK_EQ(odistance1.size(), D1.NumStates());
+        CHECK(odistance1 == odistance2);
+      }
+
       if ((wprops & (kPath | kCommutative)) == (kPath | kCommutative)) {
         VLOG(1) << "Check pruning in determinization";
         VectorFst<Arc> P;
@@ -768,6 +1232,13 @@ class WeightedTester {
       VLOG(1) << "Check disambiguated FSA is unambiguous";
       CHECK(Unambiguous(D));
 
+      VLOG(1) << "Check parallel disambiguation";
+      VectorFst<Arc> PD;
+      DisambiguateOptions<Arc> popts;
+      popts.num_threads = 2;
+      Disambiguate(R, &PD, popts);
+      CHECK(Equal(D, PD));
+
       /* TODO(riley): find out why this fails
       if ((wprops & (kPath | kCommutative)) == (kPath | kCommutative)) {
         VLOG(1)  << "Check pruning in disambiguation";
@@ -855,6 +1326,125 @@ class WeightedTester {
           Reverse(R, &P2);
           CHECK(Equiv(P1, P2));
         }
+
+        {
+          VLOG(1) << "Check pruning with a reused workspace";
+          const Weight threshold = generate_();
+          PruneWorkspace<Arc> workspace;
+          const PruneOptions<Arc, AnyArcFilter<Arc>> opts(
+              threshold, kNoStateId, AnyArcFilter<Arc>(), nullptr, kDelta,
+              false, &workspace);
+          VectorFst<Arc> P1(T);
+          Prune(&P1, opts);
+          VectorFst<Arc> P2;
+          Prune(T, &P2, opts);
+          CHECK(Equiv(P1, P2));
+          VectorFst<Arc> P3;
+          Prune(T, &P3, threshold);
+          CHECK(Equiv(P2, P3));
+        }
+
+        {
+          VLOG(1) << "Check parallel pruning";
+          const Weight threshold = generate_();
+          VectorFst<Arc> P1(T);
+          Prune(&P1, threshold, kNoStateId, kDelta, 2);
+          VectorFst<Arc> P2(T);
+          Prune(&P2, threshold);
+          CHECK(Equiv(P1, P2));
+          // Parallel pruning with a workspace, used twice.
+          PruneWorkspace<Arc> workspace;
+          const PruneOptions<Arc, AnyArcFilter<Arc>> opts(
+              threshold, kNoStateId, AnyArcFilter<Arc>(), nullptr, kDelta,
+              false, &workspace, 2);
+          for (int i = 0; i < 2; ++i) {
+            VectorFst<Arc> P3(T);
+            Prune(&P3, opts);
+            CHECK(Equal(P1, P3));
+            if (T.Start() != kNoStateId) CHECK(!workspace.idistance.empty());
+          }
+        }
+
+        {
+          VLOG(1) << "Check delayed pruning keeps the shortest path";
+          const Weight threshold = generate_();
+          std::vector<Weight> distance;
+          ShortestDistance(T, &distance, true);
+          const PruneFst<Arc> P(T, PruneFstOptions<Arc>(threshold, distance));
+          CHECK(Verify(P));
+          CHECK(ApproxEqual(ShortestDistance(P), ShortestDistance(T),
+                            kTestDelta));
+        }
+        {
+          VLOG(1) << "Check delayed pruning against Prune";
+          std::vector<Weight> distance;
+          ShortestDistance(T, &distance, true);
+          // Without a threshold, nothing is pruned.
+          const PruneFst<Arc> P1(
+              T, PruneFstOptions<Arc>(Weight::Zero(), distance));
+          CHECK(Equiv(T, P1));
+          // With exact estimates and a threshold of One(), both keep exactly
+          // the shortest paths for tropical weights (for which Times() is
+          // strictly monotonic).
+          if constexpr (std::is_same_v<Weight, TropicalWeight>) {
+            const PruneFst<Arc> P2(
+                T, PruneFstOptions<Arc>(Weight::One(), distance));
+            VectorFst<Arc> P3;
+            Prune(T, &P3, Weight::One());
+            CHECK(Equiv(P2, P3));
+            // With a wider threshold, the arcs on the paths Prune keeps are
+            // all within the beam at their states, so PruneFst keeps a
+            // superset of these paths, which pruning again recovers.
+            const Weight threshold = generate_();
+            const PruneFst<Arc> P4(
+                T, PruneFstOptions<Arc>(threshold, distance));
+            VectorFst<Arc> P5(P4);
+            Prune(&P5, threshold);
+            VectorFst<Arc> P6;
+            Prune(T, &P6, threshold);
+            CHECK(Equiv(P5, P6));
+          }
+          // With a state threshold, no more states are expanded than it
+          // allows, and each state keeps a subsequence of its arcs.
+          const StateId state_threshold = 3;
+          const PruneFst<Arc> P7(
+              T, PruneFstOptions<Arc>(Weight::Zero(), distance,
+                                      state_threshold));
+          // Input state IDs are preserved, so the states kept are found by
+          // following the arcs of P7 and compared with those of T.
+          std::vector<StateId> queue;
+          std::vector<bool> kept;
+          if (P7.Start() != kNoStateId) {
+            queue.push_back(P7.Start());
+            kept.resize(P7.Start() + 1, false);
+            kept[P7.Start()] = true;
+          }
+          for (size_t i = 0; i < queue.size(); ++i) {
+            const auto s = queue[i];
+            ArcIterator<Fst<Arc>> aiter(T, s);
+            for (ArcIterator<PruneFst<Arc>> piter(P7, s); !piter.Done();
+                 piter.Next()) {
+              const auto &arc = piter.Value();
+              if (kept.size() <= arc.nextstate) {
+                kept.resize(arc.nextstate + 1, false);
+              }
+              if (!kept[arc.nextstate]) {
+                kept[arc.nextstate] = true;
+                queue.push_back(arc.nextstate);
+              }
+              while (!aiter.Done() &&
+                     !(aiter.Value().ilabel == arc.ilabel &&
+                       aiter.Value().olabel == arc.olabel &&
+                       aiter.Value().weight == arc.weight &&
+                       aiter.Value().nextstate == arc.nextstate)) {
+                aiter.Next();
+              }
+              CHECK(!aiter.Done());
+              aiter.Next();
+            }
+          }
+          CHECK_LE(queue.size(), state_threshold);
+        }
         {
           VLOG(1) << "Check: ShortestDistance(A - prune(A))"
                   << " > ShortestDistance(A) times Threshold";
@@ -889,6 +1479,63 @@ class WeightedTester {
         CHECK(ApproxEqual(tsum, psum, kTestDelta));
       }
 
+      if ((wprops & (kPath | kRightSemiring)) == (kPath | kRightSemiring)) {
+        VLOG(1) << "Check shortest-first queues of arity 2 and 4.";
+        using Queue2 = NaturalShortestFirstQueue<StateId, Weight, 2>;
+        using Queue4 = NaturalShortestFirstQueue<StateId, Weight, 4>;
+        const StateId num_states = CountStates(T);
+        std::vector<Weight> distance;
+        for (StateId s = 0; s < num_states; ++s) {
+          distance.push_back(generate_());
+        }
+        Queue2 queue2(distance);
+        Queue4 queue4(distance);
+        for (StateId s = 0; s < num_states; ++s) {
+          queue2.Enqueue(s);
+          queue4.Enqueue(s);
+        }
+        // Lowers some of the distances, as relaxing arcs does in a search.
+        for (StateId s = 0; s < num_states; s += 2) {
+          distance[s] = Plus(distance[s], generate_());
+          queue2.Update(s);
+          queue4.Update(s);
+        }
+        const NaturalLess<Weight> less;
+        for (StateId n = 0; n < num_states; ++n) {
+          CHECK(!queue2.Empty() && !queue4.Empty());
+          const auto s2 = queue2.Head();
+          const auto s4 = queue4.Head();
+          queue2.Dequeue();
+          queue4.Dequeue();
+          // States of equal distance may come in either order.
+          CHECK(distance[s2] == distance[s4]);
+          if (!queue2.Empty()) {
+            CHECK(!less(distance[queue2.Head()], distance[s2]));
+          }
+        }
+        CHECK(queue2.Empty() && queue4.Empty());
+
+        std::vector<Weight> distance2;
+        std::vector<Weight> distance4;
+        Queue2 sd_queue2(distance2);
+        Queue4 sd_queue4(distance4);
+        const ShortestDistanceOptions<Arc, Queue2, AnyArcFilter<Arc>> opts2(
+            &sd_queue2, AnyArcFilter<Arc>(), kNoStateId, kDelta);
+        const ShortestDistanceOptions<Arc, Queue4, AnyArcFilter<Arc>> opts4(
+            &sd_queue4, AnyArcFilter<Arc>(), kNoStateId, kDelta);
+        ShortestDistance(T, &distance2, opts2);
+        ShortestDistance(T, &distance4, opts4);
+        std::vector<Weight> tdistance;
+        ShortestDistance(T, &tdistance, false, kDelta);
+        for (StateId s = 0; s < num_states; ++s) {
+          const auto weight = [s](const std::vector<Weight> &d) {
+            return s < d.size() ? d[s] : Weight::Zero();
+          };
+          CHECK(ApproxEqual(weight(distance2), weight(tdistance), kTestDelta));
+          CHECK(ApproxEqual(weight(distance4), weight(tdistance), kTestDelta));
+        }
+      }
+
       if ((wprops & (kPath | kSemiring)) == (kPath | kSemiring)) {
         VLOG(1) << "Check n-best weights";
         VectorFst<Arc> R(A);
@@ -922,6 +1569,121 @@ class WeightedTester {
           }
         }
       }
+
+      if ((wprops & (kPath | kSemiring)) == (kPath | kSemiring)) {
+        VLOG(1) << "Check lazy n-best weights.";
+        const int nshortest = std::uniform_int_distribution<>(
+            0, kNumRandomShortestPaths + 1)(rand_);
+        VectorFst<Arc> paths;
+        ShortestPath(A, &paths, nshortest, /*unique=*/false,
+                     /*first_path=*/false, Weight::Zero(), kNoStateId, kDelta);
+        std::vector<Weight> distance;
+        ShortestDistance(paths, &distance, true, kDelta);
+        ShortestPathIterator<Arc> siter(A, /*unique=*/false, kDelta);
+        StateId pstart = paths.Start();
+        if (pstart != kNoStateId) {
+          ArcIterator<Fst<Arc>> piter(paths, pstart);
+          for (; !piter.Done(); piter.Next(), siter.Next()) {
+            StateId s = piter.Value().nextstate;
+            Weight nsum = s < distance.size()
+                              ? Times(piter.Value().weight, distance[s])
+                              : Weight::Zero();
+            CHECK(!siter.Done());
+            CHECK(ApproxEqual(nsum, siter.PathWeight(), kTestDelta));
+          }
+        }
+        CHECK(!siter.Error());
+      }
+
+      if ((wprops & (kPath | kSemiring)) == (kPath | kSemiring)) {
+        VLOG(1) << "Check lazy unique n-best weights.";
+        VectorFst<Arc> R(A);
+        RmEpsilon(&R, /*connect=*/true, Arc::Weight::Zero(), kNoStateId,
+                  kDelta);
+        const int nshortest = std::uniform_int_distribution<>(
+            0, kNumRandomShortestPaths + 1)(rand_);
+        VectorFst<Arc> paths;
+        ShortestPath(R, &paths, nshortest, /*unique=*/true,
+                     /*first_path=*/false, Weight::Zero(), kNoStateId, kDelta);
+        std::vector<Weight> distance;
+        ShortestDistance(paths, &distance, true, kDelta);
+        ShortestPathIterator<Arc> siter(R, /*unique=*/true, kDelta);
+        // Input strings of the paths enumerated, which must be distinct.
+        std::set<std::vector<Label>> strings;
+        StateId pstart = paths.Start();
+        if (pstart != kNoStateId) {
+          ArcIterator<Fst<Arc>> piter(paths, pstart);
+          for (; !piter.Done(); piter.Next(), siter.Next()) {
+            StateId s = piter.Value().nextstate;
+            Weight nsum = s < distance.size()
+                              ? Times(piter.Value().weight, distance[s])
+                              : Weight::Zero();
+            CHECK(!siter.Done());
+            CHECK(ApproxEqual(nsum, siter.PathWeight(), kTestDelta));
+            std::vector<Label> string;
+            for (const auto &arc : siter.Arcs()) string.push_back(arc.ilabel);
+            CHECK(strings.insert(std::move(string)).second);
+          }
+        }
+        CHECK(!siter.Error());
+      }
+    }
+  }
+
+  // Tests that reused workspaces give the results of fresh calls, on FSTs of
+  // varying sizes, including the empty FST.
+  void TestWorkspaces(const Fst<Arc> &T1, const Fst<Arc> &T2,
+                      const Fst<Arc> &T3) {
+    VLOG(1) << "Check reused workspaces give the results of fresh calls.";
+    DfsVisitWorkspace<Fst<Arc>> dfs_workspace;
+    ConnectWorkspace<Arc> connect_workspace;
+    TopSortWorkspace<Arc> topsort_workspace;
+    ShortestDistanceWorkspace<Arc> sd_workspace;
+    const std::vector<const Fst<Arc> *> fsts = {
+        &T1, &univ_fst_, &T2, &zero_fst_, &T3, &one_fst_, &T1};
+    for (const auto *fst : fsts) {
+      {
+        std::vector<StateId> scc1, scc2;
+        uint64_t props1 = 0, props2 = 0;
+        SccVisitor<Arc> visitor1(&scc1, nullptr, nullptr, &props1);
+        SccVisitor<Arc> visitor2(&scc2, nullptr, nullptr, &props2);
+        DfsVisit(*fst, &visitor1, AnyArcFilter<Arc>(), /*access_only=*/false,
+                 &dfs_workspace);
+        DfsVisit(*fst, &visitor2, AnyArcFilter<Arc>());
+        CHECK(scc1 == scc2);
+        CHECK_EQ(props1, props2);
+      }
+      {
+        VectorFst<Arc> C1(*fst);
+        Connect(&C1, &connect_workspace);
+        VectorFst<Arc> C2(*fst);
+        Connect(&C2);
+        CHECK(Equal(C1, C2));
+      }
+      {
+        VectorFst<Arc> S1(*fst);
+        const bool acyclic1 = TopSort(&S1, &topsort_workspace);
+        VectorFst<Arc> S2(*fst);
+        const bool acyclic2 = TopSort(&S2);
+        CHECK_EQ(acyclic1, acyclic2);
+        CHECK(Equal(S1, S2));
+      }
+      if (Weight::Properties() & kRightSemiring) {
+        using Queue = FifoQueue<StateId>;
+        std::vector<Weight> distance1, distance2;
+        Queue queue1, queue2;
+        const ShortestDistanceOptions<Arc, Queue, AnyArcFilter<Arc>> opts1(
+            &queue1, AnyArcFilter<Arc>(), kNoStateId, kDelta,
+            /*first_path=*/false, &sd_workspace);
+        const ShortestDistanceOptions<Arc, Queue, AnyArcFilter<Arc>> opts2(
+            &queue2, AnyArcFilter<Arc>(), kNoStateId, kDelta);
+        ShortestDistance(*fst, &distance1, opts1);
+        ShortestDistance(*fst, &distance2, opts2);
+        CHECK_EQ(distance1.size(), distance2.size());
+        for (size_t s = 0; s < distance1.size(); ++s) {
+          CHECK(distance1[s] == distance2[s]);
+        }
+      }
     }
   }
 
@@ -1340,6 +2102,9 @@ class AlgoTester {
   void Test() {
     VLOG(1) << "weight type = " << Weight::Type();
 
+    TestHeap();
+    TestCompactIntervalSets();
+
     for (int i = 0; i < FST_FLAGS_repeat; ++i) {
       // Random transducers
       VectorFst<Arc> T1;
@@ -1364,6 +2129,166 @@ class AlgoTester {
   }
 
  private:
+  // Checks that heaps of arity 2 and 4 pop the same values, in order, under a
+  // random sequence of insertions, updates and pops.
+  void TestHeap() {
+    VLOG(1) << "Check heaps of arity 2 and 4 against an ordered set.";
+    // Values are made unique by an ID, so that pops identify their key.
+    using Value = std::pair<int, int>;
+    Heap<Value, std::less<Value>, 2> heap2;
+    Heap<Value, std::less<Value>, 4> heap4;
+    std::set<Value> values;
+    std::map<int, std::pair<int, int>> keys;  // ID -> keys in heap2, heap4.
+    std::uniform_int_distribution<int> value_dist(0, 100);
+    std::uniform_int_distribution<int> op_dist(0, 3);
+    for (int id = 0; id < kNumHeapOperations; ++id) {
+      const int op = op_dist(rand_);
+      if (op == 0 && !values.empty()) {
+        const auto value = *values.begin();
+        CHECK(heap2.Top() == value);
+        CHECK(heap4.Top() == value);
+        CHECK(heap2.Pop() == value);
+        CHECK(heap4.Pop() == value);
+        values.erase(values.begin());
+        keys.erase(value.second);
+      } else if (op == 1 && !keys.empty()) {
+        // Moves a value up or down the heaps.
+        auto it = keys.begin();
+        std::advance(it, std::uniform_int_distribution<size_t>(
+                             0, keys.size() - 1)(rand_));
+        const auto [key2, key4] = it->second;
+        CHECK(heap2.Get(key2) == heap4.Get(key4));
+        values.erase(heap2.Get(key2));
+        const Value value(value_dist(rand_), it->first);
+        heap2.Update(key2, value);
+        heap4.Update(key4, value);
+        values.insert(value);
+      } else {
+        const Value value(value_dist(rand_), id);
+        keys[id] = std::make_pair(heap2.Insert(value), heap4.Insert(value));
+        values.insert(value);
+      }
+      CHECK_EQ(heap2.Size(), values.size());
+      CHECK_EQ(heap4.Size(), values.size());
+    }
+    for (const auto &value : values) {
+      CHECK(heap2.Pop() == value);
+      CHECK(heap4.Pop() == value);
+    }
+    CHECK(heap2.Empty());
+    CHECK(heap4.Empty());
+  }
+
+  // Checks CompactIntervalSets against IntervalSet on small sets, on large
+  // sparse sets (searched by bisection) and on large dense sets (bitsets), and
+  // LabelLowerBound against std::lower_bound.
+  void TestCompactIntervalSets() {
+    VLOG(1) << "Check compact interval sets against interval sets.";
+    using ISet = IntervalSet<Label>;
+    using CSets = CompactIntervalSets<Label>;
+    std::vector<ISet> isets;
+    // Numbers of intervals and ranges of their begins: small, large and
+    // sparse, and large and dense sets.
+    for (const auto &[num_intervals, max_begin] :
+         {std::make_pair(8, 100), std::make_pair(40, 100000),
+          std::make_pair(100, 300)}) {
+      std::uniform_int_distribution<Label> begin_dist(0, max_begin);
+      std::uniform_int_distribution<Label> length_dist(1, 4);
+      for (int i = 0; i < kNumIntervalSets; ++i) {
+        ISet iset;
+        for (int j = 0; j < num_intervals; ++j) {
+          const auto begin = begin_dist(rand_);
+          iset.MutableIntervals()->emplace_back(begin,
+                                                begin + length_dist(rand_));
+        }
+        iset.Normalize();
+        isets.push_back(std::move(iset));
+      }
+    }
+    isets.emplace_back();
+    const CSets csets(isets);
+    CHECK_EQ(csets.NumSets(), isets.size());
+    bool sparse = false;
+    bool dense = false;
+    for (size_t i = 0; i < isets.size(); ++i) {
+      const auto &iset = isets[i];
+      CHECK_EQ(csets.Size(i), iset.Size());
+      if (iset.Empty()) {
+        CHECK(!csets.Member(i, 0));
+        continue;
+      }
+      const auto *intervals = iset.Intervals();
+      const ssize_t size = iset.Size();
+      const Label first = intervals[0].begin;
+      const Label last = intervals[size - 1].end;
+      if (size > CSets::kLinearSearchSize) {
+        if (static_cast<size_t>(last - first) <=
+            CSets::kBitsPerInterval * size) {
+          dense = true;
+        } else {
+          sparse = true;
+        }
+      }
+      // The interval that may contain each value advances with the value.
+      ssize_t pos = -1;
+      for (Label value = first - 2; value <= last + 2; ++value) {
+        while (pos + 1 < size && intervals[pos + 1].begin <= value) ++pos;
+        CHECK_EQ(csets.Find(i, value), pos);
+        CHECK_EQ(csets.Member(i, value), iset.Member(value));
+      }
+      std::uniform_int_distribution<Label> value_dist(first - 2, last + 2);
+      for (int j = 0; j < kNumIntersections; ++j) {
+        auto begin = value_dist(rand_);
+        auto end = value_dist(rand_);
+        if (begin > end) std::swap(begin, end);
+        const bool expected =
+            begin < end &&
+            std::any_of(intervals, intervals + size,
+                        [begin, end](const auto &interval) {
+                          return interval.begin < end && interval.end > begin;
+                        });
+        CHECK_EQ(csets.Intersects(i, begin, end), expected);
+        CHECK_EQ(csets.Intersects(i, begin, begin + 1), iset.Member(begin));
+      }
+    }
+    CHECK(sparse && dense);
+
+    VLOG(1) << "Check LabelLowerBound against std::lower_bound.";
+    // Input labels with repeats, and output labels in the same order.
+    VectorFst<Arc> fst;
+    fst.SetStart(fst.AddState());
+    std::vector<Label> labels;
+    std::uniform_int_distribution<Label> label_dist(1, kNumRandomLabels);
+    for (int i = 0; i < kNumLowerBoundArcs; ++i) {
+      labels.push_back(label_dist(rand_));
+    }
+    std::sort(labels.begin(), labels.end());
+    for (const auto label : labels) {
+      fst.EmplaceArc(0, label, 2 * label, Weight::One(), 0);
+    }
+    for (const bool reach_input : {true, false}) {
+      LabelLowerBound<Arc> lower_bound;
+      lower_bound.Init(fst, reach_input, /*is_copy=*/false);
+      lower_bound.SetState(0);
+      ArcIterator<Fst<Arc>> aiter(fst, 0);
+      std::uniform_int_distribution<ssize_t> pos_dist(0, labels.size());
+      for (int i = 0; i < kNumLowerBoundArcs; ++i) {
+        auto begin = pos_dist(rand_);
+        auto end = pos_dist(rand_);
+        if (begin > end) std::swap(begin, end);
+        const auto label = label_dist(rand_);
+        const ssize_t expected =
+            std::lower_bound(labels.begin() + begin, labels.begin() + end,
+                             label) -
+            labels.begin();
+        CHECK_EQ(lower_bound(&aiter, begin, end,
+                             reach_input ? label : 2 * label),
+                 expected);
+        CHECK_EQ(aiter.Position(), expected);
+      }
+    }
+  }
+
   // Generates weights used in testing.
   WeightGenerator generate_;
   // Random state used to seed RandFst.
@@ -1392,6 +2317,14 @@ class AlgoTester {
   static constexpr int kRandomPathLength = 25;
   // Number of random paths to explore.
   static constexpr int kNumRandomPaths = 100;
+  // Number of heap operations in TestHeap.
+  static constexpr int kNumHeapOperations = 1000;
+  // Number of interval sets of each kind in TestCompactIntervalSets.
+  static constexpr int kNumIntervalSets = 5;
+  // Number of intersection queries per set in TestCompactIntervalSets.
+  static constexpr int kNumIntersections = 100;
+  // Number of arcs and of lower bound queries in TestCompactIntervalSets.
+  static constexpr int kNumLowerBoundArcs = 100;
 
   AlgoTester(const AlgoTester &) = delete;
   AlgoTester &operator=(const AlgoTester &) = delete;
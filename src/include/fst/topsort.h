@@ -76,6 +76,24 @@ class TopOrderVisitor {
   std::vector<StateId> finish_;
 };
 
+// Scratch space for TopSort. Passing the same workspace to repeated calls lets
+// them reuse the order vector and the visitation buffers rather than
+// allocating them anew each time. A workspace may only be used by one call at
+// a time.
+template <class Arc>
+struct TopSortWorkspace {
+  using StateId = typename Arc::StateId;
+
+  TopSortWorkspace() = default;
+  TopSortWorkspace(const TopSortWorkspace &) = delete;
+  TopSortWorkspace &operator=(const TopSortWorkspace &) = delete;
+
+  std::vector<StateId> order;
+  bool acyclic = false;
+  TopOrderVisitor<Arc> top_order_visitor{&order, &acyclic};
+  DfsVisitWorkspace<Fst<Arc>> dfs_workspace;
+};
+
 // Topologically sorts its input if acyclic, modifying it. Otherwise, the input
 // is unchanged. When sorted, all transitions are from lower to higher state
 // IDs.
@@ -87,11 +105,11 @@ class TopOrderVisitor {
 //
 // where V is the number of states and E is the number of arcs.
 template <class Arc>
-bool TopSort(MutableFst<Arc> *fst) {
-  std::vector<typename Arc::StateId> order;
-  bool acyclic;
-  TopOrderVisitor<Arc> top_order_visitor(&order, &acyclic);
-  DfsVisit(*fst, &top_order_visitor);
+bool TopSort(MutableFst<Arc> *fst, TopSortWorkspace<Arc> *workspace) {
+  const auto &order = workspace->order;
+  const bool &acyclic = workspace->acyclic;
+  DfsVisit<Fst<Arc>>(*fst, &workspace->top_order_visitor, AnyArcFilter<Arc>(),
+                     /*access_only=*/false, &workspace->dfs_workspace);
   if (acyclic) {
     StateSort(fst, order);
     fst->SetProperties(kAcyclic | kInitialAcyclic | kTopSorted,
@@ -102,6 +120,13 @@ bool TopSort(MutableFst<Arc> *fst) {
   return acyclic;
 }
 
+// As above, with its own scratch space.
+template <class Arc>
+bool TopSort(MutableFst<Arc> *fst) {
+  TopSortWorkspace<Arc> workspace;
+  return TopSort(fst, &workspace);
+}
+
 }  // namespace fst
 
 #endif  // FST_TOPSORT_H_
@@ -39,6 +39,12 @@ DEFINE_bool(fst_align, false, "Write FST data aligned where appropriate");
 
 DEFINE_string(save_relabel_ipairs, "", "Save input relabel pairs to file");
 DEFINE_string(save_relabel_opairs, "", "Save output relabel pairs to file");
+DEFINE_bool(save_relabel_data, false,
+            "Save relabeling data with lookahead FSTs, so that FSTs can be "
+            "relabeled with them once read back");
+DEFINE_uint64(label_reachable_threads, 1,
+              "Number of threads used to compute label reachability for "
+              "lookahead matchers (0 = one per hardware thread)");
 
 DEFINE_string(fst_read_mode, "read",
               "Default file reading mode for mappable files");
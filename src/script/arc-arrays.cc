@@ -0,0 +1,82 @@
+// Copyright 2005-2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+
+#include <fst/script/arc-arrays.h>
+
+#include <cstdint>
+#include <tuple>
+
+#include <fst/script/script-impl.h>
+
+namespace fst {
+namespace script {
+
+int64_t CountArcs(const FstClass &fst, int64_t state) {
+  FstCountArcsInnerArgs iargs{fst, state};
+  FstCountArcsArgs args(iargs);
+  args.retval = -1;
+  Apply<Operation<FstCountArcsArgs>>("CountArcs", fst.ArcType(), &args);
+  return args.retval;
+}
+
+REGISTER_FST_OPERATION_3ARCS(CountArcs, FstCountArcsArgs);
+
+int64_t CountStates(const FstClass &fst) {
+  FstCountStatesArgs args(fst);
+  args.retval = -1;
+  Apply<Operation<FstCountStatesArgs>>("CountStates", fst.ArcType(), &args);
+  return args.retval;
+}
+
+REGISTER_FST_OPERATION_3ARCS(CountStates, FstCountStatesArgs);
+
+void GetArcArrays(const FstClass &fst, int64_t state,
+                  const ArcArrays &arrays) {
+  FstGetArcArraysArgs args(fst, state, arrays);
+  Apply<Operation<FstGetArcArraysArgs>>("GetArcArrays", fst.ArcType(), &args);
+}
+
+REGISTER_FST_OPERATION_3ARCS(GetArcArrays, FstGetArcArraysArgs);
+
+void GetFinalWeights(const FstClass &fst, double *finals) {
+  FstGetFinalWeightsArgs args(fst, finals);
+  Apply<Operation<FstGetFinalWeightsArgs>>("GetFinalWeights", fst.ArcType(),
+                                           &args);
+}
+
+REGISTER_FST_OPERATION_3ARCS(GetFinalWeights, FstGetFinalWeightsArgs);
+
+bool SetArcArrays(MutableFstClass *fst, int64_t num_states, int64_t start,
+                  const double *finals, int64_t num_arcs,
+                  const ConstArcArrays &arrays) {
+  FstSetArcArraysInnerArgs iargs{fst,
+                                 num_states,
+                                 start,
+                                 finals,
+                                 num_arcs,
+                                 arrays};
+  FstSetArcArraysArgs args(iargs);
+  args.retval = false;
+  Apply<Operation<FstSetArcArraysArgs>>("SetArcArrays", fst->ArcType(),
+                                        &args);
+  return args.retval;
+}
+
+REGISTER_FST_OPERATION_3ARCS(SetArcArrays, FstSetArcArraysArgs);
+
+}  // namespace script
+}  // namespace fst
@@ -17,6 +17,8 @@
 
 #include <fst/script/arcsort.h>
 
+#include <vector>
+
 #include <fst/script/script-impl.h>
 
 namespace fst {
@@ -27,6 +29,15 @@ void ArcSort(MutableFstClass *fst, ArcSortType sort_type) {
   Apply<Operation<FstArcSortArgs>>("ArcSort", fst->ArcType(), &args);
 }
 
+void ArcSort(const std::vector<MutableFstClass *> &fsts,
+             ArcSortType sort_type) {
+  OperationHandle<Operation<FstArcSortArgs>> op("ArcSort");
+  for (auto *fst : fsts) {
+    FstArcSortArgs args{fst, sort_type};
+    if (!op(fst->ArcType(), &args)) fst->SetProperties(kError, kError);
+  }
+}
+
 REGISTER_FST_OPERATION_3ARCS(ArcSort, FstArcSortArgs);
 
 }  // namespace script
@@ -17,6 +17,8 @@
 
 #include <fst/script/connect.h>
 
+#include <vector>
+
 #include <fst/script/script-impl.h>
 
 namespace fst {
@@ -26,6 +28,13 @@ void Connect(MutableFstClass *fst) {
   Apply<Operation<MutableFstClass>>("Connect", fst->ArcType(), fst);
 }
 
+void Connect(const std::vector<MutableFstClass *> &fsts) {
+  OperationHandle<Operation<MutableFstClass>> op("Connect");
+  for (auto *fst : fsts) {
+    if (!op(fst->ArcType(), fst)) fst->SetProperties(kError, kError);
+  }
+}
+
 REGISTER_FST_OPERATION_3ARCS(Connect, MutableFstClass);
 
 }  // namespace script
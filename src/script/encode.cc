@@ -22,12 +22,13 @@
 namespace fst {
 namespace script {
 
-void Encode(MutableFstClass *fst, EncodeMapperClass *mapper) {
+void Encode(MutableFstClass *fst, EncodeMapperClass *mapper,
+            size_t num_threads) {
   if (!internal::ArcTypesMatch(*fst, *mapper, "Encode")) {
     fst->SetProperties(kError, kError);
     return;
   }
-  FstEncodeArgs args{fst, mapper};
+  FstEncodeArgs args{fst, mapper, num_threads};
   Apply<Operation<FstEncodeArgs>>("Encode", fst->ArcType(), &args);
 }
 
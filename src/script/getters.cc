@@ -212,6 +212,22 @@ bool GetReweightType(std::string_view str, ReweightType *reweight_type) {
   return true;
 }
 
+bool GetStateReorderType(std::string_view str,
+                         StateReorderType *reorder_type) {
+  if (str == "bfs") {
+    *reorder_type = StateReorderType::BFS;
+  } else if (str == "dfs") {
+    *reorder_type = StateReorderType::DFS;
+  } else if (str == "rcm") {
+    *reorder_type = StateReorderType::RCM;
+  } else if (str == "frequency") {
+    *reorder_type = StateReorderType::FREQUENCY;
+  } else {
+    return false;
+  }
+  return true;
+}
+
 bool GetTokenType(std::string_view str, TokenType *token_type) {
   if (str == "byte") {
     *token_type = TokenType::BYTE;
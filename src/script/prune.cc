@@ -17,7 +17,9 @@
 
 #include <fst/script/prune.h>
 
+#include <cstddef>
 #include <cstdint>
+#include <vector>
 
 #include <fst/script/script-impl.h>
 
@@ -37,15 +39,30 @@ void Prune(const FstClass &ifst, MutableFstClass *ofst,
 }
 
 void Prune(MutableFstClass *fst, const WeightClass &weight_threshold,
-           int64_t state_threshold, float delta) {
+           int64_t state_threshold, float delta, size_t num_threads) {
   if (!fst->WeightTypesMatch(weight_threshold, "Prune")) {
     fst->SetProperties(kError, kError);
     return;
   }
-  FstPruneArgs2 args{fst, weight_threshold, state_threshold, delta};
+  FstPruneArgs2 args{fst, weight_threshold, state_threshold, delta,
+                     num_threads};
   Apply<Operation<FstPruneArgs2>>("Prune", fst->ArcType(), &args);
 }
 
+void Prune(const std::vector<MutableFstClass *> &fsts,
+           const WeightClass &weight_threshold, int64_t state_threshold,
+           float delta) {
+  OperationHandle<Operation<FstPruneArgs2>> op("Prune");
+  for (auto *fst : fsts) {
+    if (!fst->WeightTypesMatch(weight_threshold, "Prune")) {
+      fst->SetProperties(kError, kError);
+      continue;
+    }
+    FstPruneArgs2 args{fst, weight_threshold, state_threshold, delta, 1};
+    if (!op(fst->ArcType(), &args)) fst->SetProperties(kError, kError);
+  }
+}
+
 REGISTER_FST_OPERATION_3ARCS(Prune, FstPruneArgs1);
 REGISTER_FST_OPERATION_3ARCS(Prune, FstPruneArgs2);
 
@@ -0,0 +1,48 @@
+// Copyright 2005-2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+
+#include <fst/script/reorder.h>
+
+#include <cstdint>
+#include <memory>
+
+#include <fst/script/convert.h>
+#include <fst/script/script-impl.h>
+
+namespace fst {
+namespace script {
+
+void StateReorder(MutableFstClass *fst,
+                  const StateReorderOptions<RandArcSelection> &opts,
+                  uint64_t seed) {
+  FstStateReorderArgs args{fst, opts, seed};
+  Apply<Operation<FstStateReorderArgs>>("StateReorder", fst->ArcType(), &args);
+}
+
+std::unique_ptr<FstClass> StateReorder(
+    const FstClass &fst, const StateReorderOptions<RandArcSelection> &opts,
+    uint64_t seed) {
+  auto ofst = std::make_unique<VectorFstClass>(fst);
+  StateReorder(ofst.get(), opts, seed);
+  if (ofst->FstType() == fst.FstType()) return ofst;
+  return Convert(*ofst, fst.FstType());
+}
+
+REGISTER_FST_OPERATION_3ARCS(StateReorder, FstStateReorderArgs);
+
+}  // namespace script
+}  // namespace fst
@@ -17,6 +17,8 @@
 
 #include <fst/script/shortest-distance.h>
 
+#include <vector>
+
 #include <fst/script/script-impl.h>
 
 namespace fst {
@@ -44,6 +46,19 @@ WeightClass ShortestDistance(const FstClass &fst, double delta) {
   return args.retval;
 }
 
+void ShortestDistance(const std::vector<const FstClass *> &fsts,
+                      std::vector<WeightClass> *distances, double delta) {
+  OperationHandle<Operation<FstShortestDistanceArgs3>> op("ShortestDistance");
+  distances->clear();
+  distances->reserve(fsts.size());
+  for (const auto *fst : fsts) {
+    FstShortestDistanceInnerArgs3 iargs{*fst, delta};
+    FstShortestDistanceArgs3 args(iargs);
+    op(fst->ArcType(), &args);
+    distances->push_back(args.retval);
+  }
+}
+
 REGISTER_FST_OPERATION_3ARCS(ShortestDistance, FstShortestDistanceArgs1);
 REGISTER_FST_OPERATION_3ARCS(ShortestDistance, FstShortestDistanceArgs2);
 REGISTER_FST_OPERATION_3ARCS(ShortestDistance, FstShortestDistanceArgs3);
@@ -0,0 +1,190 @@
+// Copyright 2005-2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Regression test for FST compression.
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fst/flags.h>
+#include <fst/log.h>
+#include <fst/extensions/compress/compress.h>
+#include <fst/arc-map.h>
+#include <fst/expanded-fst.h>
+#include <fst/randequivalent.h>
+#include <fst/vector-fst.h>
+#include <fst/test/rand-fst.h>
+
+DEFINE_uint64(seed, 403, "random seed");
+
+namespace {
+
+using fst::StdArc;
+using fst::StdVectorFst;
+
+// Compresses and decompresses the FST, checking the result is equivalent.
+void TestRoundTrip(const StdVectorFst &ifst, uint64_t seed) {
+  std::stringstream strm;
+  fst::Compressor<StdArc> compressor;
+  CHECK(compressor.Compress(ifst, strm));
+  StdVectorFst decompressed;
+  fst::Compressor<StdArc> decompressor;
+  CHECK(decompressor.Decompress(strm, "stringstream", &decompressed));
+  // States are renumbered, but none are added or removed.
+  CHECK_EQ(decompressed.NumStates(), ifst.NumStates());
+  CHECK_EQ(fst::CountArcs(decompressed), fst::CountArcs(ifst));
+  if (ifst.Start() == fst::kNoStateId) {
+    CHECK_EQ(decompressed.Start(), fst::kNoStateId);
+    return;
+  }
+  const fst::RandGenOptions<fst::UniformArcSelector<StdArc>> opts(
+      fst::UniformArcSelector<StdArc>(seed), /*max_length=*/25);
+  CHECK(fst::RandEquivalent(ifst, decompressed, /*npath=*/100, opts,
+                            fst::kDelta, seed));
+}
+
+// Output of the compressor before its dictionary and bit I/O were rewritten,
+// for the FST of MakeGoldenFst() and for its unweighted version, on a
+// little-endian machine.
+constexpr unsigned char kWeightedGolden[] = {
+    0x32, 0x19, 0xcc, 0x6e, 0x4a, 0x6d, 0xd9, 0x7e, 0x08, 0x00, 0x00, 0x00,
+    0x73, 0x74, 0x61, 0x6e, 0x64, 0x61, 0x72, 0x64, 0x01, 0x03, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x1e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x25, 0x5a, 0x57, 0x45, 0xe8, 0x9d, 0x16, 0x9a, 0xb1, 0x16, 0x9b,
+    0x95, 0x2c, 0xd1, 0x7a, 0x2d, 0x37, 0xa2, 0x2d, 0x32, 0x26, 0x22, 0x7a,
+    0x76, 0x57, 0xa2, 0x91, 0x2a, 0xb4, 0x8b, 0x00, 0x12, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x3f,
+    0x00, 0x00, 0x00, 0x3f, 0x00, 0x00, 0xc0, 0x3f, 0x00, 0x00, 0x80, 0x3f,
+    0x00, 0x00, 0x80, 0x3f, 0x00, 0x00, 0x80, 0x3f, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x3f, 0x00, 0x00, 0xc0, 0x3f, 0x00, 0x00, 0x80, 0x3f,
+    0x00, 0x00, 0x80, 0x3f, 0x00, 0x00, 0x80, 0x3f, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x3f, 0x00, 0x00, 0xc0, 0x3f, 0x00, 0x00, 0x80, 0x3f,
+    0x00, 0x00, 0x80, 0x3f, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x80, 0x3f, 0x00, 0x00, 0x10, 0x40,
+};
+
+constexpr unsigned char kUnweightedGolden[] = {
+    0x32, 0x19, 0xcc, 0x6e, 0x4a, 0x6d, 0xd9, 0x7e, 0x08, 0x00, 0x00, 0x00,
+    0x73, 0x74, 0x61, 0x6e, 0x64, 0x61, 0x72, 0x64, 0x01, 0x03, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x1e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x25, 0x5a, 0x57, 0x45, 0xe8, 0x9d, 0x16, 0x9a, 0xb1, 0x16, 0x9b,
+    0x95, 0x2c, 0xd1, 0x7a, 0x2d, 0x37, 0xa2, 0x2d, 0x32, 0x26, 0x22, 0x7a,
+    0x76, 0x57, 0xa2, 0x91, 0x2a, 0xb4, 0x8b, 0x01,
+};
+
+// Returns a weighted cyclic FST with repeated arc patterns.
+StdVectorFst MakeGoldenFst() {
+  static constexpr int kNumStates = 12;
+  StdVectorFst fst;
+  for (int s = 0; s < kNumStates; ++s) fst.AddState();
+  fst.SetStart(0);
+  for (int s = 0; s < kNumStates; ++s) {
+    fst.EmplaceArc(s, 1 + s % 3, 1 + s % 3, StdArc::Weight(0.5 * (s % 4)),
+                   (s + 1) % kNumStates);
+    if (s % 2 == 0) {
+      fst.EmplaceArc(s, 2, 2, StdArc::Weight(1), (s + 3) % kNumStates);
+    }
+    if (s % 5 == 4) fst.SetFinal(s, StdArc::Weight(0.25 * s));
+  }
+  return fst;
+}
+
+// Checks the compressed format is unchanged: the FST compresses to the golden
+// bytes, which decompress to an FST compressing to the same bytes.
+void CheckGolden(const StdVectorFst &ifst, std::string_view golden) {
+  std::stringstream strm;
+  fst::Compressor<StdArc> compressor;
+  CHECK(compressor.Compress(ifst, strm));
+  CHECK(strm.str() == golden);
+  std::stringstream istrm{std::string(golden)};
+  StdVectorFst decompressed;
+  fst::Compressor<StdArc> decompressor;
+  CHECK(decompressor.Decompress(istrm, "golden", &decompressed));
+  CHECK_EQ(decompressed.NumStates(), ifst.NumStates());
+  std::stringstream ostrm;
+  fst::Compressor<StdArc> recompressor;
+  CHECK(recompressor.Compress(decompressed, ostrm));
+  CHECK(ostrm.str() == golden);
+}
+
+template <size_t n>
+std::string_view AsBytes(const unsigned char (&data)[n]) {
+  return std::string_view(reinterpret_cast<const char *>(data), n);
+}
+
+void TestGolden() {
+  // The golden bytes are those of a little-endian machine.
+  const uint32_t one = 1;
+  if (*reinterpret_cast<const char *>(&one) != 1) return;
+  auto fst = MakeGoldenFst();
+  CheckGolden(fst, AsBytes(kWeightedGolden));
+  fst::ArcMap(&fst, fst::RmWeightMapper<StdArc>());
+  CheckGolden(fst, AsBytes(kUnweightedGolden));
+}
+
+void TestCompress() {
+  fst::WeightGenerate<StdArc::Weight> generate(FST_FLAGS_seed,
+                                               /*allow_zero=*/false);
+  std::vector<StdVectorFst> fsts;
+  // The empty FST.
+  fsts.emplace_back();
+  // A single final state.
+  fsts.emplace_back();
+  fsts.back().SetStart(fsts.back().AddState());
+  fsts.back().SetFinal(0, StdArc::Weight(1.5));
+  // A single state with self-loops.
+  fsts.emplace_back(fsts.back());
+  fsts.back().EmplaceArc(0, 1, 2, StdArc::Weight(0.5), 0);
+  fsts.back().EmplaceArc(0, 0, 3, StdArc::Weight(2), 0);
+  // Random FSTs, weighted and unweighted.
+  for (int i = 0; i < 10; ++i) {
+    auto &rfst = fsts.emplace_back();
+    fst::RandFst<StdArc>(/*num_random_states=*/10, /*num_random_arcs=*/5,
+                         /*num_random_labels=*/5, /*acyclic_prob=*/0.25,
+                         generate, FST_FLAGS_seed + i, &rfst);
+    if (i % 2) fst::ArcMap(&rfst, fst::RmWeightMapper<StdArc>());
+  }
+  for (size_t i = 0; i < fsts.size(); ++i) {
+    TestRoundTrip(fsts[i], FST_FLAGS_seed + i);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::set_new_handler(FailedNewHandler);
+  SET_FLAGS(argv[0], &argc, &argv, true);
+
+  TestGolden();
+  TestCompress();
+
+  std::cout << "PASS" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,447 @@
+// Copyright 2005-2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Regression test for FST archives.
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fst/flags.h>
+#include <fst/log.h>
+#include <fst/extensions/far/far.h>
+#include <fst/extensions/far/shortest-path.h>
+#include <fstream>
+#include <fst/equal.h>
+#include <fst/shortest-path.h>
+#include <fst/vector-fst.h>
+#include <fst/test/rand-fst.h>
+
+DEFINE_uint64(seed, 403, "random seed");
+
+namespace {
+
+using fst::FarReader;
+using fst::FarType;
+using fst::FarWriter;
+using fst::StdArc;
+using fst::StdVectorFst;
+
+// Returns an acceptor of the string of labels 1, 2, ..., n.
+StdVectorFst MakeString(int n) {
+  StdVectorFst fst;
+  auto s = fst.AddState();
+  fst.SetStart(s);
+  for (int i = 1; i <= n; ++i) {
+    const auto nextstate = fst.AddState();
+    fst.AddArc(s, StdArc(i, i, StdArc::Weight(i), nextstate));
+    s = nextstate;
+  }
+  fst.SetFinal(s, StdArc::Weight::One());
+  return fst;
+}
+
+// Reads all entries, checking they are those of the given keys and FSTs.
+void CheckEntries(FarReader<StdArc> *reader,
+                  const std::vector<std::string> &keys,
+                  const std::vector<StdVectorFst> &fsts) {
+  CHECK(reader);
+  size_t i = 0;
+  for (; !reader->Done(); reader->Next(), ++i) {
+    CHECK_LT(i, keys.size());
+    CHECK_EQ(reader->GetKey(), keys[i]);
+    CHECK(fst::Equal(*reader->GetFst(), fsts[i]));
+  }
+  CHECK(!reader->Error());
+  CHECK_EQ(i, keys.size());
+}
+
+// Read-only, unseekable stream buffer, standing in for a pipe.
+class PipeStreamBuf : public std::streambuf {
+ public:
+  explicit PipeStreamBuf(std::string data) : data_(std::move(data)) {
+    setg(data_.data(), data_.data(), data_.data() + data_.size());
+  }
+
+ private:
+  std::string data_;
+};
+
+// Reads FSTs from memory; a null FST stands for an unreadable entry.
+class MemoryFarReader : public FarReader<StdArc> {
+ public:
+  MemoryFarReader(std::vector<std::string> keys,
+                  std::vector<std::unique_ptr<StdVectorFst>> fsts)
+      : keys_(std::move(keys)), fsts_(std::move(fsts)) {}
+
+  void Reset() final { pos_ = 0; }
+
+  bool Find(std::string_view key) final { return false; }
+
+  bool Done() const final { return pos_ >= keys_.size(); }
+
+  void Next() final { ++pos_; }
+
+  const std::string &GetKey() const final { return keys_[pos_]; }
+
+  const fst::Fst<StdArc> *GetFst() const final { return fsts_[pos_].get(); }
+
+  FarType Type() const final { return FarType::DEFAULT; }
+
+  bool Error() const final { return false; }
+
+ private:
+  std::vector<std::string> keys_;
+  std::vector<std::unique_ptr<StdVectorFst>> fsts_;
+  size_t pos_ = 0;
+};
+
+// Writes FSTs to memory.
+class MemoryFarWriter : public FarWriter<StdArc> {
+ public:
+  void Add(std::string_view key, const fst::Fst<StdArc> &fst) final {
+    keys.emplace_back(key);
+    fsts.emplace_back(fst);
+  }
+
+  FarType Type() const final { return FarType::DEFAULT; }
+
+  bool Error() const final { return false; }
+
+  std::vector<std::string> keys;
+  std::vector<StdVectorFst> fsts;
+};
+
+void TestSTStreamRoundTrip() {
+  const std::string source = FST_FLAGS_tmpdir + "/far_test.ststream";
+  std::vector<std::string> keys;
+  std::vector<StdVectorFst> fsts;
+  for (int i = 0; i < 5; ++i) {
+    keys.push_back("key" + std::to_string(i));
+    fsts.push_back(MakeString(i));
+  }
+  // Writes the first three entries, then appends the other two.
+  {
+    std::unique_ptr<FarWriter<StdArc>> writer(
+        FarWriter<StdArc>::Create(source, FarType::STSTREAM));
+    CHECK(writer);
+    for (int i = 0; i < 3; ++i) writer->Add(keys[i], fsts[i]);
+    CHECK(!writer->Error());
+  }
+  {
+    std::unique_ptr<FarWriter<StdArc>> writer(FarWriter<StdArc>::Create(
+        source, FarType::STSTREAM, /*append=*/true));
+    CHECK(writer);
+    for (int i = 3; i < 5; ++i) writer->Add(keys[i], fsts[i]);
+    CHECK(!writer->Error());
+  }
+  // Only STStream FARs can be appended to.
+  CHECK(!FarWriter<StdArc>::Create(source + ".stlist", FarType::STLIST,
+                                   /*append=*/true));
+  {
+    std::unique_ptr<FarReader<StdArc>> reader(FarReader<StdArc>::Open(source));
+    CHECK(reader);
+    CHECK(reader->Type() == FarType::STSTREAM);
+    CheckEntries(reader.get(), keys, fsts);
+    reader->Reset();
+    CheckEntries(reader.get(), keys, fsts);
+  }
+  // Reads the archive from an unseekable stream; the type is found by peeking,
+  // without consuming the input.
+  {
+    std::ifstream istrm(source, std::ios_base::in | std::ios_base::binary);
+    std::string data((std::istreambuf_iterator<char>(istrm)),
+                     std::istreambuf_iterator<char>());
+    PipeStreamBuf buf(data);
+    auto strm = std::make_unique<std::istream>(&buf);
+    CHECK_EQ(strm->tellg(), std::streampos(-1));
+    FarType type;
+    CHECK(fst::internal::PeekFarType(*strm, &type));
+    CHECK(type == FarType::STSTREAM);
+    const std::vector<std::string> sources{source};
+    std::unique_ptr<FarReader<StdArc>> reader(
+        fst::STStreamFarReader<StdArc>::Open(sources, std::move(strm)));
+    CheckEntries(reader.get(), keys, fsts);
+  }
+  std::remove(source.c_str());
+}
+
+// Returns the size of the file.
+std::streamoff FileSize(const std::string &source) {
+  std::ifstream istrm(source, std::ios_base::in | std::ios_base::binary |
+                                  std::ios_base::ate);
+  return istrm.tellg();
+}
+
+// Reads all entries, checking they are those of the given keys and FSTs and
+// that the reader reports an error.
+void CheckDamagedEntries(FarReader<StdArc> *reader,
+                         const std::vector<std::string> &keys,
+                         const std::vector<StdVectorFst> &fsts) {
+  CHECK(reader);
+  size_t i = 0;
+  for (; !reader->Done(); reader->Next(), ++i) {
+    CHECK_LT(i, keys.size());
+    CHECK_EQ(reader->GetKey(), keys[i]);
+    CHECK(fst::Equal(*reader->GetFst(), fsts[i]));
+  }
+  CHECK_EQ(i, keys.size());
+  CHECK(reader->Error());
+}
+
+void TestSTStreamDamage() {
+  const std::string source = FST_FLAGS_tmpdir + "/far_test.ststream";
+  std::vector<std::string> keys;
+  std::vector<StdVectorFst> fsts;
+  std::vector<std::streamoff> ends;
+  for (int i = 0; i < 5; ++i) {
+    keys.push_back("key" + std::to_string(i));
+    fsts.push_back(MakeString(i + 1));
+    std::unique_ptr<FarWriter<StdArc>> writer(FarWriter<StdArc>::Create(
+        source, FarType::STSTREAM, /*append=*/i > 0));
+    CHECK(writer);
+    writer->Add(keys[i], fsts[i]);
+    CHECK(!writer->Error());
+    writer.reset();
+    ends.push_back(FileSize(source));
+  }
+  std::string data;
+  {
+    std::ifstream istrm(source, std::ios_base::in | std::ios_base::binary);
+    data.assign(std::istreambuf_iterator<char>(istrm),
+                std::istreambuf_iterator<char>());
+  }
+  const auto write_data = [&source](std::string_view data) {
+    std::ofstream ostrm(source, std::ios_base::out | std::ios_base::binary);
+    ostrm.write(data.data(), data.size());
+  };
+  // Flips a byte in the middle of the third frame: the other entries are read.
+  std::string damaged = data;
+  damaged[(ends[1] + ends[2]) / 2] ^= 0x5a;
+  write_data(damaged);
+  const std::vector<std::string> intact_keys{keys[0], keys[1], keys[3],
+                                             keys[4]};
+  const std::vector<StdVectorFst> intact_fsts{fsts[0], fsts[1], fsts[3],
+                                              fsts[4]};
+  {
+    std::unique_ptr<FarReader<StdArc>> reader(FarReader<StdArc>::Open(source));
+    CheckDamagedEntries(reader.get(), intact_keys, intact_fsts);
+    // Resetting clears the error until the damaged frame is reached again.
+    reader->Reset();
+    CHECK(!reader->Error());
+    CheckDamagedEntries(reader.get(), intact_keys, intact_fsts);
+  }
+  // Damage to the first frame does not fail opening.
+  damaged = data;
+  damaged[ends[0] - 1] ^= 0x5a;
+  write_data(damaged);
+  {
+    std::unique_ptr<FarReader<StdArc>> reader(FarReader<StdArc>::Open(source));
+    CheckDamagedEntries(
+        reader.get(), std::vector<std::string>(keys.begin() + 1, keys.end()),
+        std::vector<StdVectorFst>(fsts.begin() + 1, fsts.end()));
+  }
+  // Cuts the last frame short: the entries before it are read.
+  write_data(std::string_view(data).substr(0, ends[4] - 3));
+  {
+    std::unique_ptr<FarReader<StdArc>> reader(FarReader<StdArc>::Open(source));
+    CheckDamagedEntries(
+        reader.get(), std::vector<std::string>(keys.begin(), keys.end() - 1),
+        std::vector<StdVectorFst>(fsts.begin(), fsts.end() - 1));
+  }
+  // An intact archive reports no error.
+  write_data(data);
+  {
+    std::unique_ptr<FarReader<StdArc>> reader(FarReader<StdArc>::Open(source));
+    CheckEntries(reader.get(), keys, fsts);
+  }
+  std::remove(source.c_str());
+}
+
+void TestFarTypeDetection() {
+  const std::vector<std::string> keys{"a", "b"};
+  const std::vector<StdVectorFst> fsts{MakeString(1), MakeString(2)};
+  for (const auto type : {FarType::STLIST, FarType::STTABLE,
+                          FarType::STSTREAM}) {
+    const std::string source = FST_FLAGS_tmpdir + "/far_test.far";
+    {
+      std::unique_ptr<FarWriter<StdArc>> writer(
+          FarWriter<StdArc>::Create(source, type));
+      CHECK(writer);
+      for (size_t i = 0; i < keys.size(); ++i) writer->Add(keys[i], fsts[i]);
+    }
+    std::ifstream istrm(source, std::ios_base::in | std::ios_base::binary);
+    FarType peeked;
+    CHECK(fst::internal::PeekFarType(istrm, &peeked));
+    CHECK(peeked == type);
+    CHECK_EQ(istrm.tellg(), std::streampos(0));
+    std::unique_ptr<FarReader<StdArc>> reader(FarReader<StdArc>::Open(source));
+    CHECK(reader);
+    CHECK(reader->Type() == type);
+    CheckEntries(reader.get(), keys, fsts);
+    std::remove(source.c_str());
+  }
+}
+
+// Checks that prefetching does not change what is read, including after
+// seeking, and that an unreadable entry ends the iteration with an error.
+void TestPrefetchFarReader() {
+  static constexpr int kNumFsts = 10;
+  const std::string source = FST_FLAGS_tmpdir + "/far_test.sttable";
+  std::vector<std::string> keys;
+  std::vector<StdVectorFst> fsts;
+  for (int i = 0; i < kNumFsts; ++i) {
+    keys.push_back("key" + std::to_string(i));
+    fsts.push_back(MakeString(i));
+  }
+  {
+    std::unique_ptr<FarWriter<StdArc>> writer(
+        FarWriter<StdArc>::Create(source, FarType::STTABLE));
+    CHECK(writer);
+    for (int i = 0; i < kNumFsts; ++i) writer->Add(keys[i], fsts[i]);
+    CHECK(!writer->Error());
+  }
+  for (const size_t prefetch : {1, 2, 4, 32}) {
+    std::unique_ptr<FarReader<StdArc>> reader(
+        fst::PrefetchFarReader<StdArc>::Open(FarReader<StdArc>::Open(source),
+                                             prefetch));
+    CHECK(reader);
+    CHECK(reader->Type() == FarType::STTABLE);
+    CheckEntries(reader.get(), keys, fsts);
+    // Seeks and resets after reading only part of the archive, while entries
+    // are still being prefetched.
+    reader->Reset();
+    for (int i = 0; i < 3; ++i) {
+      CHECK(!reader->Done());
+      CHECK_EQ(reader->GetKey(), keys[i]);
+      reader->Next();
+    }
+    CHECK(reader->Find(keys[6]));
+    CheckEntries(reader.get(), {keys.begin() + 6, keys.end()},
+                 {fsts.begin() + 6, fsts.end()});
+    CHECK(reader->Find(keys[1]));
+    CHECK_EQ(reader->GetKey(), keys[1]);
+    CHECK(fst::Equal(*reader->GetFst(), fsts[1]));
+    reader->Reset();
+    CheckEntries(reader.get(), keys, fsts);
+  }
+  std::remove(source.c_str());
+  // The entries before an unreadable one are read; then the iteration ends
+  // with an error, also when read again after Reset().
+  const bool error_fatal = FST_FLAGS_fst_error_fatal;
+  FST_FLAGS_fst_error_fatal = false;
+  std::vector<std::unique_ptr<StdVectorFst>> copies;
+  for (int i = 0; i < kNumFsts; ++i) {
+    copies.push_back(i == 3 ? nullptr
+                            : std::make_unique<StdVectorFst>(fsts[i]));
+  }
+  std::unique_ptr<FarReader<StdArc>> reader(
+      fst::PrefetchFarReader<StdArc>::Open(
+          new MemoryFarReader(keys, std::move(copies)), 2));
+  for (int pass = 0; pass < 2; ++pass) {
+    int i = 0;
+    for (; !reader->Done(); reader->Next(), ++i) {
+      CHECK_EQ(reader->GetKey(), keys[i]);
+      CHECK(fst::Equal(*reader->GetFst(), fsts[i]));
+    }
+    CHECK_EQ(i, 3);
+    CHECK(reader->Error());
+    reader->Reset();
+  }
+  FST_FLAGS_fst_error_fatal = error_fatal;
+}
+
+// Checks the FAR shortest path against ShortestPath on each FST, for several
+// numbers of threads and batch sizes.
+void TestFarShortestPath() {
+  static constexpr int kNumFsts = 20;
+  fst::WeightGenerate<StdArc::Weight> generate(FST_FLAGS_seed,
+                                               /*allow_zero=*/false);
+  std::vector<std::string> keys;
+  std::vector<StdVectorFst> fsts(kNumFsts);
+  for (int i = 0; i < kNumFsts; ++i) {
+    keys.push_back("key" + std::to_string(i));
+    fst::RandFst<StdArc>(/*num_random_states=*/10, /*num_random_arcs=*/5,
+                         /*num_random_labels=*/5, /*acyclic_prob=*/0.25,
+                         generate, FST_FLAGS_seed + i, &fsts[i]);
+  }
+  const auto make_reader = [&keys, &fsts]() {
+    std::vector<std::unique_ptr<StdVectorFst>> copies;
+    for (const auto &fst : fsts) {
+      copies.push_back(std::make_unique<StdVectorFst>(fst));
+    }
+    return MemoryFarReader(keys, std::move(copies));
+  };
+  for (const int32_t nshortest : {1, 3}) {
+    std::vector<StdVectorFst> expected(kNumFsts);
+    for (int i = 0; i < kNumFsts; ++i) {
+      fst::ShortestPath(fsts[i], &expected[i], nshortest);
+    }
+    for (const size_t num_threads : {1, 4}) {
+      for (const size_t batch_size : {1, 3, 1024}) {
+        auto reader = make_reader();
+        MemoryFarWriter writer;
+        CHECK(fst::ShortestPath(reader, writer, nshortest, /*unique=*/false,
+                                StdArc::Weight::Zero(), fst::kNoStateId,
+                                fst::kShortestDelta, num_threads,
+                                batch_size));
+        CHECK(writer.keys == keys);
+        for (int i = 0; i < kNumFsts; ++i) {
+          CHECK(fst::Equal(writer.fsts[i], expected[i]));
+        }
+      }
+    }
+  }
+  // An unreadable entry fails the search; the earlier batches are written.
+  std::vector<std::unique_ptr<StdVectorFst>> copies;
+  for (int i = 0; i < kNumFsts; ++i) {
+    copies.push_back(i == 5 ? nullptr
+                            : std::make_unique<StdVectorFst>(fsts[i]));
+  }
+  MemoryFarReader reader(keys, std::move(copies));
+  MemoryFarWriter writer;
+  CHECK(!fst::ShortestPath(reader, writer, 1, /*unique=*/false,
+                           StdArc::Weight::Zero(), fst::kNoStateId,
+                           fst::kShortestDelta, /*num_threads=*/2,
+                           /*batch_size=*/4));
+  CHECK_EQ(writer.keys.size(), 4);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::set_new_handler(FailedNewHandler);
+  SET_FLAGS(argv[0], &argc, &argv, true);
+
+  TestSTStreamRoundTrip();
+  TestSTStreamDamage();
+  TestFarTypeDetection();
+  TestPrefetchFarReader();
+  TestFarShortestPath();
+
+  std::cout << "PASS" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,229 @@
+// Copyright 2005-2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the 'License');
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an 'AS IS' BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// See www.openfst.org for extensive documentation on this weighted
+// finite-state transducer library.
+//
+// Regression test for script-level operations.
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include <fst/flags.h>
+#include <fst/log.h>
+#include <fst/arc.h>
+#include <fst/const-fst.h>
+#include <fst/float-weight.h>
+#include <fst/properties.h>
+#include <fst/reorder.h>
+#include <fst/vector-fst.h>
+#include <fst/script/arcsort.h>
+#include <fst/script/connect.h>
+#include <fst/script/equal.h>
+#include <fst/script/fst-class.h>
+#include <fst/script/prune.h>
+#include <fst/script/reorder.h>
+#include <fst/script/shortest-distance.h>
+#include <fst/script/weight-class.h>
+#include <fst/test/rand-fst.h>
+
+DEFINE_uint64(seed, 403, "random seed");
+
+namespace {
+
+namespace s = fst::script;
+
+using fst::LogArc;
+using fst::StdArc;
+
+// An arc type with no registered script operations.
+using UnregisteredArc = fst::ArcTpl<fst::TropicalWeightTpl<double>>;
+
+using FstList = std::vector<std::unique_ptr<s::VectorFstClass>>;
+
+constexpr int kNumFsts = 10;
+
+template <class Arc>
+std::unique_ptr<s::VectorFstClass> MakeRandFst(uint64_t seed) {
+  fst::WeightGenerate<typename Arc::Weight> generate(seed,
+                                                     /*allow_zero=*/false);
+  fst::VectorFst<Arc> fst;
+  fst::RandFst<Arc>(/*num_random_states=*/10, /*num_random_arcs=*/5,
+                    /*num_random_labels=*/5, /*acyclic_prob=*/0.25, generate,
+                    seed, &fst);
+  return std::make_unique<s::VectorFstClass>(fst);
+}
+
+// Returns random FSTs, of the standard arc type if std_only, and otherwise
+// alternating in runs between the standard and log arc types. The same seed
+// gives the same FSTs.
+FstList MakeFsts(uint64_t seed, bool std_only) {
+  FstList fsts;
+  for (int i = 0; i < kNumFsts; ++i) {
+    if (std_only || i % 4 < 2) {
+      fsts.push_back(MakeRandFst<StdArc>(seed + i));
+    } else {
+      fsts.push_back(MakeRandFst<LogArc>(seed + i));
+    }
+  }
+  return fsts;
+}
+
+std::vector<s::MutableFstClass *> Pointers(const FstList &fsts) {
+  std::vector<s::MutableFstClass *> pointers;
+  for (const auto &fst : fsts) pointers.push_back(fst.get());
+  return pointers;
+}
+
+std::vector<const s::FstClass *> ConstPointers(const FstList &fsts) {
+  std::vector<const s::FstClass *> pointers;
+  for (const auto &fst : fsts) pointers.push_back(fst.get());
+  return pointers;
+}
+
+void CheckEqual(const FstList &fsts1, const FstList &fsts2) {
+  CHECK_EQ(fsts1.size(), fsts2.size());
+  for (size_t i = 0; i < fsts1.size(); ++i) {
+    CHECK_EQ(fsts1[i]->ArcType(), fsts2[i]->ArcType());
+    CHECK(!fsts1[i]->Properties(fst::kError, false));
+    CHECK(s::Equal(*fsts1[i], *fsts2[i]));
+  }
+}
+
+// Checks each batch operation against the operation applied to each FST.
+void TestBatchOperations(bool std_only) {
+  const uint64_t seed = FST_FLAGS_seed;
+  {
+    auto fsts = MakeFsts(seed, std_only);
+    auto expected = MakeFsts(seed, std_only);
+    s::Connect(Pointers(fsts));
+    for (auto &fst : expected) s::Connect(fst.get());
+    CheckEqual(fsts, expected);
+  }
+  for (const auto sort_type : {s::ArcSortType::ILABEL,
+                               s::ArcSortType::OLABEL}) {
+    auto fsts = MakeFsts(seed, std_only);
+    auto expected = MakeFsts(seed, std_only);
+    s::ArcSort(Pointers(fsts), sort_type);
+    for (auto &fst : expected) s::ArcSort(fst.get(), sort_type);
+    CheckEqual(fsts, expected);
+  }
+  {
+    const auto fsts = MakeFsts(seed, std_only);
+    std::vector<s::WeightClass> distances;
+    s::ShortestDistance(ConstPointers(fsts), &distances);
+    CHECK_EQ(distances.size(), fsts.size());
+    for (size_t i = 0; i < fsts.size(); ++i) {
+      CHECK_EQ(distances[i].Type(), fsts[i]->WeightType());
+      CHECK(distances[i] == s::ShortestDistance(*fsts[i]));
+    }
+  }
+  if (std_only) {
+    const s::WeightClass threshold(fst::TropicalWeight(2.0));
+    auto fsts = MakeFsts(seed, std_only);
+    auto expected = MakeFsts(seed, std_only);
+    s::Prune(Pointers(fsts), threshold, /*state_threshold=*/8);
+    for (auto &fst : expected) s::Prune(fst.get(), threshold, 8);
+    CheckEqual(fsts, expected);
+  }
+}
+
+// Checks that FSTs of the wrong weight or arc type get an error, without
+// affecting the other FSTs of the batch.
+void TestBatchErrors() {
+  const bool error_fatal = FST_FLAGS_fst_error_fatal;
+  FST_FLAGS_fst_error_fatal = false;
+  const uint64_t seed = FST_FLAGS_seed;
+  {
+    // The log FSTs do not match the weight type of the threshold.
+    const s::WeightClass threshold(fst::TropicalWeight(2.0));
+    auto fsts = MakeFsts(seed, /*std_only=*/false);
+    auto expected = MakeFsts(seed, /*std_only=*/false);
+    s::Prune(Pointers(fsts), threshold);
+    for (size_t i = 0; i < fsts.size(); ++i) {
+      if (fsts[i]->ArcType() == StdArc::Type()) {
+        s::Prune(expected[i].get(), threshold);
+        CHECK(!fsts[i]->Properties(fst::kError, false));
+        CHECK(s::Equal(*fsts[i], *expected[i]));
+      } else {
+        CHECK(fsts[i]->Properties(fst::kError, false));
+      }
+    }
+  }
+  {
+    FstList fsts;
+    FstList expected;
+    for (const uint64_t i : {0, 1, 2}) {
+      fsts.push_back(i == 1 ? MakeRandFst<UnregisteredArc>(seed + i)
+                            : MakeRandFst<StdArc>(seed + i));
+      expected.push_back(i == 1 ? MakeRandFst<UnregisteredArc>(seed + i)
+                                : MakeRandFst<StdArc>(seed + i));
+    }
+    std::vector<s::WeightClass> distances;
+    s::ShortestDistance(ConstPointers(fsts), &distances);
+    CHECK_EQ(distances.size(), fsts.size());
+    CHECK_EQ(distances[1].Type(), "none");
+    for (const int i : {0, 2}) {
+      CHECK(distances[i] == s::ShortestDistance(*fsts[i]));
+    }
+    s::Connect(Pointers(fsts));
+    for (const int i : {0, 2}) {
+      s::Connect(expected[i].get());
+      CHECK(!fsts[i]->Properties(fst::kError, false));
+      CHECK(s::Equal(*fsts[i], *expected[i]));
+    }
+    CHECK(fsts[1]->Properties(fst::kError, false));
+  }
+  FST_FLAGS_fst_error_fatal = error_fatal;
+}
+
+// Checks that reordering a ConstFst gives a ConstFst with the states
+// renumbered, as fstreorder writes it.
+void TestReorderKeepsType() {
+  const uint64_t seed = FST_FLAGS_seed;
+  for (const auto type : {fst::StateReorderType::BFS,
+                          fst::StateReorderType::DFS,
+                          fst::StateReorderType::RCM}) {
+    const auto vfst = MakeRandFst<StdArc>(seed);
+    const fst::ConstFst<StdArc> cfst(*vfst->GetFst<StdArc>());
+    const s::FstClass ifst(cfst);
+    const fst::StateReorderOptions<s::RandArcSelection> opts(
+        type, s::RandArcSelection::UNIFORM);
+    const auto ofst = s::StateReorder(ifst, opts, seed);
+    CHECK(ofst);
+    CHECK_EQ(ofst->FstType(), cfst.Type());
+    s::VectorFstClass expected(*vfst);
+    s::StateReorder(&expected, opts, seed);
+    CHECK(s::Equal(*ofst, expected));
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::set_new_handler(FailedNewHandler);
+  SET_FLAGS(argv[0], &argc, &argv, true);
+
+  TestBatchOperations(/*std_only=*/true);
+  TestBatchOperations(/*std_only=*/false);
+  TestBatchErrors();
+  TestReorderKeepsType();
+
+  std::cout << "PASS" << std::endl;
+
+  return 0;
+}